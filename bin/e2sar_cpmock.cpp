@@ -0,0 +1,306 @@
+/**
+ * E2SAR CP Mock - in-process stand-in for the load balancer control plane (udplbd)
+ *
+ * Serves the LoadBalancer gRPC service from memory with configurable latency and
+ * error injection so lbadm, e2sar_perf and applications can be run without a real
+ * load balancer. Optionally runs the LB data plane emulator next to it and/or drives
+ * a number of simulated workers sending state to benchmark the control loop.
+ */
+
+#include <signal.h>
+#include <math.h>
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <boost/program_options.hpp>
+
+#include "e2sar.hpp"
+#include "e2sarCPMock.hpp"
+#include "e2sarLBEmu.hpp"
+
+namespace po = boost::program_options;
+using namespace e2sar;
+using namespace std::string_literals;
+
+// Control flags
+std::atomic<bool> keepRunning{true};
+
+/**
+ * Signal handler for graceful shutdown (Ctrl-C)
+ */
+void signalHandler(int sig)
+{
+    keepRunning = false;
+}
+
+/**
+ * Print mock server statistics to stdout
+ */
+void printStats(const LBMockServer &mock, const LBMockServer::ReportedStats &prev, double elapsedSec)
+{
+    auto stats = mock.getStats();
+    std::cout << "\nStatistics:" << std::endl;
+    std::cout << "  Workers:            " << mock.get_numWorkers() << std::endl;
+    std::cout << "  SendState calls:    " << stats.sendStateCalls << " (" <<
+        static_cast<u_int64_t>((stats.sendStateCalls - prev.sendStateCalls) /
+        std::max(elapsedSec, 0.001)) << "/s)" << std::endl;
+    std::cout << "  Register/Deregister:" << stats.registerCalls << "/" << stats.deregisterCalls << std::endl;
+    std::cout << "  Reserve/Free:       " << stats.reserveCalls << "/" << stats.freeCalls << std::endl;
+    std::cout << "  Other calls:        " << stats.otherCalls << std::endl;
+    std::cout << "  Injected errors:    " << stats.injectedErrors << std::endl;
+    std::cout << "  Auth errors:        " << stats.authErrors << std::endl;
+}
+
+/**
+ * Simulated workers each sending state at a fixed rate through their own LBManager
+ */
+class WorkerSimulation
+{
+    private:
+        LBManager admin;
+        std::vector<std::unique_ptr<LBManager>> workers;
+        u_int32_t deadline_ms;
+
+    public:
+        WorkerSimulation(const std::string &uri, u_int32_t dl_ms): admin{EjfatURI(uri)}, deadline_ms{dl_ms} {}
+
+        result<int> start(size_t numWorkers)
+        {
+            auto res = admin.reserveLB("e2sar_cpmock_sim", 0.0, std::vector<std::string>());
+            if (res.has_error())
+                return res.error();
+            for(size_t i = 0; i < numWorkers; i++)
+            {
+                workers.emplace_back(std::make_unique<LBManager>(admin.get_URI()));
+                auto regRes = workers.back()->registerWorker("sim"s + std::to_string(i),
+                    std::make_pair(ip::make_address("127.0.0.1"), static_cast<u_int16_t>(20000 + i)),
+                    1.0, 1, 1.0, 1.0);
+                if (regRes.has_error())
+                    return regRes.error();
+            }
+            return 0;
+        }
+
+        // one round of state updates, fill levels follow phase-shifted sine waves
+        void sendRound(double t)
+        {
+            WorkerStats ws;
+            for(size_t i = 0; i < workers.size(); i++)
+            {
+                float fill = 0.5 + 0.4 * sin(t + i);
+                workers[i]->sendStateAsync(fill, 0.5 - fill, true, ws, deadline_ms);
+            }
+        }
+
+        // aggregate async sendState statistics over all workers
+        void printStats()
+        {
+            u_int64_t sent{0}, completed{0}, failed{0}, deadlineExceeded{0}, coalesced{0};
+            LatencyHistogram::Snapshot lat;
+            lat.counts.resize(LatencyHistogram::NUM_BUCKETS);
+            for(auto &w: workers)
+            {
+                auto s = w->getSendStateStats();
+                sent += s.sent;
+                completed += s.completed;
+                failed += s.failed;
+                deadlineExceeded += s.deadlineExceeded;
+                coalesced += s.coalesced;
+                if (s.rpcLatency.count == 0)
+                    continue;
+                for(size_t b = 0; b < lat.counts.size(); b++)
+                    lat.counts[b] += s.rpcLatency.counts[b];
+                lat.mean = (lat.mean * lat.count + s.rpcLatency.mean * s.rpcLatency.count) /
+                    (lat.count + s.rpcLatency.count);
+                lat.min = (lat.count == 0) ? s.rpcLatency.min : std::min(lat.min, s.rpcLatency.min);
+                lat.max = std::max(lat.max, s.rpcLatency.max);
+                lat.count += s.rpcLatency.count;
+            }
+            std::cout << "  Simulated workers:  " << workers.size() << std::endl;
+            std::cout << "  RPCs sent:          " << sent << " completed " << completed << " failed " << failed <<
+                " (deadline " << deadlineExceeded << ") coalesced " << coalesced << std::endl;
+            std::cout << "  RPC latency (us):   mean " << lat.mean / 1000 << " p50 " << lat.percentile(50) / 1000 <<
+                " p99 " << lat.percentile(99) / 1000 << " max " << lat.max / 1000 << std::endl;
+        }
+
+        void stop()
+        {
+            for(auto &w: workers)
+                w->deregisterWorker();
+            workers.clear();
+            admin.freeLB();
+        }
+};
+
+int main(int argc, char **argv)
+{
+    po::options_description od("Command-line options");
+
+    auto opts = od.add_options()(
+        "help,h", "Show this help message"
+    );
+
+    std::string listenStr, dataStr, syncStr, adminToken;
+    u_int32_t latency, jitter, deadline, reportSec, duration;
+    float errorRate, rate;
+    int errorCode;
+    size_t maxSamples, simulate;
+
+    opts("listen,l", po::value<std::string>(&listenStr)->default_value("127.0.0.1:18008"), "Address and port to serve gRPC on (e.g., \"127.0.0.1:18008\" or \"[::1]:18008\")");
+    opts("token", po::value<std::string>(&adminToken)->default_value("mock"), "Admin token accepted on every call");
+    opts("data", po::value<std::string>(&dataStr)->default_value("127.0.0.1"), "Data plane IPv4 address handed out in reservations");
+    opts("sync", po::value<std::string>(&syncStr)->default_value("127.0.0.1:19010"), "Sync address and port handed out in reservations");
+    opts("emulate", "Also run the LB data plane emulator on the data address and port 19522, workers follow Register/Deregister");
+    opts("latency", po::value<u_int32_t>(&latency)->default_value(0), "Response latency added to every call in ms");
+    opts("jitter", po::value<u_int32_t>(&jitter)->default_value(0), "Uniformly distributed [0, jitter] ms added to the latency");
+    opts("error-rate", po::value<float>(&errorRate)->default_value(0.0), "Probability of failing a call [0.0, 1.0]");
+    opts("error-code", po::value<int>(&errorCode)->default_value(static_cast<int>(grpc::StatusCode::UNAVAILABLE)), "gRPC status code of injected failures");
+    opts("sendstate-only", "Only apply latency and errors to SendState calls");
+    opts("samples", po::value<size_t>(&maxSamples)->default_value(100000), "Number of most recent SendState samples retained");
+    opts("simulate", po::value<size_t>(&simulate)->default_value(0), "Number of simulated workers sending state to the mock (0 - none)");
+    opts("rate", po::value<float>(&rate)->default_value(10.0), "Rate in Hz at which each simulated worker sends state");
+    opts("deadline", po::value<u_int32_t>(&deadline)->default_value(500), "Deadline of simulated workers' SendState calls in ms");
+    opts("duration", po::value<u_int32_t>(&duration)->default_value(0), "Run for this many seconds (0 - until Ctrl-C)");
+    opts("report", po::value<u_int32_t>(&reportSec)->default_value(1), "Statistics reporting interval in seconds (0 - only at exit)");
+
+    po::variables_map vm;
+
+    try {
+        po::store(po::parse_command_line(argc, argv, od), vm);
+        po::notify(vm);
+    } catch (const boost::program_options::error &e) {
+        std::cerr << "Unable to parse command line: " << e.what() << std::endl;
+        return -1;
+    }
+
+    if (vm.count("help")) {
+        std::cout << "E2SAR CP Mock" << std::endl;
+        std::cout << "Version: " << get_Version() << std::endl;
+        std::cout << std::endl;
+        std::cout << "Serves the load balancer control plane API from memory for testing without udplbd." << std::endl;
+        std::cout << "Point tools at it with EJFAT_URI=ejfat://<admin token>@<listen address>/" << std::endl;
+        std::cout << std::endl;
+        std::cout << od << std::endl;
+        std::cout << std::endl;
+        std::cout << "Example usage:" << std::endl;
+        std::cout << "  e2sar_cpmock --latency 5 --jitter 10 --simulate 300 --rate 10 --duration 60" << std::endl;
+        std::cout << "  e2sar_cpmock --emulate --error-rate 0.01 --sendstate-only" << std::endl;
+        return 0;
+    }
+
+    auto listenRes = string_tuple_to_ip_and_port(listenStr);
+    if (listenRes.has_error()) {
+        std::cerr << "Invalid listen address, use format IP:PORT" << std::endl;
+        return -1;
+    }
+    auto [listenAddr, listenPort] = listenRes.value();
+
+    auto syncRes = string_tuple_to_ip_and_port(syncStr);
+    auto dataRes = string_to_ip(dataStr);
+    if (syncRes.has_error() || dataRes.has_error() || !dataRes.value().is_v4()) {
+        std::cerr << "Invalid sync or data address" << std::endl;
+        return -1;
+    }
+    if ((simulate > 0) && (rate <= 0.0)) {
+        std::cerr << "Simulated workers need a positive rate" << std::endl;
+        return -1;
+    }
+
+    LBMockServer::LBMockServerFlags mflags;
+    mflags.latency_ms = latency;
+    mflags.jitter_ms = jitter;
+    mflags.errorRate = errorRate;
+    mflags.errorCode = static_cast<grpc::StatusCode>(errorCode);
+    mflags.sendStateOnly = vm.count("sendstate-only") > 0;
+    mflags.maxSamples = maxSamples;
+    mflags.adminToken = adminToken;
+    mflags.syncAddr = syncRes.value().first.to_string();
+    mflags.syncPort = syncRes.value().second;
+    mflags.dataAddrV4 = dataStr;
+
+    try {
+        LBMockServer mock(listenAddr, listenPort, mflags);
+
+        std::unique_ptr<LBEmulator> emu;
+        if (vm.count("emulate")) {
+            emu = std::make_unique<LBEmulator>(dataRes.value(), DATAPLANE_PORT);
+            auto epochRes = emu->newEpoch(0);
+            auto emuRes = emu->openAndStart();
+            if (epochRes.has_error() || emuRes.has_error()) {
+                std::cerr << "Unable to start the LB emulator: " << (emuRes.has_error() ?
+                    emuRes.error().message() : epochRes.error().message()) << std::endl;
+                return -1;
+            }
+            mock.attachEmulator(emu.get());
+        }
+
+        auto openRes = mock.openAndStart();
+        if (openRes.has_error()) {
+            std::cerr << "Unable to start the mock: " << openRes.error().message() << std::endl;
+            return -1;
+        }
+
+        std::cout << "E2SAR CP Mock" << std::endl;
+        std::cout << "Version:      " << get_Version() << std::endl;
+        std::cout << "URI:          " << mock.get_URI() << std::endl;
+        std::cout << "Latency:      " << latency << "ms + [0, " << jitter << "]ms" << std::endl;
+        std::cout << "Error rate:   " << errorRate << (mflags.sendStateOnly ? " (SendState only)" : "") << std::endl;
+        if (emu)
+            std::cout << "Emulator:     " << dataStr << ":" << DATAPLANE_PORT << std::endl;
+
+        signal(SIGINT, signalHandler);
+        signal(SIGTERM, signalHandler);
+
+        std::unique_ptr<WorkerSimulation> sim;
+        if (simulate > 0) {
+            sim = std::make_unique<WorkerSimulation>(mock.get_URI(), deadline);
+            auto simRes = sim->start(simulate);
+            if (simRes.has_error()) {
+                std::cerr << "Unable to start simulated workers: " << simRes.error().message() << std::endl;
+                return -1;
+            }
+            std::cout << "Simulating:   " << simulate << " workers at " << rate << "Hz" << std::endl;
+        }
+        std::cout << "\nMock active... (Press Ctrl-C to stop)" << std::endl;
+
+        auto period = std::chrono::microseconds(static_cast<int64_t>(1000000 / (simulate > 0 ? rate : 1.0)));
+        auto startT = std::chrono::steady_clock::now();
+        auto nextT = startT;
+        auto nextReportT = startT + std::chrono::seconds(reportSec);
+        auto prevStats = mock.getStats();
+        auto prevReportT = startT;
+        while (keepRunning) {
+            nextT += period;
+            std::this_thread::sleep_until(nextT);
+            auto nowT = std::chrono::steady_clock::now();
+            if (sim)
+                sim->sendRound(std::chrono::duration<double>(nowT - startT).count());
+            if ((reportSec > 0) && (nowT >= nextReportT)) {
+                printStats(mock, prevStats, std::chrono::duration<double>(nowT - prevReportT).count());
+                if (sim)
+                    sim->printStats();
+                prevStats = mock.getStats();
+                prevReportT = nowT;
+                nextReportT += std::chrono::seconds(reportSec);
+            }
+            if ((duration > 0) && (nowT - startT >= std::chrono::seconds(duration)))
+                break;
+        }
+
+        std::cout << "\nShutting down..." << std::endl;
+        if (sim) {
+            sim->printStats();
+            sim->stop();
+        }
+        mock.stop();
+        if (emu)
+            emu->stopThreads();
+        printStats(mock, prevStats, std::chrono::duration<double>(std::chrono::steady_clock::now() - prevReportT).count());
+    } catch (E2SARException &e) {
+        std::cerr << "Unable to create the mock: " << static_cast<std::string>(e) << std::endl;
+        return -1;
+    }
+    return 0;
+}
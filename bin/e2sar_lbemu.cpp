@@ -0,0 +1,194 @@
+/**
+ * E2SAR LB Emulator - software stand-in for the FPGA load balancer data plane
+ *
+ * Receives LB+RE framed datagrams from Segmenters, maps the event tick to a
+ * worker via an epoch calendar, strips the LB header and forwards the datagram
+ * to the worker port selected by the entropy. Lets multi-sender/multi-worker
+ * setups be exercised on a single host without a real load balancer.
+ */
+
+#include <signal.h>
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "e2sarLBEmu.hpp"
+#include "e2sar.hpp"
+
+namespace po = boost::program_options;
+using namespace e2sar;
+using namespace std::string_literals;
+
+// Control flags
+std::atomic<bool> keepRunning{true};
+
+/**
+ * Print emulator statistics to stdout
+ */
+void printStats(LBEmulator &emu)
+{
+    auto stats = emu.getStats();
+    std::cout << "\nStatistics:" << std::endl;
+    std::cout << "  Packets received:   " << stats.packetsReceived << std::endl;
+    std::cout << "  Bytes received:     " << stats.bytesReceived << std::endl;
+    std::cout << "  Packets forwarded:  " << stats.packetsForwarded << std::endl;
+    std::cout << "  Bad LB headers:     " << stats.badHeaderDiscards << std::endl;
+    std::cout << "  No worker in slot:  " << stats.noWorkerDiscards << std::endl;
+    std::cout << "  Receive errors:     " << stats.recvErrors << std::endl;
+    std::cout << "  Send errors:        " << stats.sendErrors << std::endl;
+    if (stats.lastErrno != 0)
+        std::cout << "  Last error:         " << strerror(stats.lastErrno) << std::endl;
+    for(auto &ws: emu.getWorkerStats())
+        std::cout << "  Worker " << ws.name << ": " << ws.packets << " packets " << ws.bytes << " bytes" << std::endl;
+}
+
+/**
+ * Signal handler for graceful shutdown (Ctrl-C)
+ */
+void signalHandler(int sig)
+{
+    keepRunning = false;
+}
+
+/**
+ * Parse a worker specification of the form ip:port[,portRange[,weight]]
+ */
+result<int> addWorker(LBEmulator &emu, const std::string &name, const std::string &spec)
+{
+    std::vector<std::string> parts;
+    boost::split(parts, spec, boost::is_any_of(","));
+    auto addrRes = string_tuple_to_ip_and_port(parts[0]);
+    if (addrRes.has_error())
+        return addrRes.error();
+    auto [addr, port] = addrRes.value();
+    if (port == 0)
+        return E2SARErrorInfo{E2SARErrorc::ParameterError, "Worker port must be specified in format IP:PORT"};
+
+    u_int16_t portRange{0};
+    float weight{1.0};
+    try {
+        if (parts.size() > 1)
+            portRange = static_cast<u_int16_t>(std::stoi(parts[1]));
+        if (parts.size() > 2)
+            weight = std::stof(parts[2]);
+    } catch (const std::exception &e) {
+        return E2SARErrorInfo{E2SARErrorc::ParameterError, "Invalid worker specification " + spec};
+    }
+    auto res = emu.addWorker(name, addr, port, portRange, weight);
+    if (res.has_error())
+        return res.error();
+    std::cout << "Worker " << name << ":     " << addr.to_string() << ":" << port << "-" <<
+        port + (1 << portRange) - 1 << " weight " << weight << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    po::options_description od("Command-line options");
+
+    auto opts = od.add_options()(
+        "help,h", "Show this help message"
+    );
+
+    std::string listenStr;
+    std::vector<std::string> workerSpecs;
+    size_t numThreads;
+    int rxBufSize, txBufSize;
+    u_int32_t reportSec;
+
+    opts("listen,l", po::value<std::string>(&listenStr)->default_value("127.0.0.1:19522"), "Address and port to receive sender traffic on (e.g., \"127.0.0.1:19522\" or \"[::1]:19522\")");
+    opts("worker,w", po::value<std::vector<std::string>>(&workerSpecs)->multitoken(), "Worker as ip:port[,portRange[,weight]], may be repeated [at least one required]");
+    opts("threads", po::value<size_t>(&numThreads)->default_value(1), "Number of forwarding threads");
+    opts("rx-bufsize", po::value<int>(&rxBufSize)->default_value(3145728), "Receive socket buffer size in bytes (default 3MB)");
+    opts("tx-bufsize", po::value<int>(&txBufSize)->default_value(3145728), "Send socket buffer size in bytes (default 3MB)");
+    opts("report", po::value<u_int32_t>(&reportSec)->default_value(1), "Statistics reporting interval in seconds (0 - only at exit)");
+
+    po::variables_map vm;
+
+    try {
+        po::store(po::parse_command_line(argc, argv, od), vm);
+        po::notify(vm);
+    } catch (const boost::program_options::error &e) {
+        std::cerr << "Unable to parse command line: " << e.what() << std::endl;
+        return -1;
+    }
+
+    if (vm.count("help") || workerSpecs.empty()) {
+        std::cout << "E2SAR LB Emulator" << std::endl;
+        std::cout << "Version: " << get_Version() << std::endl;
+        std::cout << std::endl;
+        std::cout << "Emulates the load balancer data plane: forwards LB-framed datagrams from senders" << std::endl;
+        std::cout << "to workers according to an epoch calendar, stripping the LB header. Point" << std::endl;
+        std::cout << "senders at the listen address and run receivers without --withlbheader." << std::endl;
+        std::cout << std::endl;
+        std::cout << od << std::endl;
+        std::cout << std::endl;
+        std::cout << "Example usage:" << std::endl;
+        std::cout << "  e2sar_lbemu -l 127.0.0.1:19522 -w 127.0.0.1:10000,2 -w 127.0.0.1:20000,2 --threads 2" << std::endl;
+        return vm.count("help") ? 0 : -1;
+    }
+
+    auto listenRes = string_tuple_to_ip_and_port(listenStr);
+    if (listenRes.has_error() || (listenRes.value().second == 0)) {
+        std::cerr << "Invalid listen address, use format IP:PORT" << std::endl;
+        return -1;
+    }
+    auto [listenAddr, listenPort] = listenRes.value();
+
+    LBEmulator::LBEmulatorFlags eflags;
+    eflags.numThreads = numThreads;
+    eflags.rcvSocketBufSize = rxBufSize;
+    eflags.sndSocketBufSize = txBufSize;
+
+    try {
+        LBEmulator emu(listenAddr, listenPort, eflags);
+
+        std::cout << "E2SAR LB Emulator" << std::endl;
+        std::cout << "Version:      " << get_Version() << std::endl;
+        std::cout << "Listen:       " << listenAddr.to_string() << ":" << listenPort << std::endl;
+        std::cout << "Threads:      " << numThreads << std::endl;
+        for(size_t i = 0; i < workerSpecs.size(); i++)
+        {
+            auto res = addWorker(emu, "worker"s + std::to_string(i), workerSpecs[i]);
+            if (res.has_error()) {
+                std::cerr << "Unable to add worker " << workerSpecs[i] << ": " << res.error().message() << std::endl;
+                return -1;
+            }
+        }
+
+        auto epochRes = emu.newEpoch(0);
+        if (epochRes.has_error()) {
+            std::cerr << "Unable to set up the calendar: " << epochRes.error().message() << std::endl;
+            return -1;
+        }
+
+        signal(SIGINT, signalHandler);
+        signal(SIGTERM, signalHandler);
+
+        auto openRes = emu.openAndStart();
+        if (openRes.has_error()) {
+            std::cerr << "Unable to start the emulator: " << openRes.error().message() << std::endl;
+            return -1;
+        }
+        std::cout << "\nEmulator active... (Press Ctrl-C to stop)" << std::endl;
+
+        u_int32_t elapsed{0};
+        while (keepRunning) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (keepRunning && (reportSec > 0) && (++elapsed % reportSec == 0))
+                printStats(emu);
+        }
+
+        std::cout << "\nShutting down..." << std::endl;
+        emu.stopThreads();
+        printStats(emu);
+    } catch (E2SARException &e) {
+        std::cerr << "Unable to create the emulator: " << static_cast<std::string>(e) << std::endl;
+        return -1;
+    }
+    return 0;
+}
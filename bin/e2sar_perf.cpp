@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <vector>
 #include <boost/program_options.hpp>
 #include <locale>
@@ -32,6 +33,10 @@ u_int16_t reportThreadSleepMs{1000};
 Reassembler *reasPtr{nullptr};
 Segmenter *segPtr{nullptr};
 LBManager *lbmPtr{nullptr};
+MetricsExporter *metricsPtr{nullptr};
+// where to dump fragment trace rings on SIGUSR1 and on exit (empty - don't)
+std::string traceFile;
+std::atomic<bool> traceRequested{false};
 std::vector<std::string> senders;
 
 void ctrlCHandler(int sig)
@@ -40,11 +45,47 @@ void ctrlCHandler(int sig)
     threadsRunning = false;
 }
 
+void traceHandler(int sig)
+{
+    // the dump itself happens on traceDumpThread
+    traceRequested = true;
+}
+
+// write trace rings of whichever of segmenter/reassembler exists
+void dumpTrace()
+{
+    if (traceFile.empty())
+        return;
+    auto res = (segPtr != nullptr ? segPtr->dumpTrace(traceFile) : 
+        (reasPtr != nullptr ? reasPtr->dumpTrace(traceFile) : result<int>(0)));
+    if (res.has_error())
+        std::cerr << "Unable to dump trace: " << res.error().message() << std::endl;
+    else
+        std::cout << "Trace written to " << traceFile << std::endl;
+}
+
+void traceDumpThread()
+{
+    while(threadsRunning)
+    {
+        if (traceRequested.exchange(false))
+            dumpTrace();
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+    }
+}
+
 void shutDown()
 {
     ctrlCHandler(0);
     boost::chrono::milliseconds duration(1000);
     boost::this_thread::sleep_for(duration);
+    // capture the last moments before the objects go away
+    dumpTrace();
+    if (metricsPtr != nullptr) {
+        // stop serving metrics before the objects it reports on go away
+        delete metricsPtr;
+        metricsPtr = nullptr;
+    }
     if (segPtr != nullptr) {
         // d-tor will stop the threads - it is important to do that before removing sender
         // to make sure outstanding data is sent out
@@ -81,14 +122,21 @@ void shutDown()
         if (fdStats.has_error())
             std::cout << "Unable to get per FD stats: " << fdStats.error().message() << std::endl;
 
+        // same ports in the same order
+        auto dropStats = reasPtr->get_PortDropStats();
+
         std::cout << "Port Stats: " << std::endl;
-        size_t totalFragments{0};
+        size_t totalFragments{0}, totalDrops{0};
+        auto drops = dropStats.value().begin();
         for (auto fds: fdStats.value())
         {
             totalFragments += fds.second;
-            std::cout << "\tPort: " << fds.first << " Received: " << fds.second << std::endl;
+            totalDrops += drops->second;
+            std::cout << "\tPort: " << fds.first << " Received: " << fds.second << 
+                " Dropped by kernel: " << drops->second << std::endl;
+            drops++;
         }
-        std::cout << "Total: " << totalFragments << std::endl;
+        std::cout << "Total: " << totalFragments << " Dropped by kernel: " << totalDrops << std::endl;
         delete reasPtr;
     }
     exit(0);
@@ -113,6 +161,36 @@ void option_dependency(const po::variables_map &vm,
             throw std::logic_error(std::string("Option '") + for_what + "' requires option '" + required_option + "'.");
 }
 
+// format latency percentiles (recorded in ns) in usec
+std::string latencyPercentiles(const LatencyHistogram::Snapshot &snap)
+{
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1) << "count " << snap.count <<
+        " p50 " << snap.percentile(50.) / 1000. <<
+        " p90 " << snap.percentile(90.) / 1000. <<
+        " p99 " << snap.percentile(99.) / 1000. <<
+        " p99.9 " << snap.percentile(99.9) / 1000. <<
+        " max " << snap.max / 1000. << " usec";
+    return os.str();
+}
+
+// start serving OpenMetrics stats of whichever of segmenter/reassembler exists
+void startMetrics(u_int16_t port)
+{
+    if (port == 0)
+        return;
+    metricsPtr = new MetricsExporter(ip::make_address("0.0.0.0"), port);
+    if (segPtr != nullptr)
+        metricsPtr->addSegmenter(*segPtr, "e2sar_perf");
+    if (reasPtr != nullptr)
+        metricsPtr->addReassembler(*reasPtr, "e2sar_perf");
+    auto res = metricsPtr->start();
+    if (res.has_error())
+        std::cerr << "Unable to start metrics exporter: " << res.error().message() << std::endl;
+    else
+        std::cout << "Serving metrics on:            http://0.0.0.0:" << metricsPtr->getPort() << "/metrics" << std::endl;
+}
+
 // callback
 void freeBuffer(boost::any a) 
 {
@@ -208,6 +286,8 @@ result<int> sendEvents(Segmenter &s, EventNum_t startEventNum, size_t numEvents,
             expectedFrames << ")." << std::endl;
 
     std::cout << "Completed, " << stats.msgCnt << " packets sent, " << stats.errCnt << " errors" << std::endl;
+    std::cout << "ENOBUFS errors: " << stats.enobufsCnt << ", send socket buffer saturated samples: " << 
+        stats.sndQueueSaturated << ", high water mark: " << stats.sndQueueHighWater << " bytes" << std::endl;
     if (stats.errCnt != 0)
     {
         if (stats.lastE2SARError != E2SARErrorc::NoError)
@@ -228,6 +308,30 @@ result<int> sendEvents(Segmenter &s, EventNum_t startEventNum, size_t numEvents,
     std::cout << "Estimated goodput (Gbps): " <<
         (evt * eventBufSize * 8.0) / (elapsedUsec.count() * 1000) << std::endl;
 
+    auto latency = s.getLatencyStats();
+    std::cout << "Latency enqueue to dequeue: " << latencyPercentiles(latency.enqueueToDequeue) << std::endl;
+    std::cout << "Latency dequeue to first send: " << latencyPercentiles(latency.dequeueToFirstSend) << std::endl;
+    std::cout << "Event send duration: " << latencyPercentiles(latency.sendDuration) << std::endl;
+    for(size_t i = 0; i < latency.sendDurationBySize.size(); i++)
+    {
+        if (latency.sendDurationBySize[i].count == 0)
+            continue;
+        if (i < Segmenter::SEND_SIZE_BUCKETS - 1)
+            std::cout << "  events below " << Segmenter::sendSizeBucketLimit(i) / 1024 << "KB: ";
+        else
+            std::cout << "  events of " << Segmenter::sendSizeBucketLimit(i - 1) / 1024 << "KB and above: ";
+        std::cout << latencyPercentiles(latency.sendDurationBySize[i]) << std::endl;
+    }
+
+    for(auto &ss: s.getSocketStats())
+    {
+        std::cout << "Send socket " << ss.index << ": " << ss.fragments << " packets, " << ss.bytes << " bytes, " <<
+            ss.errors << " errors (EAGAIN " << ss.eagain << ", ENOBUFS " << ss.enobufs << ")";
+        if (ss.sqReadyHighWater > 0 || ss.cqReadyHighWater > 0)
+            std::cout << ", io_uring SQ high water " << ss.sqReadyHighWater << ", CQ high water " << ss.cqReadyHighWater;
+        std::cout << std::endl;
+    }
+
     return 0;
 }
 
@@ -330,23 +434,68 @@ void recvStatsThread(Reassembler *r)
         BOOST_MLL_LOG(stat) << "\tTotal Bytes: " << stats.totalBytes << std::endl;
         BOOST_MLL_LOG(stat) << "\tTotal Packets: " << stats.totalPackets << std::endl;
         BOOST_MLL_LOG(stat) << "\tBad RE Header Discards: " << stats.badHeaderDiscards << std::endl;
+        BOOST_MLL_LOG(stat) << "\tKernel Socket Drops: " << stats.kernelDrops << std::endl;
         BOOST_MLL_LOG(stat) << "\tEvents Received: " << stats.eventSuccess << std::endl;
         BOOST_MLL_LOG(stat) << "\tEvents Mangled: " << mangledEvents << std::endl;
         BOOST_MLL_LOG(stat) << "\tEvents Lost in reassembly: " << stats.reassemblyLoss << std::endl;
         BOOST_MLL_LOG(stat) << "\tEvents Lost in enqueue: " << stats.enqueueLoss << std::endl;
+        BOOST_MLL_LOG(stat) << "\tEvents Never Seen: " << stats.neverSeenLoss << std::endl;
+        BOOST_MLL_LOG(stat) << "\tAdaptive Timeout Misses: " << stats.adaptiveTimeoutMisses << std::endl;
+        if (stats.busyPollSpins > 0)
+            BOOST_MLL_LOG(stat) << "\tBusy Poll Spins: " << stats.busyPollSpins << " Hits: " << stats.busyPollHits <<
+                " (" << 100.0 * stats.busyPollHits / stats.busyPollSpins << "%) Fallbacks: " << 
+                stats.busyPollFallbacks << std::endl;
+        auto rates = r->getStatsSnapshot();
+        if (rates.periodNs > 0)
+            BOOST_MLL_LOG(stat) << "\tRates: " << rates.eventRate << " events/s " << rates.byteRate * 8 / 1e9 << 
+                " Gbps " << rates.packetRate << " packets/s " << rates.lossRate << " lost events/s " << 
+                rates.kernelDropRate << " kernel drops/s (queue depth " << rates.queueDepth << ")" << std::endl;
         BOOST_MLL_LOG(stat) << "\tData Errors: " << stats.dataErrCnt << std::endl;
         if (stats.dataErrCnt > 0)
             BOOST_MLL_LOG(stat) << "\tLast Data Error: " << strerror(stats.lastErrno) << std::endl;
         BOOST_MLL_LOG(stat) << "\tgRPC Errors: " << stats.grpcErrCnt << std::endl;
         if (stats.lastE2SARError != E2SARErrorc::NoError)
             BOOST_MLL_LOG(stat) << "\tLast E2SARError code: " << make_error_code(stats.lastE2SARError).message() << std::endl;
+        auto sendState = r->getSendStateStats();
+        if (sendState.sent > 0)
+            BOOST_MLL_LOG(stat) << "\tSendState RPCs: " << sendState.sent << " failed " << sendState.failed <<
+                " (deadline " << sendState.deadlineExceeded << ") coalesced " << sendState.coalesced <<
+                " p99 " << sendState.rpcLatency.percentile(99) / 1000 << " usec" << std::endl;
 
         BOOST_MLL_LOG(stat) << "\tEvents lost so far (<Evt ID:Data ID/num frags rcvd>): ";
         for(auto evt: lostEvents)
         {
             BOOST_MLL_LOG(stat) << "<" << evt.get<0>() << ":" << evt.get<1>() << "/" << evt.get<2>() << "> ";
         }
-        //std::cout << std::endl;
+        BOOST_MLL_LOG(stat) << std::endl;
+
+        auto lossStats = r->getLostEventStats();
+        BOOST_MLL_LOG(stat) << "\tLost events per data id (<Session/Data ID:count>): ";
+        for(auto dl: lossStats.perDataId)
+            BOOST_MLL_LOG(stat) << "<" << std::get<0>(dl) << "/" << std::get<1>(dl) << ":" << std::get<2>(dl) << "> ";
+        if (lossStats.otherDataIds > 0)
+            BOOST_MLL_LOG(stat) << "<other:" << lossStats.otherDataIds << ">";
+        BOOST_MLL_LOG(stat) << std::endl;
+        BOOST_MLL_LOG(stat) << "\tLost events by fragments received (log2 buckets): ";
+        for(auto fc: lossStats.perFragCount)
+            BOOST_MLL_LOG(stat) << fc << " ";
+        BOOST_MLL_LOG(stat) << std::endl;
+        if (lossStats.ringOverwrites > 0)
+            BOOST_MLL_LOG(stat) << "\tLost event records overwritten before being reported: " << lossStats.ringOverwrites << std::endl;
+
+        auto dataIdStats = r->getDataIdStats();
+        if (not dataIdStats.empty())
+        {
+            BOOST_MLL_LOG(stat) << "\tPer data id (<Session/Data ID:events/bytes/frags per event/reassembly loss/enqueue loss>): ";
+            for(auto &ds: dataIdStats)
+                BOOST_MLL_LOG(stat) << "<" << ds.session << "/" << ds.dataId << ":" << ds.events << "/" << ds.bytes << "/" << 
+                    ds.meanFragments() << "/" << ds.reassemblyLoss << "/" << ds.enqueueLoss << "> ";
+            BOOST_MLL_LOG(stat) << std::endl;
+        }
+
+        auto latency = r->getLatencyStats();
+        BOOST_MLL_LOG(stat) << "\tLatency first segment to complete: " << latencyPercentiles(latency.firstToComplete) << std::endl;
+        BOOST_MLL_LOG(stat) << "\tLatency complete to dequeue: " << latencyPercentiles(latency.completeToDequeue) << std::endl;
         BOOST_MLL_STOP(stat);
 
         auto until = nowT + boost::chrono::milliseconds(reportThreadSleepMs);
@@ -371,7 +520,7 @@ int main(int argc, char **argv)
     float rateGbps;
     int sockBufSize;
     int durationSec;
-    bool withCP, multiPort, smooth, autoIP, validate, quiet, dpv6, realmalloc;
+    bool withCP, multiPort, smooth, autoIP, validate, quiet, dpv6, realmalloc, seqTrack, adaptiveTimeout, useGRO, busyPoll, dropBackoff, perDataId;
     std::string sndrcvIP;
     std::string iniFile;
     u_int16_t recvStartPort;
@@ -379,6 +528,9 @@ int main(int argc, char **argv)
     std::vector<std::string> optimizations;
     int numaNode;
     int eventTimeoutMS;
+    size_t recvBufSize;
+    int spinBudgetUs;
+    u_int16_t metricsPort;
 
     // define a simple clog-based logger
     defineClogLogger();
@@ -419,6 +571,16 @@ int main(int argc, char **argv)
     opts("multiport", po::bool_switch()->default_value(false), "use consecutive destination ports instead of one port [s]");
     opts("smooth", po::bool_switch()->default_value(false), "use smooth shaping in the sender (only works without optimizations and at low sub 3-5Gbps rates!) [s]");
     opts("timeout", po::value<int>(&eventTimeoutMS)->default_value(500), "event timeout on reassembly in MS [r]");
+    opts("adaptive", po::bool_switch()->default_value(false), "use adaptive event reassembly timeout learned from inter-segment gaps (--timeout is the upper bound) [r]");
+    opts("gro", po::bool_switch()->default_value(false), "enable UDP_GRO on receive sockets (Linux only) [r]");
+    opts("recvbuf", po::value<size_t>(&recvBufSize)->default_value(9000), "size of the buffer each datagram is received into, up to 65536 (defaults to 9000, ignored with --gro) [r]");
+    opts("busypoll", po::bool_switch()->default_value(false), "busy poll receive sockets instead of blocking, burns a core per receive thread (Linux only) [r]");
+    opts("spinbudget", po::value<int>(&spinBudgetUs)->default_value(1000), "with --busypoll, microseconds to spin without data before blocking (defaults to 1000) [r]");
+    opts("dropbackoff", po::bool_switch()->default_value(false), "report a full queue to the control plane when the kernel drops datagrams on receive sockets [r]");
+    opts("seqtrack", po::bool_switch()->default_value(false), "track sequential event numbers to count events that were never seen [r]");
+    opts("dataidstats", po::bool_switch()->default_value(false), "keep and report receive statistics per data id [r]");
+    opts("metrics", po::value<u_int16_t>(&metricsPort)->default_value(0), "serve OpenMetrics statistics over HTTP at /metrics on this TCP port (defaults to 0 - disabled) [s,r]");
+    opts("trace", po::value<std::string>(&traceFile)->default_value(""), "dump recent fragment activity to this file on SIGUSR1 and on exit, decode with e2sar_trace [s,r]");
     opts("quiet,q", po::bool_switch()->default_value(false), "quiet, do not print intermediate lost event statistics [r]");
     opts("realmalloc", po::bool_switch()->default_value(false), "use real mallocs to allocate event buffers, rather than reusing a buffer [s]");
 
@@ -453,6 +615,14 @@ int main(int argc, char **argv)
         conflicting_options(vm, "recv", "multiport");
         conflicting_options(vm, "recv", "smooth");
         conflicting_options(vm, "send", "timeout");
+        conflicting_options(vm, "send", "seqtrack");
+        conflicting_options(vm, "send", "adaptive");
+        conflicting_options(vm, "send", "gro");
+        conflicting_options(vm, "send", "recvbuf");
+        conflicting_options(vm, "send", "busypoll");
+        conflicting_options(vm, "send", "spinbudget");
+        conflicting_options(vm, "send", "dropbackoff");
+        conflicting_options(vm, "send", "dataidstats");
         conflicting_options(vm, "rate", "rateGbps");
         // these are optional
         conflicting_options(vm, "send", "duration");
@@ -470,6 +640,12 @@ int main(int argc, char **argv)
 
     // for ctrl-C
     signal(SIGINT, ctrlCHandler);
+    // for trace dumps
+    if (not traceFile.empty())
+    {
+        signal(SIGUSR1, traceHandler);
+        boost::thread traceT(&traceDumpThread);
+    }
 
     std::cout << "E2SAR Version:                 " << get_Version() << std::endl;
     std::cout << "E2SAR Available Optimizations: " << 
@@ -516,6 +692,12 @@ int main(int argc, char **argv)
     quiet = vm["quiet"].as<bool>();
     dpv6 = vm["dpv6"].as<bool>();
     realmalloc = vm["realmalloc"].as<bool>();
+    seqTrack = vm["seqtrack"].as<bool>();
+    adaptiveTimeout = vm["adaptive"].as<bool>();
+    useGRO = vm["gro"].as<bool>();
+    busyPoll = vm["busypoll"].as<bool>();
+    dropBackoff = vm["dropbackoff"].as<bool>();
+    perDataId = vm["dataidstats"].as<bool>();
 
     if (not autoIP and (vm["ip"].as<std::string>().length() == 0))
     {
@@ -669,6 +851,7 @@ int main(int argc, char **argv)
                 else
                     segPtr = new Segmenter(uri, dataId, eventSourceId, sflags);
 
+                startMetrics(metricsPort);
                 auto res = sendEvents(*segPtr, startingEventNum, numEvents, eventBufferSize, oneEventBuffer);
 
                 if (res.has_error()) {
@@ -708,6 +891,22 @@ int main(int argc, char **argv)
                     rflags.validateCert = validate;
                 if (not vm["timeout"].defaulted())
                     rflags.eventTimeout_ms = eventTimeoutMS;
+                if (not vm["seqtrack"].defaulted())
+                    rflags.trackSequence = seqTrack;
+                if (not vm["adaptive"].defaulted())
+                    rflags.adaptiveTimeout = adaptiveTimeout;
+                if (not vm["gro"].defaulted())
+                    rflags.useGRO = useGRO;
+                if (not vm["recvbuf"].defaulted())
+                    rflags.recvBufferSize = recvBufSize;
+                if (not vm["busypoll"].defaulted())
+                    rflags.busyPoll = busyPoll;
+                if (not vm["spinbudget"].defaulted())
+                    rflags.spinBudget_us = spinBudgetUs;
+                if (not vm["dropbackoff"].defaulted())
+                    rflags.dropBackoff = dropBackoff;
+                if (not vm["dataidstats"].defaulted())
+                    rflags.perDataIdStats = perDataId;
             } else 
             {
                 rflags.useCP = withCP;
@@ -716,11 +915,26 @@ int main(int argc, char **argv)
                 rflags.useHostAddress = preferHostAddr;
                 rflags.validateCert = validate;
                 rflags.eventTimeout_ms = eventTimeoutMS;
+                rflags.trackSequence = seqTrack;
+                rflags.adaptiveTimeout = adaptiveTimeout;
+                rflags.useGRO = useGRO;
+                rflags.recvBufferSize = recvBufSize;
+                rflags.busyPoll = busyPoll;
+                rflags.spinBudget_us = spinBudgetUs;
+                rflags.dropBackoff = dropBackoff;
+                rflags.perDataIdStats = perDataId;
             }
             std::cout << "Control plane:                 " << (rflags.useCP ? "ON" : "OFF") << std::endl;
             std::cout << "Thread assignment to cores:    " << (vm.count("cores") ? "ON" : "OFF") << std::endl;
             std::cout << "Explicit NUMA memory binding:  " << (numaNode >= 0 ? "ON" : "OFF") << std::endl;
-            std::cout << "Event reassembly timeout (ms): " << rflags.eventTimeout_ms << std::endl;
+            std::cout << "Event reassembly timeout (ms): " << rflags.eventTimeout_ms << 
+                (rflags.adaptiveTimeout ? " (adaptive upper bound)" : "") << std::endl;
+            std::cout << "Event sequence tracking:       " << (rflags.trackSequence ? "ON" : "OFF") << std::endl;
+            std::cout << "UDP GRO:                       " << (rflags.useGRO ? "ON" : "OFF") << std::endl;
+            std::cout << "Busy poll:                     " << (rflags.busyPoll ? 
+                "ON (spin budget " + std::to_string(rflags.spinBudget_us) + " us)" : "OFF") << std::endl;
+            std::cout << "Back off on kernel drops:      " << (rflags.dropBackoff ? "ON" : "OFF") << std::endl;
+            std::cout << "Per data id statistics:        " << (rflags.perDataIdStats ? "ON" : "OFF") << std::endl;
             std::cout << "Will run for:                  " << (durationSec ? std::to_string(durationSec) + " sec": "until Ctrl-C") << std::endl;
 
             try {
@@ -750,6 +964,8 @@ int main(int argc, char **argv)
                 std::cout << (rflags.useCP ? "*** Make sure the LB has been reserved and the URI reflects the reserved instance information." :
                     "*** Make sure the URI reflects proper data address, other parts are ignored.") << std::endl;
 
+                startMetrics(metricsPort);
+
                 // don't start recv stats thread if told to be quiet - reduces debugging output
                 if (not quiet)
                     boost::thread statT(&recvStatsThread, reasPtr);
@@ -0,0 +1,133 @@
+/**
+ * E2SAR trace decoder - prints the binary trace dumps written by
+ * Segmenter::dumpTrace() and Reassembler::dumpTrace() (e.g. on SIGUSR1
+ * in e2sar_perf) as a single time-ordered list of fragment activity
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <boost/program_options.hpp>
+
+#include "e2sar.hpp"
+
+namespace po = boost::program_options;
+using namespace e2sar;
+
+// one decoded record with the ring it came from
+struct Entry {
+    const TraceRecord *rec;
+    size_t ringIdx;
+};
+
+int main(int argc, char **argv)
+{
+    po::options_description od("Command-line options");
+
+    auto opts = od.add_options()("help,h", "show this help message");
+
+    std::string traceFile;
+    int64_t lastUsec{0};
+    EventNum_t eventNum{0};
+    int dataId{-1};
+    std::string ringName;
+
+    opts("file,f", po::value<std::string>(&traceFile), "trace file to decode [required]");
+    opts("last", po::value<int64_t>(&lastUsec)->default_value(0), "only show records from this many microseconds before the newest record (0 - all)");
+    opts("event", po::value<EventNum_t>(&eventNum), "only show records of this event number");
+    opts("dataid", po::value<int>(&dataId)->default_value(-1), "only show records of this data id");
+    opts("ring", po::value<std::string>(&ringName), "only show records from this ring (e.g. recv-0, send-1, gc)");
+    opts("csv", "print comma-separated values instead of aligned columns");
+
+    po::positional_options_description pos;
+    pos.add("file", 1);
+
+    po::variables_map vm;
+
+    try {
+        po::store(po::command_line_parser(argc, argv).options(od).positional(pos).run(), vm);
+        po::notify(vm);
+    } catch (const boost::program_options::error &e) {
+        std::cerr << "Unable to parse command line: " << e.what() << std::endl;
+        return -1;
+    }
+
+    if (vm.count("help") || !vm.count("file")) {
+        std::cout << "E2SAR trace decoder" << std::endl;
+        std::cout << "Version: " << get_Version() << std::endl;
+        std::cout << od << std::endl;
+        std::cout << "Example usage:" << std::endl;
+        std::cout << "  e2sar_trace /tmp/e2sar_perf.trace --last 2000" << std::endl;
+        return vm.count("help") ? 0 : -1;
+    }
+
+    auto res = TraceFile::read(traceFile);
+    if (res.has_error()) {
+        std::cerr << "Unable to read trace file: " << res.error().message() << std::endl;
+        return -1;
+    }
+    auto &contents = res.value();
+
+    bool csv = vm.count("csv") > 0;
+    if (!csv) {
+        std::cout << "Timestamp rate: " << std::fixed << std::setprecision(3) << contents.ticksPerSec / 1e6 << " MHz" << std::endl;
+        for (auto &ring: contents.rings)
+            std::cout << "Ring " << ring.name << ": " << ring.records.size() << " records kept of " <<
+                ring.written << " written" << std::endl;
+    }
+
+    // merge all rings into one time ordered list
+    std::vector<Entry> entries;
+    u_int64_t newest{0};
+    for (size_t i = 0; i < contents.rings.size(); i++) {
+        if (vm.count("ring") && (contents.rings[i].name != ringName))
+            continue;
+        for (auto &rec: contents.rings[i].records) {
+            if (rec.action == TraceAction::none)
+                continue;
+            newest = std::max(newest, rec.tsc);
+            entries.push_back(Entry{&rec, i});
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const Entry &a, const Entry &b) { return a.rec->tsc < b.rec->tsc; });
+
+    auto newestNs = contents.toEpochNs(newest);
+    if (csv)
+        std::cout << "epoch_ns,rel_usec,ring,action,event,data_id,offset,length,aux" << std::endl;
+    else
+        std::cout << std::left << std::setw(22) << "Time" << std::right << std::setw(14) << "Rel usec" << "  " <<
+            std::left << std::setw(8) << "Ring" << std::setw(20) << "Action" << std::right <<
+            std::setw(20) << "Event" << std::setw(8) << "DataId" << std::setw(12) << "Offset" <<
+            std::setw(12) << "Length" << std::setw(10) << "Aux" << std::endl;
+
+    size_t shown{0};
+    for (auto &e: entries) {
+        auto &rec = *e.rec;
+        auto epochNs = contents.toEpochNs(rec.tsc);
+        double relUsec = (epochNs - newestNs) / 1000.;
+        if ((lastUsec > 0) && (relUsec < -lastUsec))
+            continue;
+        if (vm.count("event") && (rec.eventNum != eventNum))
+            continue;
+        if ((dataId >= 0) && (rec.dataId != dataId))
+            continue;
+
+        if (csv)
+            std::cout << epochNs << "," << std::fixed << std::setprecision(3) << relUsec << "," <<
+                contents.rings[e.ringIdx].name << "," << traceActionName(rec.action) << "," << rec.eventNum << "," <<
+                rec.dataId << "," << rec.offset << "," << rec.length << "," << rec.aux << std::endl;
+        else
+            std::cout << std::right << std::setw(10) << epochNs / 1000000000 << "." << std::setfill('0') <<
+                std::setw(9) << epochNs % 1000000000 << std::setfill(' ') << "  " <<
+                std::setw(14) << std::fixed << std::setprecision(3) << relUsec << "  " << std::left <<
+                std::setw(8) << contents.rings[e.ringIdx].name << std::setw(20) << traceActionName(rec.action) <<
+                std::right << std::setw(20) << rec.eventNum << std::setw(8) << rec.dataId << std::setw(12) <<
+                rec.offset << std::setw(12) << rec.length << std::setw(10) << rec.aux << std::endl;
+        shown++;
+    }
+    if (!csv)
+        std::cout << shown << " records shown" << std::endl;
+    return 0;
+}
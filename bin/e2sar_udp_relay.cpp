@@ -1,8 +1,13 @@
 /**
- * E2SAR UDP Relay - A simple UDP packet forwarder
+ * E2SAR UDP Relay - A UDP packet forwarder
  *
  * Receives UDP packets on a specified port and immediately forwards them
  * to a destination IP address and port. Supports both IPv4 and IPv6.
+ * Relays either sync packets or LB+RE framed data packets, validating
+ * their headers. Several relay threads can share the receive port
+ * (SO_REUSEPORT), each receiving and sending in batches. With more than
+ * one destination (fan-out) every packet is mirrored to all of them, each
+ * destination optionally sampling or filtering on header fields.
  */
 
 #include <signal.h>
@@ -15,6 +20,9 @@
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <vector>
+#include <list>
+#include <sstream>
 #include <boost/program_options.hpp>
 #include <boost/asio.hpp>
 
@@ -28,44 +36,108 @@ using namespace e2sar;
 using namespace boost::asio;
 using namespace std::string_literals;
 
-// Statistics (atomic for thread-safety)
-std::atomic<uint64_t> packetsReceived{0};
-std::atomic<uint64_t> bytesReceived{0};
-std::atomic<uint64_t> packetsSent{0};
-std::atomic<uint64_t> sendErrors{0};
-std::atomic<uint64_t> packetsDiscarded{0};
+// most datagrams received or sent per call
+const size_t MAX_BATCH_SIZE{1024};
+// largest UDP datagram
+const size_t MAX_PACKET_SIZE{65536};
+// how often relay threads wake up to check for shutdown
+const int RECV_TIMEOUT_MS{100};
+
+// What is being relayed, determines header validation
+enum class RelayMode { sync, data };
+
+// Per-thread statistics, each thread writes only its own (cache-line aligned)
+struct alignas(64) RelayStats {
+    std::atomic<uint64_t> packetsReceived{0};
+    std::atomic<uint64_t> bytesReceived{0};
+    std::atomic<uint64_t> packetsSent{0};
+    std::atomic<uint64_t> sendErrors{0};
+    std::atomic<uint64_t> packetsDiscarded{0};
+    std::atomic<uint64_t> recvCalls{0}; // packetsReceived/recvCalls is the average batch
+};
+
+// One destination of the relay. In fan-out mode each destination may
+// forward only a sample of the traffic and/or only the packets matching
+// the header filters.
+struct Destination {
+    ip::address addr;
+    u_int16_t port{0};
+    sockaddr_storage sa{};
+    socklen_t saLen{0};
+    float sample{1.0};      // fraction of events (data mode) or packets (sync mode) forwarded
+    int dataId{-1};         // forward only this RE data id (data mode), -1 - any
+    EventNum_t evMod{0};    // forward only events with eventNum % evMod == evRem, 0 - any
+    EventNum_t evRem{0};
+    std::string spec;
+
+    inline bool filtered() const
+    {
+        return (sample < 1.0) || (dataId >= 0) || (evMod > 0);
+    }
+};
+
+// Per-destination counters of a relay thread
+struct DestCounters {
+    std::atomic<uint64_t> forwarded{0};
+    std::atomic<uint64_t> skipped{0}; // sampled out or filtered out
+};
+
+// State of one relay thread: its own receive socket (sharing the port with
+// the other threads) and either a connected send socket (single destination)
+// or unconnected per-family send sockets (fan-out)
+struct RelayThread {
+    int rxSock{-1};
+    int txSock{-1};
+    int txSock4{-1};
+    int txSock6{-1};
+    std::thread threadObj;
+    RelayStats stats;
+    std::vector<DestCounters> destStats;
+
+    RelayThread(size_t numDests): destStats(numDests) {}
+};
 
 // Control flags
 std::atomic<bool> keepRunning{true};
-std::atomic<bool> handlerTriggered{false};
-
-// For cleanup in signal handler
-int rxSocket{-1};
-int txSocket{-1};
-std::thread statsThread;
 
 /**
  * Print relay statistics to stdout
  */
-void printStats()
+void printStats(const std::list<RelayThread> &threads, const std::vector<Destination> &dests)
 {
+    uint64_t received{0}, bytes{0}, sent{0}, discarded{0}, errors{0}, calls{0};
+    for (auto &t: threads) {
+        received += t.stats.packetsReceived;
+        bytes += t.stats.bytesReceived;
+        sent += t.stats.packetsSent;
+        discarded += t.stats.packetsDiscarded;
+        errors += t.stats.sendErrors;
+        calls += t.stats.recvCalls;
+    }
     std::cout << "\nStatistics:" << std::endl;
-    std::cout << "  Packets received: " << packetsReceived << std::endl;
-    std::cout << "  Bytes received:   " << bytesReceived << std::endl;
-    std::cout << "  Packets sent:     " << packetsSent << std::endl;
-    std::cout << "  Packets discarded:" << packetsDiscarded << std::endl;
-    std::cout << "  Send errors:      " << sendErrors << std::endl;
-}
-
-/**
- * Background thread function that prints statistics once per second
- */
-void statsThreadFunc()
-{
-    while (keepRunning) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        if (keepRunning) {
-            printStats();
+    std::cout << "  Packets received: " << received << std::endl;
+    std::cout << "  Bytes received:   " << bytes << std::endl;
+    std::cout << "  Packets sent:     " << sent << std::endl;
+    std::cout << "  Packets discarded:" << discarded << std::endl;
+    std::cout << "  Send errors:      " << errors << std::endl;
+    if (calls > 0)
+        std::cout << "  Average batch:    " << static_cast<double>(received) / calls << std::endl;
+    if (threads.size() > 1) {
+        size_t idx{0};
+        for (auto &t: threads)
+            std::cout << "  Thread " << idx++ << ": " << t.stats.packetsReceived << " received " <<
+                t.stats.packetsSent << " sent " << t.stats.packetsDiscarded << " discarded " <<
+                t.stats.sendErrors << " send errors" << std::endl;
+    }
+    if (dests.size() > 1 || dests[0].filtered()) {
+        for (size_t d = 0; d < dests.size(); d++) {
+            uint64_t fwd{0}, skip{0};
+            for (auto &t: threads) {
+                fwd += t.destStats[d].forwarded;
+                skip += t.destStats[d].skipped;
+            }
+            std::cout << "  Destination " << dests[d].spec << ": " << fwd << " forwarded " <<
+                skip << " skipped" << std::endl;
         }
     }
 }
@@ -75,27 +147,7 @@ void statsThreadFunc()
  */
 void signalHandler(int sig)
 {
-    if (handlerTriggered.exchange(true))
-        return;
-
-    std::cout << "\nShutting down..." << std::endl;
     keepRunning = false;
-
-    // Wait for stats thread to finish
-    if (statsThread.joinable()) {
-        statsThread.join();
-    }
-
-    // Close sockets
-    if (rxSocket >= 0)
-        close(rxSocket);
-    if (txSocket >= 0)
-        close(txSocket);
-
-    // Print final statistics
-    printStats();
-
-    exit(0);
 }
 
 /**
@@ -115,11 +167,13 @@ void conflicting_options(const po::variables_map &vm,
  * @param addr Address to bind to
  * @param port Port to bind to
  * @param bufSize Socket buffer size
+ * @param reusePort Allow other relay threads to bind the same port (SO_REUSEPORT)
  * @return Socket file descriptor or error
  */
-result<int> createReceiveSocket(ip::address addr, u_int16_t port, int bufSize)
+result<int> createReceiveSocket(ip::address addr, u_int16_t port, int bufSize, bool reusePort)
 {
     int fd;
+    int one{1};
 
     // Create socket based on address type
     if (addr.is_v6()) {
@@ -136,6 +190,13 @@ result<int> createReceiveSocket(ip::address addr, u_int16_t port, int bufSize)
                 "Unable to set receive buffer size: "s + strerror(errno)};
         }
 
+        // Let the kernel spread flows across relay threads
+        if (reusePort && (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)) {
+            close(fd);
+            return E2SARErrorInfo{E2SARErrorc::SocketError,
+                "Unable to set SO_REUSEPORT: "s + strerror(errno)};
+        }
+
         // Bind to specified address
         sockaddr_in6 rxAddr{};
         rxAddr.sin6_family = AF_INET6;
@@ -161,6 +222,13 @@ result<int> createReceiveSocket(ip::address addr, u_int16_t port, int bufSize)
                 "Unable to set receive buffer size: "s + strerror(errno)};
         }
 
+        // Let the kernel spread flows across relay threads
+        if (reusePort && (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)) {
+            close(fd);
+            return E2SARErrorInfo{E2SARErrorc::SocketError,
+                "Unable to set SO_REUSEPORT: "s + strerror(errno)};
+        }
+
         // Bind to specified address
         sockaddr_in rxAddr{};
         rxAddr.sin_family = AF_INET;
@@ -174,6 +242,16 @@ result<int> createReceiveSocket(ip::address addr, u_int16_t port, int bufSize)
         }
     }
 
+    // Wake up periodically to check for shutdown
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = RECV_TIMEOUT_MS * 1000;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+        close(fd);
+        return E2SARErrorInfo{E2SARErrorc::SocketError,
+            "Unable to set receive timeout: "s + strerror(errno)};
+    }
+
     return fd;
 }
 
@@ -247,6 +325,149 @@ result<int> createSendSocket(ip::address dest, u_int16_t port, int bufSize)
     return fd;
 }
 
+/**
+ * Create an unconnected UDP send socket for fan-out, destinations
+ * are given per message
+ *
+ * @param v6 IPv6 or IPv4 socket
+ * @param bufSize Socket buffer size
+ * @return Socket file descriptor or error
+ */
+result<int> createFanoutSocket(bool v6, int bufSize)
+{
+    int fd = socket(v6 ? AF_INET6 : AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return E2SARErrorInfo{E2SARErrorc::SocketError,
+            "Unable to create IPv"s + (v6 ? "6" : "4") + " send socket: "s + strerror(errno)};
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize)) < 0) {
+        close(fd);
+        return E2SARErrorInfo{E2SARErrorc::SocketError,
+            "Unable to set send buffer size: "s + strerror(errno)};
+    }
+    return fd;
+}
+
+/**
+ * Parse a destination specification of the form
+ * ip:port[,sample=R][,dataid=N][,evmod=M:R]
+ *
+ * @param spec Destination specification
+ * @return Destination or error
+ */
+result<Destination> parseDestination(const std::string &spec)
+{
+    Destination d;
+    d.spec = spec;
+
+    std::istringstream ss(spec);
+    std::string token;
+    std::getline(ss, token, ',');
+
+    auto res = string_tuple_to_ip_and_port(token);
+    if (res.has_error())
+        return E2SARErrorInfo{E2SARErrorc::ParameterError,
+            "Invalid destination address "s + token + ": "s + res.error().message()};
+    d.addr = res.value().first;
+    d.port = res.value().second;
+    if (d.port == 0)
+        return E2SARErrorInfo{E2SARErrorc::ParameterError,
+            "Destination port must be specified in format IP:PORT in "s + spec};
+
+    try {
+        while (std::getline(ss, token, ',')) {
+            auto eq = token.find('=');
+            if (eq == std::string::npos)
+                throw std::invalid_argument("missing '='");
+            auto key = token.substr(0, eq);
+            auto val = token.substr(eq + 1);
+            if (key == "sample") {
+                d.sample = std::stof(val);
+                if (d.sample <= 0.0 || d.sample > 1.0)
+                    throw std::invalid_argument("sample must be in (0, 1]");
+            } else if (key == "dataid") {
+                d.dataId = std::stoi(val);
+                if (d.dataId < 0 || d.dataId > UINT16_MAX)
+                    throw std::invalid_argument("dataid must be between 0 and 65535");
+            } else if (key == "evmod") {
+                auto colon = val.find(':');
+                if (colon == std::string::npos)
+                    throw std::invalid_argument("evmod must be M:R");
+                d.evMod = std::stoull(val.substr(0, colon));
+                d.evRem = std::stoull(val.substr(colon + 1));
+                if (d.evMod == 0 || d.evRem >= d.evMod)
+                    throw std::invalid_argument("evmod requires M > 0 and R < M");
+            } else
+                throw std::invalid_argument("unknown option '" + key + "'");
+        }
+    } catch (const std::exception &e) {
+        return E2SARErrorInfo{E2SARErrorc::ParameterError,
+            "Invalid destination "s + spec + ": "s + e.what()};
+    }
+
+    // Address used per message in fan-out mode
+    if (d.addr.is_v6()) {
+        auto sin6 = reinterpret_cast<sockaddr_in6*>(&d.sa);
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(d.port);
+        inet_pton(AF_INET6, d.addr.to_string().c_str(), &sin6->sin6_addr);
+        d.saLen = sizeof(sockaddr_in6);
+    } else {
+        auto sin = reinterpret_cast<sockaddr_in*>(&d.sa);
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(d.port);
+        inet_pton(AF_INET, d.addr.to_string().c_str(), &sin->sin_addr);
+        d.saLen = sizeof(sockaddr_in);
+    }
+    return d;
+}
+
+/**
+ * Decide whether a validated packet is forwarded to a fan-out destination.
+ * In data mode sampling is decided per event (hash of the event number) so
+ * that all segments of a sampled event reach the destination; in sync mode
+ * every 1/sample-th packet is forwarded.
+ *
+ * @param d Destination
+ * @param mode Sync or data packets
+ * @param buf Packet (already validated)
+ * @param acc Sampling accumulator of this destination in this thread (sync mode)
+ * @return true if the packet should be forwarded
+ */
+inline bool selectPacket(const Destination &d, RelayMode mode, const uint8_t *buf, float &acc)
+{
+    if (!d.filtered())
+        return true;
+
+    EventNum_t eventNum;
+    if (mode == RelayMode::data) {
+        const LBREHdr* hdr = reinterpret_cast<const LBREHdr*>(buf);
+        if ((d.dataId >= 0) && (hdr->re.get_dataId() != d.dataId))
+            return false;
+        eventNum = hdr->re.get_eventNum();
+    } else
+        eventNum = reinterpret_cast<const SyncHdr*>(buf)->get_eventNumber();
+
+    if ((d.evMod > 0) && (eventNum % d.evMod != d.evRem))
+        return false;
+
+    if (d.sample >= 1.0)
+        return true;
+
+    if (mode == RelayMode::data) {
+        // Fibonacci hash spreads consecutive event numbers over [0, 1)
+        uint64_t h = eventNum * 0x9E3779B97F4A7C15ULL;
+        return static_cast<float>(h >> 40) / static_cast<float>(1ULL << 24) < d.sample;
+    }
+    acc += d.sample;
+    if (acc >= 1.0) {
+        acc -= 1.0;
+        return true;
+    }
+    return false;
+}
+
 /**
  * Validate that a received packet conforms to SyncHdr structure
  *
@@ -291,54 +512,179 @@ bool validateSyncPacket(const uint8_t* buffer, ssize_t len)
 }
 
 /**
- * Main relay loop - receives packets and forwards them
+ * Validate that a received packet is an LB+RE framed data packet
+ * (as sent by a Segmenter towards the load balancer)
  *
- * @param rxSock Receive socket file descriptor
- * @param txSock Send socket file descriptor
+ * @param buffer Pointer to received data
+ * @param len Length of received data
+ * @return true if valid LB+RE packet, false otherwise
  */
-void relayLoop(int rxSock, int txSock)
+bool validateDataPacket(const uint8_t* buffer, ssize_t len)
 {
-    const size_t bufferSize = 65536; // Max UDP packet size
-    uint8_t buffer[bufferSize];
+    // At least the headers and one byte of payload
+    if (static_cast<size_t>(len) <= sizeof(LBREHdr))
+        return false;
 
-    while (keepRunning) {
-        // Receive packet
-        ssize_t recvLen = recvfrom(rxSock, buffer, bufferSize, 0, nullptr, nullptr);
+    const LBREHdr* hdr = reinterpret_cast<const LBREHdr*>(buffer);
 
-        if (recvLen < 0) {
-            if (errno == EINTR) {
-                // Signal interrupted, check keepRunning flag
-                continue;
-            }
-            sendErrors++;
-            continue; // Don't exit on single error
-        }
+    // Check LB preamble is 'L', 'B' and the version is one we know
+    if (hdr->lbu.lb2.preamble[0] != 'L' || hdr->lbu.lb2.preamble[1] != 'B')
+        return false;
+    if (!hdr->lbu.lb2.check_version() && !hdr->lbu.lb3.check_version())
+        return false;
+
+    // Check RE version and reserved field
+    return hdr->re.validate();
+}
 
-        if (recvLen == 0) {
-            continue; // Zero-length packet
+/**
+ * Send a batch of packets, skipping the ones that fail. The socket is either
+ * connected or every message carries its destination in msg_name.
+ *
+ * @param txSock Send socket file descriptor
+ * @param msgs Packets to send
+ * @param num Number of packets
+ * @param stats Statistics to update
+ */
+void sendBatch(int txSock, mmsghdr *msgs, size_t num, RelayStats &stats)
+{
+    size_t sent{0};
+    while (sent < num) {
+#ifdef SENDMMSG_AVAILABLE
+        int ret = sendmmsg(txSock, msgs + sent, num - sent, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            // skip the packet that failed and carry on with the rest
+            stats.sendErrors++;
+            sent++;
+            continue;
         }
+        sent += ret;
+        stats.packetsSent.fetch_add(ret, std::memory_order_relaxed);
+#else
+        if (sendmsg(txSock, &msgs[sent].msg_hdr, 0) < 0) {
+            if (errno == EINTR)
+                continue;
+            stats.sendErrors++;
+        } else
+            stats.packetsSent++;
+        sent++;
+#endif
+    }
+}
 
-        // Update receive statistics
-        packetsReceived++;
-        bytesReceived += recvLen;
+/**
+ * Main relay loop - receives a batch of packets, validates them and
+ * forwards the valid ones as a batch. In fan-out mode each valid packet
+ * is added to the send batch once per selected destination; the batch is
+ * split by address family since the send sockets are per family.
+ *
+ * @param rt Relay thread state (sockets and statistics)
+ * @param dests Destinations
+ * @param mode Sync or data packets
+ * @param batchSize Most packets received per call
+ */
+void relayLoop(RelayThread &rt, const std::vector<Destination> &dests, RelayMode mode, size_t batchSize)
+{
+    const bool fanout = (rt.txSock < 0);
+    // One maximum size buffer per batch slot, allocated once
+    std::vector<uint8_t> buffers(batchSize * MAX_PACKET_SIZE);
+    std::vector<mmsghdr> recvMsgs(batchSize);
+    std::vector<iovec> recvIov(batchSize);
+    // fan-out sends up to one message per packet per destination
+    std::vector<mmsghdr> sendMsgs(batchSize * dests.size());
+    std::vector<mmsghdr> sendMsgs6(fanout ? batchSize * dests.size() : 0);
+    std::vector<float> sampleAcc(dests.size(), 0.0);
+
+    memset(recvMsgs.data(), 0, sizeof(mmsghdr) * batchSize);
+    for (size_t i = 0; i < batchSize; i++) {
+        recvIov[i].iov_base = buffers.data() + i * MAX_PACKET_SIZE;
+        recvIov[i].iov_len = MAX_PACKET_SIZE;
+        recvMsgs[i].msg_hdr.msg_iov = &recvIov[i];
+        recvMsgs[i].msg_hdr.msg_iovlen = 1;
+    }
 
-        // Validate packet structure before forwarding
-        if (!validateSyncPacket(buffer, recvLen)) {
-            packetsDiscarded++;
+    while (keepRunning) {
+        size_t numRecvd{0};
+#ifdef SENDMMSG_AVAILABLE
+        // Block for the first packet, then take whatever else is already queued
+        int ret = recvmmsg(rt.rxSock, recvMsgs.data(), batchSize, MSG_WAITFORONE, nullptr);
+        if (ret < 0) {
+            // timeout or signal, check keepRunning flag
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+                rt.stats.sendErrors++;
             continue;
         }
+        numRecvd = static_cast<size_t>(ret);
+#else
+        for (; numRecvd < batchSize; numRecvd++) {
+            ssize_t ret = recvmsg(rt.rxSock, &recvMsgs[numRecvd].msg_hdr, (numRecvd == 0 ? 0 : MSG_DONTWAIT));
+            if (ret < 0) {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+                    rt.stats.sendErrors++;
+                break;
+            }
+            recvMsgs[numRecvd].msg_len = static_cast<unsigned int>(ret);
+        }
+        if (numRecvd == 0)
+            continue;
+#endif
+        rt.stats.recvCalls++;
+
+        // Collect valid packets into the send batch(es)
+        size_t numSend{0}, numSend6{0};
+        uint64_t bytes{0};
+        for (size_t i = 0; i < numRecvd; i++) {
+            auto len = recvMsgs[i].msg_len;
+            auto buf = reinterpret_cast<const uint8_t*>(recvIov[i].iov_base);
+            bytes += len;
+
+            // Zero-length or truncated packets are not relayed
+            bool valid = (len > 0) && !(recvMsgs[i].msg_hdr.msg_flags & MSG_TRUNC);
+            if (valid)
+                valid = (mode == RelayMode::sync ? validateSyncPacket(buf, len) : validateDataPacket(buf, len));
+            if (!valid) {
+                rt.stats.packetsDiscarded++;
+                continue;
+            }
+
+            // only send what was received, restored below
+            recvIov[i].iov_len = len;
 
-        // Forward packet
-        ssize_t sentLen = send(txSock, buffer, recvLen, 0);
+            if (!fanout) {
+                // connected socket, no addresses
+                auto &msg = sendMsgs[numSend++];
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_hdr.msg_iov = &recvIov[i];
+                msg.msg_hdr.msg_iovlen = 1;
+                continue;
+            }
 
-        if (sentLen < 0) {
-            sendErrors++;
-        } else if (sentLen == recvLen) {
-            packetsSent++;
-        } else {
-            // Partial send
-            sendErrors++;
+            for (size_t d = 0; d < dests.size(); d++) {
+                if (!selectPacket(dests[d], mode, buf, sampleAcc[d])) {
+                    rt.destStats[d].skipped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                rt.destStats[d].forwarded.fetch_add(1, std::memory_order_relaxed);
+                auto &msg = (dests[d].addr.is_v6() ? sendMsgs6[numSend6++] : sendMsgs[numSend++]);
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_hdr.msg_name = const_cast<sockaddr_storage*>(&dests[d].sa);
+                msg.msg_hdr.msg_namelen = dests[d].saLen;
+                msg.msg_hdr.msg_iov = &recvIov[i];
+                msg.msg_hdr.msg_iovlen = 1;
+            }
         }
+        rt.stats.packetsReceived.fetch_add(numRecvd, std::memory_order_relaxed);
+        rt.stats.bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+
+        if (numSend > 0)
+            sendBatch(fanout ? rt.txSock4 : rt.txSock, sendMsgs.data(), numSend, rt.stats);
+        if (numSend6 > 0)
+            sendBatch(rt.txSock6, sendMsgs6.data(), numSend6, rt.stats);
+
+        for (size_t i = 0; i < numRecvd; i++)
+            recvIov[i].iov_len = MAX_PACKET_SIZE;
     }
 }
 
@@ -351,14 +697,21 @@ int main(int argc, char **argv)
     );
 
     std::string rxAddrStr;
-    std::string txAddrStr;
+    std::vector<std::string> txAddrStrs;
+    std::string modeStr;
     int rxBufSize, txBufSize;
+    size_t numThreads, batchSize;
+    u_int32_t reportSec;
 
     // Define command-line options
     opts("rx-addr,r", po::value<std::string>(&rxAddrStr)->default_value("127.0.0.1:0"), "Address and port to receive on (e.g., \"192.168.1.1:5000\" or \"[::1]:5000\"). Default: 127.0.0.1:0");
-    opts("tx-addr,t", po::value<std::string>(&txAddrStr), "Destination address and port (e.g., \"192.168.1.1:5000\" or \"[::1]:5000\") [required]");
+    opts("tx-addr,t", po::value<std::vector<std::string>>(&txAddrStrs)->multitoken(), "Destination address and port (e.g., \"192.168.1.1:5000\" or \"[::1]:5000\") [required]. Repeat for fan-out, each destination optionally followed by ',sample=R' (forward fraction R of events/packets), ',dataid=N' (data mode only) and/or ',evmod=M:R' (only event numbers with eventNum % M == R)");
     opts("rx-bufsize", po::value<int>(&rxBufSize)->default_value(1048576), "Receive socket buffer size in bytes (default 1MB)");
     opts("tx-bufsize", po::value<int>(&txBufSize)->default_value(1048576), "Send socket buffer size in bytes (default 1MB)");
+    opts("mode", po::value<std::string>(&modeStr)->default_value("sync"), "What is relayed: 'sync' packets or LB+RE framed 'data' packets (headers are validated accordingly)");
+    opts("threads", po::value<size_t>(&numThreads)->default_value(1), "Number of relay threads sharing the receive port (SO_REUSEPORT)");
+    opts("batch", po::value<size_t>(&batchSize)->default_value(32), "Most packets received and sent per system call");
+    opts("report", po::value<u_int32_t>(&reportSec)->default_value(1), "Statistics reporting interval in seconds (0 - only at exit)");
 
     po::variables_map vm;
 
@@ -375,9 +728,12 @@ int main(int argc, char **argv)
         std::cout << "E2SAR UDP Relay" << std::endl;
         std::cout << "Version: " << get_Version() << std::endl;
         std::cout << std::endl;
-        std::cout << "A simple UDP packet forwarder that receives packets on one address/port" << std::endl;
+        std::cout << "A UDP packet forwarder that receives packets on one address/port" << std::endl;
         std::cout << "and forwards them to another. Supports both IPv4 and IPv6, including" << std::endl;
-        std::cout << "mixed protocol relaying (IPv4 to IPv6 and vice versa)." << std::endl;
+        std::cout << "mixed protocol relaying (IPv4 to IPv6 and vice versa). Relays sync packets" << std::endl;
+        std::cout << "or, in data mode, LB+RE framed data packets. Use several threads for high" << std::endl;
+        std::cout << "data rates, the kernel spreads sender flows across them. With several" << std::endl;
+        std::cout << "destinations every packet is mirrored to each of them (fan-out)." << std::endl;
         std::cout << std::endl;
         std::cout << od << std::endl;
         std::cout << std::endl;
@@ -386,6 +742,9 @@ int main(int argc, char **argv)
         std::cout << "  IPv4 specific:  e2sar_udp_relay -r 192.168.1.1:10000 -t 192.168.1.100:10001" << std::endl;
         std::cout << "  IPv6 loopback:  e2sar_udp_relay -r [::1]:10000 -t [::1]:10001" << std::endl;
         std::cout << "  Mixed protocol: e2sar_udp_relay -r 127.0.0.1:10000 -t [::1]:10001" << std::endl;
+        std::cout << "  Data, 4 threads: e2sar_udp_relay -r 192.168.1.1:19522 -t 192.168.1.100:19522 --mode data --threads 4" << std::endl;
+        std::cout << "  Mirror 10%:     e2sar_udp_relay -r 192.168.1.1:19522 -t 192.168.1.100:19522 -t 192.168.1.200:19522,sample=0.1 --mode data" << std::endl;
+        std::cout << "  Split by event: e2sar_udp_relay -r 192.168.1.1:19522 -t 192.168.1.100:19522,evmod=2:0 -t 192.168.1.101:19522,evmod=2:1 --mode data" << std::endl;
         std::cout << std::endl;
         std::cout << "Security note:" << std::endl;
         std::cout << "  Default receive address is 127.0.0.1 (localhost only) for security." << std::endl;
@@ -399,6 +758,15 @@ int main(int argc, char **argv)
         if (!vm.count("tx-addr")) {
             throw std::logic_error("--tx-addr is required");
         }
+        if (modeStr != "sync" && modeStr != "data") {
+            throw std::logic_error("--mode must be 'sync' or 'data'");
+        }
+        if (numThreads < 1) {
+            throw std::logic_error("--threads must be at least 1");
+        }
+        if (batchSize < 1 || batchSize > MAX_BATCH_SIZE) {
+            throw std::logic_error("--batch must be between 1 and " + std::to_string(MAX_BATCH_SIZE));
+        }
     } catch (const std::logic_error &le) {
         std::cerr << "Error: " << le.what() << std::endl;
         std::cerr << "Use --help for usage information" << std::endl;
@@ -418,18 +786,26 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    // Parse destination address and port
-    auto destRes = string_tuple_to_ip_and_port(txAddrStr);
-    if (destRes.has_error()) {
-        std::cerr << "Invalid destination address: " << destRes.error().message() << std::endl;
-        return -1;
-    }
-    auto [destAddr, destPort] = destRes.value();
+    RelayMode mode = (modeStr == "data" ? RelayMode::data : RelayMode::sync);
 
-    if (destPort == 0) {
-        std::cerr << "Error: Destination port must be specified in format IP:PORT" << std::endl;
-        return -1;
+    // Parse destinations
+    std::vector<Destination> dests;
+    bool needV4{false}, needV6{false};
+    for (auto &spec: txAddrStrs) {
+        auto destRes = parseDestination(spec);
+        if (destRes.has_error()) {
+            std::cerr << "Error: " << destRes.error().message() << std::endl;
+            return -1;
+        }
+        if ((mode == RelayMode::sync) && (destRes.value().dataId >= 0)) {
+            std::cerr << "Error: dataid filter only applies in data mode: " << spec << std::endl;
+            return -1;
+        }
+        (destRes.value().addr.is_v6() ? needV6 : needV4) = true;
+        dests.push_back(destRes.value());
     }
+    // a single unfiltered destination uses a connected socket
+    const bool fanout = (dests.size() > 1) || dests[0].filtered();
 
     // Warn if binding to all interfaces
     bool bindingToAll = false;
@@ -457,38 +833,87 @@ int main(int argc, char **argv)
     std::cout << "E2SAR UDP Relay" << std::endl;
     std::cout << "Version:      " << get_Version() << std::endl;
     std::cout << "Receive:      " << rxAddr.to_string() << ":" << rxPort << " (IPv" << (rxAddr.is_v6() ? "6" : "4") << ")" << std::endl;
-    std::cout << "Destination:  " << destAddr.to_string() << ":" << destPort << " (IPv" << (destAddr.is_v6() ? "6" : "4") << ")" << std::endl;
+    for (auto &d: dests)
+        std::cout << "Destination:  " << d.spec << " (IPv" << (d.addr.is_v6() ? "6" : "4") << ")" << std::endl;
+    std::cout << "Mode:         " << modeStr << std::endl;
+    std::cout << "Threads:      " << numThreads << std::endl;
+    std::cout << "Batch:        " << batchSize << std::endl;
     std::cout << "RX buffer:    " << rxBufSize << " bytes" << std::endl;
     std::cout << "TX buffer:    " << txBufSize << " bytes" << std::endl;
     std::cout << std::endl;
 
-    // Create receive socket
-    auto rxSocketRes = createReceiveSocket(rxAddr, rxPort, rxBufSize);
-    if (rxSocketRes.has_error()) {
-        std::cerr << "Failed to create receive socket: " << rxSocketRes.error().message() << std::endl;
-        return -1;
-    }
-    rxSocket = rxSocketRes.value();
-    std::cout << "Receive socket created and bound to " << rxAddr.to_string() << ":" << rxPort << std::endl;
-
-    // Create send socket
-    auto txRes = createSendSocket(destAddr, destPort, txBufSize);
-    if (txRes.has_error()) {
-        std::cerr << "Failed to create send socket: " << txRes.error().message() << std::endl;
-        close(rxSocket);
-        return -1;
+    // Create one receive and one send socket per thread
+    std::list<RelayThread> threads;
+    auto closeAll = [&threads]() {
+        for (auto &t: threads) {
+            if (t.rxSock >= 0)
+                close(t.rxSock);
+            if (t.txSock >= 0)
+                close(t.txSock);
+            if (t.txSock4 >= 0)
+                close(t.txSock4);
+            if (t.txSock6 >= 0)
+                close(t.txSock6);
+        }
+    };
+    for (size_t i = 0; i < numThreads; i++) {
+        auto &t = threads.emplace_back(dests.size());
+
+        auto rxSocketRes = createReceiveSocket(rxAddr, rxPort, rxBufSize, numThreads > 1);
+        if (rxSocketRes.has_error()) {
+            std::cerr << "Failed to create receive socket: " << rxSocketRes.error().message() << std::endl;
+            closeAll();
+            return -1;
+        }
+        t.rxSock = rxSocketRes.value();
+
+        if (!fanout) {
+            auto txRes = createSendSocket(dests[0].addr, dests[0].port, txBufSize);
+            if (txRes.has_error()) {
+                std::cerr << "Failed to create send socket: " << txRes.error().message() << std::endl;
+                closeAll();
+                return -1;
+            }
+            t.txSock = txRes.value();
+            continue;
+        }
+        for (bool v6: {false, true}) {
+            if (!(v6 ? needV6 : needV4))
+                continue;
+            auto txRes = createFanoutSocket(v6, txBufSize);
+            if (txRes.has_error()) {
+                std::cerr << "Failed to create send socket: " << txRes.error().message() << std::endl;
+                closeAll();
+                return -1;
+            }
+            (v6 ? t.txSock6 : t.txSock4) = txRes.value();
+        }
     }
-    txSocket = txRes.value();
-    std::cout << "Send socket created and connected to " << destAddr.to_string() << ":" << destPort << std::endl;
+    std::cout << "Receive sockets created and bound to " << rxAddr.to_string() << ":" << rxPort << std::endl;
+    if (fanout)
+        std::cout << "Send sockets created for fan-out to " << dests.size() << " destinations" << std::endl;
+    else
+        std::cout << "Send sockets created and connected to " << dests[0].addr.to_string() << ":" << dests[0].port << std::endl;
 
     // Start relay
     std::cout << "\nRelay active... (Press Ctrl-C to stop)" << std::endl;
 
-    // Start statistics thread
-    statsThread = std::thread(statsThreadFunc);
+    for (auto &t: threads)
+        t.threadObj = std::thread(relayLoop, std::ref(t), std::cref(dests), mode, batchSize);
+
+    u_int32_t elapsed{0};
+    while (keepRunning) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (keepRunning && (reportSec > 0) && (++elapsed % reportSec == 0))
+            printStats(threads, dests);
+    }
 
-    relayLoop(rxSocket, txSocket);
+    std::cout << "\nShutting down..." << std::endl;
+    for (auto &t: threads)
+        t.threadObj.join();
+    closeAll();
 
-    // Cleanup handled by signal handler
+    // Print final statistics
+    printStats(threads, dests);
     return 0;
 }
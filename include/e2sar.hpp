@@ -6,6 +6,8 @@
 #include "e2sarCP.hpp"
 #include "e2sarDPSegmenter.hpp"
 #include "e2sarDPReassembler.hpp"
+#include "e2sarMetrics.hpp"
+#include "e2sarTrace.hpp"
 
 namespace e2sar
 {
@@ -1,13 +1,18 @@
 #ifndef E2SARCPHPP
 #define E2SARCPHPP
 #include <vector>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <random>
 #include <boost/asio.hpp>
 #include <boost/tuple/tuple.hpp>
 
 #include <grpc/grpc.h>
 #include <grpcpp/channel.h>
 #include <grpcpp/client_context.h>
+#include <grpcpp/alarm.h>
 #include <grpcpp/create_channel.h>
 #include <grpcpp/security/credentials.h>
 
@@ -75,6 +80,30 @@ namespace e2sar
         }
     };
 
+    /**
+     * Statistics of the asynchronous sendState pipeline (see LBManager::sendStateAsync())
+     * - sent - number of SendState RPCs issued
+     * - completed - number of RPCs that succeeded
+     * - failed - number of RPCs that failed, including those that ran past their deadline
+     * - deadlineExceeded - number of RPCs that failed because their deadline expired
+     * - coalesced - number of samples replaced by a newer one before they could be sent
+     * - inFlight - an RPC is currently outstanding
+     * - backoff_ms - how long before the next RPC may be issued after failures (0 if not backing off)
+     * - lastError - error message of the most recent failed RPC
+     * - rpcLatency - RPC round trip time histogram in nanoseconds
+     */
+    struct SendStateStats {
+        u_int64_t sent{0};
+        u_int64_t completed{0};
+        u_int64_t failed{0};
+        u_int64_t deadlineExceeded{0};
+        u_int64_t coalesced{0};
+        bool inFlight{false};
+        u_int32_t backoff_ms{0};
+        std::string lastError;
+        LatencyHistogram::Snapshot rpcLatency;
+    };
+
     /**
      * Status of LB (converted to this structure from loadbalancer::LoadBalancerStatusReply)
      */
@@ -202,6 +231,109 @@ namespace e2sar
      */
     using TokenSelector = std::variant<uint32_t, std::string>;
 
+    /**
+     * Process-wide cache of gRPC channels to the control plane. LBManagers (and through them
+     * Reassemblers and Segmenters) connecting to the same CP address with the same credentials
+     * share one channel and with it one connection and TLS session, instead of each doing its own
+     * handshake. A cached channel lives as long as some LBManager uses it.
+     *
+     * Channels are created with HTTP/2 keepalive so a dead connection to the CP is noticed
+     * between calls. Note that servers commonly reject pings more frequent than every 5 minutes on
+     * connections with no calls, so permitWithoutCalls should stay off unless the CP allows it.
+     */
+    class ChannelCache
+    {
+        public:
+            /**
+             * Keepalive settings of newly created channels
+             * - time_ms - interval between keepalive pings {60000}
+             * - timeout_ms - how long to wait for a ping acknowledgement before closing the connection {20000}
+             * - permitWithoutCalls - send pings even when there are no calls in progress {false}
+             */
+            struct KeepaliveOptions
+            {
+                int time_ms;
+                int timeout_ms;
+                bool permitWithoutCalls;
+                KeepaliveOptions(): time_ms{60000}, timeout_ms{20000}, permitWithoutCalls{false} {}
+            };
+
+            /**
+             * Cache statistics
+             * - hits - channels handed out from the cache
+             * - misses - channels created
+             * - active - channels currently in use
+             */
+            struct CacheStats
+            {
+                u_int64_t hits{0};
+                u_int64_t misses{0};
+                size_t active{0};
+            };
+
+            /**
+             * Get a shared channel, creating it if necessary
+             * @param target - gRPC target string (e.g. 'ipv4:///192.168.1.1:18008' or 'cp.example.org:18008')
+             * @param useTls - use TLS, otherwise plaintext
+             * @param validateServer - validate the server certificate (TLS only)
+             * @param opts - custom SSL options (TLS with server validation only)
+             */
+            static std::shared_ptr<grpc::Channel> getChannel(const std::string &target, bool useTls,
+                bool validateServer, const grpc::SslCredentialsOptions &opts) noexcept;
+
+            /**
+             * Create a channel outside of the cache with the current keepalive settings
+             */
+            static std::shared_ptr<grpc::Channel> makeChannel(const std::string &target, bool useTls,
+                bool validateServer, const grpc::SslCredentialsOptions &opts) noexcept;
+
+            /**
+             * Set keepalive options for channels created from now on (channels in use keep theirs)
+             */
+            static void setKeepalive(const KeepaliveOptions &ko) noexcept;
+
+            /**
+             * Get current keepalive options
+             */
+            static KeepaliveOptions getKeepalive() noexcept;
+
+            /**
+             * Enable or disable sharing (enabled by default). When disabled every LBManager
+             * creates its own channel.
+             */
+            static void setEnabled(bool e) noexcept;
+
+            /**
+             * Is sharing enabled
+             */
+            static bool isEnabled() noexcept;
+
+            /**
+             * Get cache statistics
+             */
+            static CacheStats getStats() noexcept;
+
+        private:
+            struct State
+            {
+                std::mutex mtx;
+                // by target, keepalive settings and a digest of the credentials
+                std::map<std::string, std::weak_ptr<grpc::Channel>> channels;
+                KeepaliveOptions keepalive;
+                bool enabled{true};
+                CacheStats stats;
+            };
+            // constructed on first use so LBManagers created during static initialization
+            // of other translation units find it ready
+            static State& state() noexcept;
+
+            static std::shared_ptr<grpc::Channel> createChannel(const std::string &target, bool useTls,
+                bool validateServer, const grpc::SslCredentialsOptions &opts, const KeepaliveOptions &ko) noexcept;
+
+            ChannelCache() = delete;
+            ~ChannelCache() = delete;
+    };
+
     class LBManager
     {
     private:
@@ -210,8 +342,69 @@ namespace e2sar
         std::unique_ptr<LoadBalancer::Stub> _stub;
         std::shared_ptr<grpc::Channel> _channel;
 
+        // one asynchronous SendState call, everything the RPC refers to must outlive it
+        struct SendStateCall {
+            ClientContext context;
+            loadbalancer::SendStateRequest req;
+            loadbalancer::SendStateReply rep;
+            u_int32_t deadline_ms{0};
+            boost::chrono::steady_clock::time_point startT;
+        };
+
+        // state of the asynchronous sendState pipeline. At most one call is outstanding,
+        // a sample arriving while it is (or while backing off after failures) is parked
+        // in pending, replacing whatever was parked there before. A failure arms an alarm
+        // that sends the parked sample once the backoff expires. Completions and the alarm
+        // run on gRPC threads so this lives behind a pointer that does not move with LBManager. 
+        // The destructor cancels the outstanding call and the alarm and waits for both. The call in
+        // flight is shared with its completion handler so it can be cancelled without mtx held.
+        struct AsyncSendState {
+            LoadBalancer::Stub *stub;
+            std::mutex mtx;
+            std::condition_variable cv;
+            std::shared_ptr<SendStateCall> inFlight;
+            std::unique_ptr<SendStateCall> pending;
+            bool stopping{false};
+            u_int32_t failures{0};
+            u_int32_t backoffMin_ms{SENDSTATE_BACKOFF_MIN_MS};
+            u_int32_t backoffMax_ms{SENDSTATE_BACKOFF_MAX_MS};
+            boost::chrono::steady_clock::time_point retryAfter;
+            // fires at retryAfter, a new one each time it is armed
+            std::unique_ptr<grpc::Alarm> flushAlarm;
+            bool alarmArmed{false};
+            std::minstd_rand rng;
+            u_int64_t sent{0}, completed{0}, failed{0}, deadlineExceeded{0}, coalesced{0};
+            std::string lastError;
+            LatencyHistogram rpcLatency;
+
+            AsyncSendState(LoadBalancer::Stub *s): stub{s}, rng{std::random_device{}()} {}
+            ~AsyncSendState();
+            // set the deadline and start time of a call before it is published as inFlight
+            void prepare(SendStateCall &call) noexcept;
+            // issue a prepared call already set as inFlight (called without holding mtx)
+            void start(std::shared_ptr<SendStateCall> call) noexcept;
+            // completion handler running on a gRPC thread
+            void complete(std::shared_ptr<SendStateCall> call, const grpc::Status &status) noexcept;
+            // arm the alarm for retryAfter unless it is already armed (called with mtx held)
+            void armFlush() noexcept;
+            // alarm handler running on a gRPC thread, sends the parked sample if the backoff is over
+            void flush(bool fired) noexcept;
+        };
+        std::unique_ptr<AsyncSendState> _asyncState;
+
+        // fill in SendState request and context metadata common to the blocking and async calls
+        result<int> makeSendStateRequest(ClientContext &context, loadbalancer::SendStateRequest &req,
+            float fill_percent, float control_signal, bool is_ready, const Timestamp &ts,
+            const WorkerStats &stats) noexcept;
+
     protected:
     public:
+        // default exponential backoff bounds of the async sendState pipeline after failed RPCs
+        // (see setSendStateBackoff()). The actual delay is drawn uniformly from [delay/2, delay] 
+        // to avoid workers retrying in lockstep
+        static constexpr u_int32_t SENDSTATE_BACKOFF_MIN_MS{100};
+        static constexpr u_int32_t SENDSTATE_BACKOFF_MAX_MS{5000};
+
         /**
          * Initialize manager. Default is with TLS/SSL and default client options. To enable
          * custom SSL configuration with custom root certs, private key (for authN) and cert
@@ -222,6 +415,8 @@ namespace e2sar
          * IPv4 by default or for IPv6 if explicitly requested)
          * @param opts grpc::SslCredentialsOptions containing some combination of server root certs, client key and client cert
          * use of SSL/TLS is governed by the URI scheme ('ejfat' vs 'ejfats')
+         * The gRPC channel is shared with other LBManagers talking to the same CP with the same
+         * credentials unless disabled via ChannelCache::setEnabled()
          */
         LBManager(const EjfatURI &cpuri, bool validateServer = true, bool useHostAddress = false,
                   grpc::SslCredentialsOptions opts = grpc::SslCredentialsOptions()) : _cpuri(cpuri)
@@ -252,29 +447,13 @@ namespace e2sar
                     addr_string = "ipv6:///[" + cp_addr_v.first.to_string() + "]:" + std::to_string(cp_addr_v.second);
             }
 
-            if (cpuri.get_useTls())
-            {
-                grpc::experimental::TlsChannelCredentialsOptions topts;
-                if (!validateServer)
-                {
-                    // disable most of server certificate validation
-                    std::shared_ptr<grpc::experimental::NoOpCertificateVerifier> verifier = std::make_shared<grpc::experimental::NoOpCertificateVerifier>();
-                    topts.set_verify_server_certs(false);
-                    topts.set_check_call_host(false);
-                    topts.set_certificate_verifier(verifier);
-                    _channel = grpc::CreateChannel(addr_string, grpc::experimental::TlsCredentials(topts));
-                }
-                else
-                {
-                    // use provided SSL options
-                    _channel = grpc::CreateChannel(addr_string, grpc::SslCredentials(opts));
-                }
-            }
+            // channels to the same CP with the same credentials are shared between LBManagers
+            if (ChannelCache::isEnabled())
+                _channel = ChannelCache::getChannel(addr_string, cpuri.get_useTls(), validateServer, opts);
             else
-            {
-                _channel = grpc::CreateChannel(addr_string, grpc::InsecureChannelCredentials());
-            }
+                _channel = ChannelCache::makeChannel(addr_string, cpuri.get_useTls(), validateServer, opts);
             _stub = LoadBalancer::NewStub(_channel);
+            _asyncState = std::make_unique<AsyncSendState>(_stub.get());
         }
 
         /**
@@ -699,6 +878,46 @@ namespace e2sar
          */
         result<int> sendState(float fill_percent, float control_signal, bool is_ready, const Timestamp &ts) noexcept;
 
+        /**
+         * Send worker state update without waiting for the control plane to respond. Uses session ID and
+         * session token from register call and localtime for the timestamp. At most one SendState RPC is
+         * outstanding at a time: if one is (or if the previous ones failed and the pipeline is backing off), 
+         * this update is held and sent once it completes, replacing any update held before it - the newest 
+         * sample always wins. After a failure the next RPC is delayed by a jittered exponential backoff 
+         * between SENDSTATE_BACKOFF_MIN_MS and SENDSTATE_BACKOFF_MAX_MS (see setSendStateBackoff()), an update
+         * held during the backoff is sent when it expires. Outcomes of the RPCs are reported via getSendStateStats().
+         *
+         * @param fill_percent - [0:1] percentage filled of the queue
+         * @param control_signal - change to data rate
+         * @param is_ready - if true, worker ready to accept more data, else not ready
+         * @param stats - a struct of additional optional worker stats (WorkerStats)
+         * @param deadline_ms - deadline of the RPC in milliseconds from the moment it is issued
+         * @return - 0 if the RPC was issued, 1 if the update was held, or an error condition if the request
+         * could not be built
+         */
+        result<int> sendStateAsync(float fill_percent, float control_signal, bool is_ready,
+                       const WorkerStats &stats, u_int32_t deadline_ms) noexcept;
+
+        /**
+         * Change the bounds of the exponential backoff of sendStateAsync() after failed RPCs,
+         * takes effect with the next failure. Defaults are SENDSTATE_BACKOFF_MIN_MS and SENDSTATE_BACKOFF_MAX_MS
+         * @param min_ms - backoff after the first failure, doubled with every consecutive failure (> 0)
+         * @param max_ms - largest backoff (>= min_ms)
+         * @return - 0 or E2SARErrorc::ParameterError if the bounds are invalid
+         */
+        result<int> setSendStateBackoff(u_int32_t min_ms, u_int32_t max_ms) noexcept;
+
+        /**
+         * Get the statistics of the asynchronous sendState pipeline (see sendStateAsync())
+         */
+        SendStateStats getSendStateStats() const noexcept;
+
+        /**
+         * Get the number of failed asynchronous SendState RPCs (SendStateStats.failed) without
+         * copying the rest of the statistics - cheap enough to call on every report
+         */
+        u_int64_t getSendStateFailures() const noexcept;
+
         /**
          * Get the version of the load balancer (the commit string)
          *
@@ -0,0 +1,340 @@
+#ifndef E2SARCPMOCKHPP
+#define E2SARCPMOCKHPP
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <grpcpp/server_context.h>
+#include <grpcpp/security/server_credentials.h>
+
+#include "grpc/loadbalancer.grpc.pb.h"
+
+#include "e2sarError.hpp"
+#include "e2sarUtil.hpp"
+
+/***
+ * Mock of the load balancer control plane for testing and benchmarking without udplbd
+*/
+
+namespace e2sar
+{
+    class LBEmulator;
+
+    /**
+     * In-process implementation of the LoadBalancer gRPC service that stands in for udplbd.
+     * It keeps reservations and registered workers in memory, answers status, overview and
+     * timeseries queries from what it was told, and records every SendState it receives so the
+     * control loop of one or many Reassemblers can be observed and benchmarked offline.
+     *
+     * Every RPC can be delayed by a fixed latency plus uniform jitter and failed with a given
+     * probability and status code (optionally only SendState is affected). Both can be changed
+     * while the server is running. The admin token is accepted on every call, instance and session
+     * tokens handed out by the mock only while their reservation or session exists.
+     *
+     * If an LBEmulator is attached, registering and deregistering workers adds them to and
+     * removes them from the emulator and starts a new epoch, so the mock and the emulator together
+     * behave like a (very small) load balancer.
+     *
+     * The server listens without TLS, use 'ejfat://' URIs to talk to it.
+     */
+    class LBMockServer final: public loadbalancer::LoadBalancer::Service
+    {
+        public:
+            // number of calendar slots reported as shared between workers in proportion to their weight
+            static constexpr u_int32_t CALENDAR_SLOTS{512};
+
+            /**
+             * One recorded SendState call
+             * - lbId, sessionId - from the request
+             * - fillPercent, controlSignal, isReady - from the request
+             * - totalEventsRecv, totalEventsReassembled - worker statistics from the request
+             * - timestamp_ms - timestamp set by the worker, ms since epoch
+             * - received_ms - time the mock received the request, ms since epoch
+             */
+            struct SendStateSample {
+                std::string lbId;
+                std::string sessionId;
+                float fillPercent;
+                float controlSignal;
+                bool isReady;
+                int64_t totalEventsRecv;
+                int64_t totalEventsReassembled;
+                int64_t timestamp_ms;
+                int64_t received_ms;
+            };
+
+        private:
+            const std::string listenAddr;
+            const u_int16_t listenPort;
+            const std::string adminToken;
+            const std::string syncAddr;
+            const std::string syncAddrV6;
+            const u_int16_t syncPort;
+            const std::string dataAddrV4;
+            const std::string dataAddrV6;
+            const size_t maxSamples;
+
+            // fault injection, may be changed at runtime
+            std::atomic<u_int32_t> latency_ms;
+            std::atomic<u_int32_t> jitter_ms;
+            std::atomic<float> errorRate;
+            std::atomic<int> errorCode;
+            std::atomic<bool> sendStateOnly;
+
+            struct Worker {
+                std::string name;
+                std::string ipAddress;
+                u_int16_t udpPort;
+                u_int16_t portRange;
+                float weight;
+                std::string token;
+                float fillPercent{0.0};
+                float controlSignal{0.0};
+                bool isReady{false};
+                google::protobuf::Timestamp lastUpdated;
+            };
+
+            struct Reservation {
+                std::string name;
+                std::string token;
+                u_int32_t fpgaLBId;
+                google::protobuf::Timestamp until;
+                std::vector<std::string> senders;
+                u_int64_t epoch{0};
+                // by session id
+                std::map<std::string, Worker> workers;
+            };
+
+            // protects everything below
+            mutable boost::mutex stateMtx;
+            std::map<std::string, Reservation> reservations;
+            u_int64_t nextLBId{1};
+            u_int64_t nextSessionId{1};
+            std::deque<SendStateSample> samples;
+            LBEmulator *emu{nullptr};
+
+            struct AtomicStats {
+                std::atomic<u_int64_t> reserveCalls{0};
+                std::atomic<u_int64_t> freeCalls{0};
+                std::atomic<u_int64_t> registerCalls{0};
+                std::atomic<u_int64_t> deregisterCalls{0};
+                std::atomic<u_int64_t> sendStateCalls{0};
+                std::atomic<u_int64_t> otherCalls{0};
+                std::atomic<u_int64_t> injectedErrors{0};
+                std::atomic<u_int64_t> authErrors{0};
+                std::atomic<u_int64_t> droppedSamples{0};
+            };
+            AtomicStats stats;
+
+            std::unique_ptr<grpc::Server> server;
+            u_int16_t boundPort{0};
+
+            // check the bearer token (takes stateMtx), then apply latency and error injection to a call
+            grpc::Status admit(grpc::ServerContext *ctx, bool isSendState) noexcept;
+            // fill the status reply of a reservation (called with stateMtx held)
+            void fillStatus(const Reservation &r, loadbalancer::LoadBalancerStatusReply *rep) const noexcept;
+            // fill the reservation reply (called with stateMtx held)
+            void fillReservation(const std::string &lbId, const Reservation &r,
+                loadbalancer::ReserveLoadBalancerReply *rep) const noexcept;
+            // add/remove a worker to/from the attached emulator and start a new epoch (called with stateMtx held)
+            grpc::Status updateEmulator(const std::string &sessionId, const Worker *w) noexcept;
+
+        public:
+            /**
+             * Flags governing LBMockServer behavior with sane defaults
+             * - latency_ms - added to the response time of every call {0}
+             * - jitter_ms - uniformly distributed [0, jitter_ms] added on top of latency {0}
+             * - errorRate - probability of failing a call instead of processing it [0.0, 1.0] {0.0}
+             * - errorCode - gRPC status code of injected failures {UNAVAILABLE}
+             * - sendStateOnly - only SendState calls are delayed and failed {false}
+             * - maxSamples - number of most recent SendState samples retained {100000}
+             * - adminToken - bearer token accepted on every call {mock}
+             * - syncAddr, syncAddrV6, syncPort - sync addresses and port handed out in reservations {127.0.0.1, ::1, 19010}
+             * - dataAddrV4, dataAddrV6 - data plane addresses handed out in reservations {127.0.0.1, ::1}
+             *   (point them at an LBEmulator to send data through it)
+             */
+            struct LBMockServerFlags
+            {
+                u_int32_t latency_ms;
+                u_int32_t jitter_ms;
+                float errorRate;
+                grpc::StatusCode errorCode;
+                bool sendStateOnly;
+                size_t maxSamples;
+                std::string adminToken;
+                std::string syncAddr;
+                std::string syncAddrV6;
+                u_int16_t syncPort;
+                std::string dataAddrV4;
+                std::string dataAddrV6;
+                LBMockServerFlags(): latency_ms{0}, jitter_ms{0}, errorRate{0.0},
+                    errorCode{grpc::StatusCode::UNAVAILABLE}, sendStateOnly{false}, maxSamples{100000},
+                    adminToken{"mock"}, syncAddr{"127.0.0.1"}, syncAddrV6{"::1"}, syncPort{19010},
+                    dataAddrV4{"127.0.0.1"}, dataAddrV6{"::1"} {}
+            };
+
+            /**
+             * Create a mock control plane. Nothing listens until openAndStart() is called.
+             * @param listen_addr - address (v4 or v6) to accept gRPC connections on
+             * @param listen_port - port to listen on, 0 to pick a free one (see get_Port())
+             * @param flags - optional LBMockServerFlags
+             */
+            LBMockServer(boost::asio::ip::address listen_addr, u_int16_t listen_port,
+                const LBMockServerFlags &flags = LBMockServerFlags());
+
+            LBMockServer(const LBMockServer &) = delete;
+            LBMockServer& operator=(const LBMockServer &) = delete;
+
+            ~LBMockServer()
+            {
+                stop();
+            }
+
+            /**
+             * Start serving
+             * @return - 0 on success or an error condition
+             */
+            result<int> openAndStart() noexcept;
+
+            /**
+             * Stop serving, outstanding calls are cancelled
+             */
+            void stop() noexcept;
+
+            /**
+             * Port the server is listening on (useful when started with port 0)
+             */
+            inline u_int16_t get_Port() const noexcept
+            {
+                return boundPort;
+            }
+
+            /**
+             * URI with admin token pointing at this server, usable with LBManager and command-line tools
+             */
+            std::string get_URI() const noexcept;
+
+            /**
+             * Change response latency while running
+             * @param lat_ms - added to every call
+             * @param jit_ms - uniform [0, jit_ms] added on top
+             */
+            inline void setLatency(u_int32_t lat_ms, u_int32_t jit_ms) noexcept
+            {
+                latency_ms = lat_ms;
+                jitter_ms = jit_ms;
+            }
+
+            /**
+             * Change error injection while running
+             * @param rate - probability of failing a call [0.0, 1.0]
+             * @param code - gRPC status code returned by injected failures
+             * @param sendStateOnlyFaults - only affect SendState (applies to latency as well)
+             */
+            inline void setErrors(float rate, grpc::StatusCode code = grpc::StatusCode::UNAVAILABLE,
+                bool sendStateOnlyFaults = false) noexcept
+            {
+                errorRate = rate;
+                errorCode = static_cast<int>(code);
+                sendStateOnly = sendStateOnlyFaults;
+            }
+
+            /**
+             * Attach a data plane emulator whose workers follow Register/Deregister calls.
+             * The emulator must outlive the server or be detached with nullptr.
+             */
+            inline void attachEmulator(LBEmulator *e) noexcept
+            {
+                boost::lock_guard<boost::mutex> lock(stateMtx);
+                emu = e;
+            }
+
+            /**
+             * Get recorded SendState samples, oldest first
+             * @param sessionId - only samples of this session, all if empty
+             */
+            std::vector<SendStateSample> getSendStateSamples(const std::string &sessionId = ""s) const noexcept;
+
+            /**
+             * Forget all recorded SendState samples
+             */
+            void clearSendStateSamples() noexcept;
+
+            /**
+             * Number of workers currently registered across all reservations
+             */
+            size_t get_numWorkers() const noexcept;
+
+            /**
+             * Call statistics
+             * - reserveCalls, freeCalls, registerCalls, deregisterCalls, sendStateCalls - calls by type
+             * - otherCalls - all other calls
+             * - injectedErrors - calls failed by error injection
+             * - authErrors - calls rejected for a missing or unknown bearer token
+             * - droppedSamples - SendState samples evicted from the sample buffer
+             */
+            struct ReportedStats {
+                u_int64_t reserveCalls;
+                u_int64_t freeCalls;
+                u_int64_t registerCalls;
+                u_int64_t deregisterCalls;
+                u_int64_t sendStateCalls;
+                u_int64_t otherCalls;
+                u_int64_t injectedErrors;
+                u_int64_t authErrors;
+                u_int64_t droppedSamples;
+
+                ReportedStats() = delete;
+                ReportedStats(const AtomicStats &as): reserveCalls{as.reserveCalls}, freeCalls{as.freeCalls},
+                    registerCalls{as.registerCalls}, deregisterCalls{as.deregisterCalls},
+                    sendStateCalls{as.sendStateCalls}, otherCalls{as.otherCalls},
+                    injectedErrors{as.injectedErrors}, authErrors{as.authErrors},
+                    droppedSamples{as.droppedSamples} {}
+            };
+
+            /**
+             * Get call statistics
+             */
+            inline const ReportedStats getStats() const noexcept
+            {
+                return ReportedStats(stats);
+            }
+
+            //
+            // LoadBalancer service
+            //
+            grpc::Status ReserveLoadBalancer(grpc::ServerContext *ctx, const loadbalancer::ReserveLoadBalancerRequest *req,
+                loadbalancer::ReserveLoadBalancerReply *rep) override;
+            grpc::Status GetLoadBalancer(grpc::ServerContext *ctx, const loadbalancer::GetLoadBalancerRequest *req,
+                loadbalancer::ReserveLoadBalancerReply *rep) override;
+            grpc::Status LoadBalancerStatus(grpc::ServerContext *ctx, const loadbalancer::LoadBalancerStatusRequest *req,
+                loadbalancer::LoadBalancerStatusReply *rep) override;
+            grpc::Status Overview(grpc::ServerContext *ctx, const loadbalancer::OverviewRequest *req,
+                loadbalancer::OverviewReply *rep) override;
+            grpc::Status FreeLoadBalancer(grpc::ServerContext *ctx, const loadbalancer::FreeLoadBalancerRequest *req,
+                loadbalancer::FreeLoadBalancerReply *rep) override;
+            grpc::Status AddSenders(grpc::ServerContext *ctx, const loadbalancer::AddSendersRequest *req,
+                loadbalancer::AddSendersReply *rep) override;
+            grpc::Status RemoveSenders(grpc::ServerContext *ctx, const loadbalancer::RemoveSendersRequest *req,
+                loadbalancer::RemoveSendersReply *rep) override;
+            grpc::Status Register(grpc::ServerContext *ctx, const loadbalancer::RegisterRequest *req,
+                loadbalancer::RegisterReply *rep) override;
+            grpc::Status Deregister(grpc::ServerContext *ctx, const loadbalancer::DeregisterRequest *req,
+                loadbalancer::DeregisterReply *rep) override;
+            grpc::Status SendState(grpc::ServerContext *ctx, const loadbalancer::SendStateRequest *req,
+                loadbalancer::SendStateReply *rep) override;
+            grpc::Status Version(grpc::ServerContext *ctx, const loadbalancer::VersionRequest *req,
+                loadbalancer::VersionReply *rep) override;
+            grpc::Status Timeseries(grpc::ServerContext *ctx, const loadbalancer::TimeseriesRequest *req,
+                loadbalancer::TimeseriesResponse *rep) override;
+    };
+}
+#endif
@@ -14,7 +14,6 @@
 #include <boost/asio/ip/udp.hpp>
 #include <boost/variant.hpp>
 #include <boost/heap/priority_queue.hpp>
-#include <boost/container/flat_set.hpp>
 
 #include <sys/select.h>
 
@@ -23,11 +22,15 @@
 #endif
 
 #include <atomic>
+#include <array>
+#include <limits>
+#include <tuple>
 
 #include "e2sarError.hpp"
 #include "e2sarUtil.hpp"
 #include "e2sarHeaders.hpp"
 #include "e2sarNetUtil.hpp"
+#include "e2sarTrace.hpp"
 #include "e2sarCP.hpp"
 #include "portable_endian.h"
 
@@ -37,7 +40,10 @@
 
 namespace e2sar
 {
+    // default receive buffer size (fits a jumbo frame)
     const size_t RECV_BUFFER_SIZE{9000};
+    // largest receive buffer (and largest UDP_GRO super-datagram)
+    const size_t MAX_RECV_BUFFER_SIZE{65536};
     /*
         The Reassembler class knows how to reassemble the events back. It relies
         on the RE header structure to reassemble the event, because the LB portion
@@ -51,7 +57,6 @@ namespace e2sar
         friend class Segmenter;
         private:
             EjfatURI dpuri;
-            LBManager lbman;
 
             // Segementer queue state - we use lockfree queue
             // and an associated atomic variable that reflects
@@ -59,25 +64,32 @@ namespace e2sar
 
             // Structure to hold each recv-queue item
             struct EventQueueItem {
-                boost::chrono::steady_clock::time_point firstSegment; // when first segment arrived
+                TSCClock::steady::time_point firstSegment; // when first segment arrived
+                TSCClock::steady::time_point completed; // when last segment arrived
                 size_t numFragments; // how many fragments received (in and out of order)
                 size_t bytes;  // total length
                 size_t curBytes; // current bytes accumulated (could be scattered across fragments)
                 EventNum_t eventNum;
                 u_int8_t *event;
                 u_int16_t dataId;
+                u_int16_t session; // index of the session whose ports the event arrived on
+                // only maintained with adaptive timeout: when the last segment arrived 
+                // (usec of steady clock, read by GC thread) and the largest gap between segments
+                std::atomic<int64_t> lastSegmentUsec;
+                int64_t maxGapUsec;
 
                 EventQueueItem(): numFragments{0},  bytes{0}, curBytes{0},  
-                    eventNum{0}, event{nullptr}, dataId{0}  {}
+                    eventNum{0}, event{nullptr}, dataId{0}, session{0}, lastSegmentUsec{0}, maxGapUsec{0}  {}
 
                 ~EventQueueItem() {}
 
                 EventQueueItem& operator=(const EventQueueItem &i) = delete;
 
-                EventQueueItem(const EventQueueItem &i): firstSegment{i.firstSegment}, 
+                EventQueueItem(const EventQueueItem &i): firstSegment{i.firstSegment}, completed{i.completed},
                     numFragments{i.numFragments},               
                     bytes{i.bytes}, curBytes{i.curBytes}, 
-                    eventNum{i.eventNum},   event{i.event},  dataId{i.dataId} {}
+                    eventNum{i.eventNum},   event{i.event},  dataId{i.dataId}, session{i.session},
+                    lastSegmentUsec{i.lastSegmentUsec.load()}, maxGapUsec{i.maxGapUsec} {}
                 /**
                  * Initialize from REHdr
                  */
@@ -94,18 +106,193 @@ namespace e2sar
                     // user deallocates this, so we don't use a pool
                     event = new u_int8_t[rehdr->get_bufferLength()];
                     // set the timestamp
-                    firstSegment = boost::chrono::steady_clock::now();  
+                    firstSegment = TSCClock::steady::now();  
+                    lastSegmentUsec = boost::chrono::duration_cast<boost::chrono::microseconds>(
+                        firstSegment.time_since_epoch()).count();
+                }
+            };
+
+            // sizes of the fixed lost event accounting structures
+            static constexpr size_t LOST_RING_SIZE{1024};
+            static constexpr size_t LOSS_DATAID_SLOTS{64};
+            static constexpr size_t LOSS_FRAG_BUCKETS{16};
+            static constexpr size_t LOST_DEDUP_SLOTS{1024};
+            // sizes of the optional event sequence tracking structures
+            static constexpr size_t SEQ_DATAID_SLOTS{16};
+            static constexpr size_t SEQ_WINDOW{4096}; // in events, multiple of 64
+            // size of the optional per data id receive stats table
+            static constexpr size_t DATAID_STATS_SLOTS{128};
+            // sizes of the adaptive timeout tables (per data id and per log2 of event size)
+            static constexpr size_t ADAPT_DATAID_SLOTS{16};
+            static constexpr size_t ADAPT_SIZE_BUCKETS{32};
+            // adaptive timeout never goes below this
+            static constexpr int64_t ADAPT_TIMEOUT_FLOOR_USEC{2000};
+            // most receive threads a reassembler can have
+            static constexpr size_t MAX_RECV_THREADS{128};
+            // most LB sessions a reassembler can host (see addSession())
+            static constexpr size_t MAX_SESSIONS{16};
+            // number of datagrams read per recvmmsg() call in busy poll mode
+            static constexpr size_t BUSY_POLL_BATCH{16};
+            // busy poll counters are folded into the shared stats every so many spins
+            static constexpr size_t BUSY_POLL_FLUSH_SPINS{4096};
+            // control message space per received datagram: UDP_GRO segment size and SO_RXQ_OVFL drop count
+            static constexpr size_t RECV_CTRL_SIZE{CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(u_int32_t))};
+            // control message buffer aligned for the CMSG_* macros
+            union RecvCtrlBuffer
+            {
+                char buf[RECV_CTRL_SIZE];
+                struct cmsghdr align;
+            };
+
+            // key of a <session, data id> pair in the per data id tables. Sessions may
+            // share data ids, so the tables are keyed by both, 0 meaning an empty slot
+            static inline u_int32_t dataIdKey(size_t session, u_int16_t dataId) noexcept
+            {
+                return ((static_cast<u_int32_t>(session) << 16) | dataId) + 1;
+            }
+            static inline size_t keySession(u_int32_t key) noexcept
+            {
+                return (key - 1) >> 16;
+            }
+            static inline u_int16_t keyDataId(u_int32_t key) noexcept
+            {
+                return static_cast<u_int16_t>((key - 1) & 0xffff);
+            }
+
+            // find the slot for a data id of a session in a fixed open addressing table 
+            // whose keys come from dataIdKey(). If claim is set, an empty slot is taken
+            // for a new data id. Returns N if not found or the table is full
+            template<size_t N>
+            static inline size_t dataIdSlot(std::array<std::atomic<u_int32_t>, N> &keys, 
+                size_t session, u_int16_t dataId, bool claim = true) noexcept
+            {
+                u_int32_t key = dataIdKey(session, dataId);
+                for (size_t i = 0, slot = (dataId + session * 31) % N; i < N; i++, slot = (slot + 1) % N)
+                {
+                    u_int32_t cur = keys[slot].load();
+                    if (cur == 0)
+                    {
+                        if (not claim)
+                            return N;
+                        if (keys[slot].compare_exchange_strong(cur, key))
+                            return slot;
+                    }
+                    if (cur == key)
+                        return slot;
+                }
+                return N;
+            }
+
+            /**
+             * Sliding bitmap over the event numbers seen for one data id. Assumes the sender
+             * uses sequential event numbers. An event number that slides out of the window 
+             * without having been seen (not even one fragment) is counted as never seen. 
+             */
+            struct SeqTracker {
+                boost::mutex mtx;
+                bool started{false};
+                EventNum_t first{0}; // lowest event number tracked
+                EventNum_t highest{0}; // highest event number seen so far
+                std::array<u_int64_t, SEQ_WINDOW/64> seen{};
+                // events that slid out of the window without being seen
+                std::atomic<EventNum_t> neverSeen{0};
+                // events that arrived after sliding out of the window (may already be counted in neverSeen)
+                std::atomic<EventNum_t> outOfWindow{0};
+
+                inline bool isSet(EventNum_t evt) const
+                {
+                    return seen[(evt % SEQ_WINDOW) >> 6] & (1ULL << (evt & 63));
+                }
+                inline void set(EventNum_t evt)
+                {
+                    seen[(evt % SEQ_WINDOW) >> 6] |= (1ULL << (evt & 63));
+                }
+                inline void clear(EventNum_t evt)
+                {
+                    seen[(evt % SEQ_WINDOW) >> 6] &= ~(1ULL << (evt & 63));
+                }
+
+                /**
+                 * Mark event number as seen, advancing the window if needed. 
+                 * Amortized O(1) per event number. Caller must hold mtx.
+                 * @return number of events newly declared never seen
+                 */
+                inline EventNum_t mark(EventNum_t evt)
+                {
+                    EventNum_t lost{0};
+                    if (not started)
+                    {
+                        started = true;
+                        first = highest = evt;
+                        set(evt);
+                        return 0;
+                    }
+                    if (evt > highest)
+                    {
+                        EventNum_t shift = evt - highest;
+                        if (shift > SEQ_WINDOW)
+                        {
+                            // the whole window slides out, plus events that never made it into it
+                            EventNum_t valid = std::min<EventNum_t>(highest - first + 1, SEQ_WINDOW);
+                            EventNum_t setCount{0};
+                            for (auto &w: seen)
+                            {
+                                setCount += __builtin_popcountll(w);
+                                w = 0;
+                            }
+                            lost = valid - setCount + shift - SEQ_WINDOW;
+                        } 
+                        else
+                        {
+                            // slot of k was previously occupied by k - SEQ_WINDOW
+                            for (EventNum_t k = highest + 1; k <= evt; k++)
+                            {
+                                if ((k >= first + SEQ_WINDOW) && not isSet(k))
+                                    lost++;
+                                clear(k);
+                            }
+                        }
+                        highest = evt;
+                        set(evt);
+                    }
+                    else if (evt + SEQ_WINDOW > highest)
+                    {
+                        // reordered arrival inside the window
+                        if (evt < first)
+                            first = evt;
+                        set(evt);
+                    }
+                    else
+                        outOfWindow++;
+                    neverSeen += lost;
+                    return lost;
                 }
             };
 
             // stats block
             struct AtomicStats {
+                // counters updated on every fragment live in cache-line-padded per receive thread
+                // slots, so threads don't bounce the same line. Each slot has a single writer, readers 
+                // sum over all slots
+                struct alignas(CACHE_LINE_SIZE) ThreadStats {
+                    std::atomic<EventNum_t> eventSuccess{0}; // events successfully processed
+                    std::atomic<size_t> totalBytesReceived{0};
+                    std::atomic<size_t> totalPacketsReceived{0};
+                    std::atomic<size_t> badHeaderDiscards{0}; // number of frames discarded due to failed header check
+                    std::atomic<size_t> kernelDrops{0}; // datagrams dropped by the kernel on receive sockets (SO_RXQ_OVFL)
+                };
+                std::array<ThreadStats, MAX_RECV_THREADS> perThread;
+                template<typename T>
+                inline T sum(std::atomic<T> ThreadStats::*counter) const noexcept
+                {
+                    T ret{0};
+                    for(auto &ts: perThread)
+                        ret += (ts.*counter).load(std::memory_order_relaxed);
+                    return ret;
+                }
+
                 std::atomic<EventNum_t> enqueueLoss{0}; // number of events received and lost on enqueue
                 std::atomic<EventNum_t> reassemblyLoss{0}; // number of events lost in reassembly (missing segments)
-                std::atomic<EventNum_t> eventSuccess{0}; // events successfully processed
-                std::atomic<size_t> totalBytesReceived{0};
-                std::atomic<size_t> totalPacketsReceived{0};
-                std::atomic<size_t> badHeaderDiscards{0}; // number of frames discarded due to failed header check
                 // last error code
                 std::atomic<int> lastErrno{0};
                 // gRPC error count
@@ -114,30 +301,208 @@ namespace e2sar
                 std::atomic<int> dataErrCnt{0};
                 // last e2sar error
                 std::atomic<E2SARErrorc> lastE2SARError{E2SARErrorc::NoError};
-                // a now unlimited queue to push lost event numbers to
-                boost::lockfree::queue<boost::tuple<EventNum_t, u_int16_t, size_t>*, boost::lockfree::fixed_sized<false>> lostEventsQueue{0};
-                // this array is accessed by different threads using fd as an index (so no collisions)
-                std::vector<size_t> fragmentsPerFd;
-                std::vector<u_int16_t> portPerFd; // which port assigned to this FD - initialized at the start
+                // bounded ring of recently lost events <event number, data id, fragments received>
+                // (not per session, get_LostEvent() predates addSession())
+                // oldest entries are overwritten when it fills up, so memory is fixed
+                boost::circular_buffer<boost::tuple<EventNum_t, u_int16_t, size_t>> lostEventsRing{LOST_RING_SIZE};
+                // guards lostEventsRing (held only for a push or a pop)
+                boost::mutex lostEventsMtx;
+                // number of lost events that were evicted from the ring before being read
+                std::atomic<size_t> lostEventsOverwritten{0};
+                // aggregated losses per <session, data id> - open addressing table, slot key is dataIdKey(), 0 is empty
+                std::array<std::atomic<u_int32_t>, LOSS_DATAID_SLOTS> lossDataIds{};
+                std::array<std::atomic<EventNum_t>, LOSS_DATAID_SLOTS> lossPerDataId{};
+                // losses for data ids that didn't fit into the table
+                std::atomic<EventNum_t> lossOtherDataIds{0};
+                // histogram of losses by number of fragments received - bucket 0 is 0 fragments,
+                // bucket i is [2^(i-1), 2^i) fragments, the last bucket absorbs everything above
+                std::array<std::atomic<EventNum_t>, LOSS_FRAG_BUCKETS> lossPerFragCount{};
+                // events never seen at all (detected by optional sequence tracking)
+                std::atomic<EventNum_t> neverSeenLoss{0};
+                // fragments that arrived after their event was timed out with adaptive timeout
+                std::atomic<EventNum_t> adaptiveTimeoutMisses{0};
+                // busy poll mode - polling rounds over all sockets, rounds that returned data
+                // and times the spin budget ran out and the thread fell back to blocking
+                std::atomic<size_t> busyPollSpins{0};
+                std::atomic<size_t> busyPollHits{0};
+                std::atomic<size_t> busyPollFallbacks{0};
+                // sequence trackers per <session, data id> - open addressing table, slot key is dataIdKey(), 0 is empty
+                std::array<std::atomic<u_int32_t>, SEQ_DATAID_SLOTS> seqDataIds{};
+                std::array<SeqTracker, SEQ_DATAID_SLOTS> seqTrackers;
+                // optional receive counters per <session, data id>, updated once per event (not per fragment)
+                // by any receive thread or the GC thread - open addressing table, slot key is dataIdKey()
+                struct alignas(CACHE_LINE_SIZE) DataIdCounters {
+                    std::atomic<EventNum_t> events{0}; // events reassembled
+                    std::atomic<size_t> bytes{0}; // bytes in reassembled events
+                    std::atomic<size_t> fragments{0}; // fragments of reassembled events
+                    std::atomic<EventNum_t> reassemblyLoss{0}; // incomplete events timed out
+                    std::atomic<EventNum_t> enqueueLoss{0}; // events lost on enqueue
+                    std::atomic<EventNum_t> timeoutMisses{0}; // timed out events a late fragment then arrived for
+                };
+                std::array<std::atomic<u_int32_t>, DATAID_STATS_SLOTS> statsDataIds{};
+                std::array<DataIdCounters, DATAID_STATS_SLOTS> dataIdCounters;
+                // events (reassembled or lost in reassembly) of data ids that didn't fit into the table
+                std::atomic<EventNum_t> dataIdStatsOverflow{0};
             };
             AtomicStats recvStats;
 
-            // receive event queue definitions
+            // latency histograms across the receive path of an event (nanoseconds)
+            struct LatencyHistograms {
+                // first segment arriving to the event being complete
+                LatencyHistogram firstToComplete;
+                // event being complete to the application taking it off the event queue
+                LatencyHistogram completeToDequeue;
+            };
+            LatencyHistograms latencyHists;
+
+            // counters of a data id in the per data id stats table, nullptr if
+            // the table is disabled or full. Callers that finish an event (once per event:
+            // completion or reassembly loss) set countOverflow so events of data ids that 
+            // didn't fit are counted exactly once
+            inline AtomicStats::DataIdCounters *dataIdCounters(size_t session, u_int16_t dataId, 
+                bool countOverflow = false) noexcept
+            {
+                if (not perDataIdStats)
+                    return nullptr;
+                auto slot = dataIdSlot(recvStats.statsDataIds, session, dataId);
+                if (slot == DATAID_STATS_SLOTS)
+                {
+                    if (countOverflow)
+                        recvStats.dataIdStatsOverflow.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                return &recvStats.dataIdCounters[slot];
+            }
+
+            // add a lost event to the ring and update aggregated loss counters - O(1)
+            inline void recordLostEvent(EventNum_t eventNum, size_t session, u_int16_t dataId, size_t numFragments) noexcept
+            {
+                {
+                    boost::lock_guard<boost::mutex> guard(recvStats.lostEventsMtx);
+                    if (recvStats.lostEventsRing.full())
+                        recvStats.lostEventsOverwritten++;
+                    recvStats.lostEventsRing.push_back(boost::make_tuple(eventNum, dataId, numFragments));
+                }
+
+                // per data id counter
+                auto slot = dataIdSlot(recvStats.lossDataIds, session, dataId);
+                if (slot < LOSS_DATAID_SLOTS)
+                    recvStats.lossPerDataId[slot]++;
+                else
+                    recvStats.lossOtherDataIds++;
+
+                // per fragment-count histogram (log2 buckets)
+                size_t bucket = (numFragments == 0 ? 0 : 64 - __builtin_clzll(numFragments));
+                recvStats.lossPerFragCount[bucket < LOSS_FRAG_BUCKETS ? bucket : LOSS_FRAG_BUCKETS - 1]++;
+            }
+
+            // mark the event as seen in the sequence tracker for its session and data id and count
+            // the events that slid out of the window unseen. Called once per new event, not per fragment
+            inline void trackEventSeq(EventNum_t eventNum, size_t session, u_int16_t dataId) noexcept
+            {
+                auto slot = dataIdSlot(recvStats.seqDataIds, session, dataId);
+                // if the table is full this data id is not tracked
+                if (slot == SEQ_DATAID_SLOTS)
+                    return;
+                auto &tracker = recvStats.seqTrackers[slot];
+                boost::lock_guard<boost::mutex> guard(tracker.mtx);
+                recvStats.neverSeenLoss += tracker.mark(eventNum);
+            }
+
+            // adaptive timeout state - smoothed largest inter-segment gap (usec) of completed events
+            // per <session, data id> and per log2 of event size. 0 means nothing learned yet
+            std::array<std::atomic<u_int32_t>, ADAPT_DATAID_SLOTS> adaptDataIds{};
+            std::array<std::array<std::atomic<u_int32_t>, ADAPT_SIZE_BUCKETS>, ADAPT_DATAID_SLOTS> adaptGapUsec{};
+
+            static inline size_t adaptSizeBucket(size_t bytes) noexcept
+            {
+                size_t bucket = (bytes == 0 ? 0 : 64 - __builtin_clzll(bytes));
+                return (bucket < ADAPT_SIZE_BUCKETS ? bucket : ADAPT_SIZE_BUCKETS - 1);
+            }
+
+            // learn from a completed event: EWMA (1/8) of its largest inter-segment gap
+            inline void adaptLearnGap(size_t session, u_int16_t dataId, size_t bytes, int64_t maxGapUsec) noexcept
+            {
+                auto slot = dataIdSlot(adaptDataIds, session, dataId);
+                if (slot == ADAPT_DATAID_SLOTS)
+                    return;
+                auto &gap = adaptGapUsec[slot][adaptSizeBucket(bytes)];
+                u_int32_t sample = static_cast<u_int32_t>(std::min<int64_t>(maxGapUsec, eventTimeout_ms*1000));
+                u_int32_t cur = gap.load();
+                // racing updates from different threads may drop a sample, which is harmless
+                gap.store(cur == 0 ? std::max<u_int32_t>(sample, 1) : cur - cur/8 + sample/8);
+            }
+
+            // a fragment arrived for an event that already timed out - the learned
+            // gap is too short, back it off multiplicatively
+            inline void adaptTimeoutTooShort(size_t session, u_int16_t dataId, size_t bytes) noexcept
+            {
+                auto slot = dataIdSlot(adaptDataIds, session, dataId, false);
+                if (slot == ADAPT_DATAID_SLOTS)
+                    return;
+                auto &gap = adaptGapUsec[slot][adaptSizeBucket(bytes)];
+                u_int32_t cur = gap.load();
+                if (cur != 0)
+                    gap.store(std::min<u_int32_t>(cur * 2, eventTimeout_ms*1000));
+                recvStats.adaptiveTimeoutMisses++;
+                if (auto counters = dataIdCounters(session, dataId))
+                    counters->timeoutMisses.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // how long (usec) an incomplete event may go without new segments before it is
+            // declared lost: adaptiveTimeoutMult times the learned gap, clamped to
+            // [ADAPT_TIMEOUT_FLOOR_USEC, eventTimeout_ms]
+            inline int64_t adaptiveTimeoutUsec(size_t session, u_int16_t dataId, size_t bytes) noexcept
+            {
+                int64_t maxTimeout = static_cast<int64_t>(eventTimeout_ms)*1000;
+                auto slot = dataIdSlot(adaptDataIds, session, dataId, false);
+                if (slot == ADAPT_DATAID_SLOTS)
+                    return maxTimeout;
+                auto gap = adaptGapUsec[slot][adaptSizeBucket(bytes)].load();
+                if (gap == 0)
+                    return maxTimeout;
+                int64_t timeout = static_cast<int64_t>(adaptiveTimeoutMult * gap);
+                return std::min(std::max(timeout, ADAPT_TIMEOUT_FLOOR_USEC), maxTimeout);
+            }
+
+            // receive event queue size (each session has its own queue), the queue
+            // grows past it unless eventQueueLimit is set
             static const size_t QSIZE{1000};
-            boost::lockfree::queue<EventQueueItem*> eventQueue{QSIZE};
-            std::atomic<size_t> eventQueueDepth{0};
 
-            // push event on the common event queue
+            // event queue size the controllers measure occupancy against
+            inline size_t queueCapacity() const noexcept
+            {
+                return (eventQueueLimit > 0 ? eventQueueLimit : QSIZE);
+            }
+
+            // push event on the event queue of its session
             // return 1 if event is lost, 0 on success
             inline int enqueue(const std::shared_ptr<EventQueueItem> &item) noexcept
             {
                 int ret = 0;
+                auto &sess = *sessions[item->session];
+                // arrivals include events that find the queue full, otherwise the drain
+                // controller would see arrivals stop just when the queue overflows
+                sess.enqueuedEvents.fetch_add(1, std::memory_order_relaxed);
+                sess.enqueuedBytes.fetch_add(item->bytes, std::memory_order_relaxed);
                 // get rid of the shared object here
                 // lockfree queue uses atomic operations and cannot use shared_ptr type
                 auto newItem = new EventQueueItem(*item.get());
-                if (eventQueue.push(newItem))
-                    eventQueueDepth++;
-                else 
+                bool queued{false};
+                if (eventQueueLimit > 0)
+                {
+                    // claim a slot first so concurrent receive threads can't overshoot the limit
+                    if (sess.eventQueueDepth.fetch_add(1) < eventQueueLimit)
+                        queued = sess.eventQueue.push(newItem);
+                    if (!queued)
+                        sess.eventQueueDepth--;
+                }
+                else if (sess.eventQueue.push(newItem))
+                {
+                    sess.eventQueueDepth++;
+                    queued = true;
+                }
+                if (!queued)
                 {
                     delete newItem; // the shared ptr object will be released by caller
                     ret = 1; // event lost, queue was full
@@ -147,14 +512,17 @@ namespace e2sar
                 return ret;
             }
 
-            // pop event off the event queue
-            inline EventQueueItem* dequeue() noexcept
+            // pop event off the event queue of a session
+            inline EventQueueItem* dequeue(size_t session = 0) noexcept
             {
                 EventQueueItem* item{nullptr};
-                auto a = eventQueue.pop(item);
+                auto &sess = *sessions[session];
+                auto a = sess.eventQueue.pop(item);
                 if (a) 
                 {
-                    eventQueueDepth--;
+                    sess.eventQueueDepth--;
+                    sess.dequeuedBytes.fetch_add(item->bytes, std::memory_order_relaxed);
+                    latencyHists.completeToDequeue.recordInterval(item->completed, TSCClock::steady::now());
                     return item;
                 } else 
                     return nullptr; // queue was empty
@@ -177,10 +545,87 @@ namespace e2sar
                 PIDSample(UnixTimeMicro_t st, float er, float intg): 
                     sampleTime{st}, error{er}, integral{intg} {}
             };
-            boost::circular_buffer<PIDSample> pidSampleBuffer;
+            // depth of the PID sample buffer (usually 10 = 1sec/100ms)
+            const size_t pidSampleDepth;
+            // most recent values computed by the send state thread, see getControlStats()
+            struct ControlState {
+                std::atomic<float> fillPercent{0.};
+                std::atomic<float> controlSignal{0.};
+                std::atomic<float> error{0.};
+                std::atomic<float> integral{0.};
+                // drain rate controller estimates
+                std::atomic<float> arrivalBps{0.};
+                std::atomic<float> serviceBps{0.};
+                std::atomic<float> timeToFull_ms{std::numeric_limits<float>::infinity()};
+            };
 
-            // have we registered a worker
-            bool registeredWorker{false};
+            // weight of the newest sample in the drain rate controller EWMAs
+            static constexpr double DRAIN_EWMA_ALPHA{0.3};
+            // drain rate controller state, only touched by the send state thread
+            struct DrainState {
+                UnixTimeMicro_t lastSampleTime{0};
+                u_int64_t lastEnqueuedBytes{0};
+                u_int64_t lastEnqueuedEvents{0};
+                u_int64_t lastDequeuedBytes{0};
+                double arrivalBps{0.};
+                double serviceBps{0.};
+                double avgEventBytes{0.};
+            };
+
+            // control plane connection parameters, also used for sessions added later
+            const bool validateCert;
+            const bool useHostAddress;
+
+            /**
+             * One LB session hosted by this Reassembler. Session 0 is the one the Reassembler 
+             * was created with, more can be added with addSession(). Receive threads, GC and stats
+             * sampling are shared by all sessions, each session has its own port range, control plane 
+             * connection, event queue, worker registration and PID loop. 
+             */
+            struct SessionState {
+                const EjfatURI uri;
+                LBManager lbman;
+                const u_int16_t dataPort;
+                const int portRange;
+                const size_t numRecvPorts;
+                // reassembled events waiting for getEvent()/recvEvent()
+                boost::lockfree::queue<EventQueueItem*> eventQueue{QSIZE};
+                std::atomic<size_t> eventQueueDepth{0};
+                boost::circular_buffer<PIDSample> pidSampleBuffer;
+                ControlState controlState;
+                // have we registered a worker
+                bool registeredWorker{false};
+                // failed sendState RPCs already counted in grpcErrCnt
+                u_int64_t lastRPCFailures{0};
+                // counted once per event, not per fragment
+                std::atomic<EventNum_t> eventSuccess{0};
+                std::atomic<EventNum_t> enqueueLoss{0};
+                std::atomic<EventNum_t> reassemblyLoss{0};
+                // event queue throughput, for the drain rate controller (enqueued counts
+                // every event offered to the queue, including those lost because it was full)
+                std::atomic<u_int64_t> enqueuedEvents{0};
+                std::atomic<u_int64_t> enqueuedBytes{0};
+                std::atomic<u_int64_t> dequeuedBytes{0};
+                DrainState drainState;
+
+                SessionState(const EjfatURI &u, u_int16_t port, int pr, size_t pidDepth, 
+                    bool validateCert, bool useHostAddress): 
+                    uri{u}, lbman(uri, validateCert, useHostAddress), dataPort{port}, portRange{pr},
+                    numRecvPorts{static_cast<size_t>(pr > 0 ? 2 << (pr - 1): 1)}, pidSampleBuffer(pidDepth)
+                {}
+            };
+            // never resized once the threads are started, so receive threads can index it without locking
+            std::vector<std::unique_ptr<SessionState>> sessions;
+
+            // index of the session a port belongs to or sessions.size() if none
+            inline size_t sessionOfPort(int port) const noexcept
+            {
+                for (size_t i = 0; i < sessions.size(); i++)
+                    if ((port >= sessions[i]->dataPort) && 
+                        (port < sessions[i]->dataPort + static_cast<int>(sessions[i]->numRecvPorts)))
+                        return i;
+                return sessions.size();
+            }
 
 
             /**
@@ -190,6 +635,8 @@ namespace e2sar
             struct GCThreadState {
                 Reassembler &reas;
                 boost::thread threadObj;
+                // expired events
+                TraceRing trace;
 
                 GCThreadState(Reassembler &r): reas{r} {}
 
@@ -199,6 +646,62 @@ namespace e2sar
             };
             GCThreadState gcThreadState;
 
+        public:
+            /**
+             * One sample of the receive side taken by the sampler thread. Counters are cumulative and
+             * read one after another by the sampler, rates are per second over the preceding sample period
+             *  - int64_t timestampNs; // wall clock time of the sample in ns since epoch (0 - no sample yet)
+             *  - int64_t periodNs; // time since the previous sample (measured on the monotonic clock)
+             *  - u_int64_t eventCnt, packetCnt, byteCnt; // events reassembled, fragments and bytes received
+             *  - u_int64_t lossCnt; // events lost in reassembly or on enqueue
+             *  - u_int64_t kernelDrops; // datagrams dropped by the kernel on receive sockets
+             *  - double eventRate, packetRate, byteRate, lossRate, kernelDropRate; // the same per second
+             *  - size_t queueDepth; // reassembled events waiting for getEvent()/recvEvent()
+             */
+            struct RateSample {
+                int64_t timestampNs{0};
+                int64_t periodNs{0};
+                u_int64_t eventCnt{0};
+                u_int64_t packetCnt{0};
+                u_int64_t byteCnt{0};
+                u_int64_t lossCnt{0};
+                u_int64_t kernelDrops{0};
+                double eventRate{0.};
+                double packetRate{0.};
+                double byteRate{0.};
+                double lossRate{0.};
+                double kernelDropRate{0.};
+                size_t queueDepth{0};
+            };
+            // stats sampling period and how many samples are kept
+            static constexpr int64_t SAMPLE_PERIOD_MS{1000};
+            static constexpr size_t SAMPLE_HISTORY{300};
+        private:
+            // latest sample and recent history written by the sampler thread
+            SeqLocked<RateSample> lastSample;
+            SampleRing<RateSample, SAMPLE_HISTORY> sampleHistory;
+
+            /**
+             * This thread samples receive stats once every SAMPLE_PERIOD_MS
+             */
+            struct SamplerThreadState {
+                Reassembler &reas;
+                boost::thread threadObj;
+
+                SamplerThreadState(Reassembler &r): reas{r} {}
+
+                // monotonic time of the previous sample - periods are measured on it so
+                // wall clock adjustments don't skew the rates
+                int64_t lastMonoNs{0};
+                // taken before the receive threads start so the first rates cover all traffic
+                RateSample baseline;
+
+                // take one sample computing rates against the previous one
+                RateSample _sample(const RateSample &prev) noexcept;
+                void _threadBody();
+            };
+            SamplerThreadState samplerThreadState;
+
             /**
              * This thread receives data, reassembles into events and puts them onto the 
              * event queue for getEvent()
@@ -214,6 +717,19 @@ namespace e2sar
                 // UDP sockets
                 std::vector<int> udpPorts;
                 std::vector<int> sockets;
+                // session each port belongs to (same index as udpPorts and sockets)
+                std::vector<u_int16_t> portSessions;
+                // fragments received per port (same index as udpPorts and sockets), only this thread 
+                // writes them, get_FDStats() may read them at any time
+                std::vector<std::atomic<size_t>> fragmentsPerPort;
+                // datagrams the kernel dropped per port because the socket buffer was full (same index)
+                std::vector<std::atomic<size_t>> dropsPerPort;
+                // last cumulative SO_RXQ_OVFL drop count seen on each socket
+                std::vector<u_int32_t> lastDropCount;
+                // this thread's slot of per-fragment counters
+                AtomicStats::ThreadStats &stats;
+                // recent fragment and event activity of this thread
+                TraceRing trace;
                 int maxFdPlusOne;
                 fd_set fdSet;
 
@@ -225,23 +741,71 @@ namespace e2sar
                 // is uniquely identified by <event number, data id> and
                 // so long as the entropy doesn't change while the event
                 // segments are transmitted, they are guarangeed to go
-                // to the same port
-                boost::unordered_map<std::pair<EventNum_t, u_int16_t>, std::shared_ptr<EventQueueItem>, pair_hash, pair_equal> eventsInProgress;
+                // to the same port. One map per session, since different
+                // sessions may well use the same event numbers and data ids
+                typedef boost::unordered_map<std::pair<EventNum_t, u_int16_t>, std::shared_ptr<EventQueueItem>, 
+                    pair_hash, pair_equal> InProgressMap;
+                std::vector<InProgressMap> eventsInProgress;
                 // mutex for guarding access to events in progress (recv thread, gc thread)
                 boost::mutex evtsInProgressMutex;
-                // thread local instance of events we lost
-                boost::container::flat_set<std::pair<EventNum_t, u_int16_t>> lostEvents;
+                // recently lost events used to avoid double counting the same event
+                // (e.g. late fragments of an already timed out event). Fixed-size, direct-mapped
+                // by <event number, data id> hash, an entry only suppresses duplicates within
+                // lostDedupWindow of the original loss. Guarded by evtsInProgressMutex.
+                struct LostEventSeen {
+                    EventNum_t eventNum{0};
+                    u_int16_t dataId{0};
+                    u_int16_t session{0};
+                    bool valid{false};
+                    TSCClock::steady::time_point when;
+                };
+                std::vector<LostEventSeen> lostEventsSeen;
+                boost::chrono::milliseconds lostDedupWindow;
 
                 // CPU core ids
                 std::vector<int> cpuCoreList;
 
+                // receive buffer reused for every datagram (segments are copied out into the event)
+                std::vector<u_int8_t> recvBuffer;
+                // busy poll mode batch of receive buffers, one per datagram, recvmmsg() headers and
+                // control buffers for the UDP_GRO segment size and drop count
+                std::vector<u_int8_t> recvBatchBuffer;
+                std::vector<struct mmsghdr> recvBatchMsgs;
+                std::vector<struct iovec> recvBatchIovs;
+                std::vector<RecvCtrlBuffer> recvBatchCtrl;
+                // busy poll counters accumulated locally to keep atomics out of the spin loop
+                size_t localSpins{0}, localHits{0};
+
                 // this constructor deliberately uses move semantics for uports
-                inline RecvThreadState(Reassembler &r, std::vector<int> &&uports, 
+                inline RecvThreadState(Reassembler &r, size_t threadIdx, std::vector<int> &&uports, 
                     const std::vector<int> &ccl): 
-                    reas{r}, udpPorts{uports}, cpuCoreList{ccl}
+                    reas{r}, udpPorts{uports}, fragmentsPerPort(udpPorts.size()), 
+                    dropsPerPort(udpPorts.size()), lastDropCount(udpPorts.size(), 0),
+                    stats{r.recvStats.perThread[threadIdx]}, eventsInProgress(r.sessions.size()), 
+                    lostEventsSeen(LOST_DEDUP_SLOTS),
+                    lostDedupWindow{10 * r.eventTimeout_ms}, cpuCoreList{ccl},
+                    recvBuffer(r.recvBufferSize)
                 {
                     sleep_tv.tv_sec = 0;
                     sleep_tv.tv_usec = 10000; // 10 msec max
+
+                    for(auto port: udpPorts)
+                        portSessions.push_back(static_cast<u_int16_t>(r.sessionOfPort(port)));
+
+                    if (r.busyPoll)
+                    {
+                        recvBatchBuffer.resize(BUSY_POLL_BATCH * r.recvBufferSize);
+                        recvBatchMsgs.resize(BUSY_POLL_BATCH);
+                        recvBatchIovs.resize(BUSY_POLL_BATCH);
+                        recvBatchCtrl.resize(BUSY_POLL_BATCH);
+                        for(size_t i = 0; i < BUSY_POLL_BATCH; i++)
+                        {
+                            recvBatchIovs[i].iov_base = recvBatchBuffer.data() + i * r.recvBufferSize;
+                            recvBatchIovs[i].iov_len = r.recvBufferSize;
+                            recvBatchMsgs[i].msg_hdr.msg_iov = &recvBatchIovs[i];
+                            recvBatchMsgs[i].msg_hdr.msg_iovlen = 1;
+                        }
+                    }
                 }
 
                 inline ~RecvThreadState()
@@ -255,31 +819,68 @@ namespace e2sar
                 result<int> _close();
                 // thread loop
                 void _threadBody();
+                // busy poll over all sockets with recvmmsg() until the spin budget runs out
+                void _busyPoll();
+                // split a received datagram into segments (UDP_GRO) and reassemble them
+                void _processDatagram(size_t sockIdx, u_int8_t *dgram, ssize_t nbytes, const struct msghdr &msg);
+                // reassemble a single LBRE/RE segment from the receive buffer
+                void _processSegment(u_int8_t *segment, ssize_t nbytes, u_int16_t session);
+                // fold locally accumulated busy poll counters into the shared stats
+                inline void flushBusyPollStats()
+                {
+                    reas.recvStats.busyPollSpins += localSpins;
+                    reas.recvStats.busyPollHits += localHits;
+                    localSpins = localHits = 0;
+                }
+
+                // was this event recently logged as lost? Caller must hold evtsInProgressMutex.
+                inline bool recentlyLost(EventNum_t eventNum, u_int16_t dataId, u_int16_t session) const
+                {
+                    auto &seen = lostEventsSeen[pair_hash()(std::make_pair(eventNum, dataId)) % LOST_DEDUP_SLOTS];
+                    return seen.valid && (seen.eventNum == eventNum) && (seen.dataId == dataId) &&
+                        (seen.session == session) && (TSCClock::steady::now() - seen.when < lostDedupWindow);
+                }
 
-                // log a lost event and add to lost queue for external inspection
+                // log a lost event and add to lost ring for external inspection
                 // boolean flag discriminates between enqueue losses (true)
-                // and reassembly losses (false)
+                // and reassembly losses (false). Caller must hold evtsInProgressMutex.
                 inline void logLostEvent(std::shared_ptr<EventQueueItem> item, bool enqueLoss)
                 {
-                    std::pair<EventNum_t, u_int16_t> evt(item->eventNum, item->dataId);
+                    auto nowT = TSCClock::steady::now();
+                    auto &seen = lostEventsSeen[pair_hash()(std::make_pair(item->eventNum, item->dataId)) % LOST_DEDUP_SLOTS];
 
-                    if (lostEvents.contains(evt))
+                    if (seen.valid && (seen.eventNum == item->eventNum) && (seen.dataId == item->dataId) &&
+                        (seen.session == item->session) && (nowT - seen.when < lostDedupWindow))
                         return;
-                    // this is thread-local
-                    lostEvents.insert(evt);
-                    // lockfree queue (only takes trivial types)
-                    boost::tuple<EventNum_t, u_int16_t, size_t> *evtPtr = 
-                        new boost::tuple<EventNum_t, u_int16_t, size_t>(evt.first, evt.second, item->numFragments);
-                    reas.recvStats.lostEventsQueue.push(evtPtr);
+                    seen.eventNum = item->eventNum;
+                    seen.dataId = item->dataId;
+                    seen.session = item->session;
+                    seen.when = nowT;
+                    seen.valid = true;
+
+                    reas.recordLostEvent(item->eventNum, item->session, item->dataId, item->numFragments);
                     // this is atomic
                     if (enqueLoss)
+                    {
                         reas.recvStats.enqueueLoss++;
+                        reas.sessions[item->session]->enqueueLoss++;
+                    }
                     else
-                        reas.recvStats.reassemblyLoss++;                    
+                    {
+                        reas.recvStats.reassemblyLoss++;
+                        reas.sessions[item->session]->reassemblyLoss++;
+                    }
+                    // enqueue losses were already counted when the event completed
+                    if (auto counters = reas.dataIdCounters(item->session, item->dataId, not enqueLoss))
+                        (enqueLoss ? counters->enqueueLoss : counters->reassemblyLoss).fetch_add(1, 
+                            std::memory_order_relaxed);
                 }
             };
             friend struct RecvThreadState;
             std::list<RecvThreadState> recvThreadState;
+            // set once openAndStart() has populated recvThreadState, which doesn't change after that;
+            // accessors that may run concurrently with openAndStart() check it before walking the list
+            std::atomic<bool> recvThreadsStarted{false};
 
             // receive related parameters
             const std::vector<int> cpuCoreList;
@@ -289,11 +890,23 @@ namespace e2sar
             const size_t numRecvThreads;
             const size_t numRecvPorts;
             std::vector<std::list<int>> threadsToPorts;
+            // thread the next assigned port goes to
+            size_t nextPortThread{0};
             const bool withLBHeader;
             const int eventTimeout_ms; // how long we allow events to linger 'in progress' before we give up
+            const bool adaptiveTimeout; // expire events based on learned inter-segment gaps
+            const float adaptiveTimeoutMult; // multiple of the learned gap after which the event is expired
             const int recvWaitTimeout_ms{10}; // how long we wait on condition variable before we come up for air
             // recv socket buffer size for setsockop
             const int rcvSocketBufSize;
+            const bool useGRO; // enable UDP_GRO on receive sockets and split coalesced datagrams
+            const size_t recvBufferSize; // size of the buffer each datagram is received into
+            const bool busyPoll; // spin over non-blocking sockets instead of blocking in select()
+            const int busyPoll_us; // SO_BUSY_POLL value set on sockets
+            const int spinBudget_us; // how long to spin without data before blocking
+            const bool dropBackoff; // report a full queue to the control plane when the kernel drops datagrams
+            const bool drainControl; // use the drain rate controller instead of the PID
+            const size_t eventQueueLimit; // most events held on each event queue, 0 for no limit
 
             // lock with recv thread
             boost::mutex recvThreadMtx;
@@ -303,20 +916,33 @@ namespace e2sar
             //thread_local boost::unique_lock<boost::mutex> condLock(recvThreadMtx, boost::defer_lock);
 
             /**
-             * Use port range and starting port to assign UDP ports to threads evenly
+             * Use port range and starting port of a session to assign its UDP ports to threads 
+             * evenly, continuing round robin where the previous session left off
              */
-            inline void assignPortsToThreads()
+            inline void assignPortsToThreads(const SessionState &sess)
             {
                 // O(numRecvPorts)
-                for(size_t i=0; i<numRecvPorts;)
+                for(size_t i=0; i<sess.numRecvPorts; i++)
                 {
-                    for(size_t j=0; i<numRecvPorts && j<numRecvThreads; i++, j++)
-                    {
-                        threadsToPorts[j].push_back(dataPort + i);
-                    } 
+                    threadsToPorts[nextPortThread].push_back(sess.dataPort + i);
+                    nextPortThread = (nextPortThread + 1) % numRecvThreads;
                 }
             }
 
+            /**
+             * Create session 0 from the constructor parameters and assign its ports
+             */
+            inline void initPrimarySession()
+            {
+                sessions.emplace_back(new SessionState(dpuri, dataPort, portRange, pidSampleDepth,
+                    validateCert, useHostAddress));
+                // note if the user chooses to override portRange in rflags, 
+                // we can end up in a silly situation where the number of receive ports is smaller
+                // than the number of receive threads, but we handle it
+                // Need to break up M ports into at most N bins.
+                assignPortsToThreads(*sessions[0]);
+            }
+
             /**
              * This thread sends CP gRPC SendState messages using session token and id
              */
@@ -326,21 +952,35 @@ namespace e2sar
                 boost::thread threadObj;
 
                 const u_int16_t period_ms;
+                // deadline of each sendState RPC
+                const u_int16_t deadline_ms;
 
                 // UDP sockets
                 int socketFd{0};
 
-                inline SendStateThreadState(Reassembler &r, u_int16_t period_ms): 
-                    reas{r}, period_ms{period_ms}
+                // kernel drops seen at the previous report (for dropBackoff)
+                size_t lastKernelDrops{0};
+
+                inline SendStateThreadState(Reassembler &r, u_int16_t period_ms, u_int16_t deadline_ms): 
+                    reas{r}, period_ms{period_ms}, deadline_ms{deadline_ms}
                 {}
 
-                // thread loop. all important behavior is encapsulated inside LBManager
+                // thread loop. all important behavior is encapsulated inside LBManager. 
+                // Updates are sent asynchronously so a slow control plane does not stall the loop
                 void _threadBody();
+                // run one PID (or drain rate controller) step for a session and send the result 
+                // to its control plane
+                void _sendState(SessionState &sess, UnixTimeMicro_t currentTimeMicros, bool kernelDropped);
+                // update the queue arrival/service rate estimates of a session and compute
+                // the drain rate control signal in [-1, 1]
+                float _drainSignal(SessionState &sess, UnixTimeMicro_t currentTimeMicros, float fillPercent);
             };
             friend struct sendStateThreadState;
             SendStateThreadState sendStateThreadState;
             bool useCP; // for debugging we may not want to have CP running
             bool reportStats; // report worker stats in sendState thread (usually false)
+            const bool trackSequence; // track sequential event numbers per data id to detect never seen events
+            const bool perDataIdStats; // keep receive counters per data id
             // global thread stop signal
             bool threadsStop{false};
 
@@ -349,8 +989,8 @@ namespace e2sar
              */
             inline void sanityChecks()
             {
-                if (numRecvThreads > 128)
-                    throw E2SARException("Too many reassembly threads requested, limit 128");
+                if (numRecvThreads > MAX_RECV_THREADS)
+                    throw E2SARException("Too many reassembly threads requested, limit " + std::to_string(MAX_RECV_THREADS));
 
                 if (numRecvPorts > (2 << 13))
                     throw E2SARException("Too many receive ports reqiuested, limit 2^14");
@@ -358,6 +998,26 @@ namespace e2sar
                 if (eventTimeout_ms > 10000)
                     throw E2SARException("Event timeout exception unreasonably long, limit 10s");
 
+                if (adaptiveTimeout && adaptiveTimeoutMult < 1.0)
+                    throw E2SARException("Adaptive timeout multiple must be at least 1");
+
+                if ((recvBufferSize > MAX_RECV_BUFFER_SIZE) || (recvBufferSize <= sizeof(LBREHdr)))
+                    throw E2SARException("Receive buffer size out of bounds: (" + 
+                        std::to_string(sizeof(LBREHdr)) + ", " + std::to_string(MAX_RECV_BUFFER_SIZE) + "]");
+
+#ifndef UDP_GRO_AVAILABLE
+                if (useGRO)
+                    throw E2SARException("UDP_GRO is not supported on this platform");
+#endif
+
+#ifndef BUSY_POLL_AVAILABLE
+                if (busyPoll)
+                    throw E2SARException("Busy poll receive mode is not supported on this platform");
+#endif
+
+                if (busyPoll && ((busyPoll_us < 0) || (spinBudget_us < 0)))
+                    throw E2SARException("Busy poll time and spin budget must not be negative");
+
                 if (dataPort < 1024)
                     throw E2SARException("Base receive port in the privileged range (<1024)");
 
@@ -379,6 +1039,13 @@ namespace e2sar
              *  - E2SARErrorc lastE2SARError; // last recorded E2SAR error (use make_error_code(stats.lastE2SARError).message())
              *  - size_t totalPackets; // total packets received
              *  - size_t totalBytes; // total bytes received
+             *  - EventNum_t neverSeenLoss; // events for which no fragments arrived (only with trackSequence flag)
+             *  - EventNum_t adaptiveTimeoutMisses; // events expired by adaptive timeout that a late fragment then arrived for
+             *  - size_t busyPollSpins; // polling rounds over all sockets (only with busyPoll flag)
+             *  - size_t busyPollHits; // polling rounds that returned data, hits/spins is the poll efficiency
+             *  - size_t busyPollFallbacks; // times the spin budget ran out and the receive thread blocked
+             *  - size_t kernelDrops; // datagrams dropped by the kernel because receive socket buffers were full
+             *  (SO_RXQ_OVFL, Linux only). Unlike reassemblyLoss this points to host overload rather than network loss
              */
             struct ReportedStats {
                 EventNum_t enqueueLoss;  // number of events received and lost on enqueue
@@ -389,13 +1056,188 @@ namespace e2sar
                 int dataErrCnt; 
                 E2SARErrorc lastE2SARError;
                 size_t totalPackets, totalBytes, badHeaderDiscards;
+                EventNum_t neverSeenLoss;
+                EventNum_t adaptiveTimeoutMisses;
+                size_t busyPollSpins, busyPollHits, busyPollFallbacks;
+                size_t kernelDrops;
 
                 ReportedStats() = delete;
                 ReportedStats(const AtomicStats &as): enqueueLoss{as.enqueueLoss}, 
-                    reassemblyLoss{as.reassemblyLoss}, eventSuccess{as.eventSuccess},
+                    reassemblyLoss{as.reassemblyLoss}, eventSuccess{as.sum(&AtomicStats::ThreadStats::eventSuccess)},
                     lastErrno{as.lastErrno}, grpcErrCnt{as.grpcErrCnt}, dataErrCnt{as.dataErrCnt},
-                    lastE2SARError{as.lastE2SARError}, totalPackets{as.totalPacketsReceived}, 
-                    totalBytes{as.totalBytesReceived}, badHeaderDiscards{as.badHeaderDiscards}
+                    lastE2SARError{as.lastE2SARError}, totalPackets{as.sum(&AtomicStats::ThreadStats::totalPacketsReceived)}, 
+                    totalBytes{as.sum(&AtomicStats::ThreadStats::totalBytesReceived)}, 
+                    badHeaderDiscards{as.sum(&AtomicStats::ThreadStats::badHeaderDiscards)},
+                    neverSeenLoss{as.neverSeenLoss}, adaptiveTimeoutMisses{as.adaptiveTimeoutMisses},
+                    busyPollSpins{as.busyPollSpins}, busyPollHits{as.busyPollHits}, 
+                    busyPollFallbacks{as.busyPollFallbacks},
+                    kernelDrops{as.sum(&AtomicStats::ThreadStats::kernelDrops)}
+                    {}
+            };
+
+            /**
+             * Snapshots of latency histograms of the receive path (values in nanoseconds)
+             *  - firstToComplete - from the first segment of an event arriving to the event being complete
+             *  - completeToDequeue - from the event being complete to getEvent()/recvEvent() returning it
+             */
+            struct LatencyStats {
+                LatencyHistogram::Snapshot firstToComplete;
+                LatencyHistogram::Snapshot completeToDequeue;
+
+                LatencyStats() = delete;
+                LatencyStats(const LatencyHistograms &lh): firstToComplete{lh.firstToComplete.snapshot()},
+                    completeToDequeue{lh.completeToDequeue.snapshot()}
+                    {}
+            };
+
+            /**
+             * Most recent state of the controller as computed by the send state thread
+             *  - fillPercent - event queue occupancy sampled in [0, 1] as reported (1 after kernel drops with dropBackoff)
+             *  - controlSignal - PID (or drain rate controller) output reported to the control plane
+             *  - error - difference between the setPoint and fillPercent
+             *  - integral - PID integral accumulator (0 with drainControl)
+             *  - arrivalBps - EWMA of bytes/sec offered to the event queue, including events lost when it is full (drainControl only)
+             *  - serviceBps - EWMA of bytes/sec taken off the event queue by getEvent()/recvEvent() (drainControl only)
+             *  - timeToFull_ms - predicted time until the event queue fills at these rates, infinity if 
+             *  it is not filling (drainControl only)
+             */
+            struct ControlStats {
+                float fillPercent;
+                float controlSignal;
+                float error;
+                float integral;
+                float arrivalBps;
+                float serviceBps;
+                float timeToFull_ms;
+
+                ControlStats() = delete;
+                ControlStats(const ControlState &cs): fillPercent{cs.fillPercent.load(std::memory_order_relaxed)},
+                    controlSignal{cs.controlSignal.load(std::memory_order_relaxed)}, 
+                    error{cs.error.load(std::memory_order_relaxed)}, 
+                    integral{cs.integral.load(std::memory_order_relaxed)},
+                    arrivalBps{cs.arrivalBps.load(std::memory_order_relaxed)},
+                    serviceBps{cs.serviceBps.load(std::memory_order_relaxed)},
+                    timeToFull_ms{cs.timeToFull_ms.load(std::memory_order_relaxed)}
+                    {}
+            };
+
+            /**
+             * Structure in which aggregated lost event statistics are reported back to user.
+             *  - perDataId - list of <session, data id, number of lost events> 
+             *  - otherDataIds - lost events for data ids that did not fit in the fixed-size table
+             *  - perFragCount - histogram of lost events by the number of fragments received. Bucket 0 counts
+             *  events with no fragments, bucket i counts events with [2^(i-1), 2^i) fragments, the last bucket
+             *  absorbs everything above.
+             *  - ringOverwrites - number of lost events evicted from the lost event ring before get_LostEvent() read them
+             *  - neverSeenPerDataId - list of <session, data id, number of never seen events> (only with trackSequence flag)
+             *  - seqOutOfWindow - events that arrived too late for sequence tracking (may already be counted as never seen)
+             */
+            struct LostEventStats {
+                std::list<std::tuple<size_t, u_int16_t, EventNum_t>> perDataId;
+                EventNum_t otherDataIds;
+                std::vector<EventNum_t> perFragCount;
+                size_t ringOverwrites;
+                std::list<std::tuple<size_t, u_int16_t, EventNum_t>> neverSeenPerDataId;
+                EventNum_t seqOutOfWindow{0};
+
+                LostEventStats() = delete;
+                LostEventStats(const AtomicStats &as): otherDataIds{as.lossOtherDataIds}, 
+                    perFragCount(LOSS_FRAG_BUCKETS), ringOverwrites{as.lostEventsOverwritten}
+                {
+                    for (size_t i = 0; i < LOSS_DATAID_SLOTS; i++)
+                    {
+                        auto key = as.lossDataIds[i].load();
+                        if (key != 0)
+                            perDataId.push_back(std::make_tuple(keySession(key), keyDataId(key), 
+                                as.lossPerDataId[i].load()));
+                    }
+                    for (size_t i = 0; i < LOSS_FRAG_BUCKETS; i++)
+                        perFragCount[i] = as.lossPerFragCount[i];
+                    for (size_t i = 0; i < SEQ_DATAID_SLOTS; i++)
+                    {
+                        auto key = as.seqDataIds[i].load();
+                        if (key != 0)
+                        {
+                            neverSeenPerDataId.push_back(std::make_tuple(keySession(key), keyDataId(key), 
+                                as.seqTrackers[i].neverSeen.load()));
+                            seqOutOfWindow += as.seqTrackers[i].outOfWindow;
+                        }
+                    }
+                }
+            };
+
+            /**
+             * Receive counters of one data id of one session (only with perDataIdStats flag)
+             *  - session - session index (0 or returned by addSession())
+             *  - dataId
+             *  - events - events reassembled (including those then lost on enqueue)
+             *  - bytes - bytes in reassembled events
+             *  - fragments - fragments of reassembled events, see meanFragments()
+             *  - reassemblyLoss - incomplete events that timed out
+             *  - enqueueLoss - reassembled events lost because the event queue was full
+             *  - timeoutMisses - events expired by adaptive timeout that a late fragment then arrived for
+             *  (adaptiveTimeout only, counted like adaptiveTimeoutMisses in ReportedStats)
+             */
+            struct DataIdStats {
+                size_t session;
+                u_int16_t dataId;
+                EventNum_t events;
+                size_t bytes;
+                size_t fragments;
+                EventNum_t reassemblyLoss;
+                EventNum_t enqueueLoss;
+                EventNum_t timeoutMisses;
+
+                DataIdStats() = delete;
+                DataIdStats(size_t s, u_int16_t id, const AtomicStats::DataIdCounters &dc): session{s}, dataId{id},
+                    events{dc.events.load(std::memory_order_relaxed)}, bytes{dc.bytes.load(std::memory_order_relaxed)},
+                    fragments{dc.fragments.load(std::memory_order_relaxed)}, 
+                    reassemblyLoss{dc.reassemblyLoss.load(std::memory_order_relaxed)},
+                    enqueueLoss{dc.enqueueLoss.load(std::memory_order_relaxed)}, 
+                    timeoutMisses{dc.timeoutMisses.load(std::memory_order_relaxed)}
+                    {}
+
+                /**
+                 * Mean number of fragments per reassembled event
+                 */
+                inline double meanFragments() const noexcept
+                {
+                    return (events > 0 ? static_cast<double>(fragments) / events : 0.);
+                }
+            };
+
+            /**
+             * Counters and control state of one hosted session (see addSession()). Packet and byte
+             * counters are only kept for the Reassembler as a whole (see getStats())
+             *  - std::pair<int, int> recvPorts; // <start port, end port> of the session
+             *  - EventNum_t eventSuccess; // events reassembled
+             *  - EventNum_t enqueueLoss; // events lost because the session event queue was full
+             *  - EventNum_t reassemblyLoss; // events lost in reassembly due to missing segments
+             *  - size_t queueDepth; // reassembled events waiting for getEvent()/recvEvent()
+             *  - float fillPercent, controlSignal; // most recent PID state reported to the control plane
+             *  - bool registered; // worker registered in this session
+             *  - ControlStats control; // full controller state of the session (see getControlStats())
+             *  - SendStateStats sendState; // sendState RPCs of the session (see getSendStateStats())
+             */
+            struct SessionStats {
+                std::pair<int, int> recvPorts;
+                EventNum_t eventSuccess;
+                EventNum_t enqueueLoss;
+                EventNum_t reassemblyLoss;
+                size_t queueDepth;
+                float fillPercent;
+                float controlSignal;
+                bool registered;
+                ControlStats control;
+                SendStateStats sendState;
+
+                SessionStats() = delete;
+                SessionStats(const SessionState &s): 
+                    recvPorts{s.dataPort, s.dataPort + static_cast<int>(s.numRecvPorts) - 1},
+                    eventSuccess{s.eventSuccess}, enqueueLoss{s.enqueueLoss}, reassemblyLoss{s.reassemblyLoss},
+                    queueDepth{s.eventQueueDepth}, fillPercent{s.controlState.fillPercent},
+                    controlSignal{s.controlState.controlSignal}, registered{s.registeredWorker},
+                    control{s.controlState}, sendState{s.lbman.getSendStateStats()}
                     {}
             };
 
@@ -422,6 +1264,41 @@ namespace e2sar
              * for example, 4 nodes with a minFactor of 0.5 = (512 slots / 4) * 0.5 = min 64 slots
              * - max_factor - multiplied with the number of slots that would be assigned evenly to determine max number of slots
              * for example, 4 nodes with a maxFactor of 2 = (512 slots / 4) * 2 = max 256 slots set to 0 to specify no maximum
+             * - reportStats - report worker stats in sendState gRPC call {false}
+             * - trackSequence - track event numbers per data id of each session and count events for which no fragments arrived
+             * as never seen losses. Only meaningful if the sender uses sequential event numbers (Segmenter default) {false}
+             * - adaptiveTimeout - instead of a fixed eventTimeout_ms, expire an incomplete event once no new segments arrived
+             * for adaptiveTimeoutMult times the largest inter-segment gap learned from completed events of the same session, data id
+             * and similar size. eventTimeout_ms remains the upper bound and is used until something is learned {false}
+             * - adaptiveTimeoutMult - multiple of the learned gap (>= 1) {10.0}
+             * - useGRO - enable UDP_GRO on receive sockets so the kernel can coalesce consecutive datagrams from
+             * the same flow, which are then split back into individual segments. Forces the receive buffer to
+             * MAX_RECV_BUFFER_SIZE (64KB). Linux only {false}
+             * - recvBufferSize - size of the buffer each datagram is received into, must accommodate the largest
+             * expected segment including headers (up to 64KB) {9000}
+             * - busyPoll - set SO_BUSY_POLL/SO_PREFER_BUSY_POLL on receive sockets and spin over them with non-blocking
+             * recvmmsg() instead of blocking in select(). Burns a core per receive thread, meant for low-latency
+             * workers. Linux only {false}
+             * - busyPoll_us - SO_BUSY_POLL value, i.e. how long the kernel may busy poll the device queue per
+             * receive call (values above net.core.busy_read require CAP_NET_ADMIN) {50}
+             * - spinBudget_us - how long a receive thread keeps spinning without receiving anything before it
+             * falls back to blocking in select() until data arrives {1000}
+             * - dropBackoff - if the kernel dropped datagrams on receive sockets (SO_RXQ_OVFL) since the last
+             * sendState report, report the event queue as full (and cap the reported control signal at what a
+             * full queue would produce) so the control plane steers traffic away before the drops turn into
+             * reassembly losses. The controller itself keeps running on the real queue occupancy {false}
+             * - perDataIdStats - keep events, bytes, fragments and losses per data id of each session (see getDataIdStats())
+             * for up to DATAID_STATS_SLOTS <session, data id> pairs. Costs a table lookup per event {false}
+             * - sendStateDeadline_ms - deadline of each sendState gRPC call. Calls are asynchronous with at most one 
+             * outstanding, updates produced while one is outstanding are coalesced (see getSendStateStats()) {500}
+             * - drainControl - instead of the PID on queue occupancy, estimate the event queue arrival and service
+             * (consumer) rates in bytes/sec, predict when the queue fills and report a control signal in [-1, 1]:
+             * the relative service headroom plus (setPoint - fillPercent), pulled down further when the queue is
+             * predicted to fill within epoch_ms. PID gains are ignored (see getControlStats()) {false}
+             * - eventQueueLimit - if non-zero, at most this many reassembled events wait on the event queue of
+             * each session, events completed while it is full are dropped and counted in enqueueLoss. Queue
+             * occupancy reported to the control plane is relative to this limit. With 0 the queue grows as
+             * needed and occupancy is relative to QSIZE (1000 events) {0}
              */
             struct ReassemblerFlags 
             {
@@ -437,11 +1314,28 @@ namespace e2sar
                 int rcvSocketBufSize; 
                 float weight, min_factor, max_factor;
                 bool reportStats;
+                bool trackSequence;
+                bool adaptiveTimeout;
+                float adaptiveTimeoutMult;
+                bool useGRO;
+                size_t recvBufferSize;
+                bool busyPoll;
+                int busyPoll_us;
+                int spinBudget_us;
+                bool dropBackoff;
+                bool perDataIdStats;
+                u_int16_t sendStateDeadline_ms;
+                bool drainControl;
+                size_t eventQueueLimit;
                 ReassemblerFlags(): useCP{true}, useHostAddress{false},
                     period_ms{100}, validateCert{true}, Ki{0.}, Kp{0.}, Kd{0.}, setPoint{0.}, 
                     epoch_ms{1000}, portRange{-1}, withLBHeader{false}, eventTimeout_ms{500},
                     rcvSocketBufSize{1024*1024*3}, weight{1.0}, min_factor{0.5}, max_factor{2.0},
-                    reportStats{false} {}
+                    reportStats{false}, trackSequence{false}, adaptiveTimeout{false}, 
+                    adaptiveTimeoutMult{10.0}, useGRO{false}, recvBufferSize{RECV_BUFFER_SIZE},
+                    busyPoll{false}, busyPoll_us{50}, spinBudget_us{1000}, dropBackoff{false},
+                    perDataIdStats{false}, sendStateDeadline_ms{500}, drainControl{false}, 
+                    eventQueueLimit{0} {}
                 /**
                  * Initialize flags from an INI file
                  * @param iniFile - path to the INI file
@@ -511,8 +1405,10 @@ namespace e2sar
             Reassembler & operator=(const Reassembler &o) = delete;
             ~Reassembler()
             {
-                if (useCP && registeredWorker)
-                    auto res = lbman.deregisterWorker();
+                if (useCP)
+                    for (auto &sess: sessions)
+                        if (sess->registeredWorker)
+                            auto res = sess->lbman.deregisterWorker();
 
                 stopThreads();
 
@@ -520,14 +1416,39 @@ namespace e2sar
             }
             
             /**
-             * Register a worker with the control plane 
+             * Host another LB session on the receive threads of this Reassembler. The session gets
+             * its own port range (which must not overlap those of other sessions), control plane
+             * connection, event queue and PID loop, while receive threads, GC and stats sampling
+             * stay shared, so adding sessions doesn't add threads. Must be called before openAndStart().
+             * Sessions use the data IP address, PID parameters and other flags of the Reassembler.
+             * @param uri - EjfatURI of the session with lb_id and instance token
+             * @param starting_port - starting port number of the session
+             * @param portRange - 2^portRange ports will be open starting from starting_port, -1 means
+             * the same as session 0
+             * @return - index of the new session to use with getEvent()/recvEvent() and getSessionStats(),
+             * or an error condition
+             */
+            result<int> addSession(const EjfatURI &uri, u_int16_t starting_port, int portRange = -1) noexcept;
+
+            /**
+             * Get the number of hosted sessions (1 unless addSession() was used)
+             */
+            inline size_t get_numSessions() const noexcept
+            {
+                return sessions.size();
+            }
+
+            /**
+             * Register a worker with the control plane of every hosted session. If registering in
+             * one of them fails, the sessions registered by this call are deregistered again so the
+             * worker is either registered everywhere or nowhere.
              * @param node_name - name of this node (any unique string)
-             * @return - 0 on success or an error condition
+             * @return - 0 on success or the first error condition
              */
             result<int> registerWorker(const std::string &node_name) noexcept;
 
             /**
-             * Deregister this worker
+             * Deregister this worker from every session it is registered in
              * @return - 0 on success or an error condition 
              */ 
             result<int> deregisterWorker() noexcept;
@@ -562,6 +1483,21 @@ namespace e2sar
              */
             result<int> recvEvent(uint8_t **event, size_t *bytes, EventNum_t* eventNum, uint16_t *dataId, u_int64_t wait_ms=0) noexcept;
 
+            /**
+             * Variant of getEvent() taking events off the queue of a specific session
+             * @param session - session index (0 or returned by addSession())
+             * @return - same as getEvent(), E2SARErrorc::ParameterError if there is no such session
+             */
+            result<int> getEvent(size_t session, uint8_t **event, size_t *bytes, EventNum_t* eventNum, uint16_t *dataId) noexcept;
+
+            /**
+             * Variant of recvEvent() taking events off the queue of a specific session
+             * @param session - session index (0 or returned by addSession())
+             * @return - same as recvEvent(), E2SARErrorc::ParameterError if there is no such session
+             */
+            result<int> recvEvent(size_t session, uint8_t **event, size_t *bytes, EventNum_t* eventNum, uint16_t *dataId, 
+                u_int64_t wait_ms=0) noexcept;
+
             /**
              * Get a struct representing all the stats:
              *  - EventNum_t enqueueLoss;  // number of events received and lost on enqueue
@@ -578,43 +1514,179 @@ namespace e2sar
             }
 
             /**
-             * Try to pop an event number of a lost event from the queue that stores them
-             * @return result with either (eventNumber,dataId) or E2SARErrorc::NotFound if queue is empty
+             * Try to pop the oldest lost event from the bounded ring that stores recent losses. 
+             * If losses arrive faster than they are read, the oldest are overwritten 
+             * (see getLostEventStats().ringOverwrites).
+             * @return result with either (eventNumber,dataId,fragments received) or E2SARErrorc::NotFound if ring is empty
              */
             inline result<boost::tuple<EventNum_t, u_int16_t, size_t>> get_LostEvent() noexcept
             {
-                boost::tuple<EventNum_t, u_int16_t, size_t> *res = nullptr;
-                if (recvStats.lostEventsQueue.pop(res))
-                {
-                    auto ret{*res};
-                    delete res;
-                    return ret;
-                }
-                else
+                boost::lock_guard<boost::mutex> guard(recvStats.lostEventsMtx);
+                if (recvStats.lostEventsRing.empty())
                     return E2SARErrorInfo{E2SARErrorc::NotFound, "Lost event queue is empty"};
+                auto ret{recvStats.lostEventsRing.front()};
+                recvStats.lostEventsRing.pop_front();
+                return ret;
             }
 
             /**
-             * Get per-port/per-fd fragments received stats. Only call this after the threads have been 
-             * stopped, otherwise error is returned. 
-             * @return - list of pairs <port, number of received fragments> or error
+             * Get aggregated lost event counters: per session and data id, per number of fragments
+             * received and how many entries were overwritten in the lost event ring
              */
-            inline result<std::list<std::pair<u_int16_t, size_t>>> get_FDStats() noexcept
+            inline const LostEventStats getLostEventStats() const noexcept
             {
-                if (not threadsStop)
-                    return E2SARErrorInfo{E2SARErrorc::LogicError, "This method should only be called after the threads have been stopped."};
+                return LostEventStats(recvStats);
+            }
 
-                int i{0};
-                std::list<std::pair<u_int16_t, size_t>> ret;
-                for(auto count: recvStats.fragmentsPerFd)
+            /**
+             * Get a snapshot of receive path latency histograms
+             */
+            inline const LatencyStats getLatencyStats() const noexcept
+            {
+                return LatencyStats(latencyHists);
+            }
+
+            /**
+             * Clear receive path latency histograms
+             */
+            inline void resetLatencyStats() noexcept
+            {
+                latencyHists.firstToComplete.reset();
+                latencyHists.completeToDequeue.reset();
+            }
+
+            /**
+             * Get the most recent PID controller state of session 0 (only updated when the control plane is in use)
+             */
+            inline const ControlStats getControlStats() const noexcept
+            {
+                return ControlStats(sessions[0]->controlState);
+            }
+
+            /**
+             * Get the statistics of asynchronous sendState RPCs to the control plane of session 0, including
+             * their latency (only updated when the control plane is in use)
+             */
+            inline SendStateStats getSendStateStats() const noexcept
+            {
+                return sessions[0]->lbman.getSendStateStats();
+            }
+
+            /**
+             * Get counters and control state of a hosted session
+             * @param session - session index (0 or returned by addSession())
+             * @return - SessionStats or E2SARErrorc::ParameterError if there is no such session
+             */
+            inline result<SessionStats> getSessionStats(size_t session) const noexcept
+            {
+                if (session >= sessions.size())
+                    return E2SARErrorInfo{E2SARErrorc::ParameterError, "No such session " + std::to_string(session)};
+                return SessionStats(*sessions[session]);
+            }
+
+            /**
+             * Get receive counters of every <session, data id> seen so far, ordered by table slot (empty unless
+             * the perDataIdStats flag is set). Lock-free, safe to call while receiving.
+             */
+            inline std::list<DataIdStats> getDataIdStats() const noexcept
+            {
+                std::list<DataIdStats> ret;
+                for (size_t i = 0; i < DATAID_STATS_SLOTS; i++)
                 {
-                    if (recvStats.portPerFd[i] != 0)
-                        ret.push_back(std::make_pair<>(recvStats.portPerFd[i], count));
-                    ++i;
+                    auto key = recvStats.statsDataIds[i].load();
+                    if (key != 0)
+                        ret.emplace_back(keySession(key), keyDataId(key), recvStats.dataIdCounters[i]);
                 }
                 return ret;
             }
 
+            /**
+             * Get the number of events (reassembled or lost in reassembly, each counted once) not counted 
+             * in getDataIdStats() because the table of DATAID_STATS_SLOTS data ids was full
+             */
+            inline EventNum_t getDataIdStatsOverflow() const noexcept
+            {
+                return recvStats.dataIdStatsOverflow.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * Get the most recent receive stats sample. The counters in it are read independently
+             * (within microseconds of each other, not atomically as a set); the sequence lock only
+             * guarantees the sample is returned as it was published, never half updated. A timestampNs
+             * of 0 means no sample was taken yet (the first one is SAMPLE_PERIOD_MS after openAndStart())
+             */
+            inline const RateSample getStatsSnapshot() const noexcept
+            {
+                return lastSample.load();
+            }
+
+            /**
+             * Get up to the last n per-second receive stats samples, oldest first
+             * (at most SAMPLE_HISTORY are kept)
+             */
+            inline std::vector<RateSample> getStatsHistory(size_t n = SAMPLE_HISTORY) const noexcept
+            {
+                return sampleHistory.last(n);
+            }
+
+            /**
+             * Get the number of reassembled events of session 0 waiting to be picked up by getEvent()/recvEvent()
+             */
+            inline size_t getEventQueueDepth() const noexcept
+            {
+                return sessions[0]->eventQueueDepth.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * Get per-port fragments received stats. Safe to call while the receive threads
+             * are running. 
+             * @return - list of pairs <port, number of received fragments> sorted by port, or error
+             * if the Reassembler hasn't been started
+             */
+            inline result<std::list<std::pair<u_int16_t, size_t>>> get_FDStats() const noexcept
+            {
+                if (not recvThreadsStarted.load(std::memory_order_acquire))
+                    return E2SARErrorInfo{E2SARErrorc::LogicError, "This method should only be called after the threads have been started."};
+
+                std::list<std::pair<u_int16_t, size_t>> ret;
+                for(auto &rts: recvThreadState)
+                    for(size_t i = 0; i < rts.udpPorts.size(); i++)
+                        ret.push_back(std::make_pair<>(static_cast<u_int16_t>(rts.udpPorts[i]), 
+                            rts.fragmentsPerPort[i].load(std::memory_order_relaxed)));
+                ret.sort();
+                return ret;
+            }
+
+            /**
+             * Get per-port counts of datagrams the kernel dropped because the receive socket buffer
+             * was full (SO_RXQ_OVFL, always 0 where not supported). Safe to call while the receive threads
+             * are running.
+             * @return - list of pairs <port, number of dropped datagrams> sorted by port, or error
+             * if the Reassembler hasn't been started
+             */
+            inline result<std::list<std::pair<u_int16_t, size_t>>> get_PortDropStats() const noexcept
+            {
+                if (not recvThreadsStarted.load(std::memory_order_acquire))
+                    return E2SARErrorInfo{E2SARErrorc::LogicError, "This method should only be called after the threads have been started."};
+
+                std::list<std::pair<u_int16_t, size_t>> ret;
+                for(auto &rts: recvThreadState)
+                    for(size_t i = 0; i < rts.udpPorts.size(); i++)
+                        ret.push_back(std::make_pair<>(static_cast<u_int16_t>(rts.udpPorts[i]), 
+                            rts.dropsPerPort[i].load(std::memory_order_relaxed)));
+                ret.sort();
+                return ret;
+            }
+
+            /**
+             * Write the trace rings holding the most recent fragment activity of the receive threads
+             * and expired events of the GC thread into a binary file that can be decoded with
+             * e2sar_trace. Safe to call while the threads are running.
+             * @param path - file to write (overwritten)
+             * @return - 0 on success or E2SARErrorc::SystemError
+             */
+            result<int> dumpTrace(const std::string &path) const noexcept;
+
             /**
              * Get the number of threads this Reassembler is using
              */
@@ -624,7 +1696,7 @@ namespace e2sar
             }
 
             /**
-             * Get the ports this reassembler is listening on, returned as a pair <start port, end port>
+             * Get the ports session 0 of this reassembler is listening on, returned as a pair <start port, end port>
              */
             inline const std::pair<int, int> get_recvPorts() const noexcept
             {
@@ -665,26 +1737,24 @@ namespace e2sar
                     for(auto i = recvThreadState.begin(); i != recvThreadState.end(); ++i)
                         i->threadObj.join();
 
-                    // drain event queue
-                    EventQueueItem* item{nullptr};
-                    bool a{false};
-                    do {
-                        a = eventQueue.pop(item);
-                        if (a) 
-                        {
-                            if (item->event != nullptr)
-                                delete[] item->event;
-                            delete item;
-                        }
-                    } while (a);
+                    // drain event queues
+                    for (auto &sess: sessions)
+                    {
+                        EventQueueItem* item{nullptr};
+                        bool a{false};
+                        do {
+                            a = sess->eventQueue.pop(item);
+                            if (a) 
+                            {
+                                if (item->event != nullptr)
+                                    delete[] item->event;
+                                delete item;
+                            }
+                        } while (a);
+                    }
 
                     gcThreadState.threadObj.join();
-
-                    // drain lost events queue - tuples are heap-allocated in logLostEvent
-                    // and only freed by get_LostEvent(); if the caller never calls it they leak
-                    boost::tuple<EventNum_t, u_int16_t, size_t>* evtPtr{nullptr};
-                    while (recvStats.lostEventsQueue.pop(evtPtr))
-                        delete evtPtr;
+                    samplerThreadState.threadObj.join();
                 }
             }
         protected:
@@ -15,7 +15,6 @@
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_io.hpp>
-#include <boost/circular_buffer.hpp>
 #include <boost/any.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <boost/variant.hpp>
@@ -23,11 +22,13 @@
 #include <boost/chrono.hpp>
 
 #include <atomic>
+#include <array>
 
 #include "e2sar.hpp"
 #include "e2sarUtil.hpp"
 #include "e2sarHeaders.hpp"
 #include "e2sarNetUtil.hpp"
+#include "e2sarTrace.hpp"
 #include "portable_endian.h"
 
 /***
@@ -36,6 +37,81 @@
 
 namespace e2sar
 {
+    class Segmenter;
+
+    /**
+     * Process-wide sync service. Segmenters created with SegmenterFlags::sharedSync
+     * register with it instead of each running its own sync thread and socket. A single
+     * thread wakes up whenever the next registered Segmenter is due (each keeps its own
+     * syncPeriodMs) and sends the Sync headers of all Segmenters due at that moment as one
+     * batch from one unconnected socket per address family. Each eventSrcId is still
+     * reported in its own Sync header. Meant for DAQ hosts running many Segmenters
+     * in one process.
+     */
+    class SyncService
+    {
+        friend class Segmenter;
+        public:
+            /**
+             * Service statistics
+             * - segmenters - Segmenters currently registered
+             * - wakeups - times the service thread woke up to send
+             * - syncsSent - Sync headers sent
+             * - errors - Sync headers that failed to send
+             */
+            struct ServiceStats
+            {
+                size_t segmenters{0};
+                u_int64_t wakeups{0};
+                u_int64_t syncsSent{0};
+                u_int64_t errors{0};
+            };
+
+            /**
+             * Get the service statistics
+             */
+            static ServiceStats getStats() noexcept;
+
+        private:
+            struct Member
+            {
+                Segmenter *seg;
+                boost::chrono::steady_clock::time_point nextDue;
+            };
+            // most Sync headers sent per system call
+            static constexpr size_t MAX_BATCH{64};
+
+            // serializes attach/detach (held across thread start/join)
+            static boost::mutex ctlMtx;
+            // protects members, sockets and stats, held by the service thread while sending
+            static boost::mutex mtx;
+            static boost::condition_variable cond;
+            static std::vector<Member> members;
+            static boost::thread threadObj;
+            static bool threadStop;
+            static int socketV4;
+            static int socketV6;
+            static ServiceStats stats;
+
+            /**
+             * Register a Segmenter, opening the socket for its address family and
+             * starting the service thread as needed. Its first Sync is sent right away.
+             */
+            static result<int> attach(Segmenter *seg) noexcept;
+            /**
+             * Unregister a Segmenter (no-op if not registered). The thread is stopped and
+             * the sockets closed when the last one leaves. Once this returns the service
+             * no longer refers to seg.
+             */
+            static void detach(Segmenter *seg) noexcept;
+            static void _threadBody();
+            // send a batch of Sync headers on one socket, updating per-Segmenter sync stats
+            static void _sendBatch(int fd, struct mmsghdr *msgs, Segmenter **segs, size_t num);
+
+            SyncService() = delete;
+            ~SyncService() = delete;
+    };
+
     /*
         The Segmenter class knows how to break up the provided
         events into segments consumable by the hardware loadbalancer.
@@ -47,6 +123,7 @@ namespace e2sar
     class Segmenter
     {
         friend class Reassembler;
+        friend class SyncService;
         private:
             EjfatURI dpuri;
             // unique identifier of the originating segmentation
@@ -95,10 +172,12 @@ namespace e2sar
                 u_int16_t entropy;  // optional per event entropy
                 void (*callback)(boost::any);
                 boost::any cbArg;
+                TSCClock::steady::time_point enqueued; // when addToSendQueue() queued it
             };
 
             // Fast, lock-free, wait-free queue (supports multiple producers/consumers)
             boost::lockfree::queue<EventQueueItem*, boost::lockfree::fixed_sized<true>> eventQueue{QSIZE};
+            std::atomic<size_t> eventQueueDepth{0};
 
 #ifdef LIBURING_AVAILABLE
             std::vector<struct io_uring> rings;
@@ -118,18 +197,15 @@ namespace e2sar
             };
 #endif
 
-            // structure that maintains send stats
-            struct SendStats {
-                // Last time a sync message sent to CP in nanosec since epoch.
-                UnixTimeNano_t lastSyncTimeNanos;
-                // Number of events sent since last sync message sent to CP. 
-                EventNum_t eventsSinceLastSync; 
-            };
-            // event metadata fifo to keep track of stats
-            boost::circular_buffer<SendStats> eventStatsBuffer;
-            // keep these atomic, as they are accessed by Sync, Send (and maybe main) thread
-            boost::atomic<UnixTimeNano_t> currentSyncStartNano{0};
-            boost::atomic<EventNum_t> eventsInCurrentSync{0};
+            // LB tick of the last event fully sent (reported in Sync with measuredSync)
+            boost::atomic<EventNum_t> lastSentTick{0};
+            // EWMA of how fast lastSentTick advanced over completed sync periods in ticks/sec,
+            // starting from the nominal 1MHz of the microsecond clock ticks are taken from, and the
+            // tick and time of the previous Sync it is measured against. Only touched by the sync
+            // thread (or the sync service thread)
+            double ewmaTickRate{1e6};
+            EventNum_t prevSyncTick{0};
+            UnixTimeNano_t prevSyncNanos{0};
 
             // currently user-assigned or sequential event number at enqueuing and reported in RE header
             boost::atomic<EventNum_t> userEventNum{0};
@@ -146,20 +222,241 @@ namespace e2sar
              * Internal structure of atomic counters to maintain stats on sending
              * and sync messages
              */
+            static constexpr size_t STATS_SHARDS{16};
+            // send socket buffer occupancy (fraction of SO_SNDBUF) counted as saturated
+            static constexpr float SEND_QUEUE_SATURATION{0.9};
+            // send socket buffer occupancy is sampled once every so many events per thread
+            static constexpr size_t SEND_QUEUE_SAMPLE_EVENTS{8};
             struct AtomicStats {
-                // sync messages sent
-                std::atomic<u_int64_t> msgCnt{0}; 
-                // sync errors seen on send
-                std::atomic<u_int64_t> errCnt{0};
+                // message and error counters are sharded into cache-line-padded slots 
+                // picked by the calling thread (send thread or any thread calling sendEvent())
+                // so concurrent senders don't bounce the same line, readers sum the slots
+                struct alignas(CACHE_LINE_SIZE) Shard {
+                    // messages sent
+                    std::atomic<u_int64_t> msgCnt{0}; 
+                    // errors seen on send
+                    std::atomic<u_int64_t> errCnt{0};
+                    // events and their payload bytes fully handed to the send call (send stats only)
+                    std::atomic<u_int64_t> eventCnt{0};
+                    std::atomic<u_int64_t> byteCnt{0};
+                };
+                std::array<Shard, STATS_SHARDS> shards;
                 // last error code
                 std::atomic<int> lastErrno{0};
                 // last e2sar error
                 std::atomic<E2SARErrorc> lastE2SARError{E2SARErrorc::NoError};
+                // sends that failed with ENOBUFS (device/qdisc queue full)
+                std::atomic<u_int64_t> enobufsCnt{0};
+                // send socket buffer occupancy samples at or above SEND_QUEUE_SATURATION
+                std::atomic<u_int64_t> sndQueueSaturated{0};
+                // largest send socket buffer occupancy sampled (bytes)
+                std::atomic<int> sndQueueHighWater{0};
+
+                inline void countMsg(u_int64_t n = 1) noexcept
+                {
+                    shards[threadShardIndex() % STATS_SHARDS].msgCnt.fetch_add(n, std::memory_order_relaxed);
+                }
+                inline void countErr(u_int64_t n = 1) noexcept
+                {
+                    shards[threadShardIndex() % STATS_SHARDS].errCnt.fetch_add(n, std::memory_order_relaxed);
+                }
+                inline void countEvent(u_int64_t bytes) noexcept
+                {
+                    auto &shard = shards[threadShardIndex() % STATS_SHARDS];
+                    shard.eventCnt.fetch_add(1, std::memory_order_relaxed);
+                    shard.byteCnt.fetch_add(bytes, std::memory_order_relaxed);
+                }
+                // record errno of a failed send
+                inline void countErrno(int e) noexcept
+                {
+                    lastErrno = e;
+                    if (e == ENOBUFS)
+                        enobufsCnt.fetch_add(1, std::memory_order_relaxed);
+                }
+                // record a send socket buffer occupancy sample
+                inline void sampleSendQueue(int outstanding, int sndBufBytes) noexcept
+                {
+                    auto hw = sndQueueHighWater.load(std::memory_order_relaxed);
+                    while ((outstanding > hw) && !sndQueueHighWater.compare_exchange_weak(hw, outstanding, 
+                        std::memory_order_relaxed));
+                    if ((sndBufBytes > 0) && (outstanding >= SEND_QUEUE_SATURATION * sndBufBytes))
+                        sndQueueSaturated.fetch_add(1, std::memory_order_relaxed);
+                }
+                inline u_int64_t msgCnt() const noexcept
+                {
+                    u_int64_t sum{0};
+                    for(auto &s: shards)
+                        sum += s.msgCnt.load(std::memory_order_relaxed);
+                    return sum;
+                }
+                inline u_int64_t errCnt() const noexcept
+                {
+                    u_int64_t sum{0};
+                    for(auto &s: shards)
+                        sum += s.errCnt.load(std::memory_order_relaxed);
+                    return sum;
+                }
+                inline u_int64_t eventCnt() const noexcept
+                {
+                    u_int64_t sum{0};
+                    for(auto &s: shards)
+                        sum += s.eventCnt.load(std::memory_order_relaxed);
+                    return sum;
+                }
+                inline u_int64_t byteCnt() const noexcept
+                {
+                    u_int64_t sum{0};
+                    for(auto &s: shards)
+                        sum += s.byteCnt.load(std::memory_order_relaxed);
+                    return sum;
+                }
             };
             // independent stats for each thread
             AtomicStats syncStats;
             AtomicStats sendStats;
 
+            // counters of one send socket, the socket (and io_uring ring) used for an event is
+            // picked round robin so several threads may update the same slot
+            struct alignas(CACHE_LINE_SIZE) SocketCounters {
+                // fragments and bytes (including LB+RE headers) handed to the kernel
+                std::atomic<u_int64_t> fragments{0};
+                std::atomic<u_int64_t> bytes{0};
+                // failed sends and among them EAGAIN/EWOULDBLOCK and ENOBUFS
+                std::atomic<u_int64_t> errors{0};
+                std::atomic<u_int64_t> eagain{0};
+                std::atomic<u_int64_t> enobufs{0};
+                // io_uring submission entries not yet consumed by the kernel and completions
+                // not yet reaped, sampled after each event is submitted (last and largest seen)
+                std::atomic<u_int32_t> sqReady{0};
+                std::atomic<u_int32_t> sqReadyHighWater{0};
+                std::atomic<u_int32_t> cqReady{0};
+                std::atomic<u_int32_t> cqReadyHighWater{0};
+
+                inline void countSent(u_int64_t frags, u_int64_t nbytes) noexcept
+                {
+                    fragments.fetch_add(frags, std::memory_order_relaxed);
+                    bytes.fetch_add(nbytes, std::memory_order_relaxed);
+                }
+                inline void countError(int e, u_int64_t n = 1) noexcept
+                {
+                    errors.fetch_add(n, std::memory_order_relaxed);
+                    if ((e == EAGAIN) || (e == EWOULDBLOCK))
+                        eagain.fetch_add(n, std::memory_order_relaxed);
+                    else if (e == ENOBUFS)
+                        enobufs.fetch_add(n, std::memory_order_relaxed);
+                }
+                static inline void highWater(std::atomic<u_int32_t> &hw, u_int32_t v) noexcept
+                {
+                    auto cur = hw.load(std::memory_order_relaxed);
+                    while ((v > cur) && !hw.compare_exchange_weak(cur, v, std::memory_order_relaxed));
+                }
+                inline void sampleRing(u_int32_t sq, u_int32_t cq) noexcept
+                {
+                    sqReady.store(sq, std::memory_order_relaxed);
+                    cqReady.store(cq, std::memory_order_relaxed);
+                    highWater(sqReadyHighWater, sq);
+                    highWater(cqReadyHighWater, cq);
+                }
+            };
+            // indexed by the round robin index of the socket
+            std::vector<SocketCounters> socketStats;
+
+        public:
+            // number of event size buckets of the send time histogram, bucket 0 is events
+            // below 4KB, bucket i holds [4^i KB, 4^(i+1) KB), the last absorbs everything above
+            static constexpr size_t SEND_SIZE_BUCKETS{8};
+
+            /**
+             * Upper bound (exclusive, in bytes) of events in a send time size bucket
+             * (the last bucket has no upper bound)
+             */
+            static inline size_t sendSizeBucketLimit(size_t bucket) noexcept
+            {
+                return (bucket < SEND_SIZE_BUCKETS - 1 ? 4096UL << (2 * bucket) : std::numeric_limits<size_t>::max());
+            }
+        private:
+            static inline size_t sendSizeBucket(size_t bytes) noexcept
+            {
+                if (bytes < 4096)
+                    return 0;
+                size_t bucket = (63 - __builtin_clzll(bytes) - 10) / 2;
+                return (bucket < SEND_SIZE_BUCKETS ? bucket : SEND_SIZE_BUCKETS - 1);
+            }
+
+            // latency histograms across the send path of an event (nanoseconds)
+            struct LatencyHistograms {
+                // addToSendQueue() to the send thread taking it off the queue
+                LatencyHistogram enqueueToDequeue;
+                // send thread taking it off the queue to its first fragment handed to the kernel
+                LatencyHistogram dequeueToFirstSend;
+                // fragmenting and sending the whole event (sendEvent() and queued events)
+                LatencyHistogram sendDuration;
+                // the same split by event size (see sendSizeBucket())
+                std::array<LatencyHistogram, SEND_SIZE_BUCKETS> sendDurationBySize;
+            };
+            LatencyHistograms latencyHists;
+
+        public:
+            /**
+             * One sample of the send side taken by the sampler thread. Counters are cumulative and
+             * read one after another by the sampler, rates are per second over the preceding sample period
+             *  - int64_t timestampNs; // wall clock time of the sample in ns since epoch (0 - no sample yet)
+             *  - int64_t periodNs; // time since the previous sample (measured on the monotonic clock)
+             *  - u_int64_t eventCnt, byteCnt, msgCnt, errCnt; // events, payload bytes, fragments sent and send errors
+             *  - double eventRate, byteRate, msgRate, errRate; // the same per second
+             *  - size_t queueDepth; // events waiting in the send queue
+             */
+            struct RateSample {
+                int64_t timestampNs{0};
+                int64_t periodNs{0};
+                u_int64_t eventCnt{0};
+                u_int64_t byteCnt{0};
+                u_int64_t msgCnt{0};
+                u_int64_t errCnt{0};
+                double eventRate{0.};
+                double byteRate{0.};
+                double msgRate{0.};
+                double errRate{0.};
+                size_t queueDepth{0};
+            };
+            // stats sampling period and how many samples are kept
+            static constexpr int64_t SAMPLE_PERIOD_MS{1000};
+            static constexpr size_t SAMPLE_HISTORY{300};
+        private:
+            // latest sample and recent history written by the sampler thread
+            SeqLocked<RateSample> lastSample;
+            SampleRing<RateSample, SAMPLE_HISTORY> sampleHistory;
+
+            /**
+             * This thread samples send stats once every SAMPLE_PERIOD_MS
+             */
+            struct SamplerThreadState {
+                // owner object
+                Segmenter &seg;
+                boost::thread threadObj;
+
+                SamplerThreadState(Segmenter &s): seg{s} {}
+
+                // monotonic time of the previous sample - periods are measured on it so
+                // wall clock adjustments don't skew the rates
+                int64_t lastMonoNs{0};
+
+                // take one sample computing rates against the previous one
+                RateSample _sample(const RateSample &prev) noexcept;
+                void _threadBody();
+            };
+            friend struct SamplerThreadState;
+
+            SamplerThreadState samplerThreadState;
+
+            // trace rings of recent fragment activity, sharded by sending thread like the stats
+            static constexpr size_t TRACE_SHARDS{4};
+            std::array<TraceRing, TRACE_SHARDS> traceRings;
+            inline TraceRing &traceRing() noexcept
+            {
+                return traceRings[threadShardIndex() % TRACE_SHARDS];
+            }
+
             /** 
              * This thread sends a sync header every pre-specified number of milliseconds.
              */
@@ -187,9 +484,13 @@ namespace e2sar
                     connectSocket{cnct}
                     {}
 
+                // fill in syncAddrStruct and isV6 from the URI
+                result<int> _setAddr();
                 result<int> _open();
                 result<int> _close();
                 result<int> _send(SyncHdr *hdr);
+                // roll the send stats over into a new sync period and fill the header
+                void _fill(SyncHdr *hdr, UnixTimeNano_t currentTimeNanos);
                 void _threadBody();
 
 
@@ -227,6 +528,8 @@ namespace e2sar
 #define GET_REMOTE_SEND_STRUCT(sas, i) boost::get<2>(sas[i])
                 std::vector<boost::tuple<int, sockaddr_in, sockaddr_in>> socketFd4;
                 std::vector<boost::tuple<int, sockaddr_in6, sockaddr_in6>> socketFd6;
+                // effective send socket buffer size of each socket as reported by the kernel (same index)
+                std::vector<int> sndBufBytes;
 
                 // fast random number generator to create entropy values for events
                 // this entropy value is held the same for all packets of a given
@@ -239,7 +542,7 @@ namespace e2sar
                 inline SendThreadState(Segmenter &s, int idx, bool v6, u_int16_t mtu, bool tasreenum, bool cnct=true): 
                     seg{s}, threadIndex{idx}, connectSocket{cnct}, useV6{v6}, ticksAsREEventNum{tasreenum}, mtu{mtu}, 
                     maxPldLen{mtu - getTotalHeaderLength(v6)}, socketFd4(s.numSendSockets), 
-                    socketFd6(s.numSendSockets),
+                    socketFd6(s.numSendSockets), sndBufBytes(s.numSendSockets, 0),
                     ranlux{static_cast<u_int32_t>(std::time(0))} 
                 {
                     // this way every segmenter send thread has a unique PRNG sequence
@@ -254,9 +557,11 @@ namespace e2sar
                 // close a given socket, wait that it has sent all the data (in Linux)
                 result<int> _waitAndCloseFd(int fd);
                 // fragment and send the event
+                // (dequeued is only set for events that came off the send queue)
                 result<int> _send(u_int8_t *event, size_t bytes, EventNum_t altEventNum, u_int16_t dataId, 
                     u_int16_t entropy, size_t roundRobinIndex, int64_t interFrameSleepUsec = 0, 
-                    void (*callback)(boost::any) = nullptr, boost::any cbArg = nullptr);
+                    void (*callback)(boost::any) = nullptr, boost::any cbArg = nullptr,
+                    const TSCClock::steady::time_point *dequeued = nullptr);
                 // thread loop
                 void _threadBody();
 #ifdef LIBURING_AVAILABLE
@@ -290,6 +595,12 @@ namespace e2sar
             u_int16_t warmUpMs;
             // use control plane (can be disabled for debugging)
             bool useCP;
+            // send Sync packets via the process-wide SyncService
+            const bool sharedSync;
+            // report last sent tick and the measured rate it advances at in Sync packets
+            const bool measuredSync;
+            // EWMA weight of the newest sync period (2/(syncPeriods + 1))
+            const double ewmaAlpha;
 #define MIN_CLOCK_ENTROPY 6
             bool addEntropy;
 
@@ -329,16 +640,77 @@ namespace e2sar
              *  - u_int64_t errCnt; // errors encountered on send
              *  - int lastErrno; // last errno recorded, use strerror() to get error message
              *  - E2SARErrorc lastE2SARError; // last recorded E2SAR error (use make_error_code(stats.lastE2SARError).message())
+             *  - u_int64_t enobufsCnt; // sends that failed with ENOBUFS (send stats only)
+             *  - u_int64_t sndQueueSaturated; // times the send socket buffer was sampled at least 90% full (send stats only,
+             *  needs SIOCOUTQ or SO_NWRITE)
+             *  - int sndQueueHighWater; // largest send socket buffer occupancy sampled, in bytes (send stats only)
              */
             struct ReportedStats {
                 u_int64_t msgCnt;
                 u_int64_t errCnt;
                 int lastErrno;
                 E2SARErrorc lastE2SARError;
+                u_int64_t enobufsCnt;
+                u_int64_t sndQueueSaturated;
+                int sndQueueHighWater;
 
                 ReportedStats() = delete;
-                ReportedStats(const AtomicStats &as): msgCnt{as.msgCnt}, errCnt{as.errCnt},
-                    lastErrno{as.lastErrno}, lastE2SARError{as.lastE2SARError}
+                ReportedStats(const AtomicStats &as): msgCnt{as.msgCnt()}, errCnt{as.errCnt()},
+                    lastErrno{as.lastErrno}, lastE2SARError{as.lastE2SARError},
+                    enobufsCnt{as.enobufsCnt}, sndQueueSaturated{as.sndQueueSaturated}, 
+                    sndQueueHighWater{as.sndQueueHighWater}
+                    {}
+            };
+
+            /**
+             * Snapshots of latency histograms of the send path (values in nanoseconds)
+             *  - enqueueToDequeue - from addToSendQueue() to the send thread taking the event off the queue
+             *  - dequeueToFirstSend - from taking the event off the queue to its first fragment being handed to the kernel
+             *  - sendDuration - time to fragment and send the whole event (sendEvent() and queued events)
+             *  - sendDurationBySize - sendDuration split by event size, element i holds events smaller than
+             *  sendSizeBucketLimit(i) and at least as large as sendSizeBucketLimit(i-1)
+             */
+            struct LatencyStats {
+                LatencyHistogram::Snapshot enqueueToDequeue;
+                LatencyHistogram::Snapshot dequeueToFirstSend;
+                LatencyHistogram::Snapshot sendDuration;
+                std::vector<LatencyHistogram::Snapshot> sendDurationBySize;
+
+                LatencyStats() = delete;
+                LatencyStats(const LatencyHistograms &lh): enqueueToDequeue{lh.enqueueToDequeue.snapshot()},
+                    dequeueToFirstSend{lh.dequeueToFirstSend.snapshot()}, sendDuration{lh.sendDuration.snapshot()}
+                {
+                    for(auto &h: lh.sendDurationBySize)
+                        sendDurationBySize.push_back(h.snapshot());
+                }
+            };
+
+            /**
+             * Statistics of one send socket
+             *  - index - round robin index of the socket (0 to numSendSockets - 1)
+             *  - fragments, bytes - fragments and bytes (including LB+RE headers) handed to the kernel
+             *  - errors - failed sends, of them eagain (EAGAIN/EWOULDBLOCK) and enobufs (ENOBUFS)
+             *  - sqReady, sqReadyHighWater - io_uring submission entries not yet consumed by the kernel, 
+             *  last sampled and largest seen (liburing_send only)
+             *  - cqReady, cqReadyHighWater - io_uring completions waiting to be reaped, last sampled
+             *  and largest seen (liburing_send only)
+             */
+            struct SocketStats {
+                size_t index;
+                u_int64_t fragments, bytes;
+                u_int64_t errors, eagain, enobufs;
+                u_int32_t sqReady, sqReadyHighWater;
+                u_int32_t cqReady, cqReadyHighWater;
+
+                SocketStats() = delete;
+                SocketStats(size_t idx, const SocketCounters &sc): index{idx}, 
+                    fragments{sc.fragments.load(std::memory_order_relaxed)}, bytes{sc.bytes.load(std::memory_order_relaxed)},
+                    errors{sc.errors.load(std::memory_order_relaxed)}, eagain{sc.eagain.load(std::memory_order_relaxed)},
+                    enobufs{sc.enobufs.load(std::memory_order_relaxed)}, 
+                    sqReady{sc.sqReady.load(std::memory_order_relaxed)}, 
+                    sqReadyHighWater{sc.sqReadyHighWater.load(std::memory_order_relaxed)},
+                    cqReady{sc.cqReady.load(std::memory_order_relaxed)}, 
+                    cqReadyHighWater{sc.cqReadyHighWater.load(std::memory_order_relaxed)}
                     {}
             };
 
@@ -351,6 +723,13 @@ namespace e2sar
              * - warmUpMs - a period of sending sync messages before data is allowed {1000}
              * - syncPeriodMs - sync thread period in milliseconds {1000}
              * - syncPerods - number of sync periods to use for averaging reported send rate {2}
+             * - sharedSync - send Sync packets through the process-wide SyncService shared with
+             * other Segmenters in this process instead of a dedicated thread and socket (the sync
+             * socket is then never connected) {false}
+             * - measuredSync - report in Sync packets the LB tick of the last event actually sent and
+             * the rate at which sent ticks advanced (EWMA over syncPeriods in ticks/sec, so about 1MHz
+             * while events flow and decaying when idle), rather than the current clock and a nominal
+             * 1MHz rate {false}
              * - mtu - size of the MTU to attempt to fit the segmented data in (must accommodate
              * IP, UDP and LBRE headers). Value of 0 means auto-detect based on MTU of outgoing interface
              * - Linux only {1500}
@@ -375,6 +754,8 @@ namespace e2sar
                 u_int16_t warmUpMs;
                 u_int16_t syncPeriodMs;
                 u_int16_t syncPeriods;
+                bool sharedSync;
+                bool measuredSync;
                 u_int16_t mtu;
                 size_t numSendSockets;
                 int sndSocketBufSize;
@@ -385,7 +766,8 @@ namespace e2sar
                 u_int8_t lbHdrVersion; 
 
                 SegmenterFlags(): dpV6{false}, connectedSocket{true},
-                    useCP{true}, warmUpMs{1000}, syncPeriodMs{1000}, syncPeriods{2}, mtu{1500},
+                    useCP{true}, warmUpMs{1000}, syncPeriodMs{1000}, syncPeriods{2}, 
+                    sharedSync{false}, measuredSync{false}, mtu{1500},
                     numSendSockets{4}, sndSocketBufSize{1024*1024*3}, rateGbps{-1.0}, smooth{false}, 
                     multiPort{false}, ticksAsREEventNum{false}, lbHdrVersion{lbhdrVersion2} {}
                 /**
@@ -501,6 +883,87 @@ namespace e2sar
                 return ReportedStats(sendStats);
             }
 
+            /**
+             * Get a snapshot of send path latency histograms
+             */
+            inline const LatencyStats getLatencyStats() const noexcept
+            {
+                return LatencyStats(latencyHists);
+            }
+
+            /**
+             * Clear send path latency histograms
+             */
+            inline void resetLatencyStats() noexcept
+            {
+                latencyHists.enqueueToDequeue.reset();
+                latencyHists.dequeueToFirstSend.reset();
+                latencyHists.sendDuration.reset();
+                for(auto &h: latencyHists.sendDurationBySize)
+                    h.reset();
+            }
+
+            /**
+             * Get statistics of each send socket. Uneven fragment counts or errors concentrated on
+             * one socket help tune numSendSockets and sndSocketBufSize
+             */
+            inline std::vector<SocketStats> getSocketStats() const noexcept
+            {
+                std::vector<SocketStats> ret;
+                for(size_t i = 0; i < socketStats.size(); i++)
+                    ret.emplace_back(i, socketStats[i]);
+                return ret;
+            }
+
+            /**
+             * Get the number of io_uring sends submitted whose completions haven't been reaped
+             * yet (0 unless liburing_send optimization is used)
+             */
+            inline u_int32_t getOutstandingSends() const noexcept
+            {
+#ifdef LIBURING_AVAILABLE
+                return outstandingSends.load();
+#else
+                return 0;
+#endif
+            }
+
+            /**
+             * Get the most recent send stats sample. The counters in it are read independently
+             * (within microseconds of each other, not atomically as a set); the sequence lock only
+             * guarantees the sample is returned as it was published, never half updated. A timestampNs
+             * of 0 means no sample was taken yet (the first one is SAMPLE_PERIOD_MS after openAndStart())
+             */
+            inline const RateSample getStatsSnapshot() const noexcept
+            {
+                return lastSample.load();
+            }
+
+            /**
+             * Get up to the last n per-second send stats samples, oldest first
+             * (at most SAMPLE_HISTORY are kept)
+             */
+            inline std::vector<RateSample> getStatsHistory(size_t n = SAMPLE_HISTORY) const noexcept
+            {
+                return sampleHistory.last(n);
+            }
+
+            /**
+             * Get the number of events waiting in the send queue
+             */
+            inline size_t getSendQueueDepth() const noexcept
+            {
+                return eventQueueDepth.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * Write the trace rings holding the most recent fragment activity of the send path
+             * into a binary file that can be decoded with e2sar_trace. Safe to call while sending.
+             * @param path - file to write (overwritten)
+             * @return - 0 on success or E2SARErrorc::SystemError
+             */
+            result<int> dumpTrace(const std::string &path) const noexcept;
+
             /**
              * Get the outgoing interface (if available)
              */
@@ -546,47 +1009,51 @@ namespace e2sar
                     // wait till they are done
                     threadsStop = true;
                     sendThreadState.threadObj.join();
+                    samplerThreadState.threadObj.join();
                     // now we can stop the sync thread
                     syncThreadStop = true;
-                    syncThreadState.threadObj.join();
+                    if (sharedSync)
+                        SyncService::detach(this);
+                    else
+                        syncThreadState.threadObj.join();
                 }
             }
         private:
-            // Calculate the average event rate from circular buffer
-            // note that locking lives outside this function, as needed.
-            // NOTE: this is only useful to sync messages if sequential
-            // event IDs are used. When usec timestamp is used for LB event numbers
-            // the event is constant 1 MHz
-            inline EventRate_t eventRate(UnixTimeNano_t currentTimeNanos) 
-            {
-                // no rate to report
-                if (eventStatsBuffer.size() == 0)
-                    return 1;
-                EventNum_t eventTotal{0LL};
-                // walk the circular buffer
-                for(auto el: eventStatsBuffer)
-                {
-                    // add up the events
-                    eventTotal += el.eventsSinceLastSync;
-                }
-                auto timeDiff = currentTimeNanos - 
-                    eventStatsBuffer.begin()->lastSyncTimeNanos;
-
-                // convert to Hz and return
-                //return (eventTotal*1000000000UL)/timeDiff;
-                // this uses floating point but is more accurate at low rates
-                return std::round(static_cast<float>(eventTotal*1000000000UL)/timeDiff);
-            }
-
             // doesn't require locking as it looks at only srcId in segmenter, which
-            // never changes past initialization
+            // never changes past initialization, and at the measuredSync state only the
+            // sync thread (or the sync service thread) calling it touches
             inline void fillSyncHdr(SyncHdr *hdr, UnixTimeNano_t tnano) 
             {
                 EventRate_t reportedRate{1000000};
                 // figure out what event number would be at this moment, don't worry about its entropy
-                auto nowT = boost::chrono::system_clock::now();
+                auto nowT = TSCClock::system::now();
                 // Convert the time point to microseconds since the epoch
                 EventNum_t reportedEventNum = boost::chrono::duration_cast<boost::chrono::microseconds>(nowT.time_since_epoch()).count();
+
+                // the control plane extrapolates the event number from the reported one at the
+                // reported rate, so the rate has to be in LB ticks (microseconds) per second,
+                // not events per second
+                if (measuredSync)
+                {
+                    // the current clock at the nominal rate until the first event goes out
+                    EventNum_t tick = lastSentTick.load();
+                    if (tick != 0)
+                    {
+                        // fold the sync period that just ended into the average, ticks carry
+                        // up to 8 bits of entropy so don't let them go backwards
+                        if ((prevSyncTick != 0) && (tnano > prevSyncNanos))
+                        {
+                            double ticks = (tick > prevSyncTick ? static_cast<double>(tick - prevSyncTick) : 0.0);
+                            double periodRate = ticks * 1e9 / (tnano - prevSyncNanos);
+                            ewmaTickRate = ewmaAlpha * periodRate + (1.0 - ewmaAlpha) * ewmaTickRate;
+                        }
+                        prevSyncTick = tick;
+                        prevSyncNanos = tnano;
+                        reportedEventNum = tick;
+                        // idle - report the smallest non-zero rate
+                        reportedRate = (ewmaTickRate < 1.0 ? 1 : static_cast<EventRate_t>(std::round(ewmaTickRate)));
+                    }
+                }
                 hdr->set(eventSrcId, reportedEventNum, reportedRate, tnano);
             }
 
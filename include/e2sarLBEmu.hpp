@@ -0,0 +1,314 @@
+#ifndef E2SARLBEMUHPP
+#define E2SARLBEMUHPP
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <array>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "e2sarError.hpp"
+#include "e2sarHeaders.hpp"
+#include "e2sarUtil.hpp"
+
+/***
+ * Software emulator of the FPGA load balancer data plane for testing on a single host
+*/
+
+namespace e2sar
+{
+    /**
+     * Emulates the data plane of the EJFAT load balancer: receives LB+RE framed datagrams
+     * sent by Segmenters, picks a worker from the calendar of the epoch the event tick falls into,
+     * strips the LB header and forwards the rest to the worker, choosing the destination port
+     * within the worker's port range from the entropy (LB header v2) or port select (v3) field.
+     * The calendar slot is the low bits of the tick (v2) or the slot select field (v3).
+     *
+     * Workers are added and removed at any time, the changes take effect with the next call
+     * to newEpoch() which recomputes the calendar, giving each worker a number of slots
+     * proportional to its weight. Datagrams of ticks before the oldest remembered epoch use
+     * the oldest calendar.
+     *
+     * Forwarding threads each receive on their own SO_REUSEPORT socket bound to the same
+     * address and port, so traffic from multiple senders (or send sockets) spreads over them.
+     * Datagrams are received and forwarded in batches using recvmmsg()/sendmmsg() where available.
+     */
+    class LBEmulator
+    {
+        public:
+            // number of slots in the calendar of each epoch
+            static constexpr size_t CALENDAR_SLOTS{512};
+            // number of epochs remembered for datagrams of older ticks
+            static constexpr size_t MAX_EPOCHS{4};
+            // number of datagrams received/forwarded per system call
+            static constexpr size_t BATCH_SIZE{64};
+            // largest datagram we forward
+            static constexpr size_t MAX_DATAGRAM_SIZE{65536};
+            // how often forwarding threads check for the stop signal
+            static constexpr long RECV_TIMEOUT_MS{100};
+
+        private:
+            const boost::asio::ip::address listenAddr;
+            const u_int16_t listenPort;
+            const size_t numThreads;
+            const int rcvSocketBufSize;
+            const int sndSocketBufSize;
+
+            // forwarding counters of one worker, kept across epochs
+            struct alignas(CACHE_LINE_SIZE) WorkerCounters {
+                std::atomic<u_int64_t> packets{0};
+                std::atomic<u_int64_t> bytes{0};
+            };
+
+            // registered worker
+            struct Worker {
+                std::string name;
+                boost::asio::ip::address addr;
+                u_int16_t port;
+                u_int16_t portRange;
+                float weight;
+                std::shared_ptr<WorkerCounters> counters;
+            };
+
+            // worker as seen by the forwarding threads
+            struct Member {
+                std::string name;
+                sockaddr_storage dest;
+                socklen_t destLen;
+                u_int16_t port;
+                u_int16_t portMask;
+                std::shared_ptr<WorkerCounters> counters;
+            };
+
+            // calendar of one epoch, each slot holds an index into members (-1 if empty)
+            struct Epoch {
+                EventNum_t startTick;
+                std::array<int32_t, CALENDAR_SLOTS> slots;
+                std::vector<Member> members;
+            };
+
+            // epochs in the order of startTick, published to forwarding threads as a whole
+            using Schedule = std::vector<std::shared_ptr<const Epoch>>;
+            std::shared_ptr<const Schedule> schedule;
+
+            // protects workers and updates of the schedule
+            boost::mutex workersMtx;
+            std::vector<Worker> workers;
+
+            // highest tick seen so far
+            std::atomic<EventNum_t> maxTick{0};
+
+            struct AtomicStats {
+                std::atomic<u_int64_t> packetsReceived{0};
+                std::atomic<u_int64_t> bytesReceived{0};
+                std::atomic<u_int64_t> packetsForwarded{0};
+                std::atomic<u_int64_t> badHeaderDiscards{0};
+                std::atomic<u_int64_t> noWorkerDiscards{0};
+                std::atomic<u_int64_t> sendErrors{0};
+                std::atomic<u_int64_t> recvErrors{0};
+                std::atomic<int> lastErrno{0};
+            };
+            AtomicStats stats;
+
+#ifndef SENDMMSG_AVAILABLE
+            // same layout as Linux struct mmsghdr, messages are then received and sent one at a time
+            struct mmsghdr {
+                struct msghdr msg_hdr;
+                unsigned int msg_len;
+            };
+#endif
+
+            /**
+             * Forwarding thread state
+             */
+            struct ForwardThreadState {
+                LBEmulator &emu;
+                boost::thread threadObj;
+                const size_t threadIndex;
+
+                int recvFd{-1};
+                // -1 if the host doesn't support the address family
+                int sendFd4{-1};
+                int sendFd6{-1};
+
+                // receive buffers and message headers for one batch, plus the
+                // message headers and destinations of the forwarded datagrams
+                std::vector<u_int8_t> buffers;
+                std::array<iovec, BATCH_SIZE> recvIov;
+                std::array<iovec, BATCH_SIZE> sendIov;
+                std::array<sockaddr_storage, BATCH_SIZE> dests;
+                std::array<mmsghdr, BATCH_SIZE> recvMsgs;
+                std::array<mmsghdr, BATCH_SIZE> sendMsgs;
+
+                ForwardThreadState(LBEmulator &e, size_t idx): emu{e}, threadIndex{idx},
+                    buffers(BATCH_SIZE * MAX_DATAGRAM_SIZE) {}
+
+                // open receive and send sockets
+                result<int> _open() noexcept;
+                // close all sockets
+                void _close() noexcept;
+                // receive, route and forward until stopped
+                void _threadBody();
+                // route received datagrams and forward them, returns number forwarded
+                size_t _forward(const Schedule &sched, size_t numRecvd) noexcept;
+                // send the prepared batch on a socket
+                void _send(int fd, mmsghdr *msgs, size_t num) noexcept;
+            };
+            friend struct ForwardThreadState;
+            std::list<ForwardThreadState> forwardThreadState;
+
+            std::atomic<bool> threadsStop{false};
+
+            // build a calendar for the current set of workers
+            std::shared_ptr<const Epoch> makeEpoch(EventNum_t startTick) const noexcept;
+            // validate an LB header (v2 or v3) and extract the tick, slot and port selection
+            static bool parseLBHeader(const LBHdrU &hdr, EventNum_t &tick, u_int16_t &slotSel,
+                u_int16_t &portSel) noexcept;
+            // worker a tick/slot maps to or nullptr if the slot is empty
+            static const Member* findMember(const Schedule &sched, EventNum_t tick, u_int16_t slotSel) noexcept;
+
+        public:
+            /**
+             * Flags governing LBEmulator behavior with sane defaults
+             * - numThreads - number of forwarding threads {1}
+             * - rcvSocketBufSize - SO_RCVBUF of each receive socket {3MB}
+             * - sndSocketBufSize - SO_SNDBUF of each send socket {3MB}
+             */
+            struct LBEmulatorFlags
+            {
+                size_t numThreads;
+                int rcvSocketBufSize;
+                int sndSocketBufSize;
+                LBEmulatorFlags(): numThreads{1}, rcvSocketBufSize{1024*1024*3},
+                    sndSocketBufSize{1024*1024*3} {}
+            };
+
+            /**
+             * Create an emulator listening for sender traffic on the given address and port.
+             * @param listen_addr - address (v4 or v6) on which to receive LB-framed datagrams
+             * @param listen_port - port on which to receive
+             * @param flags - optional LBEmulatorFlags
+             */
+            LBEmulator(boost::asio::ip::address listen_addr, u_int16_t listen_port,
+                const LBEmulatorFlags &flags = LBEmulatorFlags());
+
+            LBEmulator(const LBEmulator &) = delete;
+            LBEmulator& operator=(const LBEmulator &) = delete;
+
+            ~LBEmulator()
+            {
+                stopThreads();
+            }
+
+            /**
+             * Add a worker. Takes effect with the next newEpoch().
+             * @param name - unique worker name
+             * @param addr - worker data address (v4 or v6)
+             * @param port - first port the worker listens on
+             * @param portRange - the worker listens on 2^portRange consecutive ports (0 <= portRange <= 14)
+             * @param weight - relative share of calendar slots
+             * @return - 0 on success or an error condition
+             */
+            result<int> addWorker(const std::string &name, boost::asio::ip::address addr, u_int16_t port,
+                u_int16_t portRange, float weight = 1.0) noexcept;
+
+            /**
+             * Remove a worker. Takes effect with the next newEpoch().
+             * @param name - worker name
+             * @return - 0 on success or an error condition
+             */
+            result<int> removeWorker(const std::string &name) noexcept;
+
+            /**
+             * Start a new epoch with a calendar built from the current set of workers for all
+             * ticks at and after startTick. The oldest epoch is forgotten if there are more than MAX_EPOCHS.
+             * @param startTick - first tick of the epoch, must not be below the start of the newest epoch
+             * @return - 0 on success or an error condition
+             */
+            result<int> newEpoch(EventNum_t startTick) noexcept;
+
+            /**
+             * Highest tick seen in forwarded traffic so far (useful to place the next epoch)
+             */
+            inline EventNum_t get_maxTick() const noexcept
+            {
+                return maxTick.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * Worker a datagram with this LB header would be forwarded to and the destination port.
+             * @param hdr - LB header (v2 or v3)
+             * @return - <worker name, destination port> or an error if the header is invalid or
+             * no worker is assigned to the slot
+             */
+            result<std::pair<std::string, u_int16_t>> route(const LBHdrU &hdr) const noexcept;
+
+            /**
+             * Open sockets and start forwarding threads. Works on single stack hosts, workers
+             * of an address family the host doesn't support are counted as send errors
+             * @return - 0 on success or an error condition
+             */
+            result<int> openAndStart() noexcept;
+
+            /**
+             * Stop forwarding threads and close sockets
+             */
+            void stopThreads();
+
+            /**
+             * Forwarding statistics
+             * - packetsReceived, bytesReceived - datagrams/bytes received from senders
+             * - packetsForwarded - datagrams sent on to workers
+             * - badHeaderDiscards - datagrams discarded because of a bad or unknown LB header
+             * - noWorkerDiscards - datagrams discarded because no worker was assigned to their slot
+             * - sendErrors, recvErrors - failed system calls
+             * - lastErrno - errno of the last failure
+             */
+            struct ReportedStats {
+                u_int64_t packetsReceived;
+                u_int64_t bytesReceived;
+                u_int64_t packetsForwarded;
+                u_int64_t badHeaderDiscards;
+                u_int64_t noWorkerDiscards;
+                u_int64_t sendErrors;
+                u_int64_t recvErrors;
+                int lastErrno;
+
+                ReportedStats() = delete;
+                ReportedStats(const AtomicStats &as): packetsReceived{as.packetsReceived},
+                    bytesReceived{as.bytesReceived}, packetsForwarded{as.packetsForwarded},
+                    badHeaderDiscards{as.badHeaderDiscards}, noWorkerDiscards{as.noWorkerDiscards},
+                    sendErrors{as.sendErrors}, recvErrors{as.recvErrors}, lastErrno{as.lastErrno} {}
+            };
+
+            /**
+             * Get forwarding statistics
+             */
+            inline const ReportedStats getStats() const noexcept
+            {
+                return ReportedStats(stats);
+            }
+
+            /**
+             * Datagrams and bytes forwarded to one worker
+             */
+            struct WorkerForwardStats {
+                std::string name;
+                u_int64_t packets;
+                u_int64_t bytes;
+            };
+
+            /**
+             * Get per-worker forwarding statistics of the currently registered workers
+             */
+            std::vector<WorkerForwardStats> getWorkerStats() noexcept;
+    };
+}
+#endif
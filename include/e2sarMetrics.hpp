@@ -0,0 +1,142 @@
+#ifndef E2SARMETRICSHPP
+#define E2SARMETRICSHPP
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "e2sarError.hpp"
+
+/***
+ * Metrics exporter publishing Segmenter and Reassembler statistics
+ * in OpenMetrics (Prometheus) text format over HTTP
+*/
+
+namespace e2sar
+{
+    class Segmenter;
+    class Reassembler;
+
+    /**
+     * Embedded minimal HTTP server answering GET /metrics with the counters, queue
+     * depths, PID state, per-port fragment counts and latency histograms of all registered
+     * Segmenters and Reassemblers. Metrics are collected from the same lock-free atomics
+     * that getStats() and friends read, so scraping does not stop or slow down the
+     * send/receive threads. Requests are served one at a time by a single thread.
+     *
+     * Registered objects must outlive the exporter (or the call to stop()).
+     */
+    class MetricsExporter
+    {
+        private:
+            const boost::asio::ip::address listenAddr;
+            u_int16_t listenPort;
+
+            struct SegmenterEntry {
+                const Segmenter *seg;
+                std::string name;
+            };
+            struct ReassemblerEntry {
+                const Reassembler *reas;
+                std::string name;
+            };
+            // protects registrations against a concurrent scrape
+            mutable boost::mutex registryMtx;
+            std::vector<SegmenterEntry> segmenters;
+            std::vector<ReassemblerEntry> reassemblers;
+
+            // how often the server thread checks for the stop signal
+            static constexpr long ACCEPT_POLL_MS{100};
+            // longest request we are willing to read
+            static constexpr size_t MAX_REQUEST_SIZE{8192};
+            // how long a client has to send its request
+            static constexpr long REQUEST_TIMEOUT_MS{1000};
+
+            /**
+             * HTTP server thread state
+             */
+            struct ServerThreadState {
+                MetricsExporter &exp;
+                boost::thread threadObj;
+                int socketFd{-1};
+
+                ServerThreadState(MetricsExporter &e): exp{e} {}
+
+                // open and bind the listening socket
+                result<int> _open() noexcept;
+                // close the listening socket
+                void _close() noexcept;
+                // accept and answer requests until stopped
+                void _threadBody();
+                // read one request and respond to it
+                void _serve(int clientFd);
+            };
+            friend struct ServerThreadState;
+            ServerThreadState serverThreadState;
+
+            std::atomic<bool> threadsStop{false};
+            bool running{false};
+
+        public:
+            /**
+             * Create the exporter. Nothing is opened until start() is called.
+             * @param addr - address to listen on (e.g. 127.0.0.1 or 0.0.0.0)
+             * @param port - TCP port to listen on, 0 picks an ephemeral port (see getPort())
+             */
+            MetricsExporter(const boost::asio::ip::address &addr, u_int16_t port);
+            MetricsExporter(const MetricsExporter &) = delete;
+            MetricsExporter & operator=(const MetricsExporter &) = delete;
+            ~MetricsExporter();
+
+            /**
+             * Register a Segmenter whose metrics will be published with name="<name>" label
+             * @param seg - Segmenter (must outlive the exporter)
+             * @param name - value of the name label distinguishing it from others
+             * @return - 0 on success or E2SARErrorc::ParameterError if the name is already in use
+             */
+            result<int> addSegmenter(const Segmenter &seg, const std::string &name) noexcept;
+
+            /**
+             * Register a Reassembler whose metrics will be published with name="<name>" label
+             * @param reas - Reassembler (must outlive the exporter)
+             * @param name - value of the name label distinguishing it from others
+             * @return - 0 on success or E2SARErrorc::ParameterError if the name is already in use
+             */
+            result<int> addReassembler(const Reassembler &reas, const std::string &name) noexcept;
+
+            /**
+             * Open the listening socket and start the server thread
+             * @return - 0 on success or E2SARErrorc::SocketError
+             */
+            result<int> start() noexcept;
+
+            /**
+             * Stop the server thread and close the listening socket. Safe to call more than once.
+             */
+            void stop() noexcept;
+
+            /**
+             * Render all metrics of registered objects in OpenMetrics text format
+             * (this is what a GET /metrics returns). Not noexcept - building the text allocates
+             * and may throw std::bad_alloc
+             */
+            const std::string render() const;
+
+            /**
+             * Get the port the exporter listens on (useful if constructed with port 0)
+             */
+            inline u_int16_t getPort() const noexcept
+            {
+                return listenPort;
+            }
+
+            /**
+             * Content type of the rendered exposition
+             */
+            static constexpr const char *CONTENT_TYPE{"application/openmetrics-text; version=1.0.0; charset=utf-8"};
+    };
+}
+#endif
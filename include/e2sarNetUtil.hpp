@@ -53,6 +53,13 @@ namespace e2sar
 
 #endif
         static result<int> getSocketOutstandingBytes(int sockfd) noexcept;
+
+        /**
+         * Get host-wide UDP socket buffer error counters from /proc/net/snmp (Linux only), i.e.
+         * datagrams dropped because a receive buffer was full and sends that failed for lack of send buffer
+         * @return a tuple of <RcvbufErrors, SndbufErrors> or E2SARErrorc::SystemError if not available
+         */
+        static result<boost::tuple<u_int64_t, u_int64_t>> getUDPBufferErrors() noexcept;
     };
 }
 #endif
@@ -0,0 +1,39 @@
+#ifndef E2SARPROBESHPP
+#define E2SARPROBESHPP
+
+/***
+ * USDT static tracepoints in the Segmenter and Reassembler hot paths and the control
+ * plane client (provider 'e2sar').
+ * Built in when meson finds sys/sdt.h (-Dusdt=enabled|disabled|auto), otherwise they
+ * compile to nothing. An unattached probe is a single nop, e.g.
+ *
+ *   bpftrace -e 'usdt:/path/to/binary:e2sar:reas_event_completed { @ns = hist(arg4); }'
+ *
+ * Probes and their arguments:
+ * - seg_event_enqueued(eventNum, dataId, bytes, queueDepth) - addToSendQueue()
+ * - seg_event_dequeued(eventNum, dataId, bytes, queuedNs) - send thread took the event off the queue
+ * - seg_fragment_sent(eventNum, dataId, offset, length) - fragment handed to the send call
+ * - reas_fragment_received(eventNum, dataId, offset, length) - valid fragment received
+ * - reas_event_completed(eventNum, dataId, bytes, numFragments, assemblyNs) - event reassembled
+ * - reas_event_expired(eventNum, dataId, curBytes, bytes, numFragments) - GC gave up on an event
+ * - reas_enqueue_loss(eventNum, dataId, bytes) - reassembled event dropped, queue full
+ * - reas_sendstate_start(fillPercent x 1e6, controlSignal x 1e6) - sendState update handed to LBManager
+ * - cp_sendstate_end(errorCode, durationNs) - LBManager::sendStateAsync() RPC completed (for any caller, not only
+ *   the Reassembler), fires on a gRPC thread (errorCode 0 on success)
+ */
+
+#ifdef USDT_AVAILABLE
+#include <sys/sdt.h>
+
+#define E2SAR_PROBE2(name, a1, a2) DTRACE_PROBE2(e2sar, name, a1, a2)
+#define E2SAR_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(e2sar, name, a1, a2, a3)
+#define E2SAR_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(e2sar, name, a1, a2, a3, a4)
+#define E2SAR_PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(e2sar, name, a1, a2, a3, a4, a5)
+#else
+#define E2SAR_PROBE2(name, a1, a2) do {} while(0)
+#define E2SAR_PROBE3(name, a1, a2, a3) do {} while(0)
+#define E2SAR_PROBE4(name, a1, a2, a3, a4) do {} while(0)
+#define E2SAR_PROBE5(name, a1, a2, a3, a4, a5) do {} while(0)
+#endif
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef E2SARTRACEHPP
+#define E2SARTRACEHPP
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "e2sarError.hpp"
+#include "e2sarHeaders.hpp"
+#include "e2sarUtil.hpp"
+
+/***
+ * Binary trace rings recording recent fragment activity of Segmenter and Reassembler
+ * for post-mortem analysis
+*/
+
+namespace e2sar
+{
+    /**
+     * What happened to a fragment or an event in a trace record
+     */
+    enum class TraceAction: u_int8_t {
+        none = 0,
+        // Segmenter
+        segEventDequeued = 1,   // event taken off the send queue (length - event size)
+        segFragmentSent = 2,    // fragment handed to the send call (offset, length of payload)
+        segEventSent = 3,       // all fragments of an event handed off (aux - number of fragments)
+        segSendError = 4,       // send failed (aux - errno)
+        // Reassembler
+        reasFragmentReceived = 16,  // fragment received (offset, length of payload)
+        reasEventStarted = 17,      // new event started (length - event size)
+        reasEventCompleted = 18,    // event reassembled (aux - number of fragments)
+        reasEnqueueLoss = 19,       // completed event dropped because the queue is full
+        reasBadHeader = 20,         // runt or invalid RE header discarded (length - datagram size)
+        reasKernelDrop = 21,        // kernel dropped datagrams on a socket (offset - UDP port, aux - newly dropped)
+        reasEventExpired = 22,      // event timed out in reassembly (offset - bytes received, aux - fragments)
+    };
+
+    /**
+     * Printable name of a trace action
+     */
+    std::string traceActionName(TraceAction a) noexcept;
+
+    /**
+     * Timestamp for trace records - raw TSCClock ticks. The tick rate is
+     * recorded when the trace is written out (see TraceFile).
+     */
+    inline u_int64_t traceTimestamp() noexcept
+    {
+        return TSCClock::ticks();
+    }
+
+    /**
+     * Fixed size binary trace record. Written to the trace file as is (host byte order).
+     */
+    struct TraceRecord
+    {
+        u_int64_t tsc{0};
+        EventNum_t eventNum{0};
+        u_int32_t offset{0};
+        u_int32_t length{0};
+        u_int16_t dataId{0};
+        TraceAction action{TraceAction::none};
+        u_int8_t reserved{0};
+        u_int32_t aux{0};
+    };
+    static_assert(sizeof(TraceRecord) == 32, "TraceRecord must be 32 bytes");
+
+    /**
+     * Lock-free ring holding the last RECORDS trace records. Normally written by a single
+     * thread; slots are claimed with an atomic increment, so occasional writes from other
+     * threads are safe too. Recording is always on and costs a timestamp read and a few
+     * relaxed stores. Each slot carries a sequence number (odd while it is being written)
+     * so a snapshot taken while writers are active skips slots that were in flight or 
+     * overwritten during the copy instead of returning torn records.
+     */
+    class TraceRing
+    {
+        public:
+            static constexpr size_t RECORDS{8192};
+
+            TraceRing(): slots{new Slot[RECORDS]} {}
+            TraceRing(const TraceRing &) = delete;
+            TraceRing & operator=(const TraceRing &) = delete;
+
+            /**
+             * Add a record stamped with the current time
+             */
+            inline void record(TraceAction action, EventNum_t eventNum, u_int16_t dataId,
+                u_int32_t offset, u_int32_t length, u_int32_t aux = 0) noexcept
+            {
+                TraceRecord rec;
+                rec.tsc = traceTimestamp();
+                rec.eventNum = eventNum;
+                rec.offset = offset;
+                rec.length = length;
+                rec.dataId = dataId;
+                rec.action = action;
+                rec.aux = aux;
+                u_int64_t words[Slot::WORDS];
+                memcpy(words, &rec, sizeof(rec));
+
+                auto idx = head.fetch_add(1, std::memory_order_relaxed);
+                auto &slot = slots[idx & (RECORDS - 1)];
+                slot.seq.store(2 * idx + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                for(size_t i = 0; i < Slot::WORDS; i++)
+                    slot.words[i].store(words[i], std::memory_order_relaxed);
+                slot.seq.store(2 * idx + 2, std::memory_order_release);
+            }
+
+            /**
+             * Copy of the records currently in the ring, oldest first
+             */
+            std::vector<TraceRecord> snapshot() const noexcept;
+
+            /**
+             * Total number of records ever written (including those overwritten)
+             */
+            inline u_int64_t written() const noexcept
+            {
+                return head.load(std::memory_order_relaxed);
+            }
+
+        private:
+            static_assert((RECORDS & (RECORDS - 1)) == 0, "TraceRing::RECORDS must be a power of 2");
+            // a record stored as atomic words, seq is 2*index+2 of the record it holds
+            // once complete (odd while being written, 0 if never written)
+            struct Slot
+            {
+                static constexpr size_t WORDS{sizeof(TraceRecord) / sizeof(u_int64_t)};
+                std::atomic<u_int64_t> seq{0};
+                std::atomic<u_int64_t> words[WORDS];
+            };
+            std::unique_ptr<Slot[]> slots;
+            std::atomic<u_int64_t> head{0};
+    };
+
+    /**
+     * Reading and writing trace dumps. The file starts with a header giving the measured
+     * tick rate of traceTimestamp() and a reference tick/wall-clock pair so records can
+     * be placed in real time, followed by a name and the records of each ring.
+     */
+    class TraceFile
+    {
+        public:
+            static constexpr u_int64_t MAGIC{0x45325341525452ULL}; // "E2SARTR"
+            static constexpr u_int32_t VERSION{1};
+
+            /**
+             * Records of one ring
+             */
+            struct Ring
+            {
+                std::string name;
+                u_int64_t written{0};
+                std::vector<TraceRecord> records;
+            };
+
+            /**
+             * Contents of a trace dump
+             * - ticksPerSec - measured rate of record timestamps
+             * - refTicks, refEpochNs - timestamp and UNIX epoch nanoseconds taken at the same moment
+             */
+            struct Contents
+            {
+                double ticksPerSec{1e9};
+                u_int64_t refTicks{0};
+                int64_t refEpochNs{0};
+                std::vector<Ring> rings;
+
+                /**
+                 * Convert a record timestamp into nanoseconds since the UNIX epoch
+                 */
+                inline int64_t toEpochNs(u_int64_t ticks) const noexcept
+                {
+                    return refEpochNs + static_cast<int64_t>(
+                        (static_cast<double>(ticks) - static_cast<double>(refTicks)) * 1e9 / ticksPerSec);
+                }
+            };
+
+            /**
+             * Snapshot the named rings and write them to a file (overwriting it)
+             * @param path - file to write
+             * @param rings - list of <name, ring> pairs
+             * @return - 0 on success or E2SARErrorc::SystemError
+             */
+            static result<int> write(const std::string &path,
+                const std::vector<std::pair<std::string, const TraceRing*>> &rings) noexcept;
+
+            /**
+             * Read a trace dump
+             * @param path - file to read
+             * @return - file contents or E2SARErrorc::NotFound/ParseError
+             */
+            static result<Contents> read(const std::string &path) noexcept;
+    };
+}
+#endif
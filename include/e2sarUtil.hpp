@@ -1,8 +1,16 @@
 #ifndef E2SARUTILHPP
 #define E2SARUTILHPP
 
+#include <time.h>
+
 #include <fstream>
 #include <vector>
+#include <atomic>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <type_traits>
 #include <boost/url.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/asio.hpp>
@@ -587,18 +595,502 @@ namespace e2sar
         return rets;
     }
 
-    // busy wait for a given number of microseconds using high_resolution_clock timepoints
-    inline void busyWaitUsecs(const boost::chrono::steady_clock::time_point &tp, int64_t usecs)
+    /**
+     * Cheap clock source for the hot paths built on the CPU timestamp counter (invariant TSC on x86, 
+     * virtual counter on aarch64). Reading it costs a few ns instead of a vDSO clock_gettime().
+     * The tick rate is calibrated against CLOCK_MONOTONIC_RAW on first use (a few ms) and refined, 
+     * along with the wall clock anchor, from CLOCK_REALTIME about once a second by whichever thread 
+     * notices the anchor is stale, so realtime follows NTP adjustments the way system_clock does.
+     * Where no usable counter exists it falls back to clock_gettime(CLOCK_MONOTONIC).
+     *
+     * TSCClock::steady and TSCClock::system are chrono-compatible clocks that can stand in for
+     * boost::chrono::steady_clock and system_clock. Their time points don't mix with those of the
+     * boost clocks.
+     */
+    class TSCClock
+    {
+        public:
+            // how often (ns) the anchor is refreshed from the system clocks
+            static constexpr int64_t RESYNC_PERIOD_NS{1000000000};
+            // how long the initial rate measurement takes
+            static constexpr int CALIBRATION_MS{5};
+            // largest fraction by which the wall clock is slowed down to absorb CLOCK_REALTIME
+            // moving backwards relative to it (it is never stepped back)
+            static constexpr double MAX_SLEW{0.1};
+
+            /**
+             * Raw counter value
+             */
+            static inline u_int64_t ticks() noexcept
+            {
+                if (state().useCounter)
+                    return rawCounter();
+                struct timespec ts;
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                return static_cast<u_int64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+            }
+
+            /**
+             * Monotonic nanoseconds (arbitrary epoch)
+             */
+            static inline int64_t monotonicNs() noexcept
+            {
+                auto t = ticks();
+                auto a = anchor(t);
+                return a.monoNs + static_cast<int64_t>((static_cast<int64_t>(t - a.ticks)) * a.nsPerTick);
+            }
+
+            /**
+             * Nanoseconds since the UNIX epoch
+             */
+            static inline int64_t realtimeNs() noexcept
+            {
+                auto t = ticks();
+                auto a = anchor(t);
+                return a.realNs + static_cast<int64_t>((static_cast<int64_t>(t - a.ticks)) * a.realNsPerTick);
+            }
+
+            /**
+             * Measured counter rate
+             */
+            static inline double ticksPerSec() noexcept
+            {
+                return 1e9 / state().nsPerTick.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * Convert a counter value to nanoseconds since the UNIX epoch (using the current anchor)
+             */
+            static inline int64_t toRealtimeNs(u_int64_t t) noexcept
+            {
+                auto a = anchor(ticks());
+                return a.realNs + static_cast<int64_t>((static_cast<int64_t>(t - a.ticks)) * a.realNsPerTick);
+            }
+
+            /**
+             * True if the hardware counter is used, false if falling back on clock_gettime()
+             */
+            static inline bool usesCounter() noexcept
+            {
+                return state().useCounter;
+            }
+
+            /**
+             * Refresh the wall clock anchor and the tick rate now
+             */
+            static void resync() noexcept;
+
+            /**
+             * Chrono-compatible monotonic clock
+             */
+            struct steady
+            {
+                typedef boost::chrono::nanoseconds duration;
+                typedef duration::rep rep;
+                typedef duration::period period;
+                typedef boost::chrono::time_point<steady> time_point;
+                static constexpr bool is_steady{true};
+
+                static inline time_point now() noexcept
+                {
+                    return time_point(duration(monotonicNs()));
+                }
+            };
+
+            /**
+             * Chrono-compatible wall clock (time since the UNIX epoch). Follows CLOCK_REALTIME
+             * across resyncs without going backwards: if CLOCK_REALTIME falls behind, this
+             * clock runs up to MAX_SLEW slower until it catches up rather than stepping back.
+             */
+            struct system
+            {
+                typedef boost::chrono::nanoseconds duration;
+                typedef duration::rep rep;
+                typedef duration::period period;
+                typedef boost::chrono::time_point<system> time_point;
+                static constexpr bool is_steady{false};
+
+                static inline time_point now() noexcept
+                {
+                    return time_point(duration(realtimeNs()));
+                }
+            };
+
+        private:
+            // a consistent copy of the anchor
+            struct Anchor
+            {
+                u_int64_t ticks;
+                int64_t monoNs;
+                int64_t realNs;
+                double nsPerTick;
+                double realNsPerTick;
+            };
+
+            // anchor is updated under a sequence lock so readers never block
+            struct State
+            {
+                bool useCounter{false};
+                // calibration start (for refining the rate over a long baseline)
+                u_int64_t calTicks{0};
+                int64_t calRawNs{0};
+                std::atomic<u_int64_t> seq{0};
+                std::atomic<u_int64_t> ticks{0};
+                std::atomic<int64_t> monoNs{0};
+                std::atomic<int64_t> realNs{0};
+                std::atomic<double> nsPerTick{1.0};
+                // rate of the wall clock, below nsPerTick while slewing
+                std::atomic<double> realNsPerTick{1.0};
+                // elects the thread doing the resync
+                std::atomic_flag resyncing = ATOMIC_FLAG_INIT;
+
+                State() noexcept;
+            };
+
+            // take a new anchor and refine the rate (caller must hold resyncing)
+            static void _resync(State &st) noexcept;
+
+            static inline State &state() noexcept
+            {
+                static State s;
+                return s;
+            }
+
+            static inline u_int64_t rawCounter() noexcept
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+                u_int64_t cnt;
+                asm volatile("mrs %0, cntvct_el0" : "=r"(cnt));
+                return cnt;
+#else
+                return 0;
+#endif
+            }
+
+            static inline Anchor anchor(u_int64_t now) noexcept
+            {
+                auto &st = state();
+                Anchor a;
+                while(true)
+                {
+                    auto s1 = st.seq.load(std::memory_order_acquire);
+                    a.ticks = st.ticks.load(std::memory_order_relaxed);
+                    a.monoNs = st.monoNs.load(std::memory_order_relaxed);
+                    a.realNs = st.realNs.load(std::memory_order_relaxed);
+                    a.nsPerTick = st.nsPerTick.load(std::memory_order_relaxed);
+                    a.realNsPerTick = st.realNsPerTick.load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (((s1 & 1) == 0) && (s1 == st.seq.load(std::memory_order_relaxed)))
+                        break;
+                }
+                // stale anchor - refresh it unless somebody else already is
+                if ((static_cast<int64_t>(now - a.ticks) * a.nsPerTick > RESYNC_PERIOD_NS) && 
+                    !st.resyncing.test_and_set(std::memory_order_acquire))
+                {
+                    _resync(st);
+                    st.resyncing.clear(std::memory_order_release);
+                }
+                return a;
+            }
+    };
+
+    // busy wait for a given number of microseconds past a time point of any clock
+    template<typename Clock>
+    inline void busyWaitUsecs(const boost::chrono::time_point<Clock, typename Clock::duration> &tp, int64_t usecs)
     {
         while(true)
         {
             // busy wait checking the clock
-            if (boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::high_resolution_clock::now() 
-                - tp).count() > usecs)
+            if (boost::chrono::duration_cast<boost::chrono::microseconds>(Clock::now() - tp).count() > usecs)
                 break;
         }   
     }
 
+    // assumed size of a cache line, used to pad per-thread counters so threads don't share lines
+    constexpr size_t CACHE_LINE_SIZE{64};
+
+    // small dense index of the calling thread assigned on first use, used to pick
+    // a per-thread shard of statistics counters
+    inline size_t threadShardIndex() noexcept
+    {
+        static std::atomic<size_t> nextIndex{0};
+        thread_local size_t index{nextIndex++};
+        return index;
+    }
+
+    /**
+     * Low overhead log-linear (HDR-style) latency histogram. Values (normally nanoseconds) are
+     * counted in buckets that are SUB_BUCKETS wide linear steps within each power of 2, so the
+     * relative error of any reported value is at most 1/SUB_BUCKETS. Recording is a relaxed atomic
+     * increment, so multiple threads can record while another takes a snapshot. reset() while 
+     * recording is in progress may leave a few in-flight samples behind.
+     */
+    class LatencyHistogram
+    {
+        public:
+            static constexpr size_t SUB_BUCKET_BITS{4};
+            static constexpr size_t SUB_BUCKETS{1 << SUB_BUCKET_BITS};
+            static constexpr size_t NUM_BUCKETS{(64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS};
+
+            /**
+             * Point in time copy of the histogram
+             * - count - number of recorded values
+             * - min, max - smallest and largest recorded value
+             * - mean - mean of recorded values
+             * - counts - per bucket counts (see bucketUpperBound())
+             */
+            struct Snapshot
+            {
+                u_int64_t count{0};
+                u_int64_t min{0};
+                u_int64_t max{0};
+                double mean{0.};
+                std::vector<u_int64_t> counts;
+
+                /**
+                 * Value at or below which the given percentage of recorded values fall 
+                 * (upper bound of the bucket it lands in, capped by max)
+                 * @param p - percentile in [0, 100]
+                 */
+                inline u_int64_t percentile(double p) const noexcept
+                {
+                    if (count == 0)
+                        return 0;
+                    p = std::min(std::max(p, 0.), 100.);
+                    u_int64_t rank = std::max(static_cast<u_int64_t>(std::ceil(p / 100. * count)), 
+                        static_cast<u_int64_t>(1));
+                    u_int64_t seen{0};
+                    for(size_t i = 0; i < counts.size(); i++)
+                    {
+                        seen += counts[i];
+                        if (seen >= rank)
+                            return std::min(bucketUpperBound(i), max);
+                    }
+                    return max;
+                }
+            };
+
+            LatencyHistogram() = default;
+            LatencyHistogram(const LatencyHistogram &) = delete;
+            LatencyHistogram& operator=(const LatencyHistogram &) = delete;
+
+            // bucket a value falls into
+            static inline size_t bucketIndex(u_int64_t v) noexcept
+            {
+                if (v < SUB_BUCKETS)
+                    return v;
+                size_t shift = 63 - __builtin_clzll(v) - SUB_BUCKET_BITS;
+                return (shift + 1) * SUB_BUCKETS + (v >> shift) - SUB_BUCKETS;
+            }
+
+            // largest value that falls into a bucket
+            static inline u_int64_t bucketUpperBound(size_t idx) noexcept
+            {
+                if (idx < SUB_BUCKETS)
+                    return idx;
+                size_t shift = idx / SUB_BUCKETS - 1;
+                u_int64_t top = idx % SUB_BUCKETS + SUB_BUCKETS;
+                return ((top + 1) << shift) - 1;
+            }
+
+            /**
+             * Record a value
+             */
+            inline void record(u_int64_t v) noexcept
+            {
+                buckets[bucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+                total.fetch_add(1, std::memory_order_relaxed);
+                sum.fetch_add(v, std::memory_order_relaxed);
+                auto curMin = minVal.load(std::memory_order_relaxed);
+                while ((v < curMin) && !minVal.compare_exchange_weak(curMin, v, std::memory_order_relaxed));
+                auto curMax = maxVal.load(std::memory_order_relaxed);
+                while ((v > curMax) && !maxVal.compare_exchange_weak(curMax, v, std::memory_order_relaxed));
+            }
+
+            /**
+             * Record the time elapsed between two time points in nanoseconds (negative intervals are recorded as 0)
+             */
+            template<typename TimePoint>
+            inline void recordInterval(const TimePoint &from, const TimePoint &to) noexcept
+            {
+                auto nsec = boost::chrono::duration_cast<boost::chrono::nanoseconds>(to - from).count();
+                record(nsec > 0 ? static_cast<u_int64_t>(nsec) : 0);
+            }
+
+            /**
+             * Get a point in time copy
+             */
+            inline Snapshot snapshot() const noexcept
+            {
+                Snapshot ret;
+                ret.counts.resize(NUM_BUCKETS);
+                for(size_t i = 0; i < NUM_BUCKETS; i++)
+                {
+                    ret.counts[i] = buckets[i].load(std::memory_order_relaxed);
+                    ret.count += ret.counts[i];
+                }
+                if (ret.count > 0)
+                {
+                    ret.min = minVal.load(std::memory_order_relaxed);
+                    ret.max = maxVal.load(std::memory_order_relaxed);
+                    ret.mean = static_cast<double>(sum.load(std::memory_order_relaxed)) / 
+                        total.load(std::memory_order_relaxed);
+                }
+                return ret;
+            }
+
+            /**
+             * Clear all recorded values
+             */
+            inline void reset() noexcept
+            {
+                for(auto &b: buckets)
+                    b.store(0, std::memory_order_relaxed);
+                total.store(0, std::memory_order_relaxed);
+                sum.store(0, std::memory_order_relaxed);
+                minVal.store(std::numeric_limits<u_int64_t>::max(), std::memory_order_relaxed);
+                maxVal.store(0, std::memory_order_relaxed);
+            }
+
+        private:
+            std::array<std::atomic<u_int64_t>, NUM_BUCKETS> buckets{};
+            std::atomic<u_int64_t> total{0};
+            std::atomic<u_int64_t> sum{0};
+            std::atomic<u_int64_t> minVal{std::numeric_limits<u_int64_t>::max()};
+            std::atomic<u_int64_t> maxVal{0};
+    };
+
+    /**
+     * A value of a trivially copyable type published by a single writer under a sequence lock. 
+     * Readers never block the writer and always get a copy that was stored in one piece, they
+     * retry if the writer was updating it while they read. The value is kept in relaxed atomic 
+     * words so there is no data race on the storage itself.
+     */
+    template<typename T>
+    class SeqLocked
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLocked requires a trivially copyable type");
+        static constexpr size_t WORDS{(sizeof(T) + sizeof(u_int64_t) - 1) / sizeof(u_int64_t)};
+
+        public:
+            SeqLocked() noexcept
+            {
+                store(T{});
+            }
+            SeqLocked(const SeqLocked &) = delete;
+            SeqLocked& operator=(const SeqLocked &) = delete;
+
+            /**
+             * Publish a new value (only one thread may store at a time)
+             */
+            inline void store(const T &v) noexcept
+            {
+                u_int64_t buf[WORDS]{};
+                memcpy(buf, &v, sizeof(T));
+                auto s = seq.load(std::memory_order_relaxed);
+                seq.store(s + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                for(size_t i = 0; i < WORDS; i++)
+                    words[i].store(buf[i], std::memory_order_relaxed);
+                seq.store(s + 2, std::memory_order_release);
+            }
+
+            /**
+             * Get a consistent copy of the last stored value
+             */
+            inline T load() const noexcept
+            {
+                u_int64_t buf[WORDS];
+                while(true)
+                {
+                    auto s1 = seq.load(std::memory_order_acquire);
+                    if (s1 & 1)
+                        continue;
+                    for(size_t i = 0; i < WORDS; i++)
+                        buf[i] = words[i].load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (s1 == seq.load(std::memory_order_relaxed))
+                        break;
+                }
+                T ret;
+                memcpy(&ret, buf, sizeof(T));
+                return ret;
+            }
+
+        private:
+            std::atomic<u_int64_t> seq{0};
+            std::array<std::atomic<u_int64_t>, WORDS> words{};
+    };
+
+    /**
+     * Fixed size history of the last N samples written by a single thread (e.g. once a second
+     * by a stats sampler) that any thread can read without locking. Each slot is a SeqLocked
+     * value, a slot overwritten while a reader walks the ring is skipped.
+     */
+    template<typename T, size_t N>
+    class SampleRing
+    {
+        public:
+            SampleRing() = default;
+            SampleRing(const SampleRing &) = delete;
+            SampleRing& operator=(const SampleRing &) = delete;
+
+            /**
+             * Add a sample, overwriting the oldest one when full (single writer)
+             */
+            inline void push(const T &v) noexcept
+            {
+                auto n = written.load(std::memory_order_relaxed);
+                auto &slot = slots[n % N];
+                // mark the slot as being rewritten so readers discard what they see in it
+                slot.index.store(std::numeric_limits<u_int64_t>::max(), std::memory_order_relaxed);
+                slot.value.store(v);
+                slot.index.store(n, std::memory_order_release);
+                written.store(n + 1, std::memory_order_release);
+            }
+
+            /**
+             * Get up to the last n samples, oldest first
+             */
+            inline std::vector<T> last(size_t n) const noexcept
+            {
+                std::vector<T> ret;
+                auto w = written.load(std::memory_order_acquire);
+                n = std::min({n, N, static_cast<size_t>(w)});
+                ret.reserve(n);
+                for(u_int64_t i = w - n; i < w; i++)
+                {
+                    auto &slot = slots[i % N];
+                    if (slot.index.load(std::memory_order_acquire) != i)
+                        continue;
+                    auto v = slot.value.load();
+                    // the writer lapped us on this slot
+                    if (slot.index.load(std::memory_order_acquire) != i)
+                        continue;
+                    ret.push_back(v);
+                }
+                return ret;
+            }
+
+            /**
+             * Number of samples ever pushed
+             */
+            inline u_int64_t count() const noexcept
+            {
+                return written.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct Slot {
+                SeqLocked<T> value;
+                std::atomic<u_int64_t> index{0};
+            };
+            std::array<Slot, N> slots;
+            std::atomic<u_int64_t> written{0};
+    };
+
     using OptimizationsWord = u_int16_t;
     /**
      * This class encompasses the definition, encoding and selection of optimizations
@@ -1,4 +1,10 @@
+#include <iomanip>
+#include <sstream>
+#include <boost/chrono/ceil.hpp>
+#include <boost/uuid/detail/sha1.hpp>
+
 #include "e2sarCP.hpp"
+#include "e2sarProbes.hpp"
 
 using namespace google::protobuf;
 using namespace boost::posix_time;
@@ -58,6 +64,146 @@ using loadbalancer::TokenPermission;
 
 namespace e2sar
 {
+    ChannelCache::State& ChannelCache::state() noexcept
+    {
+        static State s;
+        return s;
+    }
+
+    // SHA-1 of the TLS credentials so that keys (which stay around as long as the
+    // channel does) don't hold on to the private key
+    static std::string credentialsDigest(const grpc::SslCredentialsOptions &opts) noexcept
+    {
+        boost::uuids::detail::sha1 h;
+        for(auto part: {&opts.pem_root_certs, &opts.pem_private_key, &opts.pem_cert_chain})
+        {
+            auto len = part->length();
+            h.process_bytes(&len, sizeof(len));
+            h.process_bytes(part->data(), len);
+        }
+        boost::uuids::detail::sha1::digest_type digest;
+        h.get_digest(digest);
+
+        std::ostringstream os;
+        auto bytes = reinterpret_cast<const unsigned char*>(&digest);
+        for(size_t i = 0; i < sizeof(digest); i++)
+            os << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(bytes[i]);
+        return os.str();
+    }
+
+    std::shared_ptr<grpc::Channel> ChannelCache::createChannel(const std::string &target, bool useTls,
+        bool validateServer, const grpc::SslCredentialsOptions &opts, const KeepaliveOptions &ko) noexcept
+    {
+        grpc::ChannelArguments args;
+        args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, ko.time_ms);
+        args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, ko.timeout_ms);
+        args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, ko.permitWithoutCalls ? 1 : 0);
+
+        if (useTls)
+        {
+            if (!validateServer)
+            {
+                // disable most of server certificate validation
+                grpc::experimental::TlsChannelCredentialsOptions topts;
+                std::shared_ptr<grpc::experimental::NoOpCertificateVerifier> verifier = std::make_shared<grpc::experimental::NoOpCertificateVerifier>();
+                topts.set_verify_server_certs(false);
+                topts.set_check_call_host(false);
+                topts.set_certificate_verifier(verifier);
+                return grpc::CreateCustomChannel(target, grpc::experimental::TlsCredentials(topts), args);
+            }
+            // use provided SSL options
+            return grpc::CreateCustomChannel(target, grpc::SslCredentials(opts), args);
+        }
+        return grpc::CreateCustomChannel(target, grpc::InsecureChannelCredentials(), args);
+    }
+
+    std::shared_ptr<grpc::Channel> ChannelCache::makeChannel(const std::string &target, bool useTls,
+        bool validateServer, const grpc::SslCredentialsOptions &opts) noexcept
+    {
+        return createChannel(target, useTls, validateServer, opts, getKeepalive());
+    }
+
+    std::shared_ptr<grpc::Channel> ChannelCache::getChannel(const std::string &target, bool useTls,
+        bool validateServer, const grpc::SslCredentialsOptions &opts) noexcept
+    {
+        auto &st = state();
+        std::lock_guard<std::mutex> lock(st.mtx);
+
+        std::string key{target + "|"s + std::to_string(st.keepalive.time_ms) + "|"s +
+            std::to_string(st.keepalive.timeout_ms) + "|"s + std::to_string(st.keepalive.permitWithoutCalls)};
+        if (!useTls)
+            key += "|insecure"s;
+        else if (!validateServer)
+            key += "|tls-novalidate"s;
+        else
+            key += "|tls|"s + credentialsDigest(opts);
+
+        // forget channels nobody uses anymore
+        for(auto it = st.channels.begin(); it != st.channels.end(); )
+        {
+            if (it->second.expired())
+                it = st.channels.erase(it);
+            else
+                ++it;
+        }
+
+        auto it = st.channels.find(key);
+        if (it != st.channels.end())
+        {
+            auto ch = it->second.lock();
+            if (ch)
+            {
+                st.stats.hits++;
+                return ch;
+            }
+        }
+        // channels connect lazily, so creating one under the lock is cheap
+        auto ch = createChannel(target, useTls, validateServer, opts, st.keepalive);
+        st.channels[key] = ch;
+        st.stats.misses++;
+        return ch;
+    }
+
+    void ChannelCache::setKeepalive(const KeepaliveOptions &ko) noexcept
+    {
+        auto &st = state();
+        std::lock_guard<std::mutex> lock(st.mtx);
+        st.keepalive = ko;
+    }
+
+    ChannelCache::KeepaliveOptions ChannelCache::getKeepalive() noexcept
+    {
+        auto &st = state();
+        std::lock_guard<std::mutex> lock(st.mtx);
+        return st.keepalive;
+    }
+
+    void ChannelCache::setEnabled(bool e) noexcept
+    {
+        auto &st = state();
+        std::lock_guard<std::mutex> lock(st.mtx);
+        st.enabled = e;
+    }
+
+    bool ChannelCache::isEnabled() noexcept
+    {
+        auto &st = state();
+        std::lock_guard<std::mutex> lock(st.mtx);
+        return st.enabled;
+    }
+
+    ChannelCache::CacheStats ChannelCache::getStats() noexcept
+    {
+        auto &st = state();
+        std::lock_guard<std::mutex> lock(st.mtx);
+        CacheStats ret{st.stats};
+        ret.active = 0;
+        for(auto &[key, ch]: st.channels)
+            if (!ch.expired())
+                ret.active++;
+        return ret;
+    }
+
     // reserve load balancer
     result<u_int32_t> LBManager::reserveLB(const std::string &lb_name,
                                      const TimeUntil &until,
@@ -507,15 +653,11 @@ namespace e2sar
         return 0;
     }
 
-    // send worker queue state with explicit timestamp and attach stats
-    result<int> LBManager::sendState(float fill_percent, float control_signal, bool is_ready, const Timestamp &ts,
-        const WorkerStats &stats ) noexcept 
+    // fill in the SendState request and the authorization header
+    result<int> LBManager::makeSendStateRequest(ClientContext &context, SendStateRequest &req,
+        float fill_percent, float control_signal, bool is_ready, const Timestamp &ts,
+        const WorkerStats &stats) noexcept
     {
-        // we only need lb id from the URI
-        ClientContext context;
-        SendStateRequest req;
-        SendStateReply rep;
-
         // NOTE: This uses session token
         auto sessionToken = _cpuri.get_SessionToken();
         if (!sessionToken.has_error())
@@ -553,6 +695,21 @@ namespace e2sar
 
         // Timestamp type is weird. 'Nuf said.
         req.mutable_timestamp()->CopyFrom(ts);
+        return 0;
+    }
+
+    // send worker queue state with explicit timestamp and attach stats
+    result<int> LBManager::sendState(float fill_percent, float control_signal, bool is_ready, const Timestamp &ts,
+        const WorkerStats &stats ) noexcept 
+    {
+        // we only need lb id from the URI
+        ClientContext context;
+        SendStateRequest req;
+        SendStateReply rep;
+
+        auto res = makeSendStateRequest(context, req, fill_percent, control_signal, is_ready, ts, stats);
+        if (res.has_error())
+            return res.error();
 
         // make the RPC call
         Status status = _stub->SendState(&context, req, &rep);
@@ -591,6 +748,201 @@ namespace e2sar
         return sendState(fill_percent, control_signal, is_ready, ts, stats);
     }
 
+    // send worker queue state without blocking, using local time and attaching stats
+    result<int> LBManager::sendStateAsync(float fill_percent, float control_signal, bool is_ready,
+        const WorkerStats &stats, u_int32_t deadline_ms) noexcept
+    {
+        auto call = std::make_unique<SendStateCall>();
+        auto res = makeSendStateRequest(call->context, call->req, fill_percent, control_signal, is_ready,
+            util::TimeUtil::TimeTToTimestamp(to_time_t(second_clock::universal_time())), stats);
+        if (res.has_error())
+            return res.error();
+        call->deadline_ms = deadline_ms;
+
+        auto &as = *_asyncState;
+        std::shared_ptr<SendStateCall> c;
+        {
+            std::lock_guard<std::mutex> lock(as.mtx);
+            // a newer sample supersedes the one waiting to be sent
+            if (as.pending)
+                as.coalesced++;
+            as.pending.reset();
+            if ((as.inFlight != nullptr) || (boost::chrono::steady_clock::now() < as.retryAfter))
+            {
+                as.pending = std::move(call);
+                return 1;
+            }
+            as.prepare(*call);
+            as.inFlight = std::move(call);
+            c = as.inFlight;
+        }
+        as.start(std::move(c));
+        return 0;
+    }
+
+    result<int> LBManager::setSendStateBackoff(u_int32_t min_ms, u_int32_t max_ms) noexcept
+    {
+        if ((min_ms == 0) || (max_ms < min_ms))
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Backoff bounds must satisfy 0 < min_ms <= max_ms"};
+        auto &as = *_asyncState;
+        std::lock_guard<std::mutex> lock(as.mtx);
+        as.backoffMin_ms = min_ms;
+        as.backoffMax_ms = max_ms;
+        return 0;
+    }
+
+    SendStateStats LBManager::getSendStateStats() const noexcept
+    {
+        auto &as = *_asyncState;
+        SendStateStats ret;
+        {
+            std::lock_guard<std::mutex> lock(as.mtx);
+            ret.sent = as.sent;
+            ret.completed = as.completed;
+            ret.failed = as.failed;
+            ret.deadlineExceeded = as.deadlineExceeded;
+            ret.coalesced = as.coalesced;
+            ret.inFlight = (as.inFlight != nullptr);
+            auto nowT = boost::chrono::steady_clock::now();
+            // rounded up so that 0 means the next sample is sent right away
+            if (nowT < as.retryAfter)
+                ret.backoff_ms = boost::chrono::ceil<boost::chrono::milliseconds>(as.retryAfter - nowT).count();
+            ret.lastError = as.lastError;
+        }
+        ret.rpcLatency = as.rpcLatency.snapshot();
+        return ret;
+    }
+
+    u_int64_t LBManager::getSendStateFailures() const noexcept
+    {
+        auto &as = *_asyncState;
+        std::lock_guard<std::mutex> lock(as.mtx);
+        return as.failed;
+    }
+
+    LBManager::AsyncSendState::~AsyncSendState()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        stopping = true;
+        pending.reset();
+        // cancel without holding the lock (TryCancel may run the completion inline),
+        // the copy keeps the call alive until then. The completion of a cancelled 
+        // call still runs, wait for it. Same for the handler of a cancelled alarm
+        if (auto call = inFlight)
+        {
+            lock.unlock();
+            call->context.TryCancel();
+            lock.lock();
+        }
+        if (alarmArmed)
+        {
+            lock.unlock();
+            flushAlarm->Cancel();
+            lock.lock();
+        }
+        cv.wait(lock, [this]() { return (inFlight == nullptr) && !alarmArmed; });
+    }
+
+    void LBManager::AsyncSendState::prepare(SendStateCall &call) noexcept
+    {
+        call.context.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(call.deadline_ms));
+        call.startT = boost::chrono::steady_clock::now();
+        sent++;
+    }
+
+    void LBManager::AsyncSendState::start(std::shared_ptr<SendStateCall> call) noexcept
+    {
+        // the completion handler keeps the call alive until it has run
+        auto c = call.get();
+        stub->async()->SendState(&c->context, &c->req, &c->rep,
+            [this, call](grpc::Status status) { complete(call, status); });
+    }
+
+    void LBManager::AsyncSendState::complete(std::shared_ptr<SendStateCall> call, const grpc::Status &status) noexcept
+    {
+        std::shared_ptr<SendStateCall> next;
+        auto nowT = boost::chrono::steady_clock::now();
+
+        rpcLatency.recordInterval(call->startT, nowT);
+        E2SAR_PROBE2(cp_sendstate_end, (status.ok() ? 0 : static_cast<int>(E2SARErrorc::RPCError)),
+            boost::chrono::duration_cast<boost::chrono::nanoseconds>(nowT - call->startT).count());
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            inFlight = nullptr;
+            if (status.ok())
+            {
+                completed++;
+                failures = 0;
+            }
+            else
+            {
+                failed++;
+                if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED)
+                    deadlineExceeded++;
+                lastError = status.error_message();
+                // jittered exponential backoff, the newest sample is sent once it expires
+                failures++;
+                u_int32_t backoff = backoffMax_ms;
+                if (failures <= 16)
+                    backoff = std::min(backoffMax_ms, backoffMin_ms << (failures - 1));
+                std::uniform_int_distribution<u_int32_t> jitter(backoff/2, backoff);
+                retryAfter = nowT + boost::chrono::milliseconds(jitter(rng));
+                // whatever is parked by then is sent when the backoff expires
+                armFlush();
+            }
+            // send the sample that arrived while this call was outstanding, unless backing off
+            if (!stopping && pending && (nowT >= retryAfter))
+            {
+                next = std::move(pending);
+                prepare(*next);
+                inFlight = next;
+            }
+            // notify under the lock, the destructor may free this object as soon as it is released
+            cv.notify_all();
+        }
+        if (next)
+            start(std::move(next));
+    }
+
+    void LBManager::AsyncSendState::armFlush() noexcept
+    {
+        if (stopping || alarmArmed)
+            return;
+        auto wait = boost::chrono::duration_cast<boost::chrono::microseconds>(
+            retryAfter - boost::chrono::steady_clock::now()).count();
+        flushAlarm = std::make_unique<grpc::Alarm>();
+        flushAlarm->Set(std::chrono::system_clock::now() + std::chrono::microseconds(std::max<int64_t>(wait, 0)),
+            [this](bool fired) { flush(fired); });
+        alarmArmed = true;
+    }
+
+    void LBManager::AsyncSendState::flush(bool fired) noexcept
+    {
+        std::shared_ptr<SendStateCall> next;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            alarmArmed = false;
+            // nothing to do if cancelled, already sent by sendStateAsync() or waiting for a call
+            // in flight (its completion sends it)
+            if (fired && !stopping && pending && (inFlight == nullptr))
+            {
+                // a failure since the alarm was armed may have pushed retryAfter out
+                if (boost::chrono::steady_clock::now() < retryAfter)
+                    armFlush();
+                else
+                {
+                    next = std::move(pending);
+                    prepare(*next);
+                    inFlight = next;
+                }
+            }
+            // notify under the lock, the destructor may free this object as soon as it is released
+            cv.notify_all();
+        }
+        if (next)
+            start(std::move(next));
+    }
+
     result<boost::tuple<std::string, std::string, std::string>> LBManager::version() noexcept {
        // we only need lb id from the URI
         ClientContext context;
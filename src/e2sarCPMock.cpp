@@ -0,0 +1,544 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <boost/algorithm/string.hpp>
+#include <google/protobuf/util/time_util.h>
+
+#include "e2sarCPMock.hpp"
+#include "e2sarLBEmu.hpp"
+#include "e2sar.hpp"
+
+using google::protobuf::util::TimeUtil;
+
+namespace e2sar
+{
+    // tokens handed out for reservations and sessions, unguessable so that a client
+    // can only use the ones it was given
+    static std::string makeToken(const std::string &prefix) noexcept
+    {
+        thread_local std::mt19937_64 rng{std::random_device{}()};
+        std::ostringstream os;
+        os << prefix << std::hex << rng() << rng();
+        return os.str();
+    }
+
+    LBMockServer::LBMockServer(boost::asio::ip::address listen_addr, u_int16_t listen_port,
+        const LBMockServerFlags &flags):
+        listenAddr{listen_addr.is_v6() ? "["s + listen_addr.to_string() + "]"s : listen_addr.to_string()},
+        listenPort{listen_port}, adminToken{flags.adminToken}, syncAddr{flags.syncAddr},
+        syncAddrV6{flags.syncAddrV6}, syncPort{flags.syncPort},
+        dataAddrV4{flags.dataAddrV4}, dataAddrV6{flags.dataAddrV6}, maxSamples{flags.maxSamples},
+        latency_ms{flags.latency_ms}, jitter_ms{flags.jitter_ms}, errorRate{flags.errorRate},
+        errorCode{static_cast<int>(flags.errorCode)}, sendStateOnly{flags.sendStateOnly}
+    {
+        if ((flags.errorRate < 0.0) || (flags.errorRate > 1.0))
+            throw E2SARException("LBMockServer error rate must be between 0.0 and 1.0");
+        if (flags.errorCode == grpc::StatusCode::OK)
+            throw E2SARException("LBMockServer error code must not be OK");
+        if (flags.adminToken.empty())
+            throw E2SARException("LBMockServer admin token must not be empty");
+    }
+
+    result<int> LBMockServer::openAndStart() noexcept
+    {
+        if (server)
+            return E2SARErrorInfo{E2SARErrorc::LogicError, "Mock server already started"};
+
+        int port{0};
+        grpc::ServerBuilder builder;
+        builder.AddListeningPort(listenAddr + ":"s + std::to_string(listenPort),
+            grpc::InsecureServerCredentials(), &port);
+        builder.RegisterService(this);
+        server = builder.BuildAndStart();
+        if (!server || (port == 0))
+        {
+            server.reset();
+            return E2SARErrorInfo{E2SARErrorc::SocketError, "Unable to listen on "s + listenAddr +
+                ":"s + std::to_string(listenPort)};
+        }
+        boundPort = static_cast<u_int16_t>(port);
+        return 0;
+    }
+
+    void LBMockServer::stop() noexcept
+    {
+        if (!server)
+            return;
+        // calls sleeping in injected latency get cut short by the deadline
+        server->Shutdown(std::chrono::system_clock::now() + std::chrono::milliseconds(100));
+        server->Wait();
+        server.reset();
+    }
+
+    std::string LBMockServer::get_URI() const noexcept
+    {
+        return "ejfat://"s + adminToken + "@"s + listenAddr + ":"s + std::to_string(boundPort) + "/"s;
+    }
+
+    grpc::Status LBMockServer::admit(grpc::ServerContext *ctx, bool isSendState) noexcept
+    {
+        auto md = ctx->client_metadata();
+        auto auth = md.find("authorization");
+        std::string header{(auth == md.end()) ? ""s : std::string(auth->second.data(), auth->second.length())};
+        if (!boost::algorithm::starts_with(header, "Bearer "))
+        {
+            stats.authErrors++;
+            return grpc::Status(grpc::StatusCode::UNAUTHENTICATED, "Bearer token missing");
+        }
+
+        auto token = header.substr(7);
+        bool known{token == adminToken};
+        if (!known)
+        {
+            boost::lock_guard<boost::mutex> lock(stateMtx);
+            for(auto r = reservations.begin(); !known && (r != reservations.end()); ++r)
+            {
+                known = (token == r->second.token);
+                for(auto w = r->second.workers.begin(); !known && (w != r->second.workers.end()); ++w)
+                    known = (token == w->second.token);
+            }
+        }
+        if (!known)
+        {
+            stats.authErrors++;
+            return grpc::Status(grpc::StatusCode::UNAUTHENTICATED, "Bearer token not recognized");
+        }
+
+        if (!isSendState && sendStateOnly)
+            return grpc::Status::OK;
+
+        thread_local std::minstd_rand rng{std::random_device{}()};
+
+        u_int32_t delay = latency_ms;
+        u_int32_t jit = jitter_ms;
+        if (jit > 0)
+            delay += std::uniform_int_distribution<u_int32_t>(0, jit)(rng);
+        if (delay > 0)
+        {
+            auto until = std::chrono::system_clock::now() + std::chrono::milliseconds(delay);
+            // sleep in short steps so shutdown and client cancellation are noticed
+            while ((std::chrono::system_clock::now() < until) && !ctx->IsCancelled())
+                std::this_thread::sleep_for(std::min(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    until - std::chrono::system_clock::now()), std::chrono::milliseconds(10)));
+            if (ctx->IsCancelled())
+                return grpc::Status(grpc::StatusCode::CANCELLED, "Call cancelled during injected latency");
+        }
+
+        float rate = errorRate;
+        if ((rate > 0.0) && (std::uniform_real_distribution<float>(0.0, 1.0)(rng) < rate))
+        {
+            stats.injectedErrors++;
+            return grpc::Status(static_cast<grpc::StatusCode>(errorCode.load()), "Injected error");
+        }
+        return grpc::Status::OK;
+    }
+
+    void LBMockServer::fillReservation(const std::string &lbId, const Reservation &r,
+        loadbalancer::ReserveLoadBalancerReply *rep) const noexcept
+    {
+        rep->set_token(r.token);
+        rep->set_lbid(lbId);
+        rep->set_syncipv4address(syncAddr);
+        rep->set_syncipv6address(syncAddrV6);
+        rep->set_syncudpport(syncPort);
+        rep->set_dataipv4address(dataAddrV4);
+        rep->set_dataipv6address(dataAddrV6);
+        rep->set_fpgalbid(r.fpgaLBId);
+        rep->set_dataminport(DATAPLANE_PORT);
+        rep->set_datamaxport(DATAPLANE_PORT);
+    }
+
+    void LBMockServer::fillStatus(const Reservation &r, loadbalancer::LoadBalancerStatusReply *rep) const noexcept
+    {
+        rep->mutable_timestamp()->CopyFrom(TimeUtil::GetCurrentTime());
+        rep->set_currentepoch(r.epoch);
+        rep->set_currentpredictedeventnumber(0);
+        rep->mutable_expiresat()->CopyFrom(r.until);
+        for(auto &s: r.senders)
+            rep->add_senderaddresses(s);
+
+        float totalWeight{0.0};
+        for(auto &[sid, w]: r.workers)
+            totalWeight += w.weight;
+
+        for(auto &[sid, w]: r.workers)
+        {
+            auto ws = rep->add_workers();
+            ws->set_name(w.name);
+            ws->set_fillpercent(w.fillPercent);
+            ws->set_controlsignal(w.controlSignal);
+            ws->set_slotsassigned(totalWeight > 0.0 ?
+                static_cast<u_int32_t>(CALENDAR_SLOTS * w.weight / totalWeight) : 0);
+            ws->mutable_lastupdated()->CopyFrom(w.lastUpdated);
+        }
+    }
+
+    grpc::Status LBMockServer::updateEmulator(const std::string &sessionId, const Worker *w) noexcept
+    {
+        if (emu == nullptr)
+            return grpc::Status::OK;
+
+        result<int> res{0};
+        if (w != nullptr)
+        {
+            auto addrRes = string_to_ip(w->ipAddress);
+            if (addrRes.has_error())
+                return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, addrRes.error().message());
+            res = emu->addWorker(sessionId, addrRes.value(), w->udpPort, w->portRange, w->weight);
+        }
+        else
+            res = emu->removeWorker(sessionId);
+        if (res.has_error())
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, res.error().message());
+
+        // new calendar for everything not yet seen
+        res = emu->newEpoch(emu->get_maxTick() + 1);
+        if (res.has_error())
+            return grpc::Status(grpc::StatusCode::INTERNAL, res.error().message());
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::ReserveLoadBalancer(grpc::ServerContext *ctx,
+        const loadbalancer::ReserveLoadBalancerRequest *req, loadbalancer::ReserveLoadBalancerReply *rep)
+    {
+        stats.reserveCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        if (req->name().empty())
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Reservation name must not be empty");
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto lbId = std::to_string(nextLBId);
+        auto &r = reservations[lbId];
+        r.name = req->name();
+        r.token = makeToken("mock-instance-"s + lbId + "-"s);
+        r.fpgaLBId = static_cast<u_int32_t>(nextLBId++ % 4);
+        r.until.CopyFrom(req->until());
+        r.senders.assign(req->senderaddresses().begin(), req->senderaddresses().end());
+        fillReservation(lbId, r, rep);
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::GetLoadBalancer(grpc::ServerContext *ctx,
+        const loadbalancer::GetLoadBalancerRequest *req, loadbalancer::ReserveLoadBalancerReply *rep)
+    {
+        stats.otherCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto r = reservations.find(req->lbid());
+        if (r == reservations.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such load balancer "s + req->lbid());
+        fillReservation(r->first, r->second, rep);
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::LoadBalancerStatus(grpc::ServerContext *ctx,
+        const loadbalancer::LoadBalancerStatusRequest *req, loadbalancer::LoadBalancerStatusReply *rep)
+    {
+        stats.otherCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto r = reservations.find(req->lbid());
+        if (r == reservations.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such load balancer "s + req->lbid());
+        fillStatus(r->second, rep);
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::Overview(grpc::ServerContext *ctx,
+        const loadbalancer::OverviewRequest *req, loadbalancer::OverviewReply *rep)
+    {
+        stats.otherCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        for(auto &[lbId, r]: reservations)
+        {
+            auto o = rep->add_loadbalancers();
+            o->set_name(r.name);
+            fillReservation(lbId, r, o->mutable_reservation());
+            fillStatus(r, o->mutable_status());
+        }
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::FreeLoadBalancer(grpc::ServerContext *ctx,
+        const loadbalancer::FreeLoadBalancerRequest *req, loadbalancer::FreeLoadBalancerReply *rep)
+    {
+        stats.freeCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto r = reservations.find(req->lbid());
+        if (r == reservations.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such load balancer "s + req->lbid());
+        for(auto &[sid, w]: r->second.workers)
+            updateEmulator(sid, nullptr);
+        reservations.erase(r);
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::AddSenders(grpc::ServerContext *ctx,
+        const loadbalancer::AddSendersRequest *req, loadbalancer::AddSendersReply *rep)
+    {
+        stats.otherCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto r = reservations.find(req->lbid());
+        if (r == reservations.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such load balancer "s + req->lbid());
+        for(auto &s: req->senderaddresses())
+            if (std::find(r->second.senders.begin(), r->second.senders.end(), s) == r->second.senders.end())
+                r->second.senders.push_back(s);
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::RemoveSenders(grpc::ServerContext *ctx,
+        const loadbalancer::RemoveSendersRequest *req, loadbalancer::RemoveSendersReply *rep)
+    {
+        stats.otherCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto r = reservations.find(req->lbid());
+        if (r == reservations.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such load balancer "s + req->lbid());
+        auto &senders = r->second.senders;
+        for(auto &s: req->senderaddresses())
+            senders.erase(std::remove(senders.begin(), senders.end(), s), senders.end());
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::Register(grpc::ServerContext *ctx,
+        const loadbalancer::RegisterRequest *req, loadbalancer::RegisterReply *rep)
+    {
+        stats.registerCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        if (req->name().empty() || (req->udpport() == 0) || (req->udpport() > 65535))
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Worker name and a valid port are required");
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto r = reservations.find(req->lbid());
+        if (r == reservations.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such load balancer "s + req->lbid());
+
+        Worker w;
+        w.name = req->name();
+        w.ipAddress = req->ipaddress();
+        w.udpPort = static_cast<u_int16_t>(req->udpport());
+        w.portRange = static_cast<u_int16_t>(req->portrange());
+        w.weight = req->weight();
+        w.lastUpdated.CopyFrom(TimeUtil::GetCurrentTime());
+
+        auto sessionId = std::to_string(nextSessionId++);
+        w.token = makeToken("mock-session-"s + sessionId + "-"s);
+        status = updateEmulator(sessionId, &w);
+        if (!status.ok())
+            return status;
+
+        rep->set_token(w.token);
+        r->second.workers.emplace(sessionId, std::move(w));
+        r->second.epoch++;
+        rep->set_sessionid(sessionId);
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::Deregister(grpc::ServerContext *ctx,
+        const loadbalancer::DeregisterRequest *req, loadbalancer::DeregisterReply *rep)
+    {
+        stats.deregisterCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto r = reservations.find(req->lbid());
+        if (r == reservations.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such load balancer "s + req->lbid());
+        auto w = r->second.workers.find(req->sessionid());
+        if (w == r->second.workers.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such session "s + req->sessionid());
+
+        updateEmulator(w->first, nullptr);
+        r->second.workers.erase(w);
+        r->second.epoch++;
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::SendState(grpc::ServerContext *ctx,
+        const loadbalancer::SendStateRequest *req, loadbalancer::SendStateReply *rep)
+    {
+        stats.sendStateCalls++;
+        auto status = admit(ctx, true);
+        if (!status.ok())
+            return status;
+
+        auto now = TimeUtil::GetCurrentTime();
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        auto r = reservations.find(req->lbid());
+        if (r == reservations.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such load balancer "s + req->lbid());
+        auto w = r->second.workers.find(req->sessionid());
+        if (w == r->second.workers.end())
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such session "s + req->sessionid());
+
+        w->second.fillPercent = req->fillpercent();
+        w->second.controlSignal = req->controlsignal();
+        w->second.isReady = req->isready();
+        w->second.lastUpdated.CopyFrom(now);
+
+        if (maxSamples > 0)
+        {
+            if (samples.size() >= maxSamples)
+            {
+                samples.pop_front();
+                stats.droppedSamples++;
+            }
+            samples.push_back(SendStateSample{req->lbid(), req->sessionid(), req->fillpercent(),
+                req->controlsignal(), req->isready(), req->totaleventsrecv(), req->totaleventsreassembled(),
+                TimeUtil::TimestampToMilliseconds(req->timestamp()), TimeUtil::TimestampToMilliseconds(now)});
+        }
+        return grpc::Status::OK;
+    }
+
+    grpc::Status LBMockServer::Version(grpc::ServerContext *ctx,
+        const loadbalancer::VersionRequest *req, loadbalancer::VersionReply *rep)
+    {
+        stats.otherCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        rep->set_commit("mock");
+        rep->set_build(get_Version());
+        rep->set_compattag("mock");
+        return grpc::Status::OK;
+    }
+
+    // selectors are /lb/<lbid>/session/<sessionid>/<metric> where lbid, sessionid and metric
+    // may be '*' and a trailing '/*' matches everything below, e.g. /lb/1/* or /lb/1/session/2/fillPercent.
+    // Float series are fillPercent and controlSignal, integer series are totalEventsRecv and
+    // totalEventsReassembled, all built from the recorded SendState samples.
+    grpc::Status LBMockServer::Timeseries(grpc::ServerContext *ctx,
+        const loadbalancer::TimeseriesRequest *req, loadbalancer::TimeseriesResponse *rep)
+    {
+        stats.otherCalls++;
+        auto status = admit(ctx, false);
+        if (!status.ok())
+            return status;
+
+        static const std::vector<std::string> metrics{"fillPercent", "controlSignal",
+            "totalEventsRecv", "totalEventsReassembled"};
+        auto sinceMs = TimeUtil::TimestampToMilliseconds(req->since());
+        rep->mutable_since()->CopyFrom(req->since());
+
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        for(auto &sel: req->seriesselector())
+        {
+            // path components after the leading '/', missing trailing components match anything
+            std::vector<std::string> parts;
+            auto trimmed = boost::algorithm::trim_copy_if(sel, boost::is_any_of("/"));
+            boost::split(parts, trimmed, boost::is_any_of("/"));
+            if ((parts.size() < 2) || (parts[0] != "lb"))
+                return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Unsupported series selector "s + sel);
+            bool trailingStar = (parts.back() == "*");
+            auto matches = [&parts, trailingStar](size_t idx, const std::string &v) {
+                if (idx >= parts.size())
+                    return trailingStar;
+                if ((idx == parts.size() - 1) && trailingStar)
+                    return true;
+                return (parts[idx] == "*") || (parts[idx] == v);
+            };
+
+            for(auto &[lbId, r]: reservations)
+            {
+                if (!matches(1, lbId) || ((parts.size() > 2) && !matches(2, "session")))
+                    continue;
+                for(auto &[sid, w]: r.workers)
+                {
+                    if (!matches(3, sid))
+                        continue;
+                    for(size_t m = 0; m < metrics.size(); m++)
+                    {
+                        if (!matches(4, metrics[m]))
+                            continue;
+                        auto ts = rep->add_timeseries();
+                        ts->set_name("/lb/"s + lbId + "/session/"s + sid + "/"s + metrics[m]);
+                        bool isFloat = (m < 2);
+                        ts->set_unit(isFloat ? "" : "count");
+                        if (isFloat)
+                            ts->mutable_float_samples();
+                        else
+                            ts->mutable_integer_samples();
+                        for(auto &s: samples)
+                        {
+                            if ((s.lbId != lbId) || (s.sessionId != sid) || (s.received_ms < sinceMs))
+                                continue;
+                            if (isFloat)
+                            {
+                                auto fs = ts->mutable_float_samples()->add_data();
+                                fs->set_timestamp(s.received_ms);
+                                fs->set_value(m == 0 ? s.fillPercent : s.controlSignal);
+                            }
+                            else
+                            {
+                                auto is = ts->mutable_integer_samples()->add_data();
+                                is->set_timestamp(s.received_ms);
+                                is->set_value(m == 2 ? s.totalEventsRecv : s.totalEventsReassembled);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return grpc::Status::OK;
+    }
+
+    std::vector<LBMockServer::SendStateSample> LBMockServer::getSendStateSamples(const std::string &sessionId) const noexcept
+    {
+        std::vector<SendStateSample> ret;
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        for(auto &s: samples)
+            if (sessionId.empty() || (s.sessionId == sessionId))
+                ret.push_back(s);
+        return ret;
+    }
+
+    void LBMockServer::clearSendStateSamples() noexcept
+    {
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        samples.clear();
+    }
+
+    size_t LBMockServer::get_numWorkers() const noexcept
+    {
+        size_t ret{0};
+        boost::lock_guard<boost::mutex> lock(stateMtx);
+        for(auto &[lbId, r]: reservations)
+            ret += r.workers.size();
+        return ret;
+    }
+}
@@ -4,10 +4,15 @@
 #include <boost/property_tree/detail/file_parser_error.hpp>
 #include <iostream>
 
+#ifdef UDP_GRO_AVAILABLE
+#include <netinet/udp.h>
+#endif
+
 #include "portable_endian.h"
 
 #include "e2sarAffinity.hpp"
 #include "e2sarDPReassembler.hpp"
+#include "e2sarProbes.hpp"
 
 
 namespace e2sar 
@@ -38,12 +43,13 @@ namespace e2sar
         std::vector<int> cpuCoreList,
         const ReassemblerFlags &rflags):
         dpuri(uri),
-        lbman(dpuri, rflags.validateCert, rflags.useHostAddress),
         epochMs{rflags.epoch_ms}, setPoint{rflags.setPoint}, 
         Kp{rflags.Kp}, Ki{rflags.Ki}, Kd{rflags.Kd},
         weight{rflags.weight}, min_factor{rflags.min_factor}, max_factor{rflags.max_factor},
-        pidSampleBuffer(rflags.epoch_ms/rflags.period_ms), // ring buffer size (usually 10 = 1sec/100ms)
+        pidSampleDepth{rflags.epoch_ms/rflags.period_ms}, // ring buffer size (usually 10 = 1sec/100ms)
+        validateCert{rflags.validateCert}, useHostAddress{rflags.useHostAddress},
         gcThreadState(*this),
+        samplerThreadState(*this),
         cpuCoreList{cpuCoreList}, 
         dataIP{data_ip},
         dataPort{starting_port},
@@ -53,31 +59,40 @@ namespace e2sar
         threadsToPorts(numRecvThreads),
         withLBHeader{rflags.withLBHeader},
         eventTimeout_ms{rflags.eventTimeout_ms},
+        adaptiveTimeout{rflags.adaptiveTimeout},
+        adaptiveTimeoutMult{rflags.adaptiveTimeoutMult},
         rcvSocketBufSize{rflags.rcvSocketBufSize},
-        sendStateThreadState(*this, rflags.period_ms),
+        useGRO{rflags.useGRO},
+        recvBufferSize{rflags.useGRO ? MAX_RECV_BUFFER_SIZE : rflags.recvBufferSize},
+        busyPoll{rflags.busyPoll},
+        busyPoll_us{rflags.busyPoll_us},
+        spinBudget_us{rflags.spinBudget_us},
+        dropBackoff{rflags.dropBackoff},
+        drainControl{rflags.drainControl},
+        eventQueueLimit{rflags.eventQueueLimit},
+        sendStateThreadState(*this, rflags.period_ms, rflags.sendStateDeadline_ms),
         useCP{rflags.useCP},
-        reportStats{rflags.reportStats}
+        reportStats{rflags.reportStats},
+        trackSequence{rflags.trackSequence},
+        perDataIdStats{rflags.perDataIdStats}
     {
         sanityChecks();
         auto afres = Affinity::setProcess(cpuCoreList);
         if (afres.has_error())
             throw E2SARException(afres.error().message());
-        // note if the user chooses to override portRange in rflags, 
-        // we can end up in a silly situation where the number of receive ports is smaller
-        // than the number of receive threads, but we handle it
-        // Need to break up M ports into at most N bins.
-        assignPortsToThreads();
+        initPrimarySession();
     }
 
     Reassembler::Reassembler(const EjfatURI &uri,  ip::address data_ip, u_int16_t starting_port,
         size_t numRecvThreads, const ReassemblerFlags &rflags):
         dpuri(uri),
-        lbman(dpuri, rflags.validateCert, rflags.useHostAddress),
         epochMs{rflags.epoch_ms}, setPoint{rflags.setPoint}, 
         Kp{rflags.Kp}, Ki{rflags.Ki}, Kd{rflags.Kd},
         weight{rflags.weight}, min_factor{rflags.min_factor}, max_factor{rflags.max_factor},
-        pidSampleBuffer(rflags.epoch_ms/rflags.period_ms), // ring buffer size (usually 10 = 1sec/100ms)
+        pidSampleDepth{rflags.epoch_ms/rflags.period_ms}, // ring buffer size (usually 10 = 1sec/100ms)
+        validateCert{rflags.validateCert}, useHostAddress{rflags.useHostAddress},
         gcThreadState(*this),
+        samplerThreadState(*this),
         cpuCoreList{std::vector<int>()}, // no core list given
         dataIP{data_ip},
         dataPort{starting_port},
@@ -87,29 +102,38 @@ namespace e2sar
         threadsToPorts(numRecvThreads),
         withLBHeader{rflags.withLBHeader},
         eventTimeout_ms{rflags.eventTimeout_ms},
+        adaptiveTimeout{rflags.adaptiveTimeout},
+        adaptiveTimeoutMult{rflags.adaptiveTimeoutMult},
         rcvSocketBufSize{rflags.rcvSocketBufSize},
-        sendStateThreadState(*this, rflags.period_ms),
+        useGRO{rflags.useGRO},
+        recvBufferSize{rflags.useGRO ? MAX_RECV_BUFFER_SIZE : rflags.recvBufferSize},
+        busyPoll{rflags.busyPoll},
+        busyPoll_us{rflags.busyPoll_us},
+        spinBudget_us{rflags.spinBudget_us},
+        dropBackoff{rflags.dropBackoff},
+        drainControl{rflags.drainControl},
+        eventQueueLimit{rflags.eventQueueLimit},
+        sendStateThreadState(*this, rflags.period_ms, rflags.sendStateDeadline_ms),
         useCP{rflags.useCP},
-        reportStats{rflags.reportStats}
+        reportStats{rflags.reportStats},
+        trackSequence{rflags.trackSequence},
+        perDataIdStats{rflags.perDataIdStats}
     {
         sanityChecks();
-        // note if the user chooses to override portRange in rflags, 
-        // we can end up in a silly situation where the number of receive ports is smaller
-        // than the number of receive threads, but we handle it
-        // Need to break up M ports into at most N bins.
-        assignPortsToThreads();
+        initPrimarySession();
     }
 
     Reassembler::Reassembler(const EjfatURI &uri,  u_int16_t starting_port,
         std::vector<int> cpuCoreList,
         const ReassemblerFlags &rflags, bool v6):
         dpuri(uri),
-        lbman(dpuri, rflags.validateCert, rflags.useHostAddress),
         epochMs{rflags.epoch_ms}, setPoint{rflags.setPoint}, 
         Kp{rflags.Kp}, Ki{rflags.Ki}, Kd{rflags.Kd},
         weight{rflags.weight}, min_factor{rflags.min_factor}, max_factor{rflags.max_factor},
-        pidSampleBuffer(rflags.epoch_ms/rflags.period_ms), // ring buffer size (usually 10 = 1sec/100ms)
+        pidSampleDepth{rflags.epoch_ms/rflags.period_ms}, // ring buffer size (usually 10 = 1sec/100ms)
+        validateCert{rflags.validateCert}, useHostAddress{rflags.useHostAddress},
         gcThreadState(*this),
+        samplerThreadState(*this),
         cpuCoreList{cpuCoreList}, 
         dataPort{starting_port},
         portRange{rflags.portRange != -1 ? rflags.portRange : get_PortRange(cpuCoreList.size())}, 
@@ -118,10 +142,22 @@ namespace e2sar
         threadsToPorts(numRecvThreads),
         withLBHeader{rflags.withLBHeader},
         eventTimeout_ms{rflags.eventTimeout_ms},
+        adaptiveTimeout{rflags.adaptiveTimeout},
+        adaptiveTimeoutMult{rflags.adaptiveTimeoutMult},
         rcvSocketBufSize{rflags.rcvSocketBufSize},
-        sendStateThreadState(*this, rflags.period_ms),
+        useGRO{rflags.useGRO},
+        recvBufferSize{rflags.useGRO ? MAX_RECV_BUFFER_SIZE : rflags.recvBufferSize},
+        busyPoll{rflags.busyPoll},
+        busyPoll_us{rflags.busyPoll_us},
+        spinBudget_us{rflags.spinBudget_us},
+        dropBackoff{rflags.dropBackoff},
+        drainControl{rflags.drainControl},
+        eventQueueLimit{rflags.eventQueueLimit},
+        sendStateThreadState(*this, rflags.period_ms, rflags.sendStateDeadline_ms),
         useCP{rflags.useCP},
-        reportStats{rflags.reportStats}
+        reportStats{rflags.reportStats},
+        trackSequence{rflags.trackSequence},
+        perDataIdStats{rflags.perDataIdStats}
     {
         auto dpRes = dpuri.getDataplaneLocalAddresses(v6);
         if (dpRes.has_error())
@@ -135,22 +171,19 @@ namespace e2sar
         auto afres = Affinity::setProcess(cpuCoreList);
         if (afres.has_error())
             throw E2SARException(afres.error().message());
-        // note if the user chooses to override portRange in rflags, 
-        // we can end up in a silly situation where the number of receive ports is smaller
-        // than the number of receive threads, but we handle it
-        // Need to break up M ports into at most N bins.
-        assignPortsToThreads();
+        initPrimarySession();
     }
 
     Reassembler::Reassembler(const EjfatURI &uri,  u_int16_t starting_port,
         size_t numRecvThreads, const ReassemblerFlags &rflags, bool v6):
         dpuri(uri),
-        lbman(dpuri, rflags.validateCert, rflags.useHostAddress),
         epochMs{rflags.epoch_ms}, setPoint{rflags.setPoint}, 
         Kp{rflags.Kp}, Ki{rflags.Ki}, Kd{rflags.Kd},
         weight{rflags.weight}, min_factor{rflags.min_factor}, max_factor{rflags.max_factor},
-        pidSampleBuffer(rflags.epoch_ms/rflags.period_ms), // ring buffer size (usually 10 = 1sec/100ms)
+        pidSampleDepth{rflags.epoch_ms/rflags.period_ms}, // ring buffer size (usually 10 = 1sec/100ms)
+        validateCert{rflags.validateCert}, useHostAddress{rflags.useHostAddress},
         gcThreadState(*this),
+        samplerThreadState(*this),
         cpuCoreList{std::vector<int>()}, // no core list given
         dataPort{starting_port},
         portRange{rflags.portRange != -1 ? rflags.portRange : get_PortRange(numRecvThreads)}, 
@@ -159,10 +192,22 @@ namespace e2sar
         threadsToPorts(numRecvThreads),
         withLBHeader{rflags.withLBHeader},
         eventTimeout_ms{rflags.eventTimeout_ms},
+        adaptiveTimeout{rflags.adaptiveTimeout},
+        adaptiveTimeoutMult{rflags.adaptiveTimeoutMult},
         rcvSocketBufSize{rflags.rcvSocketBufSize},
-        sendStateThreadState(*this, rflags.period_ms),
+        useGRO{rflags.useGRO},
+        recvBufferSize{rflags.useGRO ? MAX_RECV_BUFFER_SIZE : rflags.recvBufferSize},
+        busyPoll{rflags.busyPoll},
+        busyPoll_us{rflags.busyPoll_us},
+        spinBudget_us{rflags.spinBudget_us},
+        dropBackoff{rflags.dropBackoff},
+        drainControl{rflags.drainControl},
+        eventQueueLimit{rflags.eventQueueLimit},
+        sendStateThreadState(*this, rflags.period_ms, rflags.sendStateDeadline_ms),
         useCP{rflags.useCP},
-        reportStats{rflags.reportStats}
+        reportStats{rflags.reportStats},
+        trackSequence{rflags.trackSequence},
+        perDataIdStats{rflags.perDataIdStats}
     {
         auto dpRes = dpuri.getDataplaneLocalAddresses(v6);
         if (dpRes.has_error())
@@ -173,17 +218,15 @@ namespace e2sar
             
         dataIP = dpRes.value()[0];
         sanityChecks();
-        // note if the user chooses to override portRange in rflags, 
-        // we can end up in a silly situation where the number of receive ports is smaller
-        // than the number of receive threads, but we handle it
-        // Need to break up M ports into at most N bins.
-        assignPortsToThreads();
+        initPrimarySession();
     }
 
 
     result<int> Reassembler::openAndStart() noexcept
     {
-        int maxFDPlusOne{0};
+        // calibrate the clock now rather than when the first fragment arrives
+        TSCClock::ticksPerSec();
+
         // open all file descriptors in all threads
         for(size_t i=0; i<numRecvThreads; i++)
         {
@@ -191,7 +234,7 @@ namespace e2sar
                 threadsToPorts[i].end());
 
             // this constructor uses move semantics for port vector (not for cpu list tho)
-            auto it = recvThreadState.emplace(recvThreadState.end(), *this, 
+            auto it = recvThreadState.emplace(recvThreadState.end(), *this, i,
                 std::move(portVec), cpuCoreList);
 
             // open the sockets for all ports for this thread
@@ -201,13 +244,12 @@ namespace e2sar
                return E2SARErrorInfo{E2SARErrorc::SocketError, 
                     "Unable to open receive sockets: " + open_stat.error().message()};
             }
-            // figure out the largest fd + 1 across all threads
-            maxFDPlusOne = (open_stat.value() > maxFDPlusOne ? open_stat.value() : maxFDPlusOne);
         }
 
-        // create a place for per-fd stats - avoid reallocation
-        recvStats.fragmentsPerFd.resize(maxFDPlusOne);
-        recvStats.fragmentsPerFd.reserve(maxFDPlusOne); 
+        recvThreadsStarted.store(true, std::memory_order_release);
+
+        // baseline for the first rates (not published)
+        samplerThreadState.baseline = samplerThreadState._sample(RateSample{});
 
         // now ready to start threads
         for(auto it = recvThreadState.begin(); it != recvThreadState.end(); ++it)
@@ -222,6 +264,10 @@ namespace e2sar
         boost::thread gcT(&Reassembler::GCThreadState::_threadBody, &gcThreadState);
         gcThreadState.threadObj = std::move(gcT);
 
+        // start the stats sampling thread
+        boost::thread samplerT(&Reassembler::SamplerThreadState::_threadBody, &samplerThreadState);
+        samplerThreadState.threadObj = std::move(samplerT);
+
         // open is not needed for this thread because gRPC
         if (useCP)
         {
@@ -233,9 +279,68 @@ namespace e2sar
         return 0;
     }
 
+    Reassembler::RateSample Reassembler::SamplerThreadState::_sample(const RateSample &prev) noexcept
+    {
+        RateSample cur;
+        auto monoNs = TSCClock::monotonicNs();
+        cur.timestampNs = TSCClock::realtimeNs();
+        cur.eventCnt = reas.recvStats.sum(&AtomicStats::ThreadStats::eventSuccess);
+        cur.packetCnt = reas.recvStats.sum(&AtomicStats::ThreadStats::totalPacketsReceived);
+        cur.byteCnt = reas.recvStats.sum(&AtomicStats::ThreadStats::totalBytesReceived);
+        cur.lossCnt = reas.recvStats.enqueueLoss + reas.recvStats.reassemblyLoss;
+        cur.kernelDrops = reas.recvStats.sum(&AtomicStats::ThreadStats::kernelDrops);
+        for (auto &sess: reas.sessions)
+            cur.queueDepth += sess->eventQueueDepth.load(std::memory_order_relaxed);
+        // rates need a previous sample
+        if (prev.timestampNs > 0)
+        {
+            cur.periodNs = monoNs - lastMonoNs;
+            if (cur.periodNs > 0)
+            {
+                double perSec = 1e9 / cur.periodNs;
+                cur.eventRate = (cur.eventCnt - prev.eventCnt) * perSec;
+                cur.packetRate = (cur.packetCnt - prev.packetCnt) * perSec;
+                cur.byteRate = (cur.byteCnt - prev.byteCnt) * perSec;
+                cur.lossRate = (cur.lossCnt - prev.lossCnt) * perSec;
+                cur.kernelDropRate = (cur.kernelDrops - prev.kernelDrops) * perSec;
+            }
+        }
+        lastMonoNs = monoNs;
+        return cur;
+    }
+
+    void Reassembler::SamplerThreadState::_threadBody()
+    {
+        auto prev = baseline;
+        auto nextT = TSCClock::steady::now() + boost::chrono::milliseconds(SAMPLE_PERIOD_MS);
+        while(!reas.threadsStop)
+        {
+            // sleep in short steps so stopThreads() doesn't wait for a whole period
+            auto nowT = TSCClock::steady::now();
+            if (nowT < nextT)
+            {
+                boost::this_thread::sleep_for(std::min(boost::chrono::milliseconds(100),
+                    boost::chrono::duration_cast<boost::chrono::milliseconds>(nextT - nowT) + 
+                    boost::chrono::milliseconds(1)));
+                continue;
+            }
+            prev = _sample(prev);
+            reas.lastSample.store(prev);
+            reas.sampleHistory.push(prev);
+            nextT += boost::chrono::milliseconds(SAMPLE_PERIOD_MS);
+            // don't try to catch up if we were held up for more than a period
+            if (nextT < nowT)
+                nextT = nowT + boost::chrono::milliseconds(SAMPLE_PERIOD_MS);
+        }
+    }
+
     void Reassembler::GCThreadState::_threadBody()
     {
         auto eventTimeout_ms = boost::chrono::milliseconds(reas.eventTimeout_ms);
+        // scan several times per timeout so events don't linger much past it. With adaptive
+        // timeout the expiration times are much shorter, so scan more often
+        auto scanPeriod_ms = boost::chrono::milliseconds(std::max(1, 
+            reas.eventTimeout_ms / (reas.adaptiveTimeout ? 50 : 4)));
 
         // TODO: move to a more granular affinity setting for main
         // threads and then set this thread to anything other than
@@ -250,50 +355,79 @@ namespace e2sar
 
         while (!reas.threadsStop)
         {
-            auto nowT = boost::chrono::steady_clock::now();
+            auto nowT = TSCClock::steady::now();
+            auto nowUsec = boost::chrono::duration_cast<boost::chrono::microseconds>(nowT.time_since_epoch()).count();
 
             // iterate over threads
             for(auto i = reas.recvThreadState.begin(); i != reas.recvThreadState.end(); ++i)
             {
                 i->evtsInProgressMutex.lock();
-                for (auto it = i->eventsInProgress.begin(); it != i->eventsInProgress.end(); ) {
-                    // we save time by looking at the first segment time of arrival
-                    // this way we avoid querying time on every segment arrival
-                    auto inWaiting = nowT - it->second->firstSegment;
-                    auto inWaiting_ms = boost::chrono::duration_cast<boost::chrono::milliseconds>(inWaiting);
-                    if (inWaiting_ms > eventTimeout_ms) {
+                for (auto &inProgress: i->eventsInProgress)
+                for (auto it = inProgress.begin(); it != inProgress.end(); ) {
+                    bool expired{false};
+                    if (reas.adaptiveTimeout)
+                    {
+                        // time since the last segment compared to what we learned for
+                        // events like this one
+                        expired = (nowUsec - it->second->lastSegmentUsec > 
+                            reas.adaptiveTimeoutUsec(it->second->session, it->second->dataId, it->second->bytes));
+                    }
+                    else
+                    {
+                        // we save time by looking at the first segment time of arrival
+                        // this way we avoid querying time on every segment arrival
+                        auto inWaiting = nowT - it->second->firstSegment;
+                        auto inWaiting_ms = boost::chrono::duration_cast<boost::chrono::milliseconds>(inWaiting);
+                        expired = (inWaiting_ms > eventTimeout_ms);
+                    }
+                    // don't free an event the receive thread is still copying a segment into - it
+                    // holds a reference to it outside the lock, we'll get it on the next scan
+                    if (expired && (it->second.use_count() == 1)) {
+                        trace.record(TraceAction::reasEventExpired, it->second->eventNum, it->second->dataId,
+                            it->second->curBytes, it->second->bytes, it->second->numFragments);
+                        E2SAR_PROBE5(reas_event_expired, it->second->eventNum, it->second->dataId,
+                            it->second->curBytes, it->second->bytes, it->second->numFragments);
                         i->logLostEvent(it->second, false);
                         delete[] it->second->event;
                         // deallocate queue item
                         it->second.reset();
-                        it = i->eventsInProgress.erase(it);  // erase returns the next element (or end())
+                        it = inProgress.erase(it);  // erase returns the next element (or end())
                     } else {
                         ++it;  // Just advance the iterator if no deletion
                     }
                 }
                 i->evtsInProgressMutex.unlock();
             }
-            // sleep approximately for eventTimeout msecs
-            auto until = nowT + boost::chrono::milliseconds(eventTimeout_ms);
+            // sleep until next scan
+            auto until = nowT + scanPeriod_ms;
             boost::this_thread::sleep_until(until);
         }
         // drain in progress queues in threads
         for(auto i = reas.recvThreadState.begin(); i != reas.recvThreadState.end(); ++i) 
         {
-            for (auto it = i->eventsInProgress.begin(); it != i->eventsInProgress.end(); ) {
+            for (auto &inProgress: i->eventsInProgress)
+            for (auto it = inProgress.begin(); it != inProgress.end(); ) {
                 if (it->second->event != nullptr) {
                     delete[] it->second->event;
                     it->second.reset();
                 }
-                it = i->eventsInProgress.erase(it); 
+                it = inProgress.erase(it); 
             }
         }
     }
 
     void Reassembler::RecvThreadState::_threadBody()
     {
+        // spin until the budget runs out without data, then block below until something arrives
+        bool spin{reas.busyPoll};
         while(!reas.threadsStop)
         {
+            if (spin)
+            {
+                _busyPoll();
+                spin = false;
+            }
+
             fd_set curSet{fdSet};
 
             // do select/wait on open sockets
@@ -306,130 +440,325 @@ namespace e2sar
                 continue;
             }
 
+            // data is waiting - go back to spinning, it will pick it up; on a timeout
+            // keep blocking rather than spinning through another budget
+            if (reas.busyPoll)
+            {
+                spin = (select_retval > 0);
+                continue;
+            }
+
             // receive a event fragment on one or more of them
-            for(auto fd: sockets) 
+            for(size_t sockIdx = 0; sockIdx < sockets.size(); sockIdx++) 
             {
+                int fd = sockets[sockIdx];
                 if (!FD_ISSET(fd, &curSet))
                     continue;
 
-                // allocate receive buffer 
-                auto recvBuffer = static_cast<u_int8_t*>(malloc(RECV_BUFFER_SIZE));
+                struct sockaddr_in6 client_addr{};
+                struct iovec iov{recvBuffer.data(), recvBuffer.size()};
+                // room for the UDP_GRO segment size and drop count
+                RecvCtrlBuffer ctrlBuffer;
+                struct msghdr msg{};
+                msg.msg_name = &client_addr;
+                msg.msg_namelen = sizeof(client_addr);
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = ctrlBuffer.buf;
+                msg.msg_controllen = sizeof(ctrlBuffer.buf);
 
-                struct sockaddr_in client_addr{};
-                socklen_t client_addr_len = sizeof(client_addr);
-
-                ssize_t nbytes = recvfrom(fd, recvBuffer, RECV_BUFFER_SIZE, 0,
-                    (struct sockaddr*)&client_addr, &client_addr_len);
+                ssize_t nbytes = recvmsg(fd, &msg, 0);
 
                 if (nbytes == -1) {
                     reas.recvStats.dataErrCnt++;
                     reas.recvStats.lastErrno = errno;
-                    free(recvBuffer);
                     continue;
                 }
-                // count fragment received by socket
-                reas.recvStats.fragmentsPerFd[fd]++;
-                reas.recvStats.totalPacketsReceived++;
-                reas.recvStats.totalBytesReceived += nbytes;
-
-                // start a new event if offset 0 (check for event number collisions)
-                // or attach to existing event
-                REHdr *rehdr{nullptr};
-                // for testing we may leave LB header attached, so it needs to be
-                // subtracted
-                if (reas.withLBHeader)
-                {
-                    rehdr = reinterpret_cast<REHdr*>(recvBuffer + sizeof(LBHdrU));
-                    nbytes -= sizeof(LBHdrU) + sizeof(REHdr);
-                }
-                else
+                _processDatagram(sockIdx, recvBuffer.data(), nbytes, msg);
+            }
+        }
+        if (reas.busyPoll)
+            flushBusyPollStats();
+
+        // close on exit
+        auto res = _close();
+    }
+
+    void Reassembler::RecvThreadState::_busyPoll()
+    {
+#ifdef BUSY_POLL_AVAILABLE
+        const auto budget = boost::chrono::microseconds(reas.spinBudget_us);
+        auto lastData = TSCClock::steady::now();
+
+        while(!reas.threadsStop)
+        {
+            bool gotData{false};
+            for(size_t sockIdx = 0; sockIdx < sockets.size(); sockIdx++)
+            {
+                int fd = sockets[sockIdx];
+                // the kernel overwrites these on every call
+                for(size_t i = 0; i < BUSY_POLL_BATCH; i++)
                 {
-                    rehdr = reinterpret_cast<REHdr*>(recvBuffer);
-                    nbytes -= sizeof(REHdr);
+                    recvBatchMsgs[i].msg_hdr.msg_name = nullptr;
+                    recvBatchMsgs[i].msg_hdr.msg_namelen = 0;
+                    recvBatchMsgs[i].msg_hdr.msg_control = recvBatchCtrl[i].buf;
+                    recvBatchMsgs[i].msg_hdr.msg_controllen = sizeof(recvBatchCtrl[i].buf);
+                    recvBatchMsgs[i].msg_hdr.msg_flags = 0;
                 }
 
-                if (not rehdr->validate())
+                int nmsgs = recvmmsg(fd, recvBatchMsgs.data(), BUSY_POLL_BATCH, MSG_DONTWAIT, nullptr);
+                if (nmsgs == -1)
                 {
-                    // discard invalid frames, increment counter
-                    reas.recvStats.badHeaderDiscards++;
-                    free(recvBuffer);
+                    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+                    {
+                        reas.recvStats.dataErrCnt++;
+                        reas.recvStats.lastErrno = errno;
+                    }
                     continue;
                 }
+                gotData = true;
+                for(int i = 0; i < nmsgs; i++)
+                    _processDatagram(sockIdx, static_cast<u_int8_t*>(recvBatchIovs[i].iov_base),
+                        recvBatchMsgs[i].msg_len, recvBatchMsgs[i].msg_hdr);
+            }
 
-                std::shared_ptr<EventQueueItem> item;
+            localSpins++;
+            if (localSpins >= BUSY_POLL_FLUSH_SPINS)
+                flushBusyPollStats();
 
-                if (rehdr->get_bufferOffset() == 0)
-                {
-                    // new event - start a new event item and new event buffer 
-                    // since this is done by many threads, can't use object_pool easily
-                    item = std::make_shared<EventQueueItem>(rehdr);
-                    // add to in progress map based on <event number, data id> tuple
-                    evtsInProgressMutex.lock();
-                    eventsInProgress[std::make_pair(rehdr->get_eventNum(), rehdr->get_dataId())] = item;
-                    evtsInProgressMutex.unlock();
-                } else 
+            if (gotData)
+            {
+                localHits++;
+                lastData = TSCClock::steady::now();
+            }
+            else if (TSCClock::steady::now() - lastData > budget)
+            {
+                // spin budget exhausted, let the caller block
+                reas.recvStats.busyPollFallbacks++;
+                flushBusyPollStats();
+                return;
+            }
+        }
+#endif
+    }
+
+    void Reassembler::RecvThreadState::_processDatagram(size_t sockIdx, u_int8_t *dgram, ssize_t nbytes, 
+        const struct msghdr &msg)
+    {
+        // datagram didn't fit into the receive buffer, we can't reassemble it
+        if (msg.msg_flags & MSG_TRUNC) {
+            reas.recvStats.dataErrCnt++;
+            reas.recvStats.lastErrno = EMSGSIZE;
+            return;
+        }
+
+        // with UDP_GRO a single read may return several coalesced datagrams
+        // of equal size (except for the last one)
+        ssize_t segSize{nbytes};
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; 
+            cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), cmsg))
+        {
+#ifdef UDP_GRO_AVAILABLE
+            if (reas.useGRO && (cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO))
+            {
+                int gsoSize;
+                memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof(gsoSize));
+                if (gsoSize > 0)
+                    segSize = gsoSize;
+            }
+#endif
+#ifdef RXQ_OVFL_AVAILABLE
+            // cumulative number of datagrams the kernel dropped on this socket so far
+            if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_RXQ_OVFL))
+            {
+                u_int32_t dropCount;
+                memcpy(&dropCount, CMSG_DATA(cmsg), sizeof(dropCount));
+                // unsigned arithmetic takes care of wraparound
+                u_int32_t newDrops = dropCount - lastDropCount[sockIdx];
+                lastDropCount[sockIdx] = dropCount;
+                if (newDrops > 0)
                 {
-                    // try to locate the event in the in progress map
-                    evtsInProgressMutex.lock();
-                    auto it = eventsInProgress.find(std::make_pair(rehdr->get_eventNum(), rehdr->get_dataId()));
-                    if (it != eventsInProgress.end()) 
-                        item = it->second;
-                    else
-                    {
-                        // out of order delivery and we haven't seen this event
-                        // start a new event item and new event buffer 
-                        item = std::make_shared<EventQueueItem>(rehdr);
-                        // add to in progress map
-                        eventsInProgress[std::make_pair(rehdr->get_eventNum(), rehdr->get_dataId())] = item;
-                    }
-                    evtsInProgressMutex.unlock();
+                    dropsPerPort[sockIdx].fetch_add(newDrops, std::memory_order_relaxed);
+                    stats.kernelDrops.fetch_add(newDrops, std::memory_order_relaxed);
+                    trace.record(TraceAction::reasKernelDrop, 0, 0, udpPorts[sockIdx], 0, newDrops);
                 }
+            }
+#endif
+        }
+        for (ssize_t offset = 0; offset < nbytes; offset += segSize)
+        {
+            auto segLen = std::min(segSize, nbytes - offset);
+            // count fragment received by socket
+            fragmentsPerPort[sockIdx].fetch_add(1, std::memory_order_relaxed);
+            stats.totalPacketsReceived.fetch_add(1, std::memory_order_relaxed);
+            stats.totalBytesReceived.fetch_add(segLen, std::memory_order_relaxed);
 
+            _processSegment(dgram + offset, segLen, portSessions[sockIdx]);
+        }
+    }
 
-                // copy segment into event buffer into its proper place 
-                // note that with or without LB header, our REhdr should be set now
-                memcpy(item->event + rehdr->get_bufferOffset(), 
-                    reinterpret_cast<u_int8_t*>(rehdr) + sizeof(REHdr), nbytes);
+    void Reassembler::RecvThreadState::_processSegment(u_int8_t *segment, ssize_t nbytes, u_int16_t session)
+    {
+        // start a new event if offset 0 (check for event number collisions)
+        // or attach to existing event
+        REHdr *rehdr{nullptr};
+        // for testing we may leave LB header attached, so it needs to be
+        // subtracted
+        if (reas.withLBHeader)
+        {
+            rehdr = reinterpret_cast<REHdr*>(segment + sizeof(LBHdrU));
+            nbytes -= sizeof(LBHdrU) + sizeof(REHdr);
+        }
+        else
+        {
+            rehdr = reinterpret_cast<REHdr*>(segment);
+            nbytes -= sizeof(REHdr);
+        }
 
-                // free the recv buffer
-                free(recvBuffer);
+        // discard runt and invalid frames and segments that would not fit into
+        // the event buffer, increment counter
+        if ((nbytes < 0) || not rehdr->validate() || 
+            (static_cast<u_int64_t>(rehdr->get_bufferOffset()) + nbytes > rehdr->get_bufferLength()))
+        {
+            stats.badHeaderDiscards.fetch_add(1, std::memory_order_relaxed);
+            trace.record(TraceAction::reasBadHeader, 0, 0, 0, std::max(nbytes, static_cast<ssize_t>(0)));
+            return;
+        }
 
-                // count this fragment received (it could be anywhere in the event)
-                item->numFragments++;
+        trace.record(TraceAction::reasFragmentReceived, rehdr->get_eventNum(), rehdr->get_dataId(),
+            rehdr->get_bufferOffset(), nbytes);
+        E2SAR_PROBE4(reas_fragment_received, rehdr->get_eventNum(), rehdr->get_dataId(),
+            rehdr->get_bufferOffset(), nbytes);
 
-                item->curBytes += nbytes;
+        std::shared_ptr<EventQueueItem> item;
+        auto &inProgress = eventsInProgress[session];
 
-                // check if this event is completed, if so put on queue
-                if (item->curBytes == item->bytes )
-                {
-                    // remove this item from in progress map
-                    evtsInProgressMutex.lock();
-                    // TODO: a bit inefficient as this searches for all keys equal to this.
-                    // If we can get ahold of an iterator in advance we can precisely erase the element
-                    eventsInProgress.erase(std::make_pair(item->eventNum, item->dataId));
-                    evtsInProgressMutex.unlock();
-
-                    // queue it up for the user to receive
-                    auto ret = reas.enqueue(item);
-                    // event lost on enqueuing
-                    if (ret == 1) 
-                    {
-                        // log this lost event
-                        logLostEvent(item, true);
-                        // delete event buffer
-                        delete[] item->event;
-                    }
-                    // deallocate queue item - either we put a copy of the item
-                    // on the queue or we couldn't, either way we release
-                    item.reset();
-                    // update statistics
-                    reas.recvStats.eventSuccess++;
-                }
+        if (rehdr->get_bufferOffset() == 0)
+        {
+            // new event - start a new event item and new event buffer 
+            // since this is done by many threads, can't use object_pool easily
+            item = std::make_shared<EventQueueItem>(rehdr);
+            item->session = session;
+            // add to in progress map based on <event number, data id> tuple
+            evtsInProgressMutex.lock();
+            inProgress[std::make_pair(rehdr->get_eventNum(), rehdr->get_dataId())] = item;
+            if (reas.adaptiveTimeout && recentlyLost(item->eventNum, item->dataId, session))
+                reas.adaptTimeoutTooShort(session, item->dataId, item->bytes);
+            evtsInProgressMutex.unlock();
+            trace.record(TraceAction::reasEventStarted, item->eventNum, item->dataId, 0, item->bytes);
+            if (reas.trackSequence)
+                reas.trackEventSeq(item->eventNum, session, item->dataId);
+        } else 
+        {
+            bool newEvent{false};
+            // try to locate the event in the in progress map
+            evtsInProgressMutex.lock();
+            auto it = inProgress.find(std::make_pair(rehdr->get_eventNum(), rehdr->get_dataId()));
+            if (it != inProgress.end()) 
+                item = it->second;
+            else
+            {
+                // out of order delivery and we haven't seen this event
+                // start a new event item and new event buffer 
+                item = std::make_shared<EventQueueItem>(rehdr);
+                item->session = session;
+                // add to in progress map
+                inProgress[std::make_pair(rehdr->get_eventNum(), rehdr->get_dataId())] = item;
+                newEvent = true;
             }
+            // a segment of an event we already gave up on means the adaptive timeout is too short
+            if (newEvent && reas.adaptiveTimeout && recentlyLost(item->eventNum, item->dataId, session))
+                reas.adaptTimeoutTooShort(session, item->dataId, item->bytes);
+            evtsInProgressMutex.unlock();
+            if (newEvent)
+                trace.record(TraceAction::reasEventStarted, item->eventNum, item->dataId, 0, item->bytes);
+            if (newEvent && reas.trackSequence)
+                reas.trackEventSeq(item->eventNum, session, item->dataId);
         }
 
-        // close on exit
-        auto res = _close();
+
+        // a segment claiming a different event length than the one that started the
+        // event must not write past the event buffer
+        if (static_cast<u_int64_t>(rehdr->get_bufferOffset()) + nbytes > item->bytes)
+        {
+            stats.badHeaderDiscards.fetch_add(1, std::memory_order_relaxed);
+            trace.record(TraceAction::reasBadHeader, item->eventNum, item->dataId, 
+                rehdr->get_bufferOffset(), nbytes);
+            return;
+        }
+
+        // copy segment into event buffer into its proper place 
+        // note that with or without LB header, our REhdr should be set now
+        memcpy(item->event + rehdr->get_bufferOffset(), 
+            reinterpret_cast<u_int8_t*>(rehdr) + sizeof(REHdr), nbytes);
+
+        // track gaps between segments for adaptive timeout
+        if (reas.adaptiveTimeout)
+        {
+            auto nowUsec = boost::chrono::duration_cast<boost::chrono::microseconds>(
+                TSCClock::steady::now().time_since_epoch()).count();
+            if (item->numFragments > 0)
+                item->maxGapUsec = std::max(item->maxGapUsec, nowUsec - item->lastSegmentUsec);
+            item->lastSegmentUsec = nowUsec;
+        }
+
+        // count this fragment received (it could be anywhere in the event)
+        item->numFragments++;
+
+        item->curBytes += nbytes;
+
+        // check if this event is completed, if so put on queue
+        if (item->curBytes == item->bytes )
+        {
+            // item is released below, keep what per data id stats need
+            auto counters = reas.dataIdCounters(session, item->dataId, true);
+            auto bytes = item->bytes;
+            auto numFragments = item->numFragments;
+            item->completed = TSCClock::steady::now();
+            reas.latencyHists.firstToComplete.recordInterval(item->firstSegment, item->completed);
+            trace.record(TraceAction::reasEventCompleted, item->eventNum, item->dataId, 0, item->bytes,
+                item->numFragments);
+            E2SAR_PROBE5(reas_event_completed, item->eventNum, item->dataId, item->bytes, item->numFragments,
+                boost::chrono::duration_cast<boost::chrono::nanoseconds>(item->completed - item->firstSegment).count());
+
+            // remove this item from in progress map
+            evtsInProgressMutex.lock();
+            // TODO: a bit inefficient as this searches for all keys equal to this.
+            // If we can get ahold of an iterator in advance we can precisely erase the element
+            inProgress.erase(std::make_pair(item->eventNum, item->dataId));
+            evtsInProgressMutex.unlock();
+
+            // learn inter-segment gaps from multi-segment events
+            if (reas.adaptiveTimeout && item->numFragments > 1)
+                reas.adaptLearnGap(session, item->dataId, item->bytes, item->maxGapUsec);
+
+            // queue it up for the user to receive
+            auto ret = reas.enqueue(item);
+            // event lost on enqueuing
+            if (ret == 1) 
+            {
+                trace.record(TraceAction::reasEnqueueLoss, item->eventNum, item->dataId, 0, item->bytes);
+                E2SAR_PROBE3(reas_enqueue_loss, item->eventNum, item->dataId, item->bytes);
+                // log this lost event
+                evtsInProgressMutex.lock();
+                logLostEvent(item, true);
+                evtsInProgressMutex.unlock();
+                // delete event buffer
+                delete[] item->event;
+            }
+            // deallocate queue item - either we put a copy of the item
+            // on the queue or we couldn't, either way we release
+            item.reset();
+            // update statistics
+            stats.eventSuccess.fetch_add(1, std::memory_order_relaxed);
+            reas.sessions[session]->eventSuccess.fetch_add(1, std::memory_order_relaxed);
+            if (counters != nullptr)
+            {
+                counters->events.fetch_add(1, std::memory_order_relaxed);
+                counters->bytes.fetch_add(bytes, std::memory_order_relaxed);
+                counters->fragments.fetch_add(numFragments, std::memory_order_relaxed);
+            }
+        }
     }
 
     result<int> Reassembler::RecvThreadState::_open()
@@ -498,11 +827,48 @@ namespace e2sar
                     return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                 }
             }
+#ifdef BUSY_POLL_AVAILABLE
+            // let the kernel poll the device queue on receive instead of waiting for interrupts
+            if (reas.busyPoll)
+            {
+                int on{1};
+                if ((setsockopt(socketFd, SOL_SOCKET, SO_BUSY_POLL, &reas.busyPoll_us, sizeof(reas.busyPoll_us)) < 0) ||
+                    (setsockopt(socketFd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on)) < 0)) {
+                    close(socketFd);
+                    reas.recvStats.dataErrCnt++;
+                    reas.recvStats.lastErrno = errno;
+                    return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
+                }
+            }
+#endif
+#ifdef RXQ_OVFL_AVAILABLE
+            // have the kernel report how many datagrams it dropped on this socket
+            {
+                int on{1};
+                if (setsockopt(socketFd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+                    close(socketFd);
+                    reas.recvStats.dataErrCnt++;
+                    reas.recvStats.lastErrno = errno;
+                    return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
+                }
+            }
+#endif
+#ifdef UDP_GRO_AVAILABLE
+            // let the kernel coalesce datagrams of the same flow, we split them up on receive
+            if (reas.useGRO)
+            {
+                int on{1};
+                if (setsockopt(socketFd, SOL_UDP, UDP_GRO, &on, sizeof(on)) < 0) {
+                    close(socketFd);
+                    reas.recvStats.dataErrCnt++;
+                    reas.recvStats.lastErrno = errno;
+                    return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
+                }
+            }
+#endif
             sockets.push_back(socketFd);
             FD_SET(socketFd, &fdSet);
             maxFdPlusOne = (maxFdPlusOne > socketFd ? maxFdPlusOne : socketFd);
-            reas.recvStats.portPerFd.resize(socketFd+1);
-            reas.recvStats.portPerFd[socketFd] = port; // which port is for this FD?
         }
 
         // make it plus one
@@ -524,9 +890,9 @@ namespace e2sar
         UnixTimeMicro_t currentTimeMicros = static_cast<UnixTimeMicro_t>(nowUsec);
 
         // create first PID sample with 0 error and integral values
-        PIDSample newSample{currentTimeMicros, 0.0, 0.0};
-        // push a new entry onto the circular buffer ejecting the oldest
-        reas.pidSampleBuffer.push_back(newSample);
+        // push a new entry onto the circular buffer of each session ejecting the oldest
+        for (auto &sess: reas.sessions)
+            sess->pidSampleBuffer.push_back(PIDSample{currentTimeMicros, 0.0, 0.0});
 
         // wait before entering the loop
         auto until = nowT + boost::chrono::milliseconds(period_ms);
@@ -550,82 +916,261 @@ namespace e2sar
             // this case deltaT is always ~1sec (modulo the accuracy of the sleeps).
             // The depth of circular buffer is always set to epoch_length/period_of_this_thread.
             //
-            // fillPercent is always reported as sampled in the current moment
+            // fillPercent is always reported as sampled in the current moment.
+            // Every hosted session has its own queue, PID loop and control plane
 
             // Get the current time point
             auto nowT = boost::chrono::system_clock::now();
             auto nowUsec = boost::chrono::duration_cast<boost::chrono::microseconds>(nowT.time_since_epoch()).count();
             UnixTimeMicro_t currentTimeMicros = static_cast<UnixTimeMicro_t>(nowUsec);
 
-            // at 100msec period and depth of 10 this should normally be about 1 sec
-            auto deltaTfloat = static_cast<float>(currentTimeMicros - 
-                reas.pidSampleBuffer.front().sampleTime)/1000000.;
+            // the receive threads are shared, so kernel drops affect all sessions
+            auto kernelDrops = reas.recvStats.sum(&AtomicStats::ThreadStats::kernelDrops);
+            bool kernelDropped = (kernelDrops > lastKernelDrops);
+            lastKernelDrops = kernelDrops;
+
+            for (auto &sess: reas.sessions)
+                _sendState(*sess, currentTimeMicros, kernelDropped);
+
+            // sleep approximately so we wake up every ~100ms
+            auto until = nowT + boost::chrono::milliseconds(period_ms);
+            boost::this_thread::sleep_until(until);
+        }
+    }
 
-            // sample queue state
-            auto fillPercent = static_cast<float>(static_cast<float>(reas.eventQueueDepth)/static_cast<float>(reas.QSIZE));
+    void Reassembler::SendStateThreadState::_sendState(SessionState &sess, UnixTimeMicro_t currentTimeMicros, 
+        bool kernelDropped)
+    {
+        // at 100msec period and depth of 10 this should normally be about 1 sec
+        auto deltaTfloat = static_cast<float>(currentTimeMicros - 
+            sess.pidSampleBuffer.front().sampleTime)/1000000.;
+
+        // sample queue state
+        auto fillPercent = static_cast<float>(static_cast<float>(sess.eventQueueDepth)/static_cast<float>(reas.queueCapacity()));
+        boost::tuple<float, float, float> PIDTuple;
+        if (reas.drainControl)
+            // control signal from queue arrival/service rates, no integral term
+            PIDTuple = boost::make_tuple(_drainSignal(sess, currentTimeMicros, fillPercent), 
+                reas.setPoint - fillPercent, 0.0f);
+        else
             // get PID terms (PID value, error, integral accumulator)
-            auto PIDTuple = pid<float>(reas.setPoint, fillPercent,  
+            PIDTuple = pid<float>(reas.setPoint, fillPercent,  
                 deltaTfloat, reas.Kp, reas.Ki, reas.Kd, 
-                reas.pidSampleBuffer.front().error,
-                reas.pidSampleBuffer.back().integral);
-
-            // create new PID sample using last error and integral accumulated value
-            PIDSample newSample{currentTimeMicros, PIDTuple.get<1>(), PIDTuple.get<2>()};
-            // push a new entry onto the circular buffer ejecting the oldest
-            reas.pidSampleBuffer.push_back(newSample);
-
-            // send update to CP
-            // gather the stats
-            WorkerStats stats;
-            if (reas.reportStats)
-            {
-                stats.total_events_reassembly_err = reas.recvStats.reassemblyLoss;
-                stats.total_events_reassembled = reas.recvStats.eventSuccess;
-                stats.total_event_enqueue_err = reas.recvStats.enqueueLoss;
-                stats.total_bytes_recv = reas.recvStats.totalBytesReceived;
-                stats.total_packets_recv = reas.recvStats.totalPacketsReceived;
-            }
+                sess.pidSampleBuffer.front().error,
+                sess.pidSampleBuffer.back().integral);
 
-            auto res = reas.lbman.sendState(fillPercent, PIDTuple.get<0>(), true, stats);
-            if (res.has_error())
+        // create new PID sample using last error and integral accumulated value
+        PIDSample newSample{currentTimeMicros, PIDTuple.get<1>(), PIDTuple.get<2>()};
+        // push a new entry onto the circular buffer ejecting the oldest
+        sess.pidSampleBuffer.push_back(newSample);
+
+        // the kernel dropping datagrams means we are overloaded regardless of
+        // how full the queue looks, so report it as full and no more eager for
+        // data than a full queue would make the controller. Only the report is
+        // overridden, the controller state keeps tracking the real queue
+        float reportedFill{fillPercent};
+        float reportedSignal{PIDTuple.get<0>()};
+        if (reas.dropBackoff && kernelDropped)
+        {
+            reportedFill = 1.0;
+            reportedSignal = std::min(reportedSignal, 
+                (reas.drainControl ? 1.0f : reas.Kp) * (reas.setPoint - 1.0f));
+        }
+        sess.controlState.fillPercent.store(reportedFill, std::memory_order_relaxed);
+        sess.controlState.controlSignal.store(reportedSignal, std::memory_order_relaxed);
+        sess.controlState.error.store(PIDTuple.get<1>(), std::memory_order_relaxed);
+        sess.controlState.integral.store(PIDTuple.get<2>(), std::memory_order_relaxed);
+
+        // send update to CP
+        // gather the stats - events are counted per session, packets and bytes only
+        // for the receive threads as a whole
+        WorkerStats stats;
+        if (reas.reportStats)
+        {
+            stats.total_events_reassembly_err = sess.reassemblyLoss;
+            stats.total_events_reassembled = sess.eventSuccess;
+            stats.total_event_enqueue_err = sess.enqueueLoss;
+            stats.total_bytes_recv = reas.recvStats.sum(&AtomicStats::ThreadStats::totalBytesReceived);
+            stats.total_packets_recv = reas.recvStats.sum(&AtomicStats::ThreadStats::totalPacketsReceived);
+        }
+
+        E2SAR_PROBE2(reas_sendstate_start, static_cast<int64_t>(reportedFill * 1e6), 
+            static_cast<int64_t>(reportedSignal * 1e6));
+        // does not wait for the control plane, the RPC completes in the background
+        auto res = sess.lbman.sendStateAsync(reportedFill, reportedSignal, true, stats, deadline_ms);
+        if (res.has_error())
+        {
+            // update error counts
+            reas.recvStats.grpcErrCnt++;
+            reas.recvStats.lastE2SARError = res.error().code();
+        }
+        // account for RPCs that failed since the last report
+        auto failures = sess.lbman.getSendStateFailures();
+        if (failures > sess.lastRPCFailures)
+        {
+            reas.recvStats.grpcErrCnt += static_cast<int>(failures - sess.lastRPCFailures);
+            reas.recvStats.lastE2SARError = E2SARErrorc::RPCError;
+            sess.lastRPCFailures = failures;
+        }
+    }
+
+    float Reassembler::SendStateThreadState::_drainSignal(SessionState &sess, UnixTimeMicro_t currentTimeMicros, 
+        float fillPercent)
+    {
+        auto &ds = sess.drainState;
+        auto enqBytes = sess.enqueuedBytes.load(std::memory_order_relaxed);
+        auto enqEvents = sess.enqueuedEvents.load(std::memory_order_relaxed);
+        auto deqBytes = sess.dequeuedBytes.load(std::memory_order_relaxed);
+
+        // fold the throughput since the previous step into the averages (the first call only
+        // establishes the baseline)
+        if ((ds.lastSampleTime != 0) && (currentTimeMicros > ds.lastSampleTime))
+        {
+            double deltaT = static_cast<double>(currentTimeMicros - ds.lastSampleTime)/1000000.;
+            double arrival = static_cast<double>(enqBytes - ds.lastEnqueuedBytes)/deltaT;
+            double service = static_cast<double>(deqBytes - ds.lastDequeuedBytes)/deltaT;
+            ds.arrivalBps = DRAIN_EWMA_ALPHA * arrival + (1.0 - DRAIN_EWMA_ALPHA) * ds.arrivalBps;
+            ds.serviceBps = DRAIN_EWMA_ALPHA * service + (1.0 - DRAIN_EWMA_ALPHA) * ds.serviceBps;
+            if (enqEvents > ds.lastEnqueuedEvents)
             {
-                // update error counts
-                reas.recvStats.grpcErrCnt++;
-                reas.recvStats.lastE2SARError = res.error().code();
+                double eventBytes = static_cast<double>(enqBytes - ds.lastEnqueuedBytes)/(enqEvents - ds.lastEnqueuedEvents);
+                ds.avgEventBytes = (ds.avgEventBytes == 0. ? eventBytes : 
+                    DRAIN_EWMA_ALPHA * eventBytes + (1.0 - DRAIN_EWMA_ALPHA) * ds.avgEventBytes);
             }
+        }
+        ds.lastSampleTime = currentTimeMicros;
+        ds.lastEnqueuedBytes = enqBytes;
+        ds.lastEnqueuedEvents = enqEvents;
+        ds.lastDequeuedBytes = deqBytes;
+
+        // queue capacity is in events, convert the free slots to bytes at the average event size
+        float timeToFull_ms{std::numeric_limits<float>::infinity()};
+        if (ds.arrivalBps > ds.serviceBps)
+        {
+            size_t depth = sess.eventQueueDepth;
+            size_t capacity = reas.queueCapacity();
+            double freeBytes = static_cast<double>(depth < capacity ? capacity - depth : 0) * ds.avgEventBytes;
+            timeToFull_ms = static_cast<float>(freeBytes / (ds.arrivalBps - ds.serviceBps) * 1000.);
+        }
 
-            // sleep approximately so we wake up every ~100ms
-            auto until = nowT + boost::chrono::milliseconds(period_ms);
-            boost::this_thread::sleep_until(until);
+        // relative headroom of the consumers: 1 - queue draining with nothing arriving,
+        // 0 - keeping up exactly, -1 - nothing drained while events arrive
+        double peak = std::max(ds.arrivalBps, ds.serviceBps);
+        float signal = (peak > 0. ? static_cast<float>((ds.serviceBps - ds.arrivalBps)/peak) : 0.f);
+        // steer the queue towards the setPoint
+        signal += reas.setPoint - fillPercent;
+        // the queue fills before a new schedule can take effect
+        if (timeToFull_ms < reas.epochMs)
+            signal = std::min(signal, -(1.0f - timeToFull_ms/reas.epochMs));
+        signal = std::max(-1.0f, std::min(1.0f, signal));
+
+        sess.controlState.arrivalBps.store(static_cast<float>(ds.arrivalBps), std::memory_order_relaxed);
+        sess.controlState.serviceBps.store(static_cast<float>(ds.serviceBps), std::memory_order_relaxed);
+        sess.controlState.timeToFull_ms.store(timeToFull_ms, std::memory_order_relaxed);
+        return signal;
+    }
+
+    result<int> Reassembler::addSession(const EjfatURI &uri, u_int16_t starting_port, int pRange) noexcept
+    {
+        if (not recvThreadState.empty() || threadsStop)
+            return E2SARErrorInfo{E2SARErrorc::LogicError, "Sessions can only be added before openAndStart()"};
+
+        if (sessions.size() >= MAX_SESSIONS)
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Too many sessions, limit " + std::to_string(MAX_SESSIONS)};
+
+        if (pRange == -1)
+            pRange = portRange;
+        if ((pRange < 0) || (pRange > 14))
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Port range out of bounds: [0, 14]"};
+
+        if (starting_port < 1024)
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Base receive port in the privileged range (<1024)"};
+
+        size_t nPorts = (pRange > 0 ? 2 << (pRange - 1): 1);
+        if (starting_port + nPorts - 1 > std::numeric_limits<u_int16_t>::max())
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Session ports exceed the maximum port number"};
+
+        // one port can only deliver to one session
+        for (auto &sess: sessions)
+            if ((starting_port < sess->dataPort + sess->numRecvPorts) && (sess->dataPort < starting_port + nPorts))
+                return E2SARErrorInfo{E2SARErrorc::ParameterError, "Session ports overlap ports " + 
+                    std::to_string(sess->dataPort) + "-" + std::to_string(sess->dataPort + sess->numRecvPorts - 1)};
+
+        if (!uri.has_dataAddr())
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Data address not present in the URI"};
+
+        try {
+            sessions.emplace_back(new SessionState(uri, starting_port, pRange, pidSampleDepth,
+                validateCert, useHostAddress));
+        } catch (E2SARException &e) {
+            return E2SARErrorInfo{E2SARErrorc::RPCError, static_cast<std::string>(e)};
         }
+        assignPortsToThreads(*sessions.back());
+        return static_cast<int>(sessions.size() - 1);
     }
 
     result<int> Reassembler::registerWorker(const std::string &node_name) noexcept 
     {
         if (useCP)
         {
-            registeredWorker = true;
-            return lbman.registerWorker(node_name, std::make_pair(dataIP, dataPort), weight, numRecvPorts, 
-                min_factor, max_factor);
+            for (size_t i = 0; i < sessions.size(); i++)
+            {
+                auto &sess = sessions[i];
+                auto res = sess->lbman.registerWorker(node_name, std::make_pair(dataIP, sess->dataPort), weight, 
+                    sess->numRecvPorts, min_factor, max_factor);
+                if (res.has_error())
+                {
+                    // all or nothing - undo the sessions registered so far
+                    std::string undoErrors;
+                    for (size_t j = 0; j < i; j++)
+                    {
+                        sessions[j]->registeredWorker = false;
+                        auto undo = sessions[j]->lbman.deregisterWorker();
+                        if (undo.has_error())
+                            undoErrors += "; unable to deregister session " + std::to_string(j) + ": " + 
+                                undo.error().message();
+                    }
+                    return E2SARErrorInfo{res.error().code(), res.error().message() + undoErrors};
+                }
+                sess->registeredWorker = true;
+            }
         }
         return 0;
     }
 
     result<int> Reassembler::deregisterWorker() noexcept
     {
-        if (registeredWorker)
+        bool wasRegistered{false};
+        result<int> ret{0};
+        for (auto &sess: sessions)
         {
-            registeredWorker = false;
-            return lbman.deregisterWorker();
-        } else
-            if (useCP)
-                return E2SARErrorInfo{E2SARErrorc::LogicError, "Attempting to unregister a worker when it hasn't been registered."};
-        return 0;
+            if (sess->registeredWorker)
+            {
+                wasRegistered = true;
+                sess->registeredWorker = false;
+                auto res = sess->lbman.deregisterWorker();
+                // keep going so that one failure doesn't leave the other sessions registered
+                if (res.has_error())
+                    ret = res.error();
+            }
+        }
+        if (not wasRegistered && useCP)
+            return E2SARErrorInfo{E2SARErrorc::LogicError, "Attempting to unregister a worker when it hasn't been registered."};
+        return ret;
     }
 
     result<int> Reassembler::getEvent(uint8_t **event, size_t *bytes, uint64_t* eventNum, uint16_t *dataId) noexcept
     {
-        auto eventItem = dequeue();
+        return getEvent(0, event, bytes, eventNum, dataId);
+    }
+
+    result<int> Reassembler::getEvent(size_t session, uint8_t **event, size_t *bytes, uint64_t* eventNum, 
+        uint16_t *dataId) noexcept
+    {
+        if (session >= sessions.size())
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "No such session " + std::to_string(session)};
+
+        auto eventItem = dequeue(session);
 
         if (eventItem == nullptr)
             return -1;
@@ -642,6 +1187,15 @@ namespace e2sar
 
     result<int> Reassembler::recvEvent(uint8_t **event, size_t *bytes, EventNum_t* eventNum, uint16_t *dataId, u_int64_t wait_ms) noexcept
     {
+        return recvEvent(0, event, bytes, eventNum, dataId, wait_ms);
+    }
+
+    result<int> Reassembler::recvEvent(size_t session, uint8_t **event, size_t *bytes, EventNum_t* eventNum, 
+        uint16_t *dataId, u_int64_t wait_ms) noexcept
+    {
+        if (session >= sessions.size())
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "No such session " + std::to_string(session)};
+
         // lock for the mutex (must be thread-local)
         thread_local boost::unique_lock<boost::mutex> condLock(recvThreadMtx, boost::defer_lock);
 
@@ -649,7 +1203,7 @@ namespace e2sar
         boost::chrono::steady_clock::time_point nextTimeT;
         bool overtime = false;
 
-        auto eventItem = dequeue();
+        auto eventItem = dequeue(session);
 
         // try to dequeue for a bit
         while (eventItem == nullptr && !threadsStop && !overtime)
@@ -658,7 +1212,7 @@ namespace e2sar
             recvThreadCond.wait_for(condLock, boost::chrono::milliseconds(recvWaitTimeout_ms));
             condLock.unlock();
  
-            eventItem = dequeue();
+            eventItem = dequeue(session);
             nextTimeT = boost::chrono::steady_clock::now();
 
             if ((wait_ms != 0) && (nextTimeT - nowT > boost::chrono::milliseconds(wait_ms))) 
@@ -675,6 +1229,17 @@ namespace e2sar
         return 0;
     }
 
+    result<int> Reassembler::dumpTrace(const std::string &path) const noexcept
+    {
+        std::vector<std::pair<std::string, const TraceRing*>> rings;
+        size_t threadIdx{0};
+        if (recvThreadsStarted.load(std::memory_order_acquire))
+            for(auto &rts: recvThreadState)
+                rings.emplace_back("recv-"s + std::to_string(threadIdx++), &rts.trace);
+        rings.emplace_back("gc"s, &gcThreadState.trace);
+        return TraceFile::write(path, rings);
+    }
+
     result<Reassembler::ReassemblerFlags> Reassembler::ReassemblerFlags::getFromINI(const std::string &iniFile) noexcept
     {
         boost::property_tree::ptree paramTree;
@@ -697,6 +1262,7 @@ namespace e2sar
         rFlags.useHostAddress = paramTree.get<bool>("control-plane.useHostAddress", rFlags.useHostAddress);
         rFlags.validateCert = paramTree.get<bool>("control-plane.validateCert", rFlags.validateCert);
         rFlags.reportStats = paramTree.get<bool>("control-plane.reportStats", rFlags.reportStats);
+        rFlags.sendStateDeadline_ms = paramTree.get<u_int16_t>("control-plane.sendStateDeadlineMS", rFlags.sendStateDeadline_ms);
 
         // data plane
         rFlags.portRange = paramTree.get<int>("data-plane.portRange", rFlags.portRange);
@@ -705,6 +1271,18 @@ namespace e2sar
         rFlags.rcvSocketBufSize = paramTree.get<int>("data-plane.rcvSocketBufSize", rFlags.rcvSocketBufSize);
         rFlags.epoch_ms = paramTree.get<u_int32_t>("data-plane.epochMS", rFlags.epoch_ms);
         rFlags.period_ms = paramTree.get<u_int16_t>("data-plane.periodMS", rFlags.period_ms);
+        rFlags.trackSequence = paramTree.get<bool>("data-plane.trackSequence", rFlags.trackSequence);
+        rFlags.adaptiveTimeout = paramTree.get<bool>("data-plane.adaptiveTimeout", rFlags.adaptiveTimeout);
+        rFlags.adaptiveTimeoutMult = paramTree.get<float>("data-plane.adaptiveTimeoutMult", rFlags.adaptiveTimeoutMult);
+        rFlags.useGRO = paramTree.get<bool>("data-plane.useGRO", rFlags.useGRO);
+        rFlags.recvBufferSize = paramTree.get<size_t>("data-plane.recvBufferSize", rFlags.recvBufferSize);
+        rFlags.busyPoll = paramTree.get<bool>("data-plane.busyPoll", rFlags.busyPoll);
+        rFlags.busyPoll_us = paramTree.get<int>("data-plane.busyPollUS", rFlags.busyPoll_us);
+        rFlags.spinBudget_us = paramTree.get<int>("data-plane.spinBudgetUS", rFlags.spinBudget_us);
+        rFlags.dropBackoff = paramTree.get<bool>("control-plane.dropBackoff", rFlags.dropBackoff);
+        rFlags.drainControl = paramTree.get<bool>("control-plane.drainControl", rFlags.drainControl);
+        rFlags.perDataIdStats = paramTree.get<bool>("data-plane.perDataIdStats", rFlags.perDataIdStats);
+        rFlags.eventQueueLimit = paramTree.get<size_t>("data-plane.eventQueueLimit", rFlags.eventQueueLimit);
 
         // PID parameters
         rFlags.setPoint = paramTree.get<float>("pid.setPoint", rFlags.setPoint);
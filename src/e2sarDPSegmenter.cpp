@@ -13,6 +13,7 @@
 #include "e2sarUtil.hpp"
 #include "e2sarNetUtil.hpp"
 #include "e2sarAffinity.hpp"
+#include "e2sarProbes.hpp"
 
 
 namespace e2sar 
@@ -40,13 +41,17 @@ namespace e2sar
         rings(sflags.numSendSockets),
         ringMtxs(sflags.numSendSockets),
 #endif
-        eventStatsBuffer{sflags.syncPeriods},
+        socketStats(sflags.numSendSockets),
+        samplerThreadState(*this),
         syncThreadState(*this, sflags.syncPeriodMs, sflags.connectedSocket), 
         // set thread index to 0 for a single send thread
         sendThreadState(*this, 0, sflags.dpV6, sflags.mtu, sflags.ticksAsREEventNum, sflags.connectedSocket),
         cpuCoreList{cpuCoreList},
         warmUpMs{sflags.warmUpMs},
         useCP{sflags.useCP},
+        sharedSync{sflags.sharedSync},
+        measuredSync{sflags.measuredSync},
+        ewmaAlpha{2.0 / (sflags.syncPeriods + 1)},
         addEntropy{(clockEntropyTest() > MIN_CLOCK_ENTROPY ? false : true)}
     {
         if ((lbHdrVersion < 2) || (lbHdrVersion > 3))
@@ -159,7 +164,21 @@ namespace e2sar
 
     result<int> Segmenter::openAndStart() noexcept
     {
-        if (useCP)
+        // calibrate the clock now rather than when the first event is sent
+        TSCClock::ticksPerSec();
+
+        if (useCP and sharedSync)
+        {
+            // hand the sync over to the process-wide service
+            auto status = SyncService::attach(this);
+            if (status.has_error()) 
+            {
+                return E2SARErrorInfo{E2SARErrorc::SocketError, 
+                    "Unable to register with sync service: " + status.error().message()};
+            }
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(warmUpMs));
+        }
+        else if (useCP)
         {
             // open and connect sync socket
             auto status = syncThreadState._open();
@@ -187,6 +206,10 @@ namespace e2sar
         boost::thread sendT(&Segmenter::SendThreadState::_threadBody, &sendThreadState);
         sendThreadState.threadObj = std::move(sendT);
 
+        // start the stats sampling thread
+        boost::thread samplerT(&Segmenter::SamplerThreadState::_threadBody, &samplerThreadState);
+        samplerThreadState.threadObj = std::move(samplerT);
+
         return 0;
     }
 
@@ -212,8 +235,10 @@ namespace e2sar
                 // check for errors from sendmsg
                 if (cqes[idx]->res < 0)
                 {
-                    seg.sendStats.errCnt++;
-                    seg.sendStats.lastErrno = cqes[idx]->res;
+                    seg.sendStats.countErr();
+                    seg.sendStats.countErrno(-cqes[idx]->res);
+                    seg.socketStats[roundRobinIndex].countError(-cqes[idx]->res);
+                    seg.traceRing().record(TraceAction::segSendError, 0, 0, 0, 0, -cqes[idx]->res);
                 }
                 auto sqeUserData = reinterpret_cast<SQEUserData*>(cqes[idx]->user_data);
                 auto callback = sqeUserData->callback;
@@ -239,33 +264,72 @@ namespace e2sar
     }
 #endif
 
+    Segmenter::RateSample Segmenter::SamplerThreadState::_sample(const RateSample &prev) noexcept
+    {
+        RateSample cur;
+        auto monoNs = TSCClock::monotonicNs();
+        cur.timestampNs = TSCClock::realtimeNs();
+        cur.eventCnt = seg.sendStats.eventCnt();
+        cur.byteCnt = seg.sendStats.byteCnt();
+        cur.msgCnt = seg.sendStats.msgCnt();
+        cur.errCnt = seg.sendStats.errCnt();
+        cur.queueDepth = seg.getSendQueueDepth();
+        // rates need a previous sample
+        if (prev.timestampNs > 0)
+        {
+            cur.periodNs = monoNs - lastMonoNs;
+            if (cur.periodNs > 0)
+            {
+                double perSec = 1e9 / cur.periodNs;
+                cur.eventRate = (cur.eventCnt - prev.eventCnt) * perSec;
+                cur.byteRate = (cur.byteCnt - prev.byteCnt) * perSec;
+                cur.msgRate = (cur.msgCnt - prev.msgCnt) * perSec;
+                cur.errRate = (cur.errCnt - prev.errCnt) * perSec;
+            }
+        }
+        lastMonoNs = monoNs;
+        return cur;
+    }
+
+    void Segmenter::SamplerThreadState::_threadBody()
+    {
+        // baseline for the first rates (not published)
+        auto prev = _sample(RateSample{});
+        auto nextT = TSCClock::steady::now() + boost::chrono::milliseconds(SAMPLE_PERIOD_MS);
+        while(!seg.threadsStop)
+        {
+            // sleep in short steps so stopThreads() doesn't wait for a whole period
+            auto nowT = TSCClock::steady::now();
+            if (nowT < nextT)
+            {
+                boost::this_thread::sleep_for(std::min(boost::chrono::milliseconds(100),
+                    boost::chrono::duration_cast<boost::chrono::milliseconds>(nextT - nowT) + 
+                    boost::chrono::milliseconds(1)));
+                continue;
+            }
+            prev = _sample(prev);
+            seg.lastSample.store(prev);
+            seg.sampleHistory.push(prev);
+            nextT += boost::chrono::milliseconds(SAMPLE_PERIOD_MS);
+            // don't try to catch up if we were held up for more than a period
+            if (nextT < nowT)
+                nextT = nowT + boost::chrono::milliseconds(SAMPLE_PERIOD_MS);
+        }
+    }
+
     void Segmenter::SyncThreadState::_threadBody()
     {
         while(!seg.syncThreadStop)
         {
             // Get the current time point
-            auto nowT = boost::chrono::system_clock::now();
+            auto nowT = TSCClock::system::now();
             // Convert the time point to nanoseconds since the epoch
             auto now = boost::chrono::duration_cast<boost::chrono::nanoseconds>(nowT.time_since_epoch()).count();
             UnixTimeNano_t currentTimeNanos = static_cast<UnixTimeNano_t>(now);
             // get sync header buffer
             SyncHdr hdr{};
 
-            // push the stats onto ring buffer (except the first time) and reset
-            // locking is not needed as sync thread is the  
-            // only one interacting with the circular buffer
-            if (seg.currentSyncStartNano != 0) {
-                struct SendStats statsToPush{seg.currentSyncStartNano.exchange(currentTimeNanos), 
-                    seg.eventsInCurrentSync.exchange(0)};
-                seg.eventStatsBuffer.push_back(statsToPush);
-            } else {
-                // just the first time (eventsInCurrentSync already initialized to 0)
-                seg.currentSyncStartNano = currentTimeNanos;
-            }
-
-            // fill the sync header using a mix of current and segmenter data
-            // no locking needed - we only look at one field in seg - srcId
-            seg.fillSyncHdr(&hdr, currentTimeNanos);
+            _fill(&hdr, currentTimeNanos);
 
             // send it off
             auto sendRes = _send(&hdr);
@@ -279,32 +343,57 @@ namespace e2sar
         auto res = _close();
     }
 
-    result<int> Segmenter::SyncThreadState::_open()
+    void Segmenter::SyncThreadState::_fill(SyncHdr *hdr, UnixTimeNano_t currentTimeNanos)
+    {
+        // fill the sync header using a mix of current and segmenter data
+        // no locking needed - we only look at one field in seg - srcId
+        seg.fillSyncHdr(hdr, currentTimeNanos);
+    }
+
+    result<int> Segmenter::SyncThreadState::_setAddr()
     {
         auto syncAddr = seg.dpuri.get_syncAddr();
         if (syncAddr.has_error())
             return syncAddr.error();
 
-        // Socket for sending sync message to CP
         if (syncAddr.value().first.is_v6()) {
-            if ((socketFd = socket(AF_INET6, SOCK_DGRAM, 0)) < 0) {
-                seg.syncStats.errCnt++;
-                seg.syncStats.lastErrno = errno;
-                return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
-            }
-
             sockaddr_in6 syncAddrStruct6{};
             syncAddrStruct6.sin6_family = AF_INET6;
             syncAddrStruct6.sin6_port = htobe16(syncAddr.value().second);
             inet_pton(AF_INET6, syncAddr.value().first.to_string().c_str(), &syncAddrStruct6.sin6_addr);
             isV6 = true;
             syncAddrStruct = syncAddrStruct6;
+        }
+        else {
+            sockaddr_in syncAddrStruct4{};
+            syncAddrStruct4.sin_family = AF_INET;
+            syncAddrStruct4.sin_port = htobe16(syncAddr.value().second);
+            inet_pton(AF_INET, syncAddr.value().first.to_string().c_str(), &syncAddrStruct4.sin_addr);
+            isV6 = false;
+            syncAddrStruct = syncAddrStruct4;
+        }
+        return 0;
+    }
+
+    result<int> Segmenter::SyncThreadState::_open()
+    {
+        auto addrRes = _setAddr();
+        if (addrRes.has_error())
+            return addrRes.error();
+
+        // Socket for sending sync message to CP
+        if (isV6) {
+            if ((socketFd = socket(AF_INET6, SOCK_DGRAM, 0)) < 0) {
+                seg.syncStats.countErr();
+                seg.syncStats.lastErrno = errno;
+                return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
+            }
 
             if (connectSocket) {
-                int err = connect(socketFd, (const sockaddr *) &syncAddrStruct6, sizeof(struct sockaddr_in6));
+                int err = connect(socketFd, (const sockaddr *) &GET_V6_SYNC_STRUCT(syncAddrStruct), sizeof(struct sockaddr_in6));
                 if (err < 0) {
                     close(socketFd);
-                    seg.syncStats.errCnt++;
+                    seg.syncStats.countErr();
                     seg.syncStats.lastErrno = errno;
                     return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                 }
@@ -312,22 +401,16 @@ namespace e2sar
         }
         else {
             if ((socketFd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-                seg.syncStats.errCnt++;
+                seg.syncStats.countErr();
                 seg.syncStats.lastErrno = errno;
                 return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
             }
 
-            sockaddr_in syncAddrStruct4{};
-            syncAddrStruct4.sin_family = AF_INET;
-            syncAddrStruct4.sin_port = htobe16(syncAddr.value().second);
-            inet_pton(AF_INET, syncAddr.value().first.to_string().c_str(), &syncAddrStruct4.sin_addr);
-            syncAddrStruct = syncAddrStruct4;
-
             if (connectSocket) {
-                int err = connect(socketFd, (const sockaddr *) &syncAddrStruct4, sizeof(struct sockaddr_in));
+                int err = connect(socketFd, (const sockaddr *) &GET_V4_SYNC_STRUCT(syncAddrStruct), sizeof(struct sockaddr_in));
                 if (err < 0) {
                     close(socketFd);
-                    seg.syncStats.errCnt++;
+                    seg.syncStats.countErr();
                     seg.syncStats.lastErrno = errno;
                     return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                 }
@@ -346,17 +429,17 @@ namespace e2sar
     {
         int err;
         if (connectSocket) {
-            seg.syncStats.msgCnt++;
+            seg.syncStats.countMsg();
             err = (int) send(socketFd, static_cast<void*>(hdr), sizeof(SyncHdr), 0);
         }
         else {
             if (isV6) {
-                seg.syncStats.msgCnt++;
+                seg.syncStats.countMsg();
                 err = (int) sendto(socketFd, static_cast<void*>(hdr), sizeof(SyncHdr), 0, 
                     (sockaddr * ) & GET_V6_SYNC_STRUCT(syncAddrStruct), sizeof(struct sockaddr_in6));
             }
             else {
-                seg.syncStats.msgCnt++;
+                seg.syncStats.countMsg();
                 err = (int) sendto(socketFd, static_cast<void*>(hdr), sizeof(SyncHdr), 0,  
                     (sockaddr * ) & GET_V4_SYNC_STRUCT(syncAddrStruct), sizeof(struct sockaddr_in));
             }
@@ -364,7 +447,7 @@ namespace e2sar
 
         if (err == -1)
         {
-            seg.syncStats.errCnt++;
+            seg.syncStats.countErr();
             seg.syncStats.lastErrno = errno;
             return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
         }
@@ -378,7 +461,7 @@ namespace e2sar
 
         // create a thread pool for sending events 
         boost::asio::thread_pool threadPool(seg.numSendSockets);
-        boost::chrono::high_resolution_clock::time_point nowTE;
+        TSCClock::steady::time_point nowTE;
         int64_t interEventSleepUsec{0};
         // per thread rate and inter-frame sleep if needed
         const float smoothThreadRateGbps{seg.smooth ? seg.rateGbps/seg.numSendSockets : (float)-1.0};
@@ -393,10 +476,17 @@ namespace e2sar
             EventQueueItem *item{nullptr};
             while(seg.eventQueue.pop(item))
             {
+                seg.eventQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+                auto dequeuedT = TSCClock::steady::now();
+                seg.latencyHists.enqueueToDequeue.recordInterval(item->enqueued, dequeuedT);
+                seg.traceRing().record(TraceAction::segEventDequeued, item->eventNum, item->dataId, 
+                    0, item->bytes);
+                E2SAR_PROBE4(seg_event_dequeued, item->eventNum, item->dataId, item->bytes,
+                    boost::chrono::duration_cast<boost::chrono::nanoseconds>(dequeuedT - item->enqueued).count());
                 if (not seg.smooth && seg.rateLimit)
                 {
                     // if rate limiting is enabled, we will use high-res clock for inter-event and inter-frame sleep
-                    nowTE = boost::chrono::high_resolution_clock::now();
+                    nowTE = TSCClock::steady::now();
                     // convert send rate into inter-event sleep time 
                     interEventSleepUsec = static_cast<int64_t>(item->bytes*8/(seg.rateGbps * 1000));
                 }
@@ -413,7 +503,7 @@ namespace e2sar
                 // by a separate thread that looks at completion queue
                 // and reflects into the stats block
                 boost::asio::post(threadPool,
-                    [this, rri, item, interFrameSleepUsec]() {
+                    [this, rri, item, interFrameSleepUsec, dequeuedT]() {
 #ifdef LIBURING_AVAILABLE
                         if (Optimizations::isSelected(Optimizations::Code::liburing_send)) 
                             seg.ringMtxs[rri].lock();
@@ -421,7 +511,7 @@ namespace e2sar
                         auto res = _send(item->event, item->bytes, 
                             item->eventNum, item->dataId,
                             item->entropy, rri, interFrameSleepUsec,
-                            item->callback, item->cbArg);
+                            item->callback, item->cbArg, &dequeuedT);
 
 #ifdef LIBURING_AVAILABLE
                         if (Optimizations::isSelected(Optimizations::Code::liburing_send)) 
@@ -501,7 +591,7 @@ namespace e2sar
 
                     // open and bind a socket to this port (try)
                     if ((fd = socket(AF_INET6, SOCK_DGRAM, 0)) < 0) {
-                        seg.sendStats.errCnt++;
+                        seg.sendStats.countErr();
                         seg.sendStats.lastErrno = errno;
                         return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                     }
@@ -519,7 +609,7 @@ namespace e2sar
                 if (!done)
                 {
                     // failed to bind socket after N tries
-                    seg.sendStats.errCnt++;
+                    seg.sendStats.countErr();
                     seg.sendStats.lastErrno = errno;
                     return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                 }
@@ -527,10 +617,13 @@ namespace e2sar
                 // set sndBufSize
                 if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &seg.sndSocketBufSize, sizeof(seg.sndSocketBufSize)) < 0) {
                     close(fd);
-                    seg.sendStats.errCnt++;
+                    seg.sendStats.countErr();
                     seg.sendStats.lastErrno = errno;
                     return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                 }
+                // the kernel may adjust it, so get what we actually got
+                socklen_t optLen{sizeof(sndBufBytes[fdCount])};
+                getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndBufBytes[fdCount], &optLen);
 
                 sockaddr_in6 dataAddrStruct6{};
                 dataAddrStruct6.sin6_family = AF_INET6;
@@ -545,7 +638,7 @@ namespace e2sar
                     int err = connect(fd, (const sockaddr *) &dataAddrStruct6, sizeof(struct sockaddr_in6));
                     if (err < 0) {
                         close(fd);
-                        seg.sendStats.errCnt++;
+                        seg.sendStats.countErr();
                         seg.sendStats.lastErrno = errno;
                         return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                     }
@@ -578,7 +671,7 @@ namespace e2sar
 
                     // open and bind a socket to this port (try)
                     if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-                        seg.sendStats.errCnt++;
+                        seg.sendStats.countErr();
                         seg.sendStats.lastErrno = errno;
                         return E2SARErrorInfo{E2SARErrorc::SocketError, "Unable to open socket: "s + strerror(errno)};
                     }
@@ -596,7 +689,7 @@ namespace e2sar
                 if (!done)
                 {
                     // failed to bind socket after N tries
-                    seg.sendStats.errCnt++;
+                    seg.sendStats.countErr();
                     seg.sendStats.lastErrno = errno;
                     return E2SARErrorInfo{E2SARErrorc::SocketError, "Unable to bind: "s + strerror(errno)};
                 }
@@ -604,10 +697,13 @@ namespace e2sar
                 // set sndBufSize
                 if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &seg.sndSocketBufSize, sizeof(seg.sndSocketBufSize)) < 0) {
                     close(fd);
-                    seg.sendStats.errCnt++;
+                    seg.sendStats.countErr();
                     seg.sendStats.lastErrno = errno;
                     return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                 }
+                // the kernel may adjust it, so get what we actually got
+                socklen_t optLen{sizeof(sndBufBytes[fdCount])};
+                getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndBufBytes[fdCount], &optLen);
 
                 sockaddr_in dataAddrStruct4{};
                 dataAddrStruct4.sin_family = AF_INET;
@@ -622,7 +718,7 @@ namespace e2sar
                 if (connectSocket) {
                     int err = connect(fd, (const sockaddr *) &dataAddrStruct4, sizeof(struct sockaddr_in));
                     if (err < 0) {
-                        seg.sendStats.errCnt++;
+                        seg.sendStats.countErr();
                         seg.sendStats.lastErrno = errno;
                         close(fd);
                         return E2SARErrorInfo{E2SARErrorc::SocketError, "Unable to connect: "s + strerror(errno)};
@@ -646,7 +742,7 @@ namespace e2sar
                 int ret = io_uring_register_files(&seg.rings[i], ringFds, fdCount);
                 if (ret < 0)
                 {
-                    seg.sendStats.errCnt++;
+                    seg.sendStats.countErr();
                     seg.sendStats.lastErrno = ret;
                 }
             }
@@ -659,8 +755,21 @@ namespace e2sar
     // fragment and send the event
     result<int> Segmenter::SendThreadState::_send(u_int8_t *event, size_t bytes, 
         EventNum_t eventNum, u_int16_t dataId, u_int16_t entropy, size_t roundRobinIndex,
-        int64_t interFrameSleepUsec, void (*callback)(boost::any), boost::any cbArg)
+        int64_t interFrameSleepUsec, void (*callback)(boost::any), boost::any cbArg,
+        const TSCClock::steady::time_point *dequeued)
     {
+        auto sendStartT = TSCClock::steady::now();
+        // record how long a queued event waited for its first fragment to go out
+        bool firstSent{false};
+        auto markFirstSent = [this, dequeued, &firstSent]() {
+            if (not firstSent && (dequeued != nullptr))
+                seg.latencyHists.dequeueToFirstSend.recordInterval(*dequeued, TSCClock::steady::now());
+            firstSent = true;
+        };
+        auto &trace = seg.traceRing();
+        auto &sockStats = seg.socketStats[roundRobinIndex];
+        // fragments and bytes handed to the kernel on this socket
+        u_int64_t fragsSent{0}, bytesSent{0};
         int err;
         int sendSocket{0};
         // having our own copy on the stack means we can call _send off-thread
@@ -669,7 +778,7 @@ namespace e2sar
         // number of buffers we will send
         size_t numBuffers{(bytes + maxPldLen - 1)/ maxPldLen}; // round up
         // if needed for interframe wait
-        boost::chrono::high_resolution_clock::time_point nowTF;
+        TSCClock::steady::time_point nowTF;
 
 #ifdef SENDMMSG_AVAILABLE 
         // allocate mmsg vector based on event buffer size using fast int ceiling
@@ -704,7 +813,7 @@ namespace e2sar
         size_t curLen = (bytes <= maxPldLen ? bytes : maxPldLen);
 
         // Get the current time point of event start
-        auto nowT = boost::chrono::system_clock::now();
+        auto nowT = TSCClock::system::now();
 
         // update the event number being reported in Sync and LB packets
         // use microseconds since the UNIX Epoch, but make sure the entropy
@@ -731,7 +840,7 @@ namespace e2sar
         while (curOffset < eventEnd)
         {
             if (interFrameSleepUsec > 0)
-                nowTF = boost::chrono::high_resolution_clock::now();
+                nowTF = TSCClock::steady::now();
             // fill out LB and RE headers
             void *hdrspace = malloc(sizeof(LBREHdr));
             // placement-new to construct the headers
@@ -741,6 +850,11 @@ namespace e2sar
 
             // note that buffer length is in fact event length, hence 3rd parameter is 'bytes'
             hdr->re.set(dataId, curOffset - event, bytes, eventNum);
+            // remember where this fragment is for tracing
+            u_int32_t fragOffset = curOffset - event;
+            u_int32_t fragLen = curLen;
+            trace.record(TraceAction::segFragmentSent, eventNum, dataId, fragOffset, fragLen);
+            E2SAR_PROBE4(seg_fragment_sent, eventNum, dataId, fragOffset, fragLen);
             switch(seg.lbHdrVersion) {
                 default:
                     // default to 2
@@ -781,7 +895,7 @@ namespace e2sar
 #ifdef LIBURING_AVAILABLE
             if (Optimizations::isSelected(Optimizations::Code::liburing_send))
             {
-                seg.sendStats.msgCnt++;
+                seg.sendStats.countMsg();
                 // get an SQE and fill it out
                 struct io_uring_sqe *sqe{nullptr};
                 // busy-wait for a free sqe to become available
@@ -810,22 +924,31 @@ namespace e2sar
                 io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
                 // submit for processing
                 io_uring_submit(&seg.rings[roundRobinIndex]);
+                fragsSent++;
+                bytesSent += sizeof(LBREHdr) + fragLen;
+                markFirstSent();
             }
             else
 #endif
             {
                 // just regular sendmsg
-                seg.sendStats.msgCnt++;
+                seg.sendStats.countMsg();
                 err = (int) sendmsg(sendSocket, &sendhdr, flags);
                 // free the header here for this situation
                 free(hdr);
                 free(iov);
                 if (err == -1)
                 {
-                    seg.sendStats.errCnt++;
-                    seg.sendStats.lastErrno = errno;
+                    seg.sendStats.countErr();
+                    seg.sendStats.countErrno(errno);
+                    sockStats.countError(errno);
+                    sockStats.countSent(fragsSent, bytesSent);
+                    trace.record(TraceAction::segSendError, eventNum, dataId, fragOffset, fragLen, errno);
                     return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
                 }
+                fragsSent++;
+                bytesSent += err;
+                markFirstSent();
                 // this is only set if smoothing is on. only works at low rates with reasonable MTUs
                 if (interFrameSleepUsec > 0)
                     busyWaitUsecs(nowTF, interFrameSleepUsec);
@@ -835,12 +958,16 @@ namespace e2sar
         if (Optimizations::isSelected(Optimizations::Code::sendmmsg))
         {
             // send using vector of msg_hdrs via sendmmsg
-            seg.sendStats.msgCnt += numBuffers;
+            seg.sendStats.countMsg(numBuffers);
             // this is a blocking version so send everything or error out
             err = (int) sendmmsg(sendSocket, mmsgvec, numBuffers, 0);
+            markFirstSent();
+            fragsSent = (err > 0 ? err : 0);
             // free up mmsgvec and included headers and iovecs
             for(size_t i = 0; i < numBuffers; i++)
             {
+                if (i < fragsSent)
+                    bytesSent += mmsgvec[i].msg_len;
                 free(mmsgvec[i].msg_hdr.msg_iov[0].iov_base);
                 free(mmsgvec[i].msg_hdr.msg_iov);
             }
@@ -848,10 +975,13 @@ namespace e2sar
             // sendmmsg returns the number of updated mmsgvec[i].msg_len entries
             if (err != (int)numBuffers)
             {
-                seg.sendStats.errCnt += numBuffers - err;
+                seg.sendStats.countErr(numBuffers - err);
+                sockStats.countError(errno, numBuffers - fragsSent);
+                sockStats.countSent(fragsSent, bytesSent);
                 // don't override with ESUCCESS
                 if (errno != 0)
-                    seg.sendStats.lastErrno = errno;
+                    seg.sendStats.countErrno(errno);
+                trace.record(TraceAction::segSendError, eventNum, dataId, 0, bytes, errno);
                 return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
             }
         }
@@ -861,10 +991,30 @@ namespace e2sar
         if (Optimizations::isSelected(Optimizations::Code::liburing_send))
         {
             seg.outstandingSends += numBuffers;
+            // how far the kernel is behind on this ring right after our submissions
+            sockStats.sampleRing(io_uring_sq_ready(&seg.rings[roundRobinIndex]), 
+                io_uring_cq_ready(&seg.rings[roundRobinIndex]));
         }
 #endif
         // update the event send stats
-        seg.eventsInCurrentSync++;
+        seg.lastSentTick = lbEventNum;
+        seg.sendStats.countEvent(bytes);
+        sockStats.countSent(fragsSent, bytesSent);
+        auto sendEndT = TSCClock::steady::now();
+        seg.latencyHists.sendDuration.recordInterval(sendStartT, sendEndT);
+        seg.latencyHists.sendDurationBySize[sendSizeBucket(bytes)].recordInterval(sendStartT, sendEndT);
+        trace.record(TraceAction::segEventSent, eventNum, dataId, 0, bytes, numBuffers);
+#if defined(SIOCOUTQ_AVAILABLE) || defined(SO_NWRITE_AVAILABLE)
+        // periodically sample how full the send socket buffer is
+        static thread_local size_t eventsSinceSample{0};
+        if (++eventsSinceSample >= SEND_QUEUE_SAMPLE_EVENTS)
+        {
+            eventsSinceSample = 0;
+            auto outq = NetUtil::getSocketOutstandingBytes(sendSocket);
+            if (!outq.has_error())
+                seg.sendStats.sampleSendQueue(outq.value(), sndBufBytes[roundRobinIndex]);
+        }
+#endif
 
         // keeps compiler quiet about unused variables in default optimizations
         return numBuffers * 0;
@@ -936,17 +1086,32 @@ namespace e2sar
         // continue incrementing 
         item->eventNum = userEventNum++;
         item->dataId = (_dataId  == 0 ? dataId : _dataId);
+        item->enqueued = TSCClock::steady::now();
+        // count before pushing so the send thread never sees the depth go below zero
+        eventQueueDepth.fetch_add(1, std::memory_order_relaxed);
+        // the send thread may free the item as soon as it is pushed
+        E2SAR_PROBE4(seg_event_enqueued, item->eventNum, item->dataId, bytes, 
+            eventQueueDepth.load(std::memory_order_relaxed));
         auto res = eventQueue.push(item);
         // wake up send thread (no need to hold the lock as queue is lock_free)
         //sendThreadCond.notify_one();
         if (res)
             return 0;
         else {
+            eventQueueDepth.fetch_sub(1, std::memory_order_relaxed);
             delete item;
             return E2SARErrorInfo{E2SARErrorc::MemoryError, "Send queue is temporarily full, try again later"};
         }
     }
 
+    result<int> Segmenter::dumpTrace(const std::string &path) const noexcept
+    {
+        std::vector<std::pair<std::string, const TraceRing*>> rings;
+        for(size_t i = 0; i < TRACE_SHARDS; i++)
+            rings.emplace_back("send-"s + std::to_string(i), &traceRings[i]);
+        return TraceFile::write(path, rings);
+    }
+
     result<Segmenter::SegmenterFlags> Segmenter::SegmenterFlags::getFromINI(const std::string &iniFile) noexcept
     {
         boost::property_tree::ptree paramTree;
@@ -971,6 +1136,10 @@ namespace e2sar
             sFlags.syncPeriods);
         sFlags.syncPeriodMs = paramTree.get<u_int16_t>("control-plane.syncPeriodMS", 
             sFlags.syncPeriodMs);
+        sFlags.sharedSync = paramTree.get<bool>("control-plane.sharedSync", 
+            sFlags.sharedSync);
+        sFlags.measuredSync = paramTree.get<bool>("control-plane.measuredSync", 
+            sFlags.measuredSync);
 
         // data plane
         sFlags.dpV6 = paramTree.get<bool>("data-plane.dpV6", sFlags.dpV6);
@@ -994,4 +1163,216 @@ namespace e2sar
 
         return sFlags;
     }
+
+    boost::mutex SyncService::ctlMtx;
+    boost::mutex SyncService::mtx;
+    boost::condition_variable SyncService::cond;
+    std::vector<SyncService::Member> SyncService::members;
+    boost::thread SyncService::threadObj;
+    bool SyncService::threadStop{false};
+    int SyncService::socketV4{-1};
+    int SyncService::socketV6{-1};
+    SyncService::ServiceStats SyncService::stats;
+
+    SyncService::ServiceStats SyncService::getStats() noexcept
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+        ServiceStats ret{stats};
+        ret.segmenters = members.size();
+        return ret;
+    }
+
+    result<int> SyncService::attach(Segmenter *seg) noexcept
+    {
+        boost::lock_guard<boost::mutex> ctlLock(ctlMtx);
+
+        // members only change under ctlMtx, so the check holds until the segmenter is added below.
+        // Checked before opening anything so a rejected attach leaves no socket behind
+        {
+            boost::lock_guard<boost::mutex> lock(mtx);
+            for (auto &m: members)
+                if (m.seg == seg)
+                    return E2SARErrorInfo{E2SARErrorc::LogicError, "Segmenter already registered with sync service"s};
+        }
+
+        auto addrRes = seg->syncThreadState._setAddr();
+        if (addrRes.has_error())
+            return addrRes.error();
+
+        // sockets are only ever opened and closed here and in detach() (under ctlMtx) and
+        // are not used by the thread until the first member of that family is added
+        int &fd = (seg->syncThreadState.isV6 ? socketV6 : socketV4);
+        if (fd < 0)
+        {
+            fd = socket(seg->syncThreadState.isV6 ? AF_INET6 : AF_INET, SOCK_DGRAM, 0);
+            if (fd < 0)
+            {
+                seg->syncStats.countErr();
+                seg->syncStats.lastErrno = errno;
+                return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
+            }
+        }
+
+        {
+            boost::lock_guard<boost::mutex> lock(mtx);
+            members.push_back(Member{seg, boost::chrono::steady_clock::now()});
+        }
+
+        if (!threadObj.joinable())
+        {
+            threadStop = false;
+            threadObj = boost::thread(&SyncService::_threadBody);
+        }
+        else
+            cond.notify_one();
+        return 0;
+    }
+
+    void SyncService::detach(Segmenter *seg) noexcept
+    {
+        boost::lock_guard<boost::mutex> ctlLock(ctlMtx);
+        {
+            boost::lock_guard<boost::mutex> lock(mtx);
+            auto it = std::find_if(members.begin(), members.end(), 
+                [seg](const Member &m) { return m.seg == seg; });
+            if (it == members.end())
+                return;
+            members.erase(it);
+            if (!members.empty())
+                return;
+            threadStop = true;
+        }
+        // last one out stops the thread and closes the sockets
+        cond.notify_one();
+        threadObj.join();
+        for (int *fd: {&socketV4, &socketV6})
+        {
+            if (*fd >= 0)
+                close(*fd);
+            *fd = -1;
+        }
+    }
+
+    void SyncService::_sendBatch(int fd, struct mmsghdr *msgs, Segmenter **segs, size_t num)
+    {
+        for (size_t i = 0; i < num; i++)
+            segs[i]->syncStats.countMsg();
+
+        size_t sent{0};
+        while (sent < num)
+        {
+#ifdef SENDMMSG_AVAILABLE
+            int ret = sendmmsg(fd, msgs + sent, num - sent, 0);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                // skip the header that failed and carry on with the rest
+                segs[sent]->syncStats.countErr();
+                segs[sent]->syncStats.lastErrno = errno;
+                stats.errors++;
+                sent++;
+                continue;
+            }
+            sent += ret;
+            stats.syncsSent += ret;
+#else
+            if (sendmsg(fd, &msgs[sent].msg_hdr, 0) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                segs[sent]->syncStats.countErr();
+                segs[sent]->syncStats.lastErrno = errno;
+                stats.errors++;
+            }
+            else
+                stats.syncsSent++;
+            sent++;
+#endif
+        }
+    }
+
+    void SyncService::_threadBody()
+    {
+        // one batch per address family
+        std::array<SyncHdr, MAX_BATCH> hdrs4, hdrs6;
+        std::array<struct iovec, MAX_BATCH> iov4, iov6;
+        std::array<struct mmsghdr, MAX_BATCH> msgs4, msgs6;
+        std::array<Segmenter*, MAX_BATCH> segs4, segs6;
+
+        boost::unique_lock<boost::mutex> lock(mtx);
+        while (!threadStop)
+        {
+            auto nowT = boost::chrono::steady_clock::now();
+            auto nextT = nowT + boost::chrono::seconds(1);
+            for (auto &m: members)
+                nextT = std::min(nextT, m.nextDue);
+            if (nextT > nowT)
+            {
+                // woken up early by attach/detach, or the next one is due
+                cond.wait_until(lock, nextT);
+                continue;
+            }
+            stats.wakeups++;
+
+            // one timestamp for the batch
+            auto sysT = TSCClock::system::now();
+            UnixTimeNano_t currentTimeNanos = static_cast<UnixTimeNano_t>(
+                boost::chrono::duration_cast<boost::chrono::nanoseconds>(sysT.time_since_epoch()).count());
+
+            size_t num4{0}, num6{0};
+            for (auto &m: members)
+            {
+                if (m.nextDue > nowT)
+                    continue;
+                auto &sts = m.seg->syncThreadState;
+                bool v6 = sts.isV6;
+                size_t &num = (v6 ? num6 : num4);
+                SyncHdr &hdr = (v6 ? hdrs6[num] : hdrs4[num]);
+                struct iovec &iov = (v6 ? iov6[num] : iov4[num]);
+                struct mmsghdr &msg = (v6 ? msgs6[num] : msgs4[num]);
+                (v6 ? segs6[num] : segs4[num]) = m.seg;
+
+                sts._fill(&hdr, currentTimeNanos);
+                iov.iov_base = &hdr;
+                iov.iov_len = sizeof(SyncHdr);
+                memset(&msg, 0, sizeof(msg));
+                if (v6)
+                {
+                    msg.msg_hdr.msg_name = &GET_V6_SYNC_STRUCT(sts.syncAddrStruct);
+                    msg.msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+                }
+                else
+                {
+                    msg.msg_hdr.msg_name = &GET_V4_SYNC_STRUCT(sts.syncAddrStruct);
+                    msg.msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+                }
+                msg.msg_hdr.msg_iov = &iov;
+                msg.msg_hdr.msg_iovlen = 1;
+                num++;
+
+                // next multiple of the period on the steady clock, so Segmenters with the
+                // same (or harmonic) periods fall due together regardless of when they
+                // registered; don't try to catch up on missed periods
+                boost::chrono::steady_clock::duration period = boost::chrono::milliseconds(sts.period_ms);
+                m.nextDue = boost::chrono::steady_clock::time_point(
+                    (nowT.time_since_epoch() / period + 1) * period);
+
+                if (num4 == MAX_BATCH)
+                {
+                    _sendBatch(socketV4, msgs4.data(), segs4.data(), num4);
+                    num4 = 0;
+                }
+                if (num6 == MAX_BATCH)
+                {
+                    _sendBatch(socketV6, msgs6.data(), segs6.data(), num6);
+                    num6 = 0;
+                }
+            }
+            if (num4 > 0)
+                _sendBatch(socketV4, msgs4.data(), segs4.data(), num4);
+            if (num6 > 0)
+                _sendBatch(socketV6, msgs6.data(), segs6.data(), num6);
+        }
+    }
 }
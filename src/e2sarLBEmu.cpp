@@ -0,0 +1,471 @@
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "e2sarLBEmu.hpp"
+
+namespace e2sar
+{
+    LBEmulator::LBEmulator(boost::asio::ip::address listen_addr, u_int16_t listen_port,
+        const LBEmulatorFlags &flags):
+        listenAddr{listen_addr}, listenPort{listen_port}, numThreads{flags.numThreads},
+        rcvSocketBufSize{flags.rcvSocketBufSize}, sndSocketBufSize{flags.sndSocketBufSize},
+        schedule{std::make_shared<const Schedule>()}
+    {
+        if (numThreads == 0)
+            throw E2SARException("LBEmulator requires at least one forwarding thread");
+    }
+
+    result<int> LBEmulator::addWorker(const std::string &name, boost::asio::ip::address addr, u_int16_t port,
+        u_int16_t portRange, float weight) noexcept
+    {
+        if (portRange > 14)
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Port range must be between 0 and 14"};
+        if (weight < 0.)
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Worker weight must not be negative"};
+        if (static_cast<u_int32_t>(port) + (1 << portRange) - 1 > 65535)
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Worker port range extends past port 65535"};
+
+        boost::lock_guard<boost::mutex> lock(workersMtx);
+        for(auto &w: workers)
+            if (w.name == name)
+                return E2SARErrorInfo{E2SARErrorc::ParameterError, "Worker " + name + " already registered"};
+        workers.push_back(Worker{name, addr, port, portRange, weight, std::make_shared<WorkerCounters>()});
+        return 0;
+    }
+
+    result<int> LBEmulator::removeWorker(const std::string &name) noexcept
+    {
+        boost::lock_guard<boost::mutex> lock(workersMtx);
+        for(auto it = workers.begin(); it != workers.end(); ++it)
+        {
+            if (it->name == name)
+            {
+                workers.erase(it);
+                return 0;
+            }
+        }
+        return E2SARErrorInfo{E2SARErrorc::NotFound, "Worker " + name + " not registered"};
+    }
+
+    // called with workersMtx held
+    std::shared_ptr<const LBEmulator::Epoch> LBEmulator::makeEpoch(EventNum_t startTick) const noexcept
+    {
+        auto epoch = std::make_shared<Epoch>();
+        epoch->startTick = startTick;
+        epoch->slots.fill(-1);
+
+        std::vector<float> weights;
+        float totalWeight{0.};
+        for(auto &w: workers)
+        {
+            Member m;
+            m.name = w.name;
+            memset(&m.dest, 0, sizeof(m.dest));
+            if (w.addr.is_v6())
+            {
+                auto sa = reinterpret_cast<sockaddr_in6*>(&m.dest);
+                sa->sin6_family = AF_INET6;
+                auto bytes = w.addr.to_v6().to_bytes();
+                memcpy(&sa->sin6_addr, bytes.data(), bytes.size());
+                m.destLen = sizeof(sockaddr_in6);
+            }
+            else
+            {
+                auto sa = reinterpret_cast<sockaddr_in*>(&m.dest);
+                sa->sin_family = AF_INET;
+                sa->sin_addr.s_addr = htonl(w.addr.to_v4().to_uint());
+                m.destLen = sizeof(sockaddr_in);
+            }
+            m.port = w.port;
+            m.portMask = static_cast<u_int16_t>((1 << w.portRange) - 1);
+            m.counters = w.counters;
+            epoch->members.push_back(m);
+            weights.push_back(w.weight);
+            totalWeight += w.weight;
+        }
+
+        if (totalWeight <= 0.)
+            return epoch;
+
+        // smooth weighted round robin - every worker gets a share of slots proportional
+        // to its weight and its slots are spread evenly over the calendar, so consecutive
+        // ticks go to different workers
+        std::vector<float> current(weights.size(), 0.);
+        for(size_t slot = 0; slot < CALENDAR_SLOTS; slot++)
+        {
+            size_t best{0};
+            for(size_t i = 0; i < weights.size(); i++)
+            {
+                current[i] += weights[i];
+                if (current[i] > current[best])
+                    best = i;
+            }
+            current[best] -= totalWeight;
+            epoch->slots[slot] = static_cast<int32_t>(best);
+        }
+        return epoch;
+    }
+
+    result<int> LBEmulator::newEpoch(EventNum_t startTick) noexcept
+    {
+        boost::lock_guard<boost::mutex> lock(workersMtx);
+        auto cur = std::atomic_load(&schedule);
+        if (!cur->empty() && (cur->back()->startTick > startTick))
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Epoch cannot start before the newest epoch"};
+
+        auto next = std::make_shared<Schedule>(*cur);
+        // an epoch starting at the same tick replaces the previous one
+        if (!next->empty() && (next->back()->startTick == startTick))
+            next->pop_back();
+        next->push_back(makeEpoch(startTick));
+        if (next->size() > MAX_EPOCHS)
+            next->erase(next->begin());
+        std::atomic_store(&schedule, std::shared_ptr<const Schedule>(next));
+        return 0;
+    }
+
+    bool LBEmulator::parseLBHeader(const LBHdrU &hdr, EventNum_t &tick, u_int16_t &slotSel,
+        u_int16_t &portSel) noexcept
+    {
+        if ((hdr.lb2.preamble[0] != 'L') || (hdr.lb2.preamble[1] != 'B'))
+            return false;
+        if (hdr.lb2.check_version())
+        {
+            tick = hdr.lb2.get_eventNum();
+            slotSel = static_cast<u_int16_t>(tick);
+            portSel = hdr.lb2.get_entropy();
+            return true;
+        }
+        if (hdr.lb3.check_version())
+        {
+            tick = hdr.lb3.get_tick();
+            slotSel = hdr.lb3.get_slotSelect();
+            portSel = hdr.lb3.get_portSelect();
+            return true;
+        }
+        return false;
+    }
+
+    const LBEmulator::Member* LBEmulator::findMember(const Schedule &sched, EventNum_t tick,
+        u_int16_t slotSel) noexcept
+    {
+        if (sched.empty())
+            return nullptr;
+        // newest epoch that started at or before this tick, otherwise the oldest
+        const Epoch *epoch = sched.front().get();
+        for(auto it = sched.rbegin(); it != sched.rend(); ++it)
+        {
+            if ((*it)->startTick <= tick)
+            {
+                epoch = it->get();
+                break;
+            }
+        }
+        auto idx = epoch->slots[slotSel % CALENDAR_SLOTS];
+        if (idx < 0)
+            return nullptr;
+        return &epoch->members[idx];
+    }
+
+    result<std::pair<std::string, u_int16_t>> LBEmulator::route(const LBHdrU &hdr) const noexcept
+    {
+        EventNum_t tick;
+        u_int16_t slotSel, portSel;
+        if (!parseLBHeader(hdr, tick, slotSel, portSel))
+            return E2SARErrorInfo{E2SARErrorc::ParameterError, "Invalid LB header"};
+
+        auto sched = std::atomic_load(&schedule);
+        auto m = findMember(*sched, tick, slotSel);
+        if (m == nullptr)
+            return E2SARErrorInfo{E2SARErrorc::NotFound, "No worker assigned to the calendar slot"};
+        return std::make_pair(m->name, static_cast<u_int16_t>(m->port + (portSel & m->portMask)));
+    }
+
+    result<int> LBEmulator::openAndStart() noexcept
+    {
+        threadsStop = false;
+        for(size_t i = 0; i < numThreads; i++)
+        {
+            auto it = forwardThreadState.emplace(forwardThreadState.end(), *this, i);
+            auto open_stat = it->_open();
+            if (open_stat.has_error())
+            {
+                for(auto &fts: forwardThreadState)
+                    fts._close();
+                forwardThreadState.clear();
+                return E2SARErrorInfo{E2SARErrorc::SocketError,
+                    "Unable to open emulator sockets: " + open_stat.error().message()};
+            }
+        }
+
+        for(auto &fts: forwardThreadState)
+        {
+            boost::thread forwardT(&LBEmulator::ForwardThreadState::_threadBody, &fts);
+            fts.threadObj = std::move(forwardT);
+        }
+        return 0;
+    }
+
+    void LBEmulator::stopThreads()
+    {
+        threadsStop = true;
+        for(auto &fts: forwardThreadState)
+        {
+            if (fts.threadObj.joinable())
+                fts.threadObj.join();
+            fts._close();
+        }
+        forwardThreadState.clear();
+    }
+
+    std::vector<LBEmulator::WorkerForwardStats> LBEmulator::getWorkerStats() noexcept
+    {
+        std::vector<WorkerForwardStats> ret;
+        boost::lock_guard<boost::mutex> lock(workersMtx);
+        for(auto &w: workers)
+            ret.push_back(WorkerForwardStats{w.name, w.counters->packets.load(std::memory_order_relaxed),
+                w.counters->bytes.load(std::memory_order_relaxed)});
+        return ret;
+    }
+
+    result<int> LBEmulator::ForwardThreadState::_open() noexcept
+    {
+        // close whatever was opened so far and report the error (with errno)
+        auto fail = [this](const std::string &what) -> E2SARErrorInfo {
+            std::string msg{what + strerror(errno)};
+            _close();
+            return E2SARErrorInfo{E2SARErrorc::SocketError, msg};
+        };
+
+        int one{1};
+        // receive socket, shared with the other forwarding threads via SO_REUSEPORT
+        if (emu.listenAddr.is_v6())
+        {
+            recvFd = socket(AF_INET6, SOCK_DGRAM, 0);
+            if (recvFd < 0)
+                return fail("Unable to open receive socket: "s);
+            sockaddr_in6 rxAddr{};
+            rxAddr.sin6_family = AF_INET6;
+            rxAddr.sin6_port = htons(emu.listenPort);
+            auto bytes = emu.listenAddr.to_v6().to_bytes();
+            memcpy(&rxAddr.sin6_addr, bytes.data(), bytes.size());
+            if ((setsockopt(recvFd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) ||
+                (setsockopt(recvFd, SOL_SOCKET, SO_RCVBUF, &emu.rcvSocketBufSize, sizeof(emu.rcvSocketBufSize)) < 0))
+                return fail("Unable to set receive socket options: "s);
+            if (bind(recvFd, reinterpret_cast<sockaddr*>(&rxAddr), sizeof(rxAddr)) < 0)
+                return fail("Unable to bind receive socket: "s);
+        }
+        else
+        {
+            recvFd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (recvFd < 0)
+                return fail("Unable to open receive socket: "s);
+            sockaddr_in rxAddr{};
+            rxAddr.sin_family = AF_INET;
+            rxAddr.sin_port = htons(emu.listenPort);
+            rxAddr.sin_addr.s_addr = htonl(emu.listenAddr.to_v4().to_uint());
+            if ((setsockopt(recvFd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) ||
+                (setsockopt(recvFd, SOL_SOCKET, SO_RCVBUF, &emu.rcvSocketBufSize, sizeof(emu.rcvSocketBufSize)) < 0))
+                return fail("Unable to set receive socket options: "s);
+            if (bind(recvFd, reinterpret_cast<sockaddr*>(&rxAddr), sizeof(rxAddr)) < 0)
+                return fail("Unable to bind receive socket: "s);
+        }
+        // wake up periodically to check for the stop signal
+        struct timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = RECV_TIMEOUT_MS * 1000;
+        if (setsockopt(recvFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+            return fail("Unable to set receive timeout: "s);
+
+        // unconnected send sockets, workers may be of either address family. A family the
+        // host doesn't support (e.g. no IPv6) is left closed, forwarding to its workers
+        // then counts as send errors
+        for (auto &[fd, family]: {std::make_pair(&sendFd4, AF_INET), std::make_pair(&sendFd6, AF_INET6)})
+        {
+            *fd = socket(family, SOCK_DGRAM, 0);
+            if (*fd < 0)
+            {
+                if (errno == EAFNOSUPPORT)
+                    continue;
+                return fail("Unable to open send sockets: "s);
+            }
+            if (setsockopt(*fd, SOL_SOCKET, SO_SNDBUF, &emu.sndSocketBufSize, sizeof(emu.sndSocketBufSize)) < 0)
+                return fail("Unable to set send buffer size: "s);
+        }
+
+        // receive headers point into the buffer slots, those never change
+        memset(recvMsgs.data(), 0, sizeof(mmsghdr) * BATCH_SIZE);
+        for(size_t i = 0; i < BATCH_SIZE; i++)
+        {
+            recvIov[i].iov_base = buffers.data() + i * MAX_DATAGRAM_SIZE;
+            recvIov[i].iov_len = MAX_DATAGRAM_SIZE;
+            recvMsgs[i].msg_hdr.msg_iov = &recvIov[i];
+            recvMsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        return 0;
+    }
+
+    void LBEmulator::ForwardThreadState::_close() noexcept
+    {
+        for(auto fd: {&recvFd, &sendFd4, &sendFd6})
+        {
+            if (*fd >= 0)
+                close(*fd);
+            *fd = -1;
+        }
+    }
+
+    void LBEmulator::ForwardThreadState::_threadBody()
+    {
+        while(!emu.threadsStop)
+        {
+            size_t numRecvd{0};
+#ifdef SENDMMSG_AVAILABLE
+            // block for the first datagram, then take whatever else is already queued
+            int ret = recvmmsg(recvFd, recvMsgs.data(), BATCH_SIZE, MSG_WAITFORONE, nullptr);
+            if (ret < 0)
+            {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+                {
+                    emu.stats.recvErrors++;
+                    emu.stats.lastErrno = errno;
+                }
+                continue;
+            }
+            numRecvd = static_cast<size_t>(ret);
+#else
+            for(; numRecvd < BATCH_SIZE; numRecvd++)
+            {
+                ssize_t ret = recvmsg(recvFd, &recvMsgs[numRecvd].msg_hdr, (numRecvd == 0 ? 0 : MSG_DONTWAIT));
+                if (ret < 0)
+                {
+                    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+                    {
+                        emu.stats.recvErrors++;
+                        emu.stats.lastErrno = errno;
+                    }
+                    break;
+                }
+                recvMsgs[numRecvd].msg_len = static_cast<unsigned int>(ret);
+            }
+            if (numRecvd == 0)
+                continue;
+#endif
+            // one schedule per batch, epochs changing mid-batch are picked up by the next one
+            auto sched = std::atomic_load(&emu.schedule);
+            _forward(*sched, numRecvd);
+        }
+    }
+
+    size_t LBEmulator::ForwardThreadState::_forward(const Schedule &sched, size_t numRecvd) noexcept
+    {
+        // datagrams are sent in order, split into runs by address family
+        size_t num4{0}, num6{0};
+        std::array<mmsghdr, BATCH_SIZE> msgs6;
+        u_int64_t bytesRecvd{0};
+        EventNum_t batchMaxTick{0};
+
+        for(size_t i = 0; i < numRecvd; i++)
+        {
+            auto len = recvMsgs[i].msg_len;
+            bytesRecvd += len;
+            auto buf = reinterpret_cast<u_int8_t*>(recvIov[i].iov_base);
+            if (len <= sizeof(LBHdrU))
+            {
+                emu.stats.badHeaderDiscards++;
+                continue;
+            }
+            EventNum_t tick;
+            u_int16_t slotSel, portSel;
+            if (!parseLBHeader(*reinterpret_cast<const LBHdrU*>(buf), tick, slotSel, portSel))
+            {
+                emu.stats.badHeaderDiscards++;
+                continue;
+            }
+            batchMaxTick = std::max(batchMaxTick, tick);
+
+            auto mp = findMember(sched, tick, slotSel);
+            if (mp == nullptr)
+            {
+                emu.stats.noWorkerDiscards++;
+                continue;
+            }
+            auto &m = *mp;
+            auto payloadLen = len - sizeof(LBHdrU);
+            m.counters->packets.fetch_add(1, std::memory_order_relaxed);
+            m.counters->bytes.fetch_add(payloadLen, std::memory_order_relaxed);
+
+            // strip the LB header and point the datagram at the selected worker port
+            auto slot = num4 + num6;
+            dests[slot] = m.dest;
+            u_int16_t port = htons(m.port + (portSel & m.portMask));
+            if (m.dest.ss_family == AF_INET6)
+                reinterpret_cast<sockaddr_in6*>(&dests[slot])->sin6_port = port;
+            else
+                reinterpret_cast<sockaddr_in*>(&dests[slot])->sin_port = port;
+            sendIov[slot].iov_base = buf + sizeof(LBHdrU);
+            sendIov[slot].iov_len = payloadLen;
+
+            auto &msg = (m.dest.ss_family == AF_INET6 ? msgs6[num6++] : sendMsgs[num4++]);
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_hdr.msg_name = &dests[slot];
+            msg.msg_hdr.msg_namelen = m.destLen;
+            msg.msg_hdr.msg_iov = &sendIov[slot];
+            msg.msg_hdr.msg_iovlen = 1;
+        }
+
+        emu.stats.packetsReceived.fetch_add(numRecvd, std::memory_order_relaxed);
+        emu.stats.bytesReceived.fetch_add(bytesRecvd, std::memory_order_relaxed);
+        auto prevMax = emu.maxTick.load(std::memory_order_relaxed);
+        while ((batchMaxTick > prevMax) &&
+            !emu.maxTick.compare_exchange_weak(prevMax, batchMaxTick, std::memory_order_relaxed));
+
+        if (num4 > 0)
+            _send(sendFd4, sendMsgs.data(), num4);
+        if (num6 > 0)
+            _send(sendFd6, msgs6.data(), num6);
+        return num4 + num6;
+    }
+
+    void LBEmulator::ForwardThreadState::_send(int fd, mmsghdr *msgs, size_t num) noexcept
+    {
+        // no socket of this address family on this host
+        if (fd < 0)
+        {
+            emu.stats.sendErrors.fetch_add(num, std::memory_order_relaxed);
+            emu.stats.lastErrno = EAFNOSUPPORT;
+            return;
+        }
+        size_t sent{0};
+        while (sent < num)
+        {
+#ifdef SENDMMSG_AVAILABLE
+            int ret = sendmmsg(fd, msgs + sent, num - sent, 0);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                // skip the datagram that failed and carry on with the rest
+                emu.stats.sendErrors++;
+                emu.stats.lastErrno = errno;
+                sent++;
+                continue;
+            }
+            sent += ret;
+            emu.stats.packetsForwarded.fetch_add(ret, std::memory_order_relaxed);
+#else
+            if (sendmsg(fd, &msgs[sent].msg_hdr, 0) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                emu.stats.sendErrors++;
+                emu.stats.lastErrno = errno;
+            }
+            else
+                emu.stats.packetsForwarded++;
+            sent++;
+#endif
+        }
+    }
+}
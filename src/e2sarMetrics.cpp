@@ -0,0 +1,548 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+
+#include <sstream>
+#include <iomanip>
+#include <map>
+
+#include "portable_endian.h"
+
+#include "e2sarDPSegmenter.hpp"
+#include "e2sarDPReassembler.hpp"
+#include "e2sarMetrics.hpp"
+
+namespace e2sar
+{
+    namespace {
+    /**
+     * Accumulates samples grouped by metric family, since OpenMetrics requires all
+     * samples of a family to follow its TYPE line regardless of which object they came from
+     */
+    class MetricsWriter
+    {
+        private:
+            struct Family {
+                std::string type;
+                std::string help;
+                std::string unit;
+                std::ostringstream samples;
+            };
+            std::vector<std::string> order;
+            std::map<std::string, Family> families;
+
+            // smallest and largest power of 2 nanoseconds used as histogram bucket bound (~1us to ~17s)
+            static constexpr size_t MIN_BUCKET_POW2{10};
+            static constexpr size_t MAX_BUCKET_POW2{34};
+
+            Family& family(const std::string &name, const std::string &type,
+                const std::string &help, const std::string &unit="")
+            {
+                auto it = families.find(name);
+                if (it == families.end())
+                {
+                    order.push_back(name);
+                    it = families.emplace(name, Family{}).first;
+                    it->second.type = type;
+                    it->second.help = help;
+                    it->second.unit = unit;
+                }
+                return it->second;
+            }
+
+            static std::string escape(const std::string &v)
+            {
+                std::string ret;
+                for(auto c: v)
+                {
+                    if (c == '\\')
+                        ret += "\\\\";
+                    else if (c == '"')
+                        ret += "\\\"";
+                    else if (c == '\n')
+                        ret += "\\n";
+                    else
+                        ret += c;
+                }
+                return ret;
+            }
+
+        public:
+            // label set rendered as {name="value",...}
+            using Labels = std::vector<std::pair<std::string, std::string>>;
+
+            static std::string labels(const Labels &lbls)
+            {
+                if (lbls.empty())
+                    return "";
+                std::string ret{"{"};
+                for(size_t i = 0; i < lbls.size(); i++)
+                {
+                    if (i > 0)
+                        ret += ",";
+                    ret += lbls[i].first + "=\"" + escape(lbls[i].second) + "\"";
+                }
+                return ret + "}";
+            }
+
+            template<typename T>
+            void counter(const std::string &name, const std::string &help, const Labels &lbls, T value)
+            {
+                family(name, "counter", help).samples << name << "_total" << labels(lbls) << " " << value << "\n";
+            }
+
+            template<typename T>
+            void gauge(const std::string &name, const std::string &help, const Labels &lbls, T value)
+            {
+                family(name, "gauge", help).samples << name << labels(lbls) << " " << value << "\n";
+            }
+
+            // histogram of values recorded in nanoseconds, exposed in seconds with
+            // buckets ending just below powers of 2 nanoseconds (histogram buckets never
+            // straddle a power of 2, so each le bound is the exact top of the buckets it covers)
+            void histogram(const std::string &name, const std::string &help, const Labels &lbls,
+                const LatencyHistogram::Snapshot &snap)
+            {
+                auto &f = family(name, "histogram", help, "seconds");
+                size_t idx{0};
+                u_int64_t cumulative{0};
+                for(size_t pow2 = MIN_BUCKET_POW2; pow2 <= MAX_BUCKET_POW2; pow2++)
+                {
+                    // largest value counted so far, a value of exactly 2^pow2 lands in the next bucket
+                    u_int64_t bound = (1ULL << pow2) - 1;
+                    while ((idx < snap.counts.size()) && (LatencyHistogram::bucketUpperBound(idx) <= bound))
+                        cumulative += snap.counts[idx++];
+                    Labels bl{lbls};
+                    std::ostringstream le;
+                    le << std::setprecision(11) << bound / 1e9;
+                    bl.push_back(std::make_pair("le", le.str()));
+                    f.samples << name << "_bucket" << labels(bl) << " " << cumulative << "\n";
+                }
+                Labels bl{lbls};
+                bl.push_back(std::make_pair("le", "+Inf"));
+                f.samples << name << "_bucket" << labels(bl) << " " << snap.count << "\n";
+                f.samples << name << "_count" << labels(lbls) << " " << snap.count << "\n";
+                f.samples << name << "_sum" << labels(lbls) << " " << std::setprecision(9) <<
+                    snap.mean * snap.count / 1e9 << "\n";
+            }
+
+            std::string str() const
+            {
+                std::ostringstream os;
+                for(auto &name: order)
+                {
+                    auto &f = families.at(name);
+                    os << "# TYPE " << name << " " << f.type << "\n";
+                    if (not f.unit.empty())
+                        os << "# UNIT " << name << " " << f.unit << "\n";
+                    os << "# HELP " << name << " " << f.help << "\n";
+                    os << f.samples.str();
+                }
+                os << "# EOF\n";
+                return os.str();
+            }
+    };
+    }
+
+    MetricsExporter::MetricsExporter(const boost::asio::ip::address &addr, u_int16_t port):
+        listenAddr{addr}, listenPort{port}, serverThreadState(*this)
+    {
+    }
+
+    MetricsExporter::~MetricsExporter()
+    {
+        stop();
+    }
+
+    result<int> MetricsExporter::addSegmenter(const Segmenter &seg, const std::string &name) noexcept
+    {
+        boost::lock_guard<boost::mutex> guard(registryMtx);
+        for(auto &se: segmenters)
+            if (se.name == name)
+                return E2SARErrorInfo{E2SARErrorc::ParameterError, "Segmenter with name " + name + " already registered"};
+        segmenters.push_back(SegmenterEntry{&seg, name});
+        return 0;
+    }
+
+    result<int> MetricsExporter::addReassembler(const Reassembler &reas, const std::string &name) noexcept
+    {
+        boost::lock_guard<boost::mutex> guard(registryMtx);
+        for(auto &re: reassemblers)
+            if (re.name == name)
+                return E2SARErrorInfo{E2SARErrorc::ParameterError, "Reassembler with name " + name + " already registered"};
+        reassemblers.push_back(ReassemblerEntry{&reas, name});
+        return 0;
+    }
+
+    const std::string MetricsExporter::render() const
+    {
+        MetricsWriter mw;
+
+        boost::lock_guard<boost::mutex> guard(registryMtx);
+        for(auto &se: segmenters)
+        {
+            MetricsWriter::Labels lbls{std::make_pair("name", se.name)};
+            auto sendStats = se.seg->getSendStats();
+            auto syncStats = se.seg->getSyncStats();
+            auto latency = se.seg->getLatencyStats();
+
+            mw.counter("e2sar_segmenter_frames_sent", "Event fragments sent", lbls, sendStats.msgCnt);
+            mw.counter("e2sar_segmenter_send_errors", "Errors encountered sending fragments", lbls, sendStats.errCnt);
+            mw.counter("e2sar_segmenter_sync_sent", "Sync messages sent", lbls, syncStats.msgCnt);
+            mw.counter("e2sar_segmenter_sync_errors", "Errors encountered sending sync messages", lbls, syncStats.errCnt);
+            mw.counter("e2sar_segmenter_enobufs", "Sends that failed with ENOBUFS", lbls, sendStats.enobufsCnt);
+            mw.counter("e2sar_segmenter_socket_queue_saturated", "Send socket buffer samples at least 90% full",
+                lbls, sendStats.sndQueueSaturated);
+            mw.gauge("e2sar_segmenter_socket_queue_high_water_bytes", "Largest send socket buffer occupancy sampled",
+                lbls, sendStats.sndQueueHighWater);
+            mw.gauge("e2sar_segmenter_send_queue_depth", "Events waiting in the send queue", lbls,
+                se.seg->getSendQueueDepth());
+            mw.histogram("e2sar_segmenter_enqueue_to_dequeue_seconds",
+                "Time from addToSendQueue() to the send thread dequeuing the event", lbls, latency.enqueueToDequeue);
+            mw.histogram("e2sar_segmenter_dequeue_to_first_send_seconds",
+                "Time from dequeuing the event to its first fragment handed to the kernel", lbls, latency.dequeueToFirstSend);
+            mw.histogram("e2sar_segmenter_send_duration_seconds",
+                "Time to fragment and send an event", lbls, latency.sendDuration);
+            for(size_t i = 0; i < latency.sendDurationBySize.size(); i++)
+            {
+                MetricsWriter::Labels blbls{lbls};
+                blbls.push_back(std::make_pair("size_below", i < Segmenter::SEND_SIZE_BUCKETS - 1 ? 
+                    std::to_string(Segmenter::sendSizeBucketLimit(i)) : "+Inf"));
+                mw.histogram("e2sar_segmenter_send_duration_by_size_seconds",
+                    "Time to fragment and send an event by event size", blbls, latency.sendDurationBySize[i]);
+            }
+            mw.gauge("e2sar_segmenter_outstanding_sends", "io_uring sends whose completions were not reaped yet",
+                lbls, se.seg->getOutstandingSends());
+            for(auto &ss: se.seg->getSocketStats())
+            {
+                MetricsWriter::Labels slbls{lbls};
+                slbls.push_back(std::make_pair("socket", std::to_string(ss.index)));
+                mw.counter("e2sar_segmenter_socket_frames_sent", "Event fragments sent per send socket", slbls, ss.fragments);
+                mw.counter("e2sar_segmenter_socket_bytes_sent", "Bytes sent per send socket including LB+RE headers",
+                    slbls, ss.bytes);
+                mw.counter("e2sar_segmenter_socket_send_errors", "Failed sends per send socket", slbls, ss.errors);
+                mw.counter("e2sar_segmenter_socket_eagain", "Sends that failed with EAGAIN per send socket", slbls, ss.eagain);
+                mw.counter("e2sar_segmenter_socket_enobufs", "Sends that failed with ENOBUFS per send socket",
+                    slbls, ss.enobufs);
+                mw.gauge("e2sar_segmenter_socket_uring_sq_ready", "io_uring submissions not yet consumed by the kernel",
+                    slbls, ss.sqReady);
+                mw.gauge("e2sar_segmenter_socket_uring_cq_ready", "io_uring completions waiting to be reaped",
+                    slbls, ss.cqReady);
+            }
+        }
+
+        for(auto &re: reassemblers)
+        {
+            MetricsWriter::Labels lbls{std::make_pair("name", re.name)};
+            auto stats = re.reas->getStats();
+            auto lossStats = re.reas->getLostEventStats();
+            auto latency = re.reas->getLatencyStats();
+
+            mw.counter("e2sar_reassembler_events_received", "Events successfully reassembled", lbls, stats.eventSuccess);
+            mw.counter("e2sar_reassembler_events_lost_reassembly", "Events lost in reassembly due to missing segments",
+                lbls, stats.reassemblyLoss);
+            mw.counter("e2sar_reassembler_events_lost_enqueue", "Events reassembled and lost because the event queue was full",
+                lbls, stats.enqueueLoss);
+            mw.counter("e2sar_reassembler_events_never_seen", "Events for which no fragments arrived (only with trackSequence)",
+                lbls, stats.neverSeenLoss);
+            mw.counter("e2sar_reassembler_packets_received", "Fragments received", lbls, stats.totalPackets);
+            mw.counter("e2sar_reassembler_bytes_received", "Bytes received", lbls, stats.totalBytes);
+            mw.counter("e2sar_reassembler_bad_header_discards", "Fragments discarded due to bad RE header",
+                lbls, stats.badHeaderDiscards);
+            mw.counter("e2sar_reassembler_adaptive_timeout_misses", "Events expired by adaptive timeout that a late fragment then arrived for",
+                lbls, stats.adaptiveTimeoutMisses);
+            mw.counter("e2sar_reassembler_data_errors", "Data plane errors", lbls, stats.dataErrCnt);
+            mw.counter("e2sar_reassembler_grpc_errors", "Control plane gRPC errors", lbls, stats.grpcErrCnt);
+            mw.counter("e2sar_reassembler_busy_poll_spins", "Busy poll rounds over all sockets", lbls, stats.busyPollSpins);
+            mw.counter("e2sar_reassembler_busy_poll_hits", "Busy poll rounds that returned data", lbls, stats.busyPollHits);
+            mw.counter("e2sar_reassembler_busy_poll_fallbacks", "Times the busy poll spin budget ran out",
+                lbls, stats.busyPollFallbacks);
+            mw.counter("e2sar_reassembler_kernel_drops", "Datagrams dropped by the kernel because receive socket buffers were full",
+                lbls, stats.kernelDrops);
+            mw.counter("e2sar_reassembler_lost_event_ring_overwrites", "Lost event records overwritten before being read",
+                lbls, lossStats.ringOverwrites);
+            for(auto &dl: lossStats.perDataId)
+            {
+                MetricsWriter::Labels dlbls{lbls};
+                dlbls.push_back(std::make_pair("session", std::to_string(std::get<0>(dl))));
+                dlbls.push_back(std::make_pair("data_id", std::to_string(std::get<1>(dl))));
+                mw.counter("e2sar_reassembler_events_lost_by_data_id", "Events lost in reassembly or enqueue per data id",
+                    dlbls, std::get<2>(dl));
+            }
+            for(auto &dl: lossStats.neverSeenPerDataId)
+            {
+                MetricsWriter::Labels dlbls{lbls};
+                dlbls.push_back(std::make_pair("session", std::to_string(std::get<0>(dl))));
+                dlbls.push_back(std::make_pair("data_id", std::to_string(std::get<1>(dl))));
+                mw.counter("e2sar_reassembler_events_never_seen_by_data_id", "Events never seen per data id",
+                    dlbls, std::get<2>(dl));
+            }
+            // only with perDataIdStats
+            for(auto &ds: re.reas->getDataIdStats())
+            {
+                MetricsWriter::Labels dlbls{lbls};
+                dlbls.push_back(std::make_pair("session", std::to_string(ds.session)));
+                dlbls.push_back(std::make_pair("data_id", std::to_string(ds.dataId)));
+                mw.counter("e2sar_reassembler_data_id_events", "Events reassembled per data id", dlbls, ds.events);
+                mw.counter("e2sar_reassembler_data_id_bytes", "Bytes in reassembled events per data id", dlbls, ds.bytes);
+                mw.counter("e2sar_reassembler_data_id_fragments", "Fragments of reassembled events per data id", 
+                    dlbls, ds.fragments);
+                mw.counter("e2sar_reassembler_data_id_lost_reassembly", "Incomplete events timed out per data id", 
+                    dlbls, ds.reassemblyLoss);
+                mw.counter("e2sar_reassembler_data_id_lost_enqueue", "Events lost on enqueue per data id", 
+                    dlbls, ds.enqueueLoss);
+                mw.counter("e2sar_reassembler_data_id_timeout_misses", 
+                    "Events expired by adaptive timeout that a late fragment then arrived for per data id", 
+                    dlbls, ds.timeoutMisses);
+            }
+            mw.counter("e2sar_reassembler_data_id_stats_overflow", 
+                "Events of data ids that didn't fit into the per data id stats table", 
+                lbls, re.reas->getDataIdStatsOverflow());
+            // only available once the receive threads are started
+            auto fdStats = re.reas->get_FDStats();
+            if (!fdStats.has_error())
+            {
+                for(auto &ps: fdStats.value())
+                {
+                    MetricsWriter::Labels plbls{lbls};
+                    plbls.push_back(std::make_pair("port", std::to_string(ps.first)));
+                    mw.counter("e2sar_reassembler_port_fragments", "Fragments received per UDP port", plbls, ps.second);
+                }
+            }
+            auto dropStats = re.reas->get_PortDropStats();
+            if (!dropStats.has_error())
+            {
+                for(auto &ps: dropStats.value())
+                {
+                    MetricsWriter::Labels plbls{lbls};
+                    plbls.push_back(std::make_pair("port", std::to_string(ps.first)));
+                    mw.counter("e2sar_reassembler_port_kernel_drops", "Datagrams dropped by the kernel per UDP port", 
+                        plbls, ps.second);
+                }
+            }
+            mw.histogram("e2sar_reassembler_first_to_complete_seconds",
+                "Time from the first segment of an event arriving to the event being complete", lbls, latency.firstToComplete);
+            mw.histogram("e2sar_reassembler_complete_to_dequeue_seconds",
+                "Time from an event being complete to the application picking it up", lbls, latency.completeToDequeue);
+
+            // each hosted session has its own event queue, controller and control plane connection
+            for(size_t i = 0; i < re.reas->get_numSessions(); i++)
+            {
+                auto sessRes = re.reas->getSessionStats(i);
+                if (sessRes.has_error())
+                    continue;
+                auto &sess = sessRes.value();
+                MetricsWriter::Labels slbls{lbls};
+                slbls.push_back(std::make_pair("session", std::to_string(i)));
+                mw.gauge("e2sar_reassembler_event_queue_depth", "Reassembled events waiting to be picked up",
+                    slbls, sess.queueDepth);
+                mw.gauge("e2sar_reassembler_pid_fill_percent", "Event queue occupancy last reported to the control plane",
+                    slbls, sess.control.fillPercent);
+                mw.gauge("e2sar_reassembler_pid_control_signal", "PID control signal last reported to the control plane",
+                    slbls, sess.control.controlSignal);
+                mw.gauge("e2sar_reassembler_pid_error", "PID error term", slbls, sess.control.error);
+                mw.gauge("e2sar_reassembler_pid_integral", "PID integral accumulator", slbls, sess.control.integral);
+
+                auto &sendState = sess.sendState;
+                mw.counter("e2sar_reassembler_sendstate_rpcs", "SendState RPCs issued to the control plane", 
+                    slbls, sendState.sent);
+                mw.counter("e2sar_reassembler_sendstate_failures", "SendState RPCs that failed, including deadline expirations",
+                    slbls, sendState.failed);
+                mw.counter("e2sar_reassembler_sendstate_deadline_exceeded", "SendState RPCs that ran past their deadline",
+                    slbls, sendState.deadlineExceeded);
+                mw.counter("e2sar_reassembler_sendstate_coalesced", "SendState updates replaced by a newer one before being sent",
+                    slbls, sendState.coalesced);
+                mw.gauge("e2sar_reassembler_sendstate_backoff_ms", "Time left before the next SendState RPC after failures",
+                    slbls, sendState.backoff_ms);
+                mw.histogram("e2sar_reassembler_sendstate_rpc_seconds", "SendState RPC round trip time",
+                    slbls, sendState.rpcLatency);
+            }
+        }
+        // host-wide counters also covering sockets outside of E2SAR
+        auto udpErrors = NetUtil::getUDPBufferErrors();
+        if (!udpErrors.has_error())
+        {
+            mw.counter("e2sar_host_udp_rcvbuf_errors", "Host-wide UDP datagrams dropped due to full receive buffers",
+                {}, udpErrors.value().get<0>());
+            mw.counter("e2sar_host_udp_sndbuf_errors", "Host-wide UDP sends failed due to lack of send buffer",
+                {}, udpErrors.value().get<1>());
+        }
+        return mw.str();
+    }
+
+    result<int> MetricsExporter::start() noexcept
+    {
+        if (running)
+            return E2SARErrorInfo{E2SARErrorc::LogicError, "Metrics exporter already started"};
+
+        auto openRes = serverThreadState._open();
+        if (openRes.has_error())
+            return openRes;
+
+        threadsStop = false;
+        boost::thread serverT(&ServerThreadState::_threadBody, &serverThreadState);
+        serverThreadState.threadObj = std::move(serverT);
+        running = true;
+        return 0;
+    }
+
+    void MetricsExporter::stop() noexcept
+    {
+        if (not running)
+            return;
+        threadsStop = true;
+        serverThreadState.threadObj.join();
+        serverThreadState._close();
+        running = false;
+    }
+
+    result<int> MetricsExporter::ServerThreadState::_open() noexcept
+    {
+        int on{1};
+        if (exp.listenAddr.is_v6())
+        {
+            if ((socketFd = socket(AF_INET6, SOCK_STREAM, 0)) < 0)
+                return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
+            setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+            sockaddr_in6 addr6{};
+            addr6.sin6_family = AF_INET6;
+            addr6.sin6_port = htobe16(exp.listenPort);
+            inet_pton(AF_INET6, exp.listenAddr.to_string().c_str(), &addr6.sin6_addr);
+            if (bind(socketFd, (const sockaddr *) &addr6, sizeof(addr6)) < 0)
+            {
+                auto err = errno;
+                _close();
+                return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(err)};
+            }
+            socklen_t addrLen{sizeof(addr6)};
+            getsockname(socketFd, (sockaddr *) &addr6, &addrLen);
+            exp.listenPort = be16toh(addr6.sin6_port);
+        }
+        else
+        {
+            if ((socketFd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+                return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(errno)};
+            setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+            sockaddr_in addr4{};
+            addr4.sin_family = AF_INET;
+            addr4.sin_port = htobe16(exp.listenPort);
+            inet_pton(AF_INET, exp.listenAddr.to_string().c_str(), &addr4.sin_addr);
+            if (bind(socketFd, (const sockaddr *) &addr4, sizeof(addr4)) < 0)
+            {
+                auto err = errno;
+                _close();
+                return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(err)};
+            }
+            socklen_t addrLen{sizeof(addr4)};
+            getsockname(socketFd, (sockaddr *) &addr4, &addrLen);
+            exp.listenPort = be16toh(addr4.sin_port);
+        }
+
+        if (listen(socketFd, SOMAXCONN) < 0)
+        {
+            auto err = errno;
+            _close();
+            return E2SARErrorInfo{E2SARErrorc::SocketError, strerror(err)};
+        }
+        return 0;
+    }
+
+    void MetricsExporter::ServerThreadState::_close() noexcept
+    {
+        if (socketFd >= 0)
+            close(socketFd);
+        socketFd = -1;
+    }
+
+    void MetricsExporter::ServerThreadState::_threadBody()
+    {
+        while(!exp.threadsStop)
+        {
+            fd_set curSet;
+            FD_ZERO(&curSet);
+            FD_SET(socketFd, &curSet);
+            // wait with a timeout so we notice the stop signal
+            struct timeval timeout{0, ACCEPT_POLL_MS * 1000};
+            if (select(socketFd + 1, &curSet, nullptr, nullptr, &timeout) <= 0)
+                continue;
+
+            int clientFd = accept(socketFd, nullptr, nullptr);
+            if (clientFd < 0)
+                continue;
+            // a request that can't be served (e.g. out of memory rendering it) just drops the connection
+            try {
+                _serve(clientFd);
+            } catch (const std::exception &e) {}
+            close(clientFd);
+        }
+    }
+
+    void MetricsExporter::ServerThreadState::_serve(int clientFd)
+    {
+        // don't let a slow client stall the exporter
+        struct timeval timeout{REQUEST_TIMEOUT_MS / 1000, (REQUEST_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // read up to the end of the request headers
+        std::string request;
+        char buf[1024];
+        while ((request.find("\r\n\r\n") == std::string::npos) && (request.size() < MAX_REQUEST_SIZE))
+        {
+            auto nbytes = recv(clientFd, buf, sizeof(buf), 0);
+            if (nbytes <= 0)
+                break;
+            request.append(buf, nbytes);
+        }
+
+        std::string status{"200 OK"};
+        std::string contentType{CONTENT_TYPE};
+        std::string body;
+
+        // request line is 'METHOD PATH VERSION', query string is ignored
+        std::istringstream requestLine(request.substr(0, request.find("\r\n")));
+        std::string method, path;
+        requestLine >> method >> path;
+        path = path.substr(0, path.find('?'));
+        if ((method != "GET") && (method != "HEAD"))
+        {
+            status = "405 Method Not Allowed";
+            contentType = "text/plain";
+            body = "Only GET is supported\n";
+        }
+        else if ((path != "/metrics") && (path != "/"))
+        {
+            status = "404 Not Found";
+            contentType = "text/plain";
+            body = "Metrics are served at /metrics\n";
+        }
+        else
+            body = exp.render();
+
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << "\r\n" <<
+            "Content-Type: " << contentType << "\r\n" <<
+            "Content-Length: " << body.size() << "\r\n" <<
+            "Connection: close\r\n\r\n";
+        if (method != "HEAD")
+            response << body;
+
+        auto out = response.str();
+        size_t sent{0};
+        while (sent < out.size())
+        {
+            auto nbytes = send(clientFd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (nbytes <= 0)
+                break;
+            sent += nbytes;
+        }
+    }
+}
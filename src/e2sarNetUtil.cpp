@@ -7,6 +7,9 @@
 #include <sys/socket.h>
 #include <ifaddrs.h>
 
+#include <fstream>
+#include <sstream>
+
 #include "e2sarNetUtil.hpp"
 
 namespace e2sar
@@ -172,4 +175,50 @@ namespace e2sar
     #endif
         return outstanding;
   }
+
+    result<boost::tuple<u_int64_t, u_int64_t>> NetUtil::getUDPBufferErrors() noexcept
+    {
+        std::ifstream snmp("/proc/net/snmp");
+        if (!snmp.is_open())
+            return E2SARErrorInfo{E2SARErrorc::SystemError, "Unable to open /proc/net/snmp"};
+
+        // the Udp: section is a line of counter names followed by a line of values
+        std::string line, names;
+        while (std::getline(snmp, line))
+        {
+            if (line.rfind("Udp:", 0) != 0)
+                continue;
+            if (names.empty())
+            {
+                names = line;
+                continue;
+            }
+            std::istringstream nameStream(names), valueStream(line);
+            std::string name, value;
+            u_int64_t rcvbufErrors{0}, sndbufErrors{0};
+            bool found{false};
+            // strtoull rather than std::stoull, which throws on malformed values
+            auto parse = [](const std::string &v, u_int64_t &out) {
+                char *end{nullptr};
+                errno = 0;
+                out = strtoull(v.c_str(), &end, 10);
+                return (errno == 0) && (end != v.c_str()) && (*end == '\0');
+            };
+            while ((nameStream >> name) && (valueStream >> value))
+            {
+                if (name == "RcvbufErrors")
+                {
+                    if (!parse(value, rcvbufErrors))
+                        return E2SARErrorInfo{E2SARErrorc::SystemError, "Unable to parse RcvbufErrors value " + value};
+                    found = true;
+                }
+                else if ((name == "SndbufErrors") && !parse(value, sndbufErrors))
+                    return E2SARErrorInfo{E2SARErrorc::SystemError, "Unable to parse SndbufErrors value " + value};
+            }
+            if (!found)
+                break;
+            return boost::make_tuple<u_int64_t, u_int64_t>(rcvbufErrors, sndbufErrors);
+        }
+        return E2SARErrorInfo{E2SARErrorc::NotFound, "UDP buffer error counters not found in /proc/net/snmp"};
+    }
 }
@@ -0,0 +1,138 @@
+#include <fstream>
+
+#include "e2sarTrace.hpp"
+
+namespace e2sar
+{
+    std::string traceActionName(TraceAction a) noexcept
+    {
+        switch(a)
+        {
+            case TraceAction::segEventDequeued: return "SEG_DEQUEUED";
+            case TraceAction::segFragmentSent: return "SEG_FRAG_SENT";
+            case TraceAction::segEventSent: return "SEG_EVENT_SENT";
+            case TraceAction::segSendError: return "SEG_SEND_ERROR";
+            case TraceAction::reasFragmentReceived: return "REAS_FRAG_RECV";
+            case TraceAction::reasEventStarted: return "REAS_EVENT_START";
+            case TraceAction::reasEventCompleted: return "REAS_EVENT_DONE";
+            case TraceAction::reasEnqueueLoss: return "REAS_ENQUEUE_LOSS";
+            case TraceAction::reasBadHeader: return "REAS_BAD_HEADER";
+            case TraceAction::reasKernelDrop: return "REAS_KERNEL_DROP";
+            case TraceAction::reasEventExpired: return "REAS_EVENT_EXPIRED";
+            default: return "UNKNOWN";
+        }
+    }
+
+    std::vector<TraceRecord> TraceRing::snapshot() const noexcept
+    {
+        std::vector<TraceRecord> ret;
+        auto end = head.load(std::memory_order_acquire);
+        auto start = (end > RECORDS ? end - RECORDS : 0);
+        ret.reserve(end - start);
+        for(auto i = start; i < end; i++)
+        {
+            auto &slot = slots[i & (RECORDS - 1)];
+            // skip slots still being written or already reused for a later record
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != 2 * i + 2)
+                continue;
+            u_int64_t words[Slot::WORDS];
+            for(size_t w = 0; w < Slot::WORDS; w++)
+                words[w] = slot.words[w].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq)
+                continue;
+            TraceRecord rec;
+            memcpy(&rec, words, sizeof(rec));
+            ret.push_back(rec);
+        }
+        return ret;
+    }
+
+    namespace {
+        template<typename T>
+        inline void writeVal(std::ofstream &out, const T &v)
+        {
+            out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+        }
+
+        template<typename T>
+        inline bool readVal(std::ifstream &in, T &v)
+        {
+            return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+        }
+    }
+
+    result<int> TraceFile::write(const std::string &path,
+        const std::vector<std::pair<std::string, const TraceRing*>> &rings) noexcept
+    {
+        std::vector<std::pair<std::vector<TraceRecord>, u_int64_t>> snaps;
+        for(auto &r: rings)
+            snaps.emplace_back(r.second->snapshot(), r.second->written());
+
+        // calibrated rate and a wall clock reference for placing records in time
+        double ticksPerSec = TSCClock::ticksPerSec();
+        auto refTicks = TSCClock::ticks();
+        int64_t epochNs = TSCClock::toRealtimeNs(refTicks);
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return E2SARErrorInfo{E2SARErrorc::SystemError, "Unable to open trace file "s + path};
+
+        writeVal(out, MAGIC);
+        writeVal(out, VERSION);
+        writeVal(out, static_cast<u_int32_t>(rings.size()));
+        writeVal(out, ticksPerSec);
+        writeVal(out, refTicks);
+        writeVal(out, epochNs);
+        for(size_t i = 0; i < rings.size(); i++)
+        {
+            writeVal(out, static_cast<u_int32_t>(rings[i].first.size()));
+            out.write(rings[i].first.data(), rings[i].first.size());
+            writeVal(out, snaps[i].second);
+            writeVal(out, static_cast<u_int64_t>(snaps[i].first.size()));
+            out.write(reinterpret_cast<const char*>(snaps[i].first.data()),
+                snaps[i].first.size() * sizeof(TraceRecord));
+        }
+        out.close();
+        if (!out)
+            return E2SARErrorInfo{E2SARErrorc::SystemError, "Unable to write trace file "s + path};
+        return 0;
+    }
+
+    result<TraceFile::Contents> TraceFile::read(const std::string &path) noexcept
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return E2SARErrorInfo{E2SARErrorc::NotFound, "Unable to open trace file "s + path};
+
+        u_int64_t magic{0};
+        u_int32_t version{0}, numRings{0};
+        Contents ret;
+        if (!readVal(in, magic) || (magic != MAGIC))
+            return E2SARErrorInfo{E2SARErrorc::ParseError, "Not an E2SAR trace file"};
+        if (!readVal(in, version) || (version != VERSION))
+            return E2SARErrorInfo{E2SARErrorc::ParseError, "Unsupported trace file version"};
+        if (!readVal(in, numRings) || !readVal(in, ret.ticksPerSec) ||
+            !readVal(in, ret.refTicks) || !readVal(in, ret.refEpochNs))
+            return E2SARErrorInfo{E2SARErrorc::ParseError, "Truncated trace file header"};
+
+        for(u_int32_t i = 0; i < numRings; i++)
+        {
+            Ring ring;
+            u_int32_t nameLen{0};
+            u_int64_t numRecords{0};
+            if (!readVal(in, nameLen) || (nameLen > 1024))
+                return E2SARErrorInfo{E2SARErrorc::ParseError, "Invalid ring name in trace file"};
+            ring.name.resize(nameLen);
+            if (!in.read(ring.name.data(), nameLen) || !readVal(in, ring.written) ||
+                !readVal(in, numRecords) || (numRecords > TraceRing::RECORDS))
+                return E2SARErrorInfo{E2SARErrorc::ParseError, "Invalid ring header in trace file"};
+            ring.records.resize(numRecords);
+            if (!in.read(reinterpret_cast<char*>(ring.records.data()), numRecords * sizeof(TraceRecord)))
+                return E2SARErrorInfo{E2SARErrorc::ParseError, "Truncated trace file"};
+            ret.rings.push_back(std::move(ring));
+        }
+        return ret;
+    }
+}
@@ -6,6 +6,10 @@
 #include <boost/url.hpp>
 #include <boost/algorithm/string.hpp>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
 #include "e2sarUtil.hpp"
 #include "e2sarNetUtil.hpp"
 
@@ -415,6 +419,101 @@ namespace e2sar
 #endif
     }
 
+    namespace {
+        inline int64_t clockNs(clockid_t id) noexcept
+        {
+            struct timespec ts;
+            clock_gettime(id, &ts);
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+        }
+
+        // the counter is only usable if it ticks at a constant rate regardless of 
+        // frequency scaling and sleep states and is synchronized across cores
+        bool counterUsable() noexcept
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            unsigned int eax, ebx, ecx, edx;
+            if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+                return false;
+            // invariant TSC
+            return (edx & (1 << 8)) != 0;
+#elif defined(__aarch64__)
+            // architected generic timer runs at a fixed frequency
+            return true;
+#else
+            return false;
+#endif
+        }
+    }
+
+    TSCClock::State::State() noexcept
+    {
+        useCounter = counterUsable();
+        if (useCounter)
+        {
+            calRawNs = clockNs(CLOCK_MONOTONIC_RAW);
+            calTicks = rawCounter();
+            // initial rate estimate, every resync refines it over a longer baseline
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(CALIBRATION_MS));
+        }
+        _resync(*this);
+    }
+
+    void TSCClock::_resync(State &st) noexcept
+    {
+        auto realNs = clockNs(CLOCK_REALTIME);
+        auto rawNs = clockNs(CLOCK_MONOTONIC_RAW);
+        u_int64_t t = (st.useCounter ? rawCounter() : static_cast<u_int64_t>(clockNs(CLOCK_MONOTONIC)));
+
+        double nsPerTick{1.0};
+        if (st.useCounter && (t > st.calTicks) && (rawNs > st.calRawNs))
+            nsPerTick = static_cast<double>(rawNs - st.calRawNs) / static_cast<double>(t - st.calTicks);
+
+        // keep the monotonic clock continuous across rate changes
+        int64_t monoNs;
+        auto prevTicks = st.ticks.load(std::memory_order_relaxed);
+        if (prevTicks == 0)
+            monoNs = clockNs(CLOCK_MONOTONIC);
+        else
+            monoNs = st.monoNs.load(std::memory_order_relaxed) + static_cast<int64_t>(
+                static_cast<int64_t>(t - prevTicks) * st.nsPerTick.load(std::memory_order_relaxed));
+
+        // the wall clock jumps forward with CLOCK_REALTIME but never steps back: if
+        // CLOCK_REALTIME is behind where the old anchor has us, continue from there at
+        // a reduced rate so the difference is absorbed over the next resync period
+        double realNsPerTick{nsPerTick};
+        if (prevTicks != 0)
+        {
+            auto predictedNs = st.realNs.load(std::memory_order_relaxed) + static_cast<int64_t>(
+                static_cast<int64_t>(t - prevTicks) * st.realNsPerTick.load(std::memory_order_relaxed));
+            if (realNs < predictedNs)
+            {
+                double slew = std::min(MAX_SLEW, 
+                    static_cast<double>(predictedNs - realNs) / static_cast<double>(RESYNC_PERIOD_NS));
+                realNs = predictedNs;
+                realNsPerTick = nsPerTick * (1.0 - slew);
+            }
+        }
+
+        auto seq = st.seq.load(std::memory_order_relaxed);
+        st.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        st.ticks.store(t, std::memory_order_relaxed);
+        st.monoNs.store(monoNs, std::memory_order_relaxed);
+        st.realNs.store(realNs, std::memory_order_relaxed);
+        st.nsPerTick.store(nsPerTick, std::memory_order_relaxed);
+        st.realNsPerTick.store(realNsPerTick, std::memory_order_relaxed);
+        st.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    void TSCClock::resync() noexcept
+    {
+        auto &st = state();
+        while(st.resyncing.test_and_set(std::memory_order_acquire));
+        _resync(st);
+        st.resyncing.clear(std::memory_order_release);
+    }
+
     std::string expandTilde(const std::string& path) {
         if (path.empty() || path[0] != '~') {
             return path;  // No tilde, return as-is
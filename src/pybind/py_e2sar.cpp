@@ -136,5 +136,6 @@ void init_e2sarResultTypes(py::module_ &m)
     bind_result<std::list<std::pair<u_int16_t, size_t>>>(m, "E2SARResultListOfFDPairs");
     bind_result<std::pair<u_int64_t, uint16_t>>(m, "E2SARResultPairUInt64");
     bind_result<Reassembler::ReassemblerFlags>(m, "E2SARResultReassemblerFlags");
+    bind_result<Reassembler::SessionStats>(m, "E2SARResultSessionStats");
     bind_result<Segmenter::SegmenterFlags>(m, "E2SARResultSegmenterFlags");
 }
@@ -87,6 +87,39 @@ void init_e2sarCP(py::module_ &m) {
         .def_readwrite("total_bytes_recv", &WorkerStats::total_bytes_recv)
         .def_readwrite("total_packets_recv", &WorkerStats::total_packets_recv);
 
+    /**
+     * Bindings for struct "SendStateStats" (returned by LBManager.get_send_state_stats())
+     */
+    py::class_<SendStateStats>(e2sarCP, "SendStateStats")
+        .def_readonly("sent", &SendStateStats::sent)
+        .def_readonly("completed", &SendStateStats::completed)
+        .def_readonly("failed", &SendStateStats::failed)
+        .def_readonly("deadlineExceeded", &SendStateStats::deadlineExceeded)
+        .def_readonly("coalesced", &SendStateStats::coalesced)
+        .def_readonly("inFlight", &SendStateStats::inFlight)
+        .def_readonly("backoff_ms", &SendStateStats::backoff_ms)
+        .def_readonly("lastError", &SendStateStats::lastError)
+        .def_readonly("rpcLatency", &SendStateStats::rpcLatency);
+
+    /**
+     * Bindings for the process-wide gRPC channel cache shared by LBManagers
+     */
+    py::class_<ChannelCache, std::unique_ptr<ChannelCache, py::nodelete>> channel_cache(e2sarCP, "ChannelCache");
+    py::class_<ChannelCache::KeepaliveOptions>(channel_cache, "KeepaliveOptions")
+        .def(py::init<>())
+        .def_readwrite("time_ms", &ChannelCache::KeepaliveOptions::time_ms)
+        .def_readwrite("timeout_ms", &ChannelCache::KeepaliveOptions::timeout_ms)
+        .def_readwrite("permitWithoutCalls", &ChannelCache::KeepaliveOptions::permitWithoutCalls);
+    py::class_<ChannelCache::CacheStats>(channel_cache, "CacheStats")
+        .def_readonly("hits", &ChannelCache::CacheStats::hits)
+        .def_readonly("misses", &ChannelCache::CacheStats::misses)
+        .def_readonly("active", &ChannelCache::CacheStats::active);
+    channel_cache.def_static("set_keepalive", &ChannelCache::setKeepalive, py::arg("ko"));
+    channel_cache.def_static("get_keepalive", &ChannelCache::getKeepalive);
+    channel_cache.def_static("set_enabled", &ChannelCache::setEnabled, py::arg("e"));
+    channel_cache.def_static("is_enabled", &ChannelCache::isEnabled);
+    channel_cache.def_static("get_stats", &ChannelCache::getStats);
+
     /**
      * Bindings for struct "LBStatus"
      */
@@ -338,6 +371,21 @@ void init_e2sarCP(py::module_ &m) {
         py::arg("fill_percent"), py::arg("control_signal"), py::arg("is_ready"),
         py::arg("stats")
     );
+    lb_manager.def(
+        "send_state_async",
+        &LBManager::sendStateAsync,
+        "Send worker state update without waiting for the response, at most one update is outstanding.",
+        py::arg("fill_percent"), py::arg("control_signal"), py::arg("is_ready"),
+        py::arg("stats"), py::arg("deadline_ms")
+    );
+    lb_manager.def(
+        "set_send_state_backoff",
+        &LBManager::setSendStateBackoff,
+        "Change the bounds of the backoff of send_state_async after failed updates.",
+        py::arg("min_ms"), py::arg("max_ms")
+    );
+    lb_manager.def("get_send_state_stats", &LBManager::getSendStateStats);
+    lb_manager.def("get_send_state_failures", &LBManager::getSendStateFailures);
     /// TODO: type cast between C++ google::protobuf::Timestamp between Python datetime package
     // lb_manager.def(
     //     "send_state_with_timestamp",
@@ -80,6 +80,7 @@ struct PythonCallbackWrapper {
 
 void init_e2sarDP_reassembler(py::module_ &m);
 void init_e2sarDP_segmenter(py::module_ &m);
+void init_e2sarDP_metrics(py::module_ &m);
 
 void init_e2sarDP(py::module_ &m) {
     // Define the submodule "DataPlane"
@@ -87,9 +88,19 @@ void init_e2sarDP(py::module_ &m) {
 
     init_e2sarDP_segmenter(e2sarDP);
     init_e2sarDP_reassembler(e2sarDP);
+    init_e2sarDP_metrics(e2sarDP);
 }
 
 void init_e2sarDP_segmenter(py::module_ &m) {
+    // Process-wide sync service (static only)
+    py::class_<SyncService, std::unique_ptr<SyncService, py::nodelete>> sync_service(m, "SyncService");
+    py::class_<SyncService::ServiceStats>(sync_service, "ServiceStats")
+        .def_readonly("segmenters", &SyncService::ServiceStats::segmenters)
+        .def_readonly("wakeups", &SyncService::ServiceStats::wakeups)
+        .def_readonly("syncsSent", &SyncService::ServiceStats::syncsSent)
+        .def_readonly("errors", &SyncService::ServiceStats::errors);
+    sync_service.def_static("get_stats", &SyncService::getStats);
+
     py::class_<Segmenter> seg(m, "Segmenter");
 
     // Bind "SegmenterFlags" struct as a nested class of Segmenter
@@ -100,6 +111,8 @@ void init_e2sarDP_segmenter(py::module_ &m) {
         .def_readwrite("useCP", &Segmenter::SegmenterFlags::useCP)
         .def_readwrite("syncPeriodMs", &Segmenter::SegmenterFlags::syncPeriodMs)
         .def_readwrite("syncPeriods", &Segmenter::SegmenterFlags::syncPeriods)
+        .def_readwrite("sharedSync", &Segmenter::SegmenterFlags::sharedSync)
+        .def_readwrite("measuredSync", &Segmenter::SegmenterFlags::measuredSync)
         .def_readwrite("mtu", &Segmenter::SegmenterFlags::mtu)
         .def_readwrite("numSendSockets", &Segmenter::SegmenterFlags::numSendSockets)
         .def_readwrite("sndSocketBufSize", &Segmenter::SegmenterFlags::sndSocketBufSize)
@@ -231,11 +244,58 @@ void init_e2sarDP_segmenter(py::module_ &m) {
             .def_readonly("msgCnt", &Segmenter::ReportedStats::msgCnt)
             .def_readonly("errCnt", &Segmenter::ReportedStats::errCnt)
             .def_readonly("lastErrno", &Segmenter::ReportedStats::lastErrno)
-            .def_readonly("lastE2SARError", &Segmenter::ReportedStats::lastE2SARError);
+            .def_readonly("lastE2SARError", &Segmenter::ReportedStats::lastE2SARError)
+            .def_readonly("enobufsCnt", &Segmenter::ReportedStats::enobufsCnt)
+            .def_readonly("sndQueueSaturated", &Segmenter::ReportedStats::sndQueueSaturated)
+            .def_readonly("sndQueueHighWater", &Segmenter::ReportedStats::sndQueueHighWater);
 
     seg.def("getSendStats", &Segmenter::getSendStats);
     seg.def("getSyncStats", &Segmenter::getSyncStats);
 
+    // Return type of LatencyStats: bind LatencyStats as a subclass
+    py::class_<Segmenter::LatencyStats,
+        std::unique_ptr<Segmenter::LatencyStats, py::nodelete>>(seg, "LatencyStats")
+            .def_readonly("enqueueToDequeue", &Segmenter::LatencyStats::enqueueToDequeue)
+            .def_readonly("dequeueToFirstSend", &Segmenter::LatencyStats::dequeueToFirstSend)
+            .def_readonly("sendDuration", &Segmenter::LatencyStats::sendDuration)
+            .def_readonly("sendDurationBySize", &Segmenter::LatencyStats::sendDurationBySize);
+    seg.def("getLatencyStats", &Segmenter::getLatencyStats);
+    seg.def("resetLatencyStats", &Segmenter::resetLatencyStats);
+    seg.def("getSendQueueDepth", &Segmenter::getSendQueueDepth);
+    seg.def_static("sendSizeBucketLimit", &Segmenter::sendSizeBucketLimit, py::arg("bucket"));
+
+    // Per send socket stats: bind SocketStats as a subclass of Segmenter
+    py::class_<Segmenter::SocketStats>(seg, "SocketStats")
+        .def_readonly("index", &Segmenter::SocketStats::index)
+        .def_readonly("fragments", &Segmenter::SocketStats::fragments)
+        .def_readonly("bytes", &Segmenter::SocketStats::bytes)
+        .def_readonly("errors", &Segmenter::SocketStats::errors)
+        .def_readonly("eagain", &Segmenter::SocketStats::eagain)
+        .def_readonly("enobufs", &Segmenter::SocketStats::enobufs)
+        .def_readonly("sqReady", &Segmenter::SocketStats::sqReady)
+        .def_readonly("sqReadyHighWater", &Segmenter::SocketStats::sqReadyHighWater)
+        .def_readonly("cqReady", &Segmenter::SocketStats::cqReady)
+        .def_readonly("cqReadyHighWater", &Segmenter::SocketStats::cqReadyHighWater);
+    seg.def("getSocketStats", &Segmenter::getSocketStats);
+    seg.def("getOutstandingSends", &Segmenter::getOutstandingSends);
+
+    // Per-second stats samples: bind RateSample as a subclass of Segmenter
+    py::class_<Segmenter::RateSample>(seg, "RateSample")
+        .def_readonly("timestampNs", &Segmenter::RateSample::timestampNs)
+        .def_readonly("periodNs", &Segmenter::RateSample::periodNs)
+        .def_readonly("eventCnt", &Segmenter::RateSample::eventCnt)
+        .def_readonly("byteCnt", &Segmenter::RateSample::byteCnt)
+        .def_readonly("msgCnt", &Segmenter::RateSample::msgCnt)
+        .def_readonly("errCnt", &Segmenter::RateSample::errCnt)
+        .def_readonly("eventRate", &Segmenter::RateSample::eventRate)
+        .def_readonly("byteRate", &Segmenter::RateSample::byteRate)
+        .def_readonly("msgRate", &Segmenter::RateSample::msgRate)
+        .def_readonly("errRate", &Segmenter::RateSample::errRate)
+        .def_readonly("queueDepth", &Segmenter::RateSample::queueDepth);
+    seg.def("getStatsSnapshot", &Segmenter::getStatsSnapshot);
+    seg.def("getStatsHistory", &Segmenter::getStatsHistory, py::arg("n") = Segmenter::SAMPLE_HISTORY);
+    seg.def("dumpTrace", &Segmenter::dumpTrace, py::arg("path"));
+
     // Simple return types
     seg.def("getMTU", &Segmenter::getMTU);
     seg.def("getMaxPldLen", &Segmenter::getMaxPldLen);
@@ -267,6 +327,19 @@ void init_e2sarDP_reassembler(py::module_ &m) {
         .def_readwrite("weight", &Reassembler::ReassemblerFlags::weight)
         .def_readwrite("min_factor", &Reassembler::ReassemblerFlags::min_factor)
         .def_readwrite("max_factor", &Reassembler::ReassemblerFlags::max_factor)
+        .def_readwrite("trackSequence", &Reassembler::ReassemblerFlags::trackSequence)
+        .def_readwrite("adaptiveTimeout", &Reassembler::ReassemblerFlags::adaptiveTimeout)
+        .def_readwrite("adaptiveTimeoutMult", &Reassembler::ReassemblerFlags::adaptiveTimeoutMult)
+        .def_readwrite("useGRO", &Reassembler::ReassemblerFlags::useGRO)
+        .def_readwrite("recvBufferSize", &Reassembler::ReassemblerFlags::recvBufferSize)
+        .def_readwrite("busyPoll", &Reassembler::ReassemblerFlags::busyPoll)
+        .def_readwrite("busyPoll_us", &Reassembler::ReassemblerFlags::busyPoll_us)
+        .def_readwrite("spinBudget_us", &Reassembler::ReassemblerFlags::spinBudget_us)
+        .def_readwrite("dropBackoff", &Reassembler::ReassemblerFlags::dropBackoff)
+        .def_readwrite("drainControl", &Reassembler::ReassemblerFlags::drainControl)
+        .def_readwrite("eventQueueLimit", &Reassembler::ReassemblerFlags::eventQueueLimit)
+        .def_readwrite("perDataIdStats", &Reassembler::ReassemblerFlags::perDataIdStats)
+        .def_readwrite("sendStateDeadline_ms", &Reassembler::ReassemblerFlags::sendStateDeadline_ms)
         .def("getFromINI", &Reassembler::ReassemblerFlags::getFromINI);
 
     // Constructor-simple
@@ -441,6 +514,38 @@ void init_e2sarDP_reassembler(py::module_ &m) {
     "Get an event in the blocking mode. Use py.bytes to accept the data.",
     py::arg("wait_ms") = 0);
 
+    reas.def("recvSessionEventBytes",
+        [](Reassembler& self, size_t session, u_int64_t wait_ms) -> py::tuple {
+            u_int8_t *eventBuf{nullptr};
+            size_t eventLen = 0;
+            EventNum_t eventNum = 0;
+            u_int16_t recDataId = 0;
+
+            auto recvres = self.recvEvent(session, &eventBuf, &eventLen, &eventNum, &recDataId, wait_ms);
+
+            // Return empty bytes object of return code is not 0
+            if (recvres.has_error())
+                return py::make_tuple(static_cast<int>(-2), py::bytes(), eventNum, recDataId);
+
+            if (recvres.value() == -1)
+                return py::make_tuple(static_cast<int>(-1), py::bytes(), eventNum, recDataId);
+
+            py::bytes recv_bytes(reinterpret_cast<const char*>(eventBuf), eventLen);
+            delete [] eventBuf;  // Clean up the buffer
+            return py::make_tuple(eventLen, recv_bytes, eventNum, recDataId);
+    },
+    "Get an event of a specific session in the blocking mode. Use py.bytes to accept the data.",
+    py::arg("session"),
+    py::arg("wait_ms") = 0);
+
+    // Hosting multiple LB sessions
+    reas.def("addSession", &Reassembler::addSession,
+        "Host another LB session on the receive threads of this Reassembler (before OpenAndStart).",
+        py::arg("uri"),
+        py::arg("starting_port"),
+        py::arg("portRange") = -1);
+    reas.def("get_numSessions", &Reassembler::get_numSessions);
+
     // Return type of result<int>
     reas.def("OpenAndStart", &Reassembler::openAndStart);
     reas.def("registerWorker", &Reassembler::registerWorker);
@@ -448,6 +553,7 @@ void init_e2sarDP_reassembler(py::module_ &m) {
 
     // Return type of result<std::list<std::pair<u_int16_t, size_t>>>
     reas.def("get_FDStats", &Reassembler::get_FDStats);
+    reas.def("get_PortDropStats", &Reassembler::get_PortDropStats);
 
     // Return type of result<boost::tuple<EventNum_t, u_int16_t, size_t>>
     // TODO: check the underlying C++ result<T> convention and pybind
@@ -474,9 +580,96 @@ void init_e2sarDP_reassembler(py::module_ &m) {
         .def_readonly("lastE2SARError", &Reassembler::ReportedStats::lastE2SARError)
         .def_readonly("totalPackets", &Reassembler::ReportedStats::totalPackets)
         .def_readonly("totalBytes", &Reassembler::ReportedStats::totalBytes)
-        .def_readonly("badHeaderDiscards", &Reassembler::ReportedStats::badHeaderDiscards);
+        .def_readonly("badHeaderDiscards", &Reassembler::ReportedStats::badHeaderDiscards)
+        .def_readonly("neverSeenLoss", &Reassembler::ReportedStats::neverSeenLoss)
+        .def_readonly("adaptiveTimeoutMisses", &Reassembler::ReportedStats::adaptiveTimeoutMisses)
+        .def_readonly("busyPollSpins", &Reassembler::ReportedStats::busyPollSpins)
+        .def_readonly("busyPollHits", &Reassembler::ReportedStats::busyPollHits)
+        .def_readonly("busyPollFallbacks", &Reassembler::ReportedStats::busyPollFallbacks)
+        .def_readonly("kernelDrops", &Reassembler::ReportedStats::kernelDrops);
     reas.def("getStats", &Reassembler::getStats);
 
+    // Return type of LostEventStats: bind LostEventStats as a subclass of Reassembler
+    py::class_<Reassembler::LostEventStats,
+                std::unique_ptr<Reassembler::LostEventStats, py::nodelete>>(reas, "LostEventStats")
+        .def_readonly("perDataId", &Reassembler::LostEventStats::perDataId)
+        .def_readonly("otherDataIds", &Reassembler::LostEventStats::otherDataIds)
+        .def_readonly("perFragCount", &Reassembler::LostEventStats::perFragCount)
+        .def_readonly("ringOverwrites", &Reassembler::LostEventStats::ringOverwrites)
+        .def_readonly("neverSeenPerDataId", &Reassembler::LostEventStats::neverSeenPerDataId)
+        .def_readonly("seqOutOfWindow", &Reassembler::LostEventStats::seqOutOfWindow);
+    reas.def("getLostEventStats", &Reassembler::getLostEventStats);
+
+    // Return type of LatencyStats: bind LatencyStats as a subclass of Reassembler
+    py::class_<Reassembler::LatencyStats,
+                std::unique_ptr<Reassembler::LatencyStats, py::nodelete>>(reas, "LatencyStats")
+        .def_readonly("firstToComplete", &Reassembler::LatencyStats::firstToComplete)
+        .def_readonly("completeToDequeue", &Reassembler::LatencyStats::completeToDequeue);
+    reas.def("getLatencyStats", &Reassembler::getLatencyStats);
+    reas.def("resetLatencyStats", &Reassembler::resetLatencyStats);
+
+    // Return type of ControlStats: bind ControlStats as a subclass of Reassembler
+    py::class_<Reassembler::ControlStats,
+                std::unique_ptr<Reassembler::ControlStats, py::nodelete>>(reas, "ControlStats")
+        .def_readonly("fillPercent", &Reassembler::ControlStats::fillPercent)
+        .def_readonly("controlSignal", &Reassembler::ControlStats::controlSignal)
+        .def_readonly("error", &Reassembler::ControlStats::error)
+        .def_readonly("integral", &Reassembler::ControlStats::integral)
+        .def_readonly("arrivalBps", &Reassembler::ControlStats::arrivalBps)
+        .def_readonly("serviceBps", &Reassembler::ControlStats::serviceBps)
+        .def_readonly("timeToFull_ms", &Reassembler::ControlStats::timeToFull_ms);
+    reas.def("getControlStats", &Reassembler::getControlStats);
+
+    // Return type of SessionStats: bind SessionStats as a subclass of Reassembler
+    py::class_<Reassembler::SessionStats,
+                std::unique_ptr<Reassembler::SessionStats, py::nodelete>>(reas, "SessionStats")
+        .def_readonly("recvPorts", &Reassembler::SessionStats::recvPorts)
+        .def_readonly("eventSuccess", &Reassembler::SessionStats::eventSuccess)
+        .def_readonly("enqueueLoss", &Reassembler::SessionStats::enqueueLoss)
+        .def_readonly("reassemblyLoss", &Reassembler::SessionStats::reassemblyLoss)
+        .def_readonly("queueDepth", &Reassembler::SessionStats::queueDepth)
+        .def_readonly("fillPercent", &Reassembler::SessionStats::fillPercent)
+        .def_readonly("controlSignal", &Reassembler::SessionStats::controlSignal)
+        .def_readonly("registered", &Reassembler::SessionStats::registered)
+        .def_readonly("control", &Reassembler::SessionStats::control)
+        .def_readonly("sendState", &Reassembler::SessionStats::sendState);
+    reas.def("getSessionStats", &Reassembler::getSessionStats);
+    reas.def("getSendStateStats", &Reassembler::getSendStateStats);
+    reas.def("getEventQueueDepth", &Reassembler::getEventQueueDepth);
+
+    // Per data id receive counters: bind DataIdStats as a subclass of Reassembler
+    py::class_<Reassembler::DataIdStats>(reas, "DataIdStats")
+        .def_readonly("session", &Reassembler::DataIdStats::session)
+        .def_readonly("dataId", &Reassembler::DataIdStats::dataId)
+        .def_readonly("events", &Reassembler::DataIdStats::events)
+        .def_readonly("bytes", &Reassembler::DataIdStats::bytes)
+        .def_readonly("fragments", &Reassembler::DataIdStats::fragments)
+        .def_readonly("reassemblyLoss", &Reassembler::DataIdStats::reassemblyLoss)
+        .def_readonly("enqueueLoss", &Reassembler::DataIdStats::enqueueLoss)
+        .def_readonly("timeoutMisses", &Reassembler::DataIdStats::timeoutMisses)
+        .def("meanFragments", &Reassembler::DataIdStats::meanFragments);
+    reas.def("getDataIdStats", &Reassembler::getDataIdStats);
+    reas.def("getDataIdStatsOverflow", &Reassembler::getDataIdStatsOverflow);
+
+    // Per-second stats samples: bind RateSample as a subclass of Reassembler
+    py::class_<Reassembler::RateSample>(reas, "RateSample")
+        .def_readonly("timestampNs", &Reassembler::RateSample::timestampNs)
+        .def_readonly("periodNs", &Reassembler::RateSample::periodNs)
+        .def_readonly("eventCnt", &Reassembler::RateSample::eventCnt)
+        .def_readonly("packetCnt", &Reassembler::RateSample::packetCnt)
+        .def_readonly("byteCnt", &Reassembler::RateSample::byteCnt)
+        .def_readonly("lossCnt", &Reassembler::RateSample::lossCnt)
+        .def_readonly("kernelDrops", &Reassembler::RateSample::kernelDrops)
+        .def_readonly("eventRate", &Reassembler::RateSample::eventRate)
+        .def_readonly("packetRate", &Reassembler::RateSample::packetRate)
+        .def_readonly("byteRate", &Reassembler::RateSample::byteRate)
+        .def_readonly("lossRate", &Reassembler::RateSample::lossRate)
+        .def_readonly("kernelDropRate", &Reassembler::RateSample::kernelDropRate)
+        .def_readonly("queueDepth", &Reassembler::RateSample::queueDepth);
+    reas.def("getStatsSnapshot", &Reassembler::getStatsSnapshot);
+    reas.def("getStatsHistory", &Reassembler::getStatsHistory, py::arg("n") = Reassembler::SAMPLE_HISTORY);
+    reas.def("dumpTrace", &Reassembler::dumpTrace, py::arg("path"));
+
     // Return type: ip::address - convert to string for Python
     reas.def("get_dataIP", [](const Reassembler &reasObj) {
         return reasObj.get_dataIP().to_string();
@@ -488,3 +681,24 @@ void init_e2sarDP_reassembler(py::module_ &m) {
     reas.def("get_portRange", &Reassembler::get_portRange);
     reas.def("stopThreads", &Reassembler::stopThreads);
 }
+
+void init_e2sarDP_metrics(py::module_ &m) {
+    py::class_<MetricsExporter> exp(m, "MetricsExporter");
+
+    exp.def(
+        py::init<const ip::address &, u_int16_t>(),
+        "Init the OpenMetrics exporter listening on given address and TCP port (0 for ephemeral).",
+        py::arg("addr"),
+        py::arg("port"));
+
+    // registered objects must stay alive as long as the exporter
+    exp.def("addSegmenter", &MetricsExporter::addSegmenter,
+        py::arg("seg"), py::arg("name"), py::keep_alive<1, 2>());
+    exp.def("addReassembler", &MetricsExporter::addReassembler,
+        py::arg("reas"), py::arg("name"), py::keep_alive<1, 2>());
+
+    exp.def("start", &MetricsExporter::start);
+    exp.def("stop", &MetricsExporter::stop);
+    exp.def("render", &MetricsExporter::render);
+    exp.def("getPort", &MetricsExporter::getPort);
+}
@@ -150,4 +150,19 @@ void init_e2sarUtil(py::module_ &m) {
         .value("liburing_recv", Optimizations::Code::liburing_recv)
         .value("unknown", Optimizations::Code::unknown)
         .export_values();
+
+    //..............................................................
+    // Bind the LatencyHistogram snapshot (returned by Segmenter and Reassembler getLatencyStats())
+    py::class_<LatencyHistogram> latencyHistogram(m, "LatencyHistogram");
+    latencyHistogram
+        .def_static("bucketUpperBound", &LatencyHistogram::bucketUpperBound, py::arg("idx"));
+
+    py::class_<LatencyHistogram::Snapshot>(latencyHistogram, "Snapshot")
+        .def_readonly("count", &LatencyHistogram::Snapshot::count)
+        .def_readonly("min", &LatencyHistogram::Snapshot::min)
+        .def_readonly("max", &LatencyHistogram::Snapshot::max)
+        .def_readonly("mean", &LatencyHistogram::Snapshot::mean)
+        .def_readonly("counts", &LatencyHistogram::Snapshot::counts)
+        .def("percentile", &LatencyHistogram::Snapshot::percentile, py::arg("p"),
+            "Value (ns) at or below which p percent of recorded values fall");
 }
@@ -7,6 +7,7 @@
 #include <boost/test/included/unit_test.hpp>
 
 #include "e2sar.hpp"
+#include "e2sarCPMock.hpp"
 
 using namespace e2sar;
 
@@ -69,4 +70,199 @@ BOOST_AUTO_TEST_CASE(LBMTest3)
 
     LBManager lbm(uri);
 }
+
+BOOST_AUTO_TEST_CASE(LBMTest4)
+{
+    // exercise LBManager against the mock control plane
+    LBMockServer mock(ip::make_address("127.0.0.1"), 0);
+    auto startRes = mock.openAndStart();
+    BOOST_TEST(!startRes.has_error());
+    BOOST_TEST(mock.get_Port() != 0);
+
+    EjfatURI uri(mock.get_URI());
+    LBManager lbm(uri);
+
+    auto verRes = lbm.version();
+    BOOST_TEST(!verRes.has_error());
+
+    auto resRes = lbm.reserveLB("mocklb", 60.0, {"192.168.100.1"s});
+    BOOST_TEST(!resRes.has_error());
+    BOOST_TEST(!lbm.get_URI().get_lbId().empty());
+
+    auto regRes = lbm.registerWorker("node1", std::make_pair(ip::make_address("127.0.0.1"), 10000), 1.0, 4, 1.0, 1.0);
+    BOOST_TEST(!regRes.has_error());
+    BOOST_TEST(mock.get_numWorkers() == 1);
+    auto sessionId = lbm.get_URI().get_sessionId();
+    BOOST_TEST(!sessionId.empty());
+
+    for(int i = 0; i < 5; i++)
+        BOOST_TEST(!lbm.sendState(0.1 * i, 1.0, true).has_error());
+
+    auto samples = mock.getSendStateSamples(sessionId);
+    BOOST_TEST(samples.size() == 5);
+    BOOST_TEST(samples.back().fillPercent == 0.4, boost::test_tools::tolerance(0.001));
+    BOOST_TEST(samples.back().isReady);
+
+    auto statusRes = lbm.getLBStatus();
+    BOOST_TEST(!statusRes.has_error());
+    auto status = LBManager::asLBStatus(statusRes.value());
+    BOOST_TEST(status->workers.size() == 1);
+    BOOST_TEST(status->workers[0].name() == "node1");
+    BOOST_TEST(status->workers[0].fillpercent() == 0.4, boost::test_tools::tolerance(0.001));
+    BOOST_TEST(status->senderAddresses.size() == 1);
+
+    // injected latency and errors
+    mock.setLatency(50, 0);
+    auto t1 = boost::chrono::steady_clock::now();
+    BOOST_TEST(!lbm.sendState(0.5, 1.0, true).has_error());
+    BOOST_TEST(boost::chrono::duration_cast<boost::chrono::milliseconds>(
+        boost::chrono::steady_clock::now() - t1).count() >= 50);
+    mock.setLatency(0, 0);
+
+    mock.setErrors(1.0, grpc::StatusCode::UNAVAILABLE, true);
+    BOOST_TEST(lbm.sendState(0.5, 1.0, true).has_error());
+    // other calls are not affected
+    BOOST_TEST(!lbm.getLBStatus().has_error());
+    mock.setErrors(0.0);
+    BOOST_TEST(mock.getStats().injectedErrors == 1);
+    BOOST_TEST(mock.getStats().sendStateCalls == 7);
+
+    // tokens the mock did not hand out are rejected
+    EjfatURI badUri("ejfat://notmock@127.0.0.1:"s + std::to_string(mock.get_Port()) + "/"s);
+    LBManager lbmBad(badUri);
+    BOOST_TEST(lbmBad.version().has_error());
+    BOOST_TEST(mock.getStats().authErrors == 1);
+
+    BOOST_TEST(!lbm.deregisterWorker().has_error());
+    BOOST_TEST(mock.get_numWorkers() == 0);
+    BOOST_TEST(!lbm.freeLB().has_error());
+    mock.stop();
+}
+
+BOOST_AUTO_TEST_CASE(LBMTest5)
+{
+    // LBManagers talking to the same CP with the same credentials share a channel
+    LBMockServer mock(ip::make_address("127.0.0.1"), 0);
+    BOOST_TEST(!mock.openAndStart().has_error());
+    EjfatURI uri(mock.get_URI());
+
+    auto before = ChannelCache::getStats();
+    {
+        LBManager lbm1(uri);
+        LBManager lbm2(uri);
+        auto during = ChannelCache::getStats();
+        BOOST_TEST(during.misses == before.misses + 1);
+        BOOST_TEST(during.hits == before.hits + 1);
+        BOOST_TEST(during.active == before.active + 1);
+        BOOST_TEST(!lbm1.version().has_error());
+        BOOST_TEST(!lbm2.version().has_error());
+
+        // different credentials get their own channel
+        EjfatURI tlsUri("ejfats://mock@127.0.0.1:"s + std::to_string(mock.get_Port()) + "/"s);
+        LBManager lbm3(tlsUri, false);
+        BOOST_TEST(ChannelCache::getStats().misses == before.misses + 2);
+        grpc::SslCredentialsOptions opts1{LBManager::makeSslOptions("root cert"s, "priv key 1"s, "cert chain"s).value()};
+        grpc::SslCredentialsOptions opts2{LBManager::makeSslOptions("root cert"s, "priv key 2"s, "cert chain"s).value()};
+        LBManager lbm5(tlsUri, true, false, opts1);
+        LBManager lbm6(tlsUri, true, false, opts1);
+        LBManager lbm7(tlsUri, true, false, opts2);
+        BOOST_TEST(ChannelCache::getStats().misses == before.misses + 4);
+        BOOST_TEST(ChannelCache::getStats().hits == before.hits + 2);
+
+        // and so does everyone when sharing is off
+        ChannelCache::setEnabled(false);
+        LBManager lbm4(uri);
+        ChannelCache::setEnabled(true);
+        BOOST_TEST(ChannelCache::getStats().misses == before.misses + 4);
+        BOOST_TEST(!lbm4.version().has_error());
+    }
+    // released with the last user
+    BOOST_TEST(ChannelCache::getStats().active == before.active);
+    mock.stop();
+}
+
+BOOST_AUTO_TEST_CASE(LBMTest6)
+{
+    // asynchronous sendState against the mock control plane with injected latency and errors
+    LBMockServer mock(ip::make_address("127.0.0.1"), 0);
+    BOOST_TEST(!mock.openAndStart().has_error());
+    EjfatURI uri(mock.get_URI());
+    LBManager lbm(uri);
+    BOOST_TEST(!lbm.reserveLB("mocklb", 60.0, {"192.168.100.1"s}).has_error());
+    BOOST_TEST(!lbm.registerWorker("node1", std::make_pair(ip::make_address("127.0.0.1"), 10000), 
+        1.0, 4, 1.0, 1.0).has_error());
+    auto sessionId = lbm.get_URI().get_sessionId();
+
+    // poll the pipeline stats until a condition holds or a timeout passes
+    auto waitFor = [&lbm](std::function<bool(const SendStateStats&)> cond, int timeout_ms) {
+        auto until = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(timeout_ms);
+        while (boost::chrono::steady_clock::now() < until)
+        {
+            if (cond(lbm.getSendStateStats()))
+                return true;
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+        }
+        return false;
+    };
+    WorkerStats wstats;
+
+    // coalescing: while one call is outstanding only the newest of the following samples is kept
+    mock.setLatency(200, 0);
+    BOOST_TEST(lbm.sendStateAsync(0.1, 1.0, true, wstats, 1000).value() == 0);
+    BOOST_TEST(lbm.sendStateAsync(0.2, 1.0, true, wstats, 1000).value() == 1);
+    BOOST_TEST(lbm.sendStateAsync(0.3, 1.0, true, wstats, 1000).value() == 1);
+    BOOST_TEST(waitFor([](const SendStateStats &st) { return st.completed == 2 && !st.inFlight; }, 2000));
+    auto st = lbm.getSendStateStats();
+    BOOST_TEST(st.sent == 2);
+    BOOST_TEST(st.coalesced == 1);
+    BOOST_TEST(st.failed == 0);
+    BOOST_TEST(st.rpcLatency.count == 2);
+    auto samples = mock.getSendStateSamples(sessionId);
+    BOOST_TEST(samples.size() == 2);
+    BOOST_TEST(samples.back().fillPercent == 0.3, boost::test_tools::tolerance(0.001));
+
+    // short backoff bounds keep the test fast
+    const u_int32_t backoffMin{50}, backoffMax{400};
+    BOOST_TEST(lbm.setSendStateBackoff(0, backoffMax).has_error());
+    BOOST_TEST(lbm.setSendStateBackoff(backoffMax, backoffMin).has_error());
+    BOOST_TEST(!lbm.setSendStateBackoff(backoffMin, backoffMax).has_error());
+
+    // deadline: a call outliving its deadline fails and starts the backoff at backoffMin
+    mock.setLatency(500, 0);
+    BOOST_TEST(lbm.sendStateAsync(0.4, 1.0, true, wstats, 50).value() == 0);
+    BOOST_TEST(waitFor([](const SendStateStats &st) { return st.failed == 1; }, 2000));
+    st = lbm.getSendStateStats();
+    BOOST_TEST(st.deadlineExceeded == 1);
+    BOOST_TEST(lbm.getSendStateFailures() == 1);
+    BOOST_TEST(st.backoff_ms <= backoffMin);
+    mock.setLatency(0, 0);
+    mock.setErrors(1.0, grpc::StatusCode::UNAVAILABLE, true);
+
+    // consecutive failures double the backoff up to backoffMax. An update during the backoff
+    // is held, not sent, until the backoff expires - without another sendStateAsync()
+    u_int32_t expected{backoffMin};
+    for (u_int64_t failures = 2; expected < backoffMax; failures++)
+    {
+        expected = std::min(2 * expected, backoffMax);
+        BOOST_TEST(lbm.sendStateAsync(0.5, 1.0, true, wstats, 1000).value() == 1);
+        BOOST_TEST(lbm.getSendStateStats().sent == failures + 1);
+        BOOST_TEST(waitFor([failures](const SendStateStats &st) { return st.failed == failures; }, 2000));
+        st = lbm.getSendStateStats();
+        std::cout << "Backoff after " << failures << " failures " << st.backoff_ms << "ms" << std::endl;
+        BOOST_TEST(st.sent == failures + 2);
+        BOOST_TEST(st.backoff_ms <= expected);
+        // drawn from [expected/2, expected], allow for the time it took to look
+        BOOST_TEST(st.backoff_ms + 10 >= expected / 2);
+    }
+    BOOST_TEST(expected == backoffMax);
+
+    // the held update goes out once the control plane recovers
+    mock.setErrors(0.0);
+    BOOST_TEST(lbm.sendStateAsync(0.7, 1.0, true, wstats, 1000).value() == 1);
+    BOOST_TEST(waitFor([](const SendStateStats &st) { return st.completed == 3 && !st.inFlight; }, 2000));
+    BOOST_TEST(lbm.getSendStateStats().backoff_ms == 0);
+    samples = mock.getSendStateSamples(sessionId);
+    BOOST_TEST(samples.back().fillPercent == 0.7, boost::test_tools::tolerance(0.001));
+    mock.stop();
+}
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -45,4 +45,18 @@ BOOST_AUTO_TEST_CASE(NetUtilTest3)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(NetUtilTest4)
+{
+    // test getting host-wide UDP buffer error counters
+    auto res = NetUtil::getUDPBufferErrors();
+
+    #ifdef __linux__
+    BOOST_CHECK(!res.has_error());
+    #endif
+    if (!res.has_error())
+        std::cout << "UDP RcvbufErrors " << res.value().get<0>() << " SndbufErrors " << res.value().get<1>() << std::endl;
+    else
+        std::cout << "UDP buffer error counters not available: " << res.error().message() << std::endl;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
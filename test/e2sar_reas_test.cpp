@@ -6,19 +6,118 @@
 #include <boost/chrono.hpp>
 #include <boost/thread/thread.hpp>
 #include <vector>
+#include <set>
 #include <boost/test/included/unit_test.hpp>
 #include <boost/program_options.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/detail/file_parser_error.hpp>
 
+#ifdef UDP_GRO_AVAILABLE
+#include <netinet/udp.h>
+#endif
+
 #include "e2sar.hpp"
+#include "e2sarCPMock.hpp"
+#include "e2sarLBEmu.hpp"
 
 using namespace e2sar;
 
 namespace po = boost::program_options;
 namespace pt = boost::posix_time;
 
+// sends hand-built LB+RE frames to a reassembler listening on the local host
+class FrameSender
+{
+    int fd;
+    sockaddr_in dest{};
+    std::vector<u_int8_t> frame;
+public:
+    FrameSender(u_int16_t port, size_t pldLen): fd{socket(AF_INET, SOCK_DGRAM, 0)},
+        frame(sizeof(LBREHdr) + pldLen)
+    {
+        BOOST_CHECK(fd >= 0);
+        dest.sin_family = AF_INET;
+        dest.sin_port = htobe16(port);
+        inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr);
+    }
+    FrameSender(const FrameSender &) = delete;
+    FrameSender &operator=(const FrameSender &) = delete;
+    ~FrameSender()
+    {
+        close(fd);
+    }
+
+    // send a frame with the given RE header (arguments in REHdr::set() order) and pld bytes
+    // of payload, returns true if all of it went out
+    bool send(u_int16_t dataId, u_int32_t offset, u_int32_t evtLen, EventNum_t evt, size_t pld)
+    {
+        memset(frame.data(), 0, frame.size());
+        auto hdr = new (frame.data()) LBREHdr();
+        hdr->re.set(dataId, offset, evtLen, evt);
+        return sendRaw(sizeof(LBREHdr) + pld);
+    }
+
+    // send a frame with the full payload
+    bool send(u_int16_t dataId, u_int32_t offset, u_int32_t evtLen, EventNum_t evt)
+    {
+        return send(dataId, offset, evtLen, evt, frame.size() - sizeof(LBREHdr));
+    }
+
+    // send the first len bytes of the last frame, e.g. to make a runt
+    bool sendRaw(size_t len)
+    {
+        auto ret = sendto(fd, frame.data(), len, 0, (const sockaddr*)&dest, sizeof(dest));
+        return ret == static_cast<ssize_t>(len);
+    }
+};
+
+// mock control plane running on the local host for the duration of a test
+struct MockCPFixture
+{
+    ip::address loopback{ip::make_address("127.0.0.1")};
+    LBMockServer mock{loopback, 0};
+
+    MockCPFixture()
+    {
+        BOOST_REQUIRE(!mock.openAndStart().has_error());
+    }
+    ~MockCPFixture()
+    {
+        mock.stop();
+    }
+
+    // reserve a load balancer with the admin token, the returned URI also carries
+    // the instance token and LB id the Reassembler registers with
+    EjfatURI reserve(const std::string &name)
+    {
+        LBManager lbm(EjfatURI(mock.get_URI()));
+        BOOST_REQUIRE(!lbm.reserveLB(name, 60.0, std::vector<std::string>()).has_error());
+        return lbm.get_URI();
+    }
+};
+
+// run a test body reporting any exception it throws as a failure
+template<typename Body>
+void reportExceptions(Body body)
+{
+    try {
+        body();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE(DPReasTests)
 
 // this is a test that uses local host to send/receive fragments
@@ -643,6 +742,14 @@ BOOST_AUTO_TEST_CASE(DPReasTest4)
                 " received " << lostEvent.value().get<2>() << "frames" << std::endl;
         BOOST_CHECK(lostEvent.has_error() && lostEvent.error().code() == E2SARErrorc::NotFound);
 
+        // per port stats are available while the threads are running
+        auto runningFdStats = reas.get_FDStats();
+        BOOST_CHECK(not runningFdStats.has_error());
+        size_t fdFragments{0};
+        for (auto fds: runningFdStats.value())
+            fdFragments += fds.second;
+        BOOST_CHECK(fdFragments == recvStats.totalPackets);
+
         // stop threads and exit
         reas.stopThreads();
 
@@ -714,4 +821,1794 @@ BOOST_AUTO_TEST_CASE(DPReasTest5)
     std::remove(iniFileName.c_str());
 }
 
+// this test sends partial events to the reassembler over local host
+// and checks that lost events are counted once and aggregated correctly
+BOOST_AUTO_TEST_CASE(DPReasTest6)
+{
+    std::cout << "DPReasTest6: Test bounded lost event accounting on local host with no control plane" << std::endl;
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+        rflags.eventTimeout_ms = 100; // give up on partial events quickly
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        // send only the first half of each event, so none of them can be completed
+        const size_t pldLen{100};
+        FrameSender sender(listen_port, pldLen);
+        auto sendFirstHalf = [&](EventNum_t evt, u_int16_t dataId) {
+            BOOST_CHECK(sender.send(dataId, 0, 2*pldLen, evt));
+        };
+
+        for(EventNum_t evt = 1; evt < 4; evt++)
+            sendFirstHalf(evt, 0x0505);
+        sendFirstHalf(4, 0x0606);
+
+        // let the GC thread time out the events
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(400));
+
+        auto recvStats = reas.getStats();
+        BOOST_CHECK(recvStats.totalPackets == 4);
+        BOOST_CHECK(recvStats.reassemblyLoss == 4);
+        BOOST_CHECK(recvStats.eventSuccess == 0);
+
+        // a late fragment of an already lost event is not counted again
+        sendFirstHalf(1, 0x0505);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(400));
+        recvStats = reas.getStats();
+        BOOST_CHECK(recvStats.totalPackets == 5);
+        BOOST_CHECK(recvStats.reassemblyLoss == 4);
+
+        auto lossStats = reas.getLostEventStats();
+        std::cout << "Lost events per data id: ";
+        for(auto dl: lossStats.perDataId)
+        {
+            std::cout << "<" << std::get<1>(dl) << ":" << std::get<2>(dl) << "> ";
+            BOOST_CHECK(std::get<0>(dl) == 0);
+            if (std::get<1>(dl) == 0x0505)
+                BOOST_CHECK(std::get<2>(dl) == 3);
+            else if (std::get<1>(dl) == 0x0606)
+                BOOST_CHECK(std::get<2>(dl) == 1);
+            else
+                BOOST_CHECK(false);
+        }
+        std::cout << std::endl;
+        BOOST_CHECK(lossStats.perDataId.size() == 2);
+        BOOST_CHECK(lossStats.otherDataIds == 0);
+        // one fragment received for each event
+        BOOST_CHECK(lossStats.perFragCount[1] == 4);
+        BOOST_CHECK(lossStats.ringOverwrites == 0);
+
+        size_t lostCount{0};
+        while(true)
+        {
+            auto lostEvent = reas.get_LostEvent();
+            if (lostEvent.has_error())
+            {
+                BOOST_CHECK(lostEvent.error().code() == E2SARErrorc::NotFound);
+                break;
+            }
+            std::cout << "LOST EVENT " << lostEvent.value().get<0>() << ":" << lostEvent.value().get<1>() << 
+                " received " << lostEvent.value().get<2>() << " frames" << std::endl;
+            BOOST_CHECK(lostEvent.value().get<2>() == 1);
+            lostCount++;
+        }
+        BOOST_CHECK(lostCount == 4);
+
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+// this test sends single-frame events with gaps in event numbers to the reassembler
+// over local host and checks that never seen events are detected
+BOOST_AUTO_TEST_CASE(DPReasTest7)
+{
+    std::cout << "DPReasTest7: Test event sequence tracking on local host with no control plane" << std::endl;
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+        rflags.trackSequence = true;
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        const size_t pldLen{100};
+        FrameSender sender(listen_port, pldLen);
+        auto sendEvent = [&](EventNum_t evt, u_int16_t dataId) {
+            BOOST_CHECK(sender.send(dataId, 0, pldLen, evt));
+        };
+
+        // events 1-10 without event 5 - the gap is still inside the tracking window
+        for(EventNum_t evt = 1; evt <= 10; evt++)
+            if (evt != 5)
+                sendEvent(evt, 0x0505);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(200));
+
+        auto recvStats = reas.getStats();
+        BOOST_CHECK(recvStats.eventSuccess == 9);
+        BOOST_CHECK(recvStats.neverSeenLoss == 0);
+
+        // jump far ahead - event 5 and everything that can no longer fit 
+        // in the window behind event 10000 is never seen
+        sendEvent(10000, 0x0505);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(200));
+        recvStats = reas.getStats();
+        std::cout << "Never seen events: " << recvStats.neverSeenLoss << std::endl;
+        BOOST_CHECK(recvStats.eventSuccess == 10);
+        BOOST_CHECK(recvStats.neverSeenLoss == 1 + 10000 - 4096 - 10);
+        // never seen events are not reassembly losses
+        BOOST_CHECK(recvStats.reassemblyLoss == 0);
+
+        // a very late event is reported as out of window
+        sendEvent(3, 0x0505);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(200));
+
+        auto lossStats = reas.getLostEventStats();
+        BOOST_CHECK(lossStats.neverSeenPerDataId.size() == 1);
+        BOOST_CHECK(std::get<0>(lossStats.neverSeenPerDataId.front()) == 0);
+        BOOST_CHECK(std::get<1>(lossStats.neverSeenPerDataId.front()) == 0x0505);
+        BOOST_CHECK(std::get<2>(lossStats.neverSeenPerDataId.front()) == recvStats.neverSeenLoss);
+        BOOST_CHECK(lossStats.seqOutOfWindow == 1);
+
+        // drain the event queue
+        u_int8_t *eventBuf{nullptr};
+        size_t eventLen;
+        EventNum_t eventNum;
+        u_int16_t recDataId;
+        while(true)
+        {
+            auto recvres = reas.getEvent(&eventBuf, &eventLen, &eventNum, &recDataId);
+            if (recvres.has_error() || recvres.value() == -1)
+                break;
+            delete[] eventBuf;
+        }
+
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+// this test checks that with adaptive timeout an incomplete event is expired
+// well before the (long) fixed event timeout once a gap has been learned
+BOOST_AUTO_TEST_CASE(DPReasTest8)
+{
+    std::cout << "DPReasTest8: Test adaptive reassembly timeout on local host with no control plane" << std::endl;
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+        rflags.eventTimeout_ms = 2000; // upper bound
+        rflags.adaptiveTimeout = true;
+        rflags.adaptiveTimeoutMult = 10.0;
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        // send one half of a two-segment event
+        const size_t pldLen{100};
+        FrameSender sender(listen_port, pldLen);
+        auto sendHalf = [&](EventNum_t evt, int half) {
+            BOOST_CHECK(sender.send(0x0505, half*pldLen, 2*pldLen, evt));
+        };
+
+        // teach the reassembler that segments of these events come ~5ms apart
+        for(EventNum_t evt = 1; evt <= 5; evt++)
+        {
+            sendHalf(evt, 0);
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+            sendHalf(evt, 1);
+        }
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+        auto recvStats = reas.getStats();
+        BOOST_CHECK(recvStats.eventSuccess == 5);
+
+        // an incomplete event is expired long before the 2s upper bound
+        sendHalf(6, 0);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(500));
+        recvStats = reas.getStats();
+        std::cout << "Reassembly losses after 500ms: " << recvStats.reassemblyLoss << std::endl;
+        BOOST_CHECK(recvStats.reassemblyLoss == 1);
+
+        // the late segment is reported as a miss of the adaptive timeout
+        sendHalf(6, 1);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+        recvStats = reas.getStats();
+        BOOST_CHECK(recvStats.adaptiveTimeoutMisses == 1);
+
+        // drain the event queue
+        u_int8_t *eventBuf{nullptr};
+        size_t eventLen;
+        EventNum_t eventNum;
+        u_int16_t recDataId;
+        while(true)
+        {
+            auto recvres = reas.getEvent(&eventBuf, &eventLen, &eventNum, &recDataId);
+            if (recvres.has_error() || recvres.value() == -1)
+                break;
+            delete[] eventBuf;
+        }
+
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+#ifdef UDP_GRO_AVAILABLE
+// this test sends segments of several events as a single UDP GSO super-datagram over
+// local host and checks that the reassembler with UDP_GRO splits them up correctly
+BOOST_AUTO_TEST_CASE(DPReasTest9)
+{
+    std::cout << "DPReasTest9: Test UDP GRO receive on local host with no control plane" << std::endl;
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+        rflags.useGRO = true;
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        int sendSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        BOOST_CHECK(sendSocket >= 0);
+        sockaddr_in dest{};
+        dest.sin_family = AF_INET;
+        dest.sin_port = htobe16(listen_port);
+        inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr);
+
+        // 3 events of 4 segments each, the very last segment is shorter
+        const size_t numEvents{3}, segsPerEvent{4}, pldLen{1000}, lastPldLen{200};
+        const size_t segLen{sizeof(LBREHdr) + pldLen};
+        const size_t eventLen{(segsPerEvent - 1) * pldLen + lastPldLen};
+        std::vector<u_int8_t> superDgram(numEvents * segsPerEvent * segLen);
+        size_t dgramLen{0};
+        for(size_t evt = 0; evt < numEvents; evt++)
+        {
+            for(size_t seg = 0; seg < segsPerEvent; seg++)
+            {
+                // GSO requires all but the last segment to be of equal size
+                bool last = (evt == numEvents - 1) && (seg == segsPerEvent - 1);
+                auto hdr = new (superDgram.data() + dgramLen) LBREHdr();
+                hdr->re.set(0x0606, seg*pldLen, (evt == numEvents - 1 ? eventLen : segsPerEvent*pldLen), evt + 1);
+                memset(superDgram.data() + dgramLen + sizeof(LBREHdr), static_cast<int>(evt + 1), last ? lastPldLen : pldLen);
+                dgramLen += sizeof(LBREHdr) + (last ? lastPldLen : pldLen);
+            }
+        }
+
+        struct iovec iov{superDgram.data(), dgramLen};
+        u_int8_t ctrlBuffer[CMSG_SPACE(sizeof(u_int16_t))]{};
+        struct msghdr msg{};
+        msg.msg_name = &dest;
+        msg.msg_namelen = sizeof(dest);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrlBuffer;
+        msg.msg_controllen = sizeof(ctrlBuffer);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(u_int16_t));
+        u_int16_t gsoSize = segLen;
+        memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof(gsoSize));
+
+        auto ret = sendmsg(sendSocket, &msg, 0);
+        if (ret < 0)
+            std::cout << "Unable to send GSO datagram: " << strerror(errno) << std::endl;
+        BOOST_CHECK(ret == static_cast<ssize_t>(dgramLen));
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(200));
+
+        auto recvStats = reas.getStats();
+        std::cout << "Received " << recvStats.totalPackets << " segments in " << recvStats.eventSuccess << " events" << std::endl;
+        BOOST_CHECK(recvStats.totalPackets == numEvents * segsPerEvent);
+        BOOST_CHECK(recvStats.eventSuccess == numEvents);
+        BOOST_CHECK(recvStats.badHeaderDiscards == 0);
+
+        u_int8_t *eventBuf{nullptr};
+        size_t recvLen;
+        EventNum_t eventNum;
+        u_int16_t recDataId;
+        for(size_t i = 0; i < numEvents; i++)
+        {
+            auto recvres = reas.getEvent(&eventBuf, &recvLen, &eventNum, &recDataId);
+            BOOST_CHECK(!recvres.has_error() && recvres.value() != -1);
+            if (recvres.has_error() || recvres.value() == -1)
+                break;
+            BOOST_CHECK(recDataId == 0x0606);
+            BOOST_CHECK(recvLen == (eventNum == numEvents ? eventLen : segsPerEvent*pldLen));
+            BOOST_CHECK(eventBuf[0] == eventNum && eventBuf[recvLen - 1] == eventNum);
+            delete[] eventBuf;
+        }
+
+        close(sendSocket);
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+#endif
+
+#ifdef BUSY_POLL_AVAILABLE
+// this test runs the reassembler in busy poll mode over local host and checks 
+// that events are received and poll counters are reported
+BOOST_AUTO_TEST_CASE(DPReasTest10)
+{
+    std::cout << "DPReasTest10: Test busy poll receive on local host with no control plane" << std::endl;
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+        rflags.busyPoll = true;
+        rflags.busyPoll_us = 0; // values above net.core.busy_read need CAP_NET_ADMIN
+        rflags.spinBudget_us = 1000;
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        const size_t numEvents{100}, pldLen{100};
+        FrameSender sender(listen_port, pldLen);
+        for(EventNum_t evt = 1; evt <= numEvents; evt++)
+        {
+            BOOST_CHECK(sender.send(0x0707, 0, pldLen, evt));
+            // let the receive thread run out of its spin budget now and then
+            if (evt % 10 == 0)
+                boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+        }
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(200));
+
+        auto recvStats = reas.getStats();
+        std::cout << "Busy poll spins " << recvStats.busyPollSpins << " hits " << recvStats.busyPollHits << 
+            " fallbacks " << recvStats.busyPollFallbacks << std::endl;
+        BOOST_CHECK(recvStats.eventSuccess == numEvents);
+        BOOST_CHECK(recvStats.busyPollHits > 0);
+        BOOST_CHECK(recvStats.busyPollSpins >= recvStats.busyPollHits);
+        BOOST_CHECK(recvStats.busyPollFallbacks > 0);
+
+        // an idle receive thread stays blocked in select() instead of spinning again on every timeout
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(200));
+        BOOST_CHECK(reas.getStats().busyPollFallbacks == recvStats.busyPollFallbacks);
+
+        u_int8_t *eventBuf{nullptr};
+        size_t eventLen;
+        EventNum_t eventNum;
+        u_int16_t recDataId;
+        size_t received{0};
+        while(true)
+        {
+            auto recvres = reas.getEvent(&eventBuf, &eventLen, &eventNum, &recDataId);
+            if (recvres.has_error() || recvres.value() == -1)
+                break;
+            received++;
+            delete[] eventBuf;
+        }
+        BOOST_CHECK(received == numEvents);
+
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(DPReasTest11)
+{
+    std::cout << "DPReasTest11: Test event latency histograms on local host with no control plane" << std::endl;
+
+    // histogram bucketing is within 1/16 of the value
+    LatencyHistogram hist;
+    for(u_int64_t v = 1; v <= 1000; v++)
+        hist.record(v * 1000);
+    auto snap = hist.snapshot();
+    BOOST_CHECK(snap.count == 1000);
+    BOOST_CHECK(snap.min == 1000);
+    BOOST_CHECK(snap.max == 1000000);
+    BOOST_CHECK(snap.percentile(50.) >= 500000 && snap.percentile(50.) <= 500000 * 17 / 16);
+    BOOST_CHECK(snap.percentile(99.) >= 990000 && snap.percentile(99.) <= 1000000);
+    BOOST_CHECK(snap.percentile(100.) == 1000000);
+    hist.reset();
+    BOOST_CHECK(hist.snapshot().count == 0);
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        // two segments per event, 10ms apart
+        const size_t numEvents{10}, pldLen{100};
+        FrameSender sender(listen_port, pldLen);
+        for(EventNum_t evt = 1; evt <= numEvents; evt++)
+        {
+            for(size_t seg = 0; seg < 2; seg++)
+            {
+                BOOST_CHECK(sender.send(0x0707, seg * pldLen, 2 * pldLen, evt));
+                if (seg == 0)
+                    boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+            }
+        }
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+
+        u_int8_t *eventBuf{nullptr};
+        size_t eventLen;
+        EventNum_t eventNum;
+        u_int16_t recDataId;
+        size_t received{0};
+        while(true)
+        {
+            auto recvres = reas.getEvent(&eventBuf, &eventLen, &eventNum, &recDataId);
+            if (recvres.has_error() || recvres.value() == -1)
+                break;
+            received++;
+            delete[] eventBuf;
+        }
+        BOOST_CHECK(received == numEvents);
+
+        auto latency = reas.getLatencyStats();
+        std::cout << "First segment to complete p50 " << latency.firstToComplete.percentile(50.) << 
+            "ns, complete to dequeue p50 " << latency.completeToDequeue.percentile(50.) << "ns" << std::endl;
+        BOOST_CHECK(latency.firstToComplete.count == numEvents);
+        BOOST_CHECK(latency.completeToDequeue.count == numEvents);
+        // segments were sent 10ms apart
+        BOOST_CHECK(latency.firstToComplete.min >= 10000000);
+
+        reas.resetLatencyStats();
+        latency = reas.getLatencyStats();
+        BOOST_CHECK(latency.firstToComplete.count == 0);
+        BOOST_CHECK(latency.completeToDequeue.count == 0);
+
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DPReasTest12)
+{
+    std::cout << "DPReasTest12: Test OpenMetrics exporter on local host with no control plane" << std::endl;
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+        BOOST_CHECK(reas.addSession(reasUri, 10100).value() == 1);
+
+        // ephemeral port
+        MetricsExporter exporter(loopback, 0);
+        auto addres = exporter.addReassembler(reas, "test");
+        BOOST_CHECK(!addres.has_error());
+        addres = exporter.addReassembler(reas, "test");
+        BOOST_CHECK(addres.has_error());
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        auto expres = exporter.start();
+        if (expres.has_error())
+            std::cout << "Error starting metrics exporter: " << expres.error().message() << std::endl;
+        BOOST_CHECK(!expres.has_error());
+        BOOST_CHECK(exporter.getPort() != 0);
+
+        const size_t numEvents{10}, pldLen{100};
+        FrameSender sender(listen_port, pldLen);
+        for(EventNum_t evt = 1; evt <= numEvents; evt++)
+            BOOST_CHECK(sender.send(0x0707, 0, pldLen, evt));
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+
+        auto text = exporter.render();
+        BOOST_CHECK(text.find("# TYPE e2sar_reassembler_events_received counter") != std::string::npos);
+        BOOST_CHECK(text.find("e2sar_reassembler_events_received_total{name=\"test\"} 10") != std::string::npos);
+        BOOST_CHECK(text.find("e2sar_reassembler_port_fragments_total{name=\"test\",port=\"10000\"} 10") != std::string::npos);
+        BOOST_CHECK(text.find("e2sar_reassembler_event_queue_depth{name=\"test\",session=\"0\"} 10") != std::string::npos);
+        BOOST_CHECK(text.find("e2sar_reassembler_event_queue_depth{name=\"test\",session=\"1\"} 0") != std::string::npos);
+        BOOST_CHECK(text.find("e2sar_reassembler_first_to_complete_seconds_bucket{name=\"test\",le=\"+Inf\"} 10") != std::string::npos);
+        // bucket bounds are the exact tops of the histogram buckets they cover, 2^10-1 ns .. 2^34-1 ns
+        BOOST_CHECK(text.find("e2sar_reassembler_first_to_complete_seconds_bucket{name=\"test\",le=\"1.023e-06\"}") != std::string::npos);
+        BOOST_CHECK(text.find("e2sar_reassembler_first_to_complete_seconds_bucket{name=\"test\",le=\"17.179869183\"} 10") != std::string::npos);
+        BOOST_CHECK(text.size() > 6 && text.substr(text.size() - 6) == "# EOF\n");
+
+        // scrape it over HTTP
+        int httpSocket = socket(AF_INET, SOCK_STREAM, 0);
+        BOOST_CHECK(httpSocket >= 0);
+        sockaddr_in httpAddr{};
+        httpAddr.sin_family = AF_INET;
+        httpAddr.sin_port = htobe16(exporter.getPort());
+        inet_pton(AF_INET, "127.0.0.1", &httpAddr.sin_addr);
+        BOOST_CHECK(connect(httpSocket, (const sockaddr*)&httpAddr, sizeof(httpAddr)) == 0);
+        std::string request{"GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+        BOOST_CHECK(send(httpSocket, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+        std::string response;
+        char buf[4096];
+        ssize_t nbytes;
+        while((nbytes = recv(httpSocket, buf, sizeof(buf), 0)) > 0)
+            response.append(buf, nbytes);
+        close(httpSocket);
+        BOOST_CHECK(response.find("HTTP/1.1 200 OK") == 0);
+        BOOST_CHECK(response.find("Content-Type: application/openmetrics-text") != std::string::npos);
+        BOOST_CHECK(response.find("e2sar_reassembler_events_received_total{name=\"test\"} 10") != std::string::npos);
+
+        exporter.stop();
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DPReasTest13)
+{
+    std::cout << "DPReasTest13: Test kernel receive socket drop accounting on local host with no control plane" << std::endl;
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+        rflags.rcvSocketBufSize = 4096; // tiny buffer so that a burst overflows it
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        const size_t numEvents{2000}, pldLen{1000};
+        FrameSender sender(listen_port, pldLen);
+        for(EventNum_t evt = 1; evt <= numEvents; evt++)
+            sender.send(0x0707, 0, pldLen, evt);
+        // the drop count arrives with the next datagram delivered after the drops
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+        sender.send(0x0707, 0, pldLen, numEvents + 1);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+
+        auto recvStats = reas.getStats();
+        std::cout << "Received " << recvStats.totalPackets << " fragments, kernel dropped " << recvStats.kernelDrops << std::endl;
+#ifdef RXQ_OVFL_AVAILABLE
+        // everything sent was either received or dropped by the kernel
+        BOOST_CHECK(recvStats.totalPackets + recvStats.kernelDrops == numEvents + 1);
+        BOOST_CHECK(recvStats.kernelDrops > 0);
+#else
+        BOOST_CHECK(recvStats.kernelDrops == 0);
+#endif
+
+        auto dropStats = reas.get_PortDropStats();
+        BOOST_CHECK(!dropStats.has_error());
+        size_t portDrops{0};
+        for(auto &pd: dropStats.value())
+            portDrops += pd.second;
+        BOOST_CHECK(portDrops == recvStats.kernelDrops);
+
+        // segments that don't fit into their event buffer are discarded: one that runs past the 
+        // event length in its own header, and one that runs past the length of the event it joins
+        const size_t smallPldLen{100};
+        FrameSender smallSender(listen_port, smallPldLen);
+        smallSender.send(0x0707, 50, 100, numEvents + 2);
+        smallSender.send(0x0707, 0, 100, numEvents + 3, smallPldLen/2);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+        smallSender.send(0x0707, 50, 300, numEvents + 3);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+        BOOST_CHECK(reas.getStats().badHeaderDiscards == 2);
+
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DPReasTest14)
+{
+    std::cout << "DPReasTest14: Test fragment trace rings and trace dumps on local host with no control plane" << std::endl;
+
+    // ring keeps only the newest records
+    TraceRing ring;
+    for(EventNum_t evt = 1; evt <= TraceRing::RECORDS + 10; evt++)
+        ring.record(TraceAction::reasFragmentReceived, evt, 1, 0, 100);
+    auto snap = ring.snapshot();
+    BOOST_CHECK(snap.size() == TraceRing::RECORDS);
+    BOOST_CHECK(snap.front().eventNum == 11);
+    BOOST_CHECK(snap.back().eventNum == TraceRing::RECORDS + 10);
+    BOOST_CHECK(ring.written() == TraceRing::RECORDS + 10);
+
+    // snapshots taken while a writer wraps the ring never return torn or reordered records
+    {
+        TraceRing busyRing;
+        std::atomic<bool> stopWriter{false};
+        boost::thread writer([&]() {
+            for(EventNum_t evt = 1; !stopWriter; evt++)
+                busyRing.record(TraceAction::reasFragmentReceived, evt, 1, static_cast<u_int32_t>(evt), 
+                    ~static_cast<u_int32_t>(evt));
+        });
+        bool consistent{true};
+        for(int i = 0; i < 100; i++)
+        {
+            auto busySnap = busyRing.snapshot();
+            for(size_t r = 0; r < busySnap.size(); r++)
+            {
+                if ((busySnap[r].offset != static_cast<u_int32_t>(busySnap[r].eventNum)) ||
+                    (busySnap[r].length != ~static_cast<u_int32_t>(busySnap[r].eventNum)) ||
+                    ((r > 0) && (busySnap[r].eventNum <= busySnap[r - 1].eventNum)))
+                    consistent = false;
+            }
+        }
+        stopWriter = true;
+        writer.join();
+        BOOST_CHECK(consistent);
+    }
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+        rflags.eventTimeout_ms = 100; // so the incomplete event expires quickly
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        const size_t pldLen{1000};
+        FrameSender sender(listen_port, pldLen);
+        auto sendFrame = [&](EventNum_t evt, u_int32_t offset) {
+            sender.send(0x0505, offset, 2*pldLen, evt);
+        };
+        // event 1 complete, event 2 missing its second fragment, then a runt
+        sendFrame(1, 0);
+        sendFrame(1, pldLen);
+        sendFrame(2, 0);
+        sender.sendRaw(sizeof(LBREHdr) - 4);
+
+        // let event 2 expire
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(500));
+
+        std::string traceFile{"/tmp/e2sar_reas_test.trace"};
+        auto dumpRes = reas.dumpTrace(traceFile);
+        BOOST_CHECK(!dumpRes.has_error());
+        reas.stopThreads();
+
+        auto readRes = TraceFile::read(traceFile);
+        BOOST_CHECK(!readRes.has_error());
+        auto &contents = readRes.value();
+        BOOST_CHECK(contents.ticksPerSec > 0);
+        BOOST_CHECK(contents.rings.size() == 2);
+        BOOST_CHECK(contents.rings[0].name == "recv-0");
+        BOOST_CHECK(contents.rings[1].name == "gc");
+
+        size_t fragments{0}, started{0}, completed{0}, badHeaders{0};
+        u_int64_t prevTsc{0};
+        bool ordered{true};
+        for(auto &rec: contents.rings[0].records)
+        {
+            ordered = ordered && (rec.tsc >= prevTsc);
+            prevTsc = rec.tsc;
+            switch(rec.action)
+            {
+                case TraceAction::reasFragmentReceived:
+                    fragments++;
+                    BOOST_CHECK(rec.dataId == 0x0505);
+                    BOOST_CHECK(rec.length == pldLen);
+                    break;
+                case TraceAction::reasEventStarted: 
+                    started++; 
+                    break;
+                case TraceAction::reasEventCompleted:
+                    completed++;
+                    BOOST_CHECK(rec.eventNum == 1);
+                    BOOST_CHECK(rec.aux == 2);
+                    break;
+                case TraceAction::reasBadHeader: 
+                    badHeaders++; 
+                    break;
+                default:
+                    break;
+            }
+        }
+        BOOST_CHECK(ordered);
+        BOOST_CHECK(fragments == 3);
+        BOOST_CHECK(started == 2);
+        BOOST_CHECK(completed == 1);
+        BOOST_CHECK(badHeaders == 1);
+
+        BOOST_CHECK(contents.rings[1].records.size() == 1);
+        if (contents.rings[1].records.size() == 1)
+        {
+            auto &expired = contents.rings[1].records[0];
+            BOOST_CHECK(expired.action == TraceAction::reasEventExpired);
+            BOOST_CHECK(expired.eventNum == 2);
+            BOOST_CHECK(expired.offset == pldLen);
+            BOOST_CHECK(expired.length == 2*pldLen);
+            BOOST_CHECK(expired.aux == 1);
+            // expiration happened within the last second in wall clock time
+            auto nowNs = boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                boost::chrono::system_clock::now().time_since_epoch()).count();
+            auto ageMs = (nowNs - contents.toEpochNs(expired.tsc)) / 1000000;
+            std::cout << "Event expired " << ageMs << "ms ago" << std::endl;
+            BOOST_CHECK(ageMs >= 0 && ageMs < 1000);
+        }
+        std::remove(traceFile.c_str());
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DPReasTest15)
+{
+    std::cout << "DPReasTest15: Test consistent stats samples and rate history on local host with no control plane" << std::endl;
+
+    // sample ring keeps only the newest samples, oldest first
+    SampleRing<Reassembler::RateSample, 4> ring;
+    BOOST_CHECK(ring.last(10).size() == 0);
+    for(u_int64_t i = 1; i <= 6; i++)
+    {
+        Reassembler::RateSample sample;
+        sample.eventCnt = i;
+        ring.push(sample);
+    }
+    auto history = ring.last(10);
+    BOOST_CHECK(history.size() == 4);
+    BOOST_CHECK(history.front().eventCnt == 3);
+    BOOST_CHECK(history.back().eventCnt == 6);
+    BOOST_CHECK(ring.last(2).front().eventCnt == 5);
+    BOOST_CHECK(ring.count() == 6);
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        // nothing sampled before the threads start
+        BOOST_CHECK(reas.getStatsSnapshot().timestampNs == 0);
+        BOOST_CHECK(reas.getStatsHistory().size() == 0);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        const size_t pldLen{1000};
+        const EventNum_t numEvents{50};
+        FrameSender sender(listen_port, pldLen);
+        for(EventNum_t evt = 1; evt <= numEvents; evt++)
+            sender.send(0x0505, 0, pldLen, evt);
+
+        // wait for at least two samples
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(2*Reassembler::SAMPLE_PERIOD_MS + 300));
+
+        auto sample = reas.getStatsSnapshot();
+        auto stats = reas.getStats();
+        reas.stopThreads();
+
+        std::cout << "Sample: " << sample.eventCnt << " events " << sample.packetCnt << " packets " << 
+            sample.byteCnt << " bytes over " << sample.periodNs << "ns" << std::endl;
+        BOOST_CHECK(sample.timestampNs > 0);
+        BOOST_CHECK(sample.periodNs > Reassembler::SAMPLE_PERIOD_MS * 900000);
+        BOOST_CHECK(sample.periodNs < Reassembler::SAMPLE_PERIOD_MS * 1100000);
+        BOOST_CHECK(sample.eventCnt == numEvents);
+        BOOST_CHECK(sample.packetCnt == numEvents);
+        BOOST_CHECK(sample.byteCnt == stats.totalBytes);
+        BOOST_CHECK(sample.queueDepth == numEvents);
+        BOOST_CHECK(sample.lossCnt == 0);
+
+        history = reas.getStatsHistory();
+        BOOST_CHECK(history.size() >= 2);
+        BOOST_CHECK(history.back().timestampNs == sample.timestampNs);
+        // all traffic arrived before the first sample, so its rate accounts for all of it
+        // and the rates that follow are 0
+        double events{0.};
+        for(auto &h: history)
+            events += h.eventRate * h.periodNs / 1e9;
+        BOOST_CHECK(std::abs(events - numEvents) < 0.5);
+        BOOST_CHECK(history.back().eventRate == 0.);
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DPReasTest16)
+{
+    std::cout << "DPReasTest16: Test per data id receive stats on local host with no control plane" << std::endl;
+
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+        rflags.eventTimeout_ms = 100; // so the incomplete event expires quickly
+        rflags.perDataIdStats = true;
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res = reas.openAndStart();
+        if (res.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res.error().message() << std::endl;
+        BOOST_CHECK(!res.has_error());
+
+        const size_t pldLen{1000};
+        FrameSender sender(listen_port, pldLen);
+        // data id 1: 3 single fragment events
+        for(EventNum_t evt = 1; evt <= 3; evt++)
+            sender.send(1, 0, pldLen, evt);
+        // data id 2: 2 events of 2 fragments and one missing its second fragment
+        for(EventNum_t evt = 1; evt <= 2; evt++)
+        {
+            sender.send(2, 0, 2*pldLen, evt);
+            sender.send(2, pldLen, 2*pldLen, evt);
+        }
+        sender.send(2, 0, 2*pldLen, 3);
+        // fill the rest of the table with one event per data id
+        const u_int16_t tableSize{128}; // DATAID_STATS_SLOTS
+        for(u_int16_t dataId = 3; dataId <= tableSize; dataId++)
+            sender.send(dataId, 0, pldLen, 1);
+        // two data ids that don't fit: one complete and one incomplete event each, every
+        // event counts once towards the overflow however many fragments it had
+        for(u_int16_t dataId = tableSize + 1; dataId <= tableSize + 2; dataId++)
+        {
+            sender.send(dataId, 0, 2*pldLen, 1);
+            sender.send(dataId, pldLen, 2*pldLen, 1);
+            sender.send(dataId, 0, 2*pldLen, 2);
+        }
+
+        // let the incomplete events expire
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(500));
+
+        auto dataIdStats = reas.getDataIdStats();
+        auto overflow = reas.getDataIdStatsOverflow();
+        reas.stopThreads();
+
+        BOOST_CHECK(dataIdStats.size() == tableSize);
+        BOOST_CHECK(overflow == 4);
+        for(auto &ds: dataIdStats)
+        {
+            BOOST_CHECK(ds.session == 0);
+            if (ds.dataId <= 2)
+                std::cout << "Data id " << ds.dataId << ": " << ds.events << " events " << ds.bytes << " bytes " <<
+                    ds.meanFragments() << " fragments per event " << ds.reassemblyLoss << " lost" << std::endl;
+            if (ds.dataId == 1)
+            {
+                BOOST_CHECK(ds.events == 3);
+                BOOST_CHECK(ds.bytes == 3*pldLen);
+                BOOST_CHECK(ds.meanFragments() == 1.);
+                BOOST_CHECK(ds.reassemblyLoss == 0);
+            }
+            else if (ds.dataId == 2)
+            {
+                BOOST_CHECK(ds.events == 2);
+                BOOST_CHECK(ds.bytes == 4*pldLen);
+                BOOST_CHECK(ds.meanFragments() == 2.);
+                BOOST_CHECK(ds.reassemblyLoss == 1);
+            }
+            else
+                BOOST_CHECK(ds.events == 1);
+            BOOST_CHECK(ds.enqueueLoss == 0);
+        }
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DPReasTest17)
+{
+    std::cout << "DPReasTest17: Test per send socket stats and send time by event size on local host with no control plane" << std::endl;
+
+    BOOST_CHECK(Segmenter::sendSizeBucketLimit(0) == 4096);
+    BOOST_CHECK(Segmenter::sendSizeBucketLimit(1) == 16384);
+    BOOST_CHECK(Segmenter::sendSizeBucketLimit(Segmenter::SEND_SIZE_BUCKETS - 1) == std::numeric_limits<size_t>::max());
+
+    // create URI for segmenter - since we will turn off CP only the data part of the query is used
+    std::string segUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1:10000"};
+    // create URI for reassembler - since we turn off CP, none of it is actually used
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        EjfatURI segUri(segUriString, EjfatURI::TokenType::instance);
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+
+        // create segmenter with no control plane and two send sockets
+        Segmenter::SegmenterFlags sflags;
+
+        sflags.useCP = false; // turn off CP
+        sflags.numSendSockets = 2;
+        sflags.mtu = 1500;
+
+        u_int16_t dataId = 0x0505;
+        u_int32_t eventSrcId = 0x11223344;
+
+        Segmenter seg(segUri, dataId, eventSrcId, sflags);
+
+        // create reassembler with no control plane
+        Reassembler::ReassemblerFlags rflags;
+
+        rflags.useCP = false; // turn off CP
+        rflags.withLBHeader = true; // LB header will be attached since there is no LB
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        u_int16_t listen_port = 10000;
+        Reassembler reas(reasUri, loopback, listen_port, 1, rflags);
+
+        auto res1 = seg.openAndStart();
+        if (res1.has_error())
+            std::cout << "Error encountered opening sockets and starting segmenter threads: " << res1.error().message() << std::endl;
+        BOOST_CHECK(!res1.has_error());
+
+        auto res2 = reas.openAndStart();
+        if (res2.has_error())
+            std::cout << "Error encountered opening sockets and starting reassembler threads: " << res2.error().message() << std::endl;
+        BOOST_CHECK(!res2.has_error());
+
+        // 4 small events and 2 events in the [16KB, 64KB) bucket
+        std::vector<u_int8_t> smallEvent(1000, 'a');
+        std::vector<u_int8_t> largeEvent(20000, 'b');
+        for(auto i = 0; i < 4; i++)
+            BOOST_CHECK(!seg.sendEvent(smallEvent.data(), smallEvent.size()).has_error());
+        for(auto i = 0; i < 2; i++)
+            BOOST_CHECK(!seg.sendEvent(largeEvent.data(), largeEvent.size()).has_error());
+
+        auto sendStats = seg.getSendStats();
+        auto socketStats = seg.getSocketStats();
+        auto latency = seg.getLatencyStats();
+
+        BOOST_CHECK(socketStats.size() == 2);
+        u_int64_t fragments{0}, bytes{0};
+        for(auto &ss: socketStats)
+        {
+            std::cout << "Socket " << ss.index << ": " << ss.fragments << " fragments " << ss.bytes << " bytes " <<
+                ss.errors << " errors" << std::endl;
+            // round robin spreads the events evenly
+            BOOST_CHECK(ss.fragments > 0);
+            BOOST_CHECK(ss.errors == 0);
+            fragments += ss.fragments;
+            bytes += ss.bytes;
+        }
+        BOOST_CHECK(fragments == sendStats.msgCnt);
+        BOOST_CHECK(bytes == 4*smallEvent.size() + 2*largeEvent.size() + fragments*sizeof(LBREHdr));
+        BOOST_CHECK(seg.getOutstandingSends() == 0);
+
+        BOOST_CHECK(latency.sendDurationBySize.size() == Segmenter::SEND_SIZE_BUCKETS);
+        BOOST_CHECK(latency.sendDurationBySize[0].count == 4);
+        BOOST_CHECK(latency.sendDurationBySize[1].count == 0);
+        BOOST_CHECK(latency.sendDurationBySize[2].count == 2);
+        BOOST_CHECK(latency.sendDuration.count == 6);
+
+        seg.stopThreads();
+        reas.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::error_code &e) {
+        std::cout << "STD ERROR CODE " << e.value() << " category " << e.category().name() << " with message " << e.message() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (boost::exception &e) {
+        std::cout << "BOOST:EXCEPTION encountered " << typeid(e).name() << ": " << *boost::get_error_info<boost::throw_function>(e) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DPReasTest18)
+{
+    std::cout << "DPReasTest18: Test segmentation and reassembly on local host through the software LB emulator" << std::endl;
+
+    // segmenter sends to the emulator, which strips the LB header and forwards to the reassemblers
+    std::string segUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1:19522"};
+    std::string reasUriString{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    try {
+        ip::address loopback = ip::make_address("127.0.0.1");
+
+        LBEmulator::LBEmulatorFlags eflags;
+        eflags.numThreads = 2;
+        LBEmulator emu(loopback, 19522, eflags);
+
+        // calendar: weights 1 and 3 share the slots 1:3, port selected within the port range
+        BOOST_CHECK(emu.route(LBHdrU(lbhdrVersion2)).has_error()); // no epoch yet
+        BOOST_CHECK(!emu.addWorker("w1", loopback, 21000, 0, 1.0).has_error());
+        BOOST_CHECK(!emu.addWorker("w2", loopback, 22000, 1, 3.0).has_error());
+        BOOST_CHECK(emu.addWorker("w2", loopback, 23000, 0, 1.0).has_error()); // duplicate name
+        BOOST_CHECK(emu.addWorker("w3", loopback, 23000, 15, 1.0).has_error()); // port range too large
+        BOOST_CHECK(!emu.newEpoch(0).has_error());
+
+        size_t w1Slots{0}, w2Slots{0};
+        for(EventNum_t tick = 0; tick < LBEmulator::CALENDAR_SLOTS; tick++)
+        {
+            LBHdrU hdr(lbhdrVersion2);
+            hdr.lb2.set(1, tick);
+            auto r = emu.route(hdr);
+            BOOST_CHECK(!r.has_error());
+            if (r.value().first == "w1")
+            {
+                w1Slots++;
+                BOOST_CHECK(r.value().second == 21000);
+            }
+            else
+            {
+                w2Slots++;
+                BOOST_CHECK(r.value().second == 22001);
+            }
+        }
+        BOOST_CHECK(w1Slots == LBEmulator::CALENDAR_SLOTS/4);
+        BOOST_CHECK(w2Slots == 3*LBEmulator::CALENDAR_SLOTS/4);
+
+        // v3 header selects the slot and port explicitly
+        LBHdrU hdr3(lbhdrVersion3);
+        hdr3.lb3.set(7, 2, 100);
+        BOOST_CHECK(!emu.route(hdr3).has_error());
+
+        // a new epoch without w1 only applies to ticks at or after its start
+        BOOST_CHECK(!emu.removeWorker("w1").has_error());
+        BOOST_CHECK(emu.removeWorker("w1").has_error());
+        BOOST_CHECK(!emu.newEpoch(1000).has_error());
+        BOOST_CHECK(emu.newEpoch(500).has_error());
+        bool oldEpochHasW1{false};
+        for(EventNum_t tick = 0; tick < 4; tick++)
+        {
+            LBHdrU hdr(lbhdrVersion2);
+            hdr.lb2.set(0, tick);
+            oldEpochHasW1 |= (emu.route(hdr).value().first == "w1");
+            hdr.lb2.set(0, 1000 + tick);
+            BOOST_CHECK(emu.route(hdr).value().first == "w2");
+        }
+        BOOST_CHECK(oldEpochHasW1);
+
+        // now forward real traffic to two reassemblers sharing the calendar evenly,
+        // the segmenter LB ticks are far past the start of this epoch
+        BOOST_CHECK(!emu.addWorker("w1", loopback, 21000, 0, 1.0).has_error());
+        BOOST_CHECK(!emu.removeWorker("w2").has_error());
+        BOOST_CHECK(!emu.addWorker("w2", loopback, 22000, 0, 1.0).has_error());
+        BOOST_CHECK(!emu.newEpoch(2000).has_error());
+
+        Segmenter::SegmenterFlags sflags;
+        sflags.useCP = false;
+        EjfatURI segUri(segUriString, EjfatURI::TokenType::instance);
+        EjfatURI reasUri(reasUriString, EjfatURI::TokenType::instance);
+        Segmenter seg(segUri, 0x0505, 0x11223344, sflags);
+
+        Reassembler::ReassemblerFlags rflags;
+        rflags.useCP = false;
+        rflags.withLBHeader = false; // the emulator strips it
+        Reassembler reas1(reasUri, loopback, 21000, 1, rflags);
+        Reassembler reas2(reasUri, loopback, 22000, 1, rflags);
+
+        BOOST_CHECK(!emu.openAndStart().has_error());
+        BOOST_CHECK(!reas1.openAndStart().has_error());
+        BOOST_CHECK(!reas2.openAndStart().has_error());
+        BOOST_CHECK(!seg.openAndStart().has_error());
+
+        std::vector<u_int8_t> event(20000, 'e');
+        const size_t numEvents{20};
+        for(size_t i = 0; i < numEvents; i++)
+            BOOST_CHECK(!seg.addToSendQueue(event.data(), event.size()).has_error());
+        boost::this_thread::sleep_for(boost::chrono::seconds(2));
+
+        auto stats1 = reas1.getStats();
+        auto stats2 = reas2.getStats();
+        auto emuStats = emu.getStats();
+        auto sendStats = seg.getSendStats();
+        std::cout << "Emulator received " << emuStats.packetsReceived << " forwarded " << emuStats.packetsForwarded <<
+            ", reassembler 1 got " << stats1.eventSuccess << " events, reassembler 2 got " << stats2.eventSuccess << std::endl;
+        BOOST_CHECK(emuStats.packetsReceived == sendStats.msgCnt);
+        BOOST_CHECK(emuStats.packetsForwarded == sendStats.msgCnt);
+        BOOST_CHECK(emuStats.badHeaderDiscards == 0);
+        BOOST_CHECK(emuStats.noWorkerDiscards == 0);
+        // the segmenter uses time as the LB tick, so the split between the workers varies
+        BOOST_CHECK(stats1.eventSuccess + stats2.eventSuccess == numEvents);
+        BOOST_CHECK(stats1.eventSuccess > 0);
+        BOOST_CHECK(stats2.eventSuccess > 0);
+        BOOST_CHECK(emu.get_maxTick() > 2000);
+
+        seg.stopThreads();
+        reas1.stopThreads();
+        reas2.stopThreads();
+        emu.stopThreads();
+    }
+    catch (E2SARException &ee) {
+        std::cout << "Exception encountered: " << static_cast<std::string>(ee) << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (std::exception &e) {
+        std::cout << "STD:EXCEPTION encountered " << typeid(e).name() << ": " << e.what() << std::endl;
+        BOOST_CHECK(false);
+    }
+    catch (...) {
+        std::cout << "Some other exception" << std::endl;
+        BOOST_CHECK(false);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(DPReasTest19, MockCPFixture)
+{
+    std::cout << "DPReasTest19: Test the Reassembler control loop against the mock control plane" << std::endl;
+
+    reportExceptions([&]() {
+        Reassembler::ReassemblerFlags rflags;
+        rflags.withLBHeader = true;
+        rflags.period_ms = 50;
+        rflags.setPoint = 0.5;
+        rflags.Kp = 1.0;
+        Reassembler reas(reserve("pidtest"), loopback, 19522, 1, rflags);
+
+        BOOST_CHECK(!reas.registerWorker("pidworker").has_error());
+        BOOST_CHECK(mock.get_numWorkers() == 1);
+        BOOST_CHECK(!reas.openAndStart().has_error());
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(1000));
+
+        // empty queue below the set point - positive control signal from the proportional term
+        auto samples = mock.getSendStateSamples();
+        std::cout << "Mock received " << samples.size() << " SendState samples" << std::endl;
+        BOOST_CHECK(samples.size() >= 10);
+        if (samples.size() > 0)
+        {
+            BOOST_CHECK(samples.back().fillPercent == 0.0);
+            BOOST_CHECK(samples.back().controlSignal > 0.0);
+            BOOST_CHECK(samples.back().isReady);
+        }
+
+        // a control plane failing every SendState shows up as failed RPCs, not as a stalled loop
+        mock.setErrors(1.0, grpc::StatusCode::UNAVAILABLE, true);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(500));
+        mock.setErrors(0.0);
+        auto sss = reas.getSendStateStats();
+        BOOST_CHECK(sss.failed > 0);
+        mock.clearSendStateSamples();
+        // backoff is at most a few hundred ms after this few failures
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(1500));
+        BOOST_CHECK(mock.getSendStateSamples().size() > 0);
+
+        reas.stopThreads();
+        BOOST_CHECK(!reas.deregisterWorker().has_error());
+        BOOST_CHECK(mock.get_numWorkers() == 0);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(DPReasTest20)
+{
+    std::cout << "DPReasTest20: Test one Reassembler hosting two sessions on shared receive threads" << std::endl;
+
+    // two senders using the same event numbers and data id, each sending to its own session
+    std::string segUriString1{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1:10200"};
+    std::string segUriString2{"ejfat://useless@192.168.100.1:9876/lb/2?sync=192.168.0.1:12345&data=127.0.0.1:10300"};
+    std::string reasUriString1{"ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1"};
+    std::string reasUriString2{"ejfat://useless@192.168.100.1:9876/lb/2?sync=192.168.0.1:12345&data=127.0.0.1"};
+
+    reportExceptions([&]() {
+        EjfatURI segUri1(segUriString1, EjfatURI::TokenType::instance);
+        EjfatURI segUri2(segUriString2, EjfatURI::TokenType::instance);
+        EjfatURI reasUri1(reasUriString1, EjfatURI::TokenType::instance);
+        EjfatURI reasUri2(reasUriString2, EjfatURI::TokenType::instance);
+
+        Segmenter::SegmenterFlags sflags;
+        sflags.useCP = false;
+        u_int16_t dataId = 0x0505;
+        Segmenter seg1(segUri1, dataId, 0x11223344, sflags);
+        Segmenter seg2(segUri2, dataId, 0x11223355, sflags);
+
+        Reassembler::ReassemblerFlags rflags;
+        rflags.useCP = false;
+        rflags.withLBHeader = true;
+        rflags.portRange = 1;
+        rflags.perDataIdStats = true;
+        rflags.trackSequence = true;
+
+        ip::address loopback = ip::make_address("127.0.0.1");
+        Reassembler reas(reasUri1, loopback, 10200, 1, rflags);
+
+        // ports of different sessions must not overlap
+        BOOST_CHECK(reas.addSession(reasUri2, 10201).has_error());
+        auto sessRes = reas.addSession(reasUri2, 10300, 0);
+        BOOST_CHECK(!sessRes.has_error());
+        BOOST_CHECK(sessRes.value() == 1);
+        BOOST_CHECK(reas.get_numSessions() == 2);
+        BOOST_CHECK(reas.get_numRecvThreads() == 1);
+
+        BOOST_CHECK(!seg1.openAndStart().has_error());
+        BOOST_CHECK(!seg2.openAndStart().has_error());
+        BOOST_CHECK(!reas.openAndStart().has_error());
+
+        // no sessions once the threads are running
+        BOOST_CHECK(reas.addSession(reasUri2, 10400).has_error());
+
+        auto fdStats = reas.get_FDStats();
+        BOOST_CHECK(!fdStats.has_error());
+        BOOST_CHECK(fdStats.value().size() == 3);
+
+        std::string eventString1{"THIS IS AN EVENT FOR THE FIRST SESSION"s};
+        std::string eventString2{"THIS IS A SOMEWHAT LONGER EVENT FOR THE SECOND SESSION"s};
+        for(auto i=0; i<5;i++) {
+            BOOST_CHECK(!seg1.addToSendQueue(reinterpret_cast<u_int8_t*>(eventString1.data()), 
+                eventString1.length()).has_error());
+            BOOST_CHECK(!seg2.addToSendQueue(reinterpret_cast<u_int8_t*>(eventString2.data()), 
+                eventString2.length()).has_error());
+        }
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(500));
+
+        u_int8_t *eventBuf{nullptr};
+        size_t eventLen;
+        EventNum_t eventNum;
+        u_int16_t recDataId;
+
+        // each session queue has only the events of its sender
+        for(size_t sess = 0; sess < 2; sess++)
+        {
+            size_t received{0};
+            while(true)
+            {
+                auto recvres = reas.recvEvent(sess, &eventBuf, &eventLen, &eventNum, &recDataId, 100);
+                BOOST_CHECK(!recvres.has_error());
+                if (recvres.value() == -1)
+                    break;
+                BOOST_CHECK(eventLen == (sess == 0 ? eventString1.length() : eventString2.length()));
+                BOOST_CHECK(recDataId == dataId);
+                delete[] eventBuf;
+                received++;
+            }
+            BOOST_CHECK(received == 5);
+
+            auto statsRes = reas.getSessionStats(sess);
+            BOOST_CHECK(!statsRes.has_error());
+            BOOST_CHECK(statsRes.value().eventSuccess == 5);
+            BOOST_CHECK(statsRes.value().reassemblyLoss == 0);
+            BOOST_CHECK(statsRes.value().queueDepth == 0);
+        }
+        BOOST_CHECK(reas.getSessionStats(1).value().recvPorts.first == 10300);
+        BOOST_CHECK(reas.getSessionStats(1).value().recvPorts.second == 10300);
+        BOOST_CHECK(reas.getSessionStats(2).has_error());
+        BOOST_CHECK(reas.getEvent(2, &eventBuf, &eventLen, &eventNum, &recDataId).has_error());
+        BOOST_CHECK(reas.getStats().eventSuccess == 10);
+
+        // per data id tables keep the sessions sharing a data id apart
+        auto dataIdStats = reas.getDataIdStats();
+        BOOST_CHECK(dataIdStats.size() == 2);
+        std::set<size_t> statsSessions;
+        for(auto &ds: dataIdStats)
+        {
+            statsSessions.insert(ds.session);
+            BOOST_CHECK(ds.dataId == dataId);
+            BOOST_CHECK(ds.events == 5);
+            BOOST_CHECK(ds.bytes == 5*(ds.session == 0 ? eventString1.length() : eventString2.length()));
+        }
+        BOOST_CHECK(statsSessions.size() == 2);
+        auto lossStats = reas.getLostEventStats();
+        BOOST_CHECK(lossStats.neverSeenPerDataId.size() == 2);
+        for(auto &dl: lossStats.neverSeenPerDataId)
+        {
+            BOOST_CHECK(std::get<1>(dl) == dataId);
+            BOOST_CHECK(std::get<2>(dl) == 0);
+        }
+        BOOST_CHECK(lossStats.seqOutOfWindow == 0);
+
+        seg1.stopThreads();
+        seg2.stopThreads();
+        reas.stopThreads();
+    });
+
+    // with a control plane each session registers and runs its own PID loop
+    MockCPFixture cp;
+    auto &mock = cp.mock;
+    reportExceptions([&]() {
+        EjfatURI lbUri2 = cp.reserve("sess2");
+
+        Reassembler::ReassemblerFlags rflags;
+        rflags.withLBHeader = true;
+        rflags.period_ms = 50;
+        Reassembler reas(cp.reserve("sess1"), cp.loopback, 10500, 1, rflags);
+        BOOST_CHECK(!reas.addSession(lbUri2, 10600).has_error());
+
+        BOOST_CHECK(!reas.registerWorker("multiworker").has_error());
+        BOOST_CHECK(mock.get_numWorkers() == 2);
+        BOOST_CHECK(reas.getSessionStats(1).value().registered);
+        BOOST_CHECK(!reas.openAndStart().has_error());
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(500));
+
+        // both sessions report state
+        std::set<std::string> reporting;
+        for(auto &sample: mock.getSendStateSamples())
+            reporting.insert(sample.sessionId);
+        BOOST_CHECK(reporting.size() == 2);
+
+        reas.stopThreads();
+        BOOST_CHECK(!reas.deregisterWorker().has_error());
+        BOOST_CHECK(mock.get_numWorkers() == 0);
+
+        // registration is all or nothing - failing in the second session undoes the first
+        BOOST_CHECK(!LBManager(lbUri2).freeLB().has_error());
+        BOOST_CHECK(reas.registerWorker("multiworker").has_error());
+        BOOST_CHECK(mock.get_numWorkers() == 0);
+        BOOST_CHECK(!reas.getSessionStats(0).value().registered);
+        BOOST_CHECK(!reas.getSessionStats(1).value().registered);
+    });
+}
+
+BOOST_FIXTURE_TEST_CASE(DPReasTest21, MockCPFixture)
+{
+    std::cout << "DPReasTest21: Test the drain rate controller following a stalled and then draining consumer" << std::endl;
+
+    reportExceptions([&]() {
+        EjfatURI segUri("ejfat://useless@192.168.100.1:9876/lb/1?sync=192.168.0.1:12345&data=127.0.0.1:10700"s, 
+            EjfatURI::TokenType::instance);
+        Segmenter::SegmenterFlags sflags;
+        sflags.useCP = false;
+        Segmenter seg(segUri, 0x0505, 0x11223344, sflags);
+
+        Reassembler::ReassemblerFlags rflags;
+        rflags.withLBHeader = true;
+        rflags.period_ms = 50;
+        rflags.portRange = 0;
+        rflags.drainControl = true;
+        Reassembler reas(reserve("drain"), loopback, 10700, 1, rflags);
+
+        BOOST_CHECK(!reas.registerWorker("drainworker").has_error());
+        BOOST_CHECK(!seg.openAndStart().has_error());
+        BOOST_CHECK(!reas.openAndStart().has_error());
+
+        // events arrive and nobody takes them off the queue
+        std::vector<u_int8_t> event(8000, 'x');
+        for (int i = 0; i < 100; i++)
+        {
+            BOOST_CHECK(!seg.sendEvent(event.data(), event.size()).has_error());
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+        }
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(60));
+
+        auto cs = reas.getControlStats();
+        std::cout << "Stalled: arrival " << cs.arrivalBps << "B/s service " << cs.serviceBps << 
+            "B/s time to full " << cs.timeToFull_ms << "ms signal " << cs.controlSignal << std::endl;
+        BOOST_CHECK(cs.arrivalBps > 0.);
+        BOOST_CHECK(cs.serviceBps == 0.);
+        BOOST_CHECK(cs.timeToFull_ms < std::numeric_limits<float>::infinity());
+        BOOST_CHECK(cs.controlSignal < 0.);
+        BOOST_CHECK(cs.integral == 0.);
+
+        // the consumer catches up
+        u_int8_t *eventBuf{nullptr};
+        size_t eventLen;
+        EventNum_t eventNum;
+        u_int16_t recDataId;
+        int received{0};
+        while (reas.getEvent(&eventBuf, &eventLen, &eventNum, &recDataId).value() != -1)
+        {
+            received++;
+            delete[] eventBuf;
+        }
+        BOOST_CHECK(received == 100);
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(120));
+
+        cs = reas.getControlStats();
+        std::cout << "Draining: arrival " << cs.arrivalBps << "B/s service " << cs.serviceBps << 
+            "B/s time to full " << cs.timeToFull_ms << "ms signal " << cs.controlSignal << std::endl;
+        BOOST_CHECK(cs.serviceBps > cs.arrivalBps);
+        BOOST_CHECK(cs.timeToFull_ms == std::numeric_limits<float>::infinity());
+        BOOST_CHECK(cs.controlSignal > 0.);
+        BOOST_CHECK(cs.controlSignal <= 1.);
+
+        // the control plane saw both
+        bool sawNegative{false}, sawPositive{false};
+        for(auto &sample: mock.getSendStateSamples())
+        {
+            sawNegative = sawNegative || (sample.controlSignal < 0.);
+            sawPositive = sawPositive || (sample.controlSignal > 0.);
+        }
+        BOOST_CHECK(sawNegative);
+        BOOST_CHECK(sawPositive);
+
+        reas.stopThreads();
+        BOOST_CHECK(!reas.deregisterWorker().has_error());
+    });
+}
+
+BOOST_FIXTURE_TEST_CASE(DPReasTest22, MockCPFixture)
+{
+    std::cout << "DPReasTest22: Test the drain rate controller and event queue accounting when the queue overflows" << std::endl;
+
+    reportExceptions([&]() {
+        Reassembler::ReassemblerFlags rflags;
+        rflags.withLBHeader = true;
+        rflags.period_ms = 50;
+        rflags.portRange = 0;
+        rflags.drainControl = true;
+        rflags.eventQueueLimit = 500;
+        u_int16_t listen_port = 10800;
+        Reassembler reas(reserve("overfill"), loopback, listen_port, 1, rflags);
+
+        BOOST_CHECK(!reas.registerWorker("overfillworker").has_error());
+        BOOST_CHECK(!reas.openAndStart().has_error());
+        // the first control step only takes the baseline of the queue throughput
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+
+        // more single frame events than the queue may hold and nobody takes them off it,
+        // spread over several control steps
+        const size_t limit{rflags.eventQueueLimit};
+        const size_t numEvents{limit + 200}, pldLen{1000};
+        FrameSender sender(listen_port, pldLen);
+        for(EventNum_t evt = 1; evt <= numEvents; evt++)
+        {
+            BOOST_CHECK(sender.send(0x0505, 0, pldLen, evt));
+            if (evt % 20 == 0)
+                boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+        }
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(60));
+
+        auto stats = reas.getStats();
+        auto sessStats = reas.getSessionStats(0).value();
+        std::cout << "Reassembled " << stats.eventSuccess << " events, " << stats.enqueueLoss << 
+            " lost to a full queue, " << stats.kernelDrops << " dropped by the kernel" << std::endl;
+        BOOST_CHECK(stats.kernelDrops == 0);
+        BOOST_CHECK(stats.eventSuccess == numEvents);
+        BOOST_CHECK(stats.enqueueLoss == numEvents - limit);
+        BOOST_CHECK(sessStats.queueDepth == limit);
+
+        // the events that found the queue full still count as arrivals, so the controller 
+        // sees a full queue that will not drain
+        auto cs = reas.getControlStats();
+        std::cout << "Overflowing: arrival " << cs.arrivalBps << "B/s service " << cs.serviceBps << 
+            "B/s time to full " << cs.timeToFull_ms << "ms signal " << cs.controlSignal << std::endl;
+        BOOST_CHECK(cs.fillPercent == 1.);
+        BOOST_CHECK(cs.arrivalBps > 0.);
+        BOOST_CHECK(cs.serviceBps == 0.);
+        BOOST_CHECK(cs.timeToFull_ms == 0.);
+        BOOST_CHECK(cs.controlSignal == -1.);
+
+        // only what fit on the queue can be received
+        u_int8_t *eventBuf{nullptr};
+        size_t eventLen;
+        EventNum_t eventNum;
+        u_int16_t recDataId;
+        size_t received{0};
+        while (reas.getEvent(&eventBuf, &eventLen, &eventNum, &recDataId).value() != -1)
+        {
+            received++;
+            delete[] eventBuf;
+        }
+        BOOST_CHECK(received == limit);
+
+        reas.stopThreads();
+        BOOST_CHECK(!reas.deregisterWorker().has_error());
+    });
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -369,4 +369,48 @@ BOOST_AUTO_TEST_CASE(DPSegTest5)
 
     std::remove(iniFileName.c_str());
 }
+BOOST_AUTO_TEST_CASE(DPSegTest6)
+{
+    // test the calibrated TSC clock against the system clocks
+    std::cout << "DPSegTest6: TSC clock uses counter " << TSCClock::usesCounter() << 
+        " at " << TSCClock::ticksPerSec() / 1e6 << " MHz" << std::endl;
+    BOOST_CHECK(TSCClock::ticksPerSec() > 0);
+
+    // wall clock agrees with system_clock, within a few ms to allow for a descheduled
+    // thread between the two reads and for calibration error
+    auto sysNs = boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+        boost::chrono::system_clock::now().time_since_epoch()).count();
+    auto tscNs = TSCClock::realtimeNs();
+    std::cout << "Realtime difference " << tscNs - sysNs << "ns" << std::endl;
+    BOOST_CHECK(std::abs(tscNs - sysNs) < 5000000);
+
+    // elapsed time agrees with steady_clock over an interval longer than the resync period
+    auto steadyStart = boost::chrono::steady_clock::now();
+    auto tscStart = TSCClock::steady::now();
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(1200));
+    auto tscElapsed = boost::chrono::duration_cast<boost::chrono::microseconds>(TSCClock::steady::now() - tscStart).count();
+    auto steadyElapsed = boost::chrono::duration_cast<boost::chrono::microseconds>(
+        boost::chrono::steady_clock::now() - steadyStart).count();
+    std::cout << "Elapsed TSC " << tscElapsed << "us steady " << steadyElapsed << "us" << std::endl;
+    // 0.5% of the interval, but no less than 5ms as the two clocks aren't read at the same instant
+    BOOST_CHECK(std::abs(tscElapsed - steadyElapsed) < std::max<int64_t>(5000, steadyElapsed / 200));
+
+    // monotonic (and the wall clock non-decreasing) across explicit resyncs
+    auto prev = TSCClock::monotonicNs();
+    auto prevReal = TSCClock::realtimeNs();
+    bool monotonic{true}, realNonDecreasing{true};
+    for (int i = 0; i < 1000; i++)
+    {
+        if (i % 100 == 0)
+            TSCClock::resync();
+        auto cur = TSCClock::monotonicNs();
+        auto curReal = TSCClock::realtimeNs();
+        monotonic = monotonic && (cur >= prev);
+        realNonDecreasing = realNonDecreasing && (curReal >= prevReal);
+        prev = cur;
+        prevReal = curReal;
+    }
+    BOOST_CHECK(monotonic);
+    BOOST_CHECK(realNonDecreasing);
+}
 BOOST_AUTO_TEST_SUITE_END()
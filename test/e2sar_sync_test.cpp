@@ -6,6 +6,9 @@
 #include <boost/chrono.hpp>
 #include <boost/thread/thread.hpp>
 #include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
 #include <boost/test/included/unit_test.hpp>
 #include <boost/program_options.hpp>
 
@@ -66,4 +69,176 @@ BOOST_AUTO_TEST_CASE(DPSyncTest1)
     // stop threads and exit
 }
 
+BOOST_AUTO_TEST_CASE(DPSyncTest2)
+{
+    std::cout << "DPSyncTest2: test several segmenters sharing the sync service" << std::endl;
+
+    // local sync receiver
+    int rxFd = socket(AF_INET, SOCK_DGRAM, 0);
+    BOOST_REQUIRE(rxFd >= 0);
+    sockaddr_in rxAddr{};
+    rxAddr.sin_family = AF_INET;
+    rxAddr.sin_port = htons(19531);
+    inet_pton(AF_INET, "127.0.0.1", &rxAddr.sin_addr);
+    BOOST_REQUIRE(bind(rxFd, (sockaddr*)&rxAddr, sizeof(rxAddr)) == 0);
+    struct timeval tv{0, 100000};
+    setsockopt(rxFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    EjfatURI uri("ejfat://useless@192.168.100.1:9876/lb/1?sync=127.0.0.1:19531&data=127.0.0.1"s);
+
+    Segmenter::SegmenterFlags sflags;
+    sflags.sharedSync = true;
+    sflags.syncPeriodMs = 100;
+    sflags.warmUpMs = 10;
+
+    std::vector<u_int64_t> syncCounts;
+    {
+        std::vector<std::unique_ptr<Segmenter>> segs;
+        for (u_int32_t srcId = 1; srcId <= 4; srcId++)
+        {
+            segs.emplace_back(std::make_unique<Segmenter>(uri, 0x0505, srcId, sflags));
+            auto res = segs.back()->openAndStart();
+            if (res.has_error())
+                std::cout << "ERROR: " << res.error().message() << std::endl;
+            BOOST_CHECK(!res.has_error());
+        }
+        BOOST_CHECK(SyncService::getStats().segmenters == 4);
+
+        // wait for ten periods worth of syncs from everyone, allowing for a slow host
+        auto until = boost::chrono::steady_clock::now() + boost::chrono::seconds(5);
+        while (boost::chrono::steady_clock::now() < until)
+        {
+            bool done{true};
+            for (auto &seg: segs)
+                done = done && (seg->getSyncStats().msgCnt >= 10);
+            if (done)
+                break;
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+        }
+        for (auto &seg: segs)
+        {
+            auto syncStats = seg->getSyncStats();
+            BOOST_CHECK(syncStats.errCnt == 0);
+            syncCounts.push_back(syncStats.msgCnt);
+        }
+    }
+    // last segmenter out stops the service
+    auto serviceStats = SyncService::getStats();
+    std::cout << "Service woke up " << serviceStats.wakeups << " times and sent " << 
+        serviceStats.syncsSent << " sync frames" << std::endl;
+    BOOST_CHECK(serviceStats.segmenters == 0);
+    BOOST_CHECK(serviceStats.errors == 0);
+    // segmenters with the same period are sent together
+    BOOST_CHECK(serviceStats.wakeups < serviceStats.syncsSent);
+
+    // every eventSrcId is reported separately at its own period
+    std::map<u_int32_t, u_int64_t> received;
+    SyncHdr hdr;
+    while (recv(rxFd, &hdr, sizeof(hdr), 0) == sizeof(hdr))
+    {
+        BOOST_CHECK(hdr.check_version());
+        received[hdr.get_eventSrcId()]++;
+    }
+    close(rxFd);
+
+    BOOST_CHECK(received.size() == 4);
+    for (u_int32_t srcId = 1; srcId <= 4; srcId++)
+    {
+        std::cout << "Source " << srcId << " sent " << syncCounts[srcId - 1] << 
+            " received " << received[srcId] << std::endl;
+        BOOST_CHECK(syncCounts[srcId - 1] >= 10);
+        BOOST_CHECK(received[srcId] >= syncCounts[srcId - 1]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DPSyncTest3)
+{
+    std::cout << "DPSyncTest3: test sync reporting measured event rate and last sent tick" << std::endl;
+
+    // local sync and data receivers
+    auto bindLocal = [](u_int16_t port) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        BOOST_REQUIRE(bind(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+        struct timeval tv{0, 100000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        int bufSize{4*1024*1024};
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+        return fd;
+    };
+    int syncFd = bindLocal(19532);
+    int dataFd = bindLocal(19533);
+
+    EjfatURI uri("ejfat://useless@192.168.100.1:9876/lb/1?sync=127.0.0.1:19532&data=127.0.0.1:19533"s);
+
+    Segmenter::SegmenterFlags sflags;
+    sflags.measuredSync = true;
+    sflags.syncPeriodMs = 100;
+    sflags.syncPeriods = 3;
+    sflags.warmUpMs = 100;
+    sflags.numSendSockets = 1;
+
+    {
+        Segmenter seg(uri, 0x0505, 0x11223344, sflags);
+        auto res = seg.openAndStart();
+        BOOST_CHECK(!res.has_error());
+
+        // ~200 events/sec for 1.5 seconds
+        std::string eventString{"THIS IS AN EVENT"s};
+        for (int i = 0; i < 300; i++)
+        {
+            auto sendres = seg.sendEvent(reinterpret_cast<u_int8_t*>(eventString.data()), eventString.length());
+            BOOST_CHECK(!sendres.has_error());
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+        }
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(250));
+    }
+
+    // ticks of the events sent
+    std::set<EventNum_t> ticks;
+    u_int8_t buf[9000];
+    while (recv(dataFd, buf, sizeof(buf), 0) > 0)
+        ticks.insert(reinterpret_cast<LBREHdr*>(buf)->lbu.lb2.get_eventNum());
+    close(dataFd);
+
+    std::vector<SyncHdr> syncs;
+    SyncHdr hdr;
+    while (recv(syncFd, &hdr, sizeof(hdr), 0) == sizeof(hdr))
+        syncs.push_back(hdr);
+    close(syncFd);
+
+    std::cout << "Received " << ticks.size() << " events and " << syncs.size() << " sync frames" << std::endl;
+    BOOST_CHECK(ticks.size() == 300);
+    BOOST_REQUIRE(syncs.size() > 10);
+
+    // once events flow, sync reports the tick of an event actually sent
+    // and the rate ticks advance at
+    size_t matched{0};
+    for (auto &s: syncs)
+    {
+        if (ticks.count(s.get_eventNumber()))
+        {
+            matched++;
+            std::cout << "Sync tick " << s.get_eventNumber() << " rate " << s.get_avgEventRateHz() << std::endl;
+        }
+    }
+    BOOST_CHECK(matched > 5);
+    // the last sync while sending - ticks are microseconds, so they advance at about 1MHz
+    // no matter how many events there are
+    auto lastTick = *ticks.rbegin();
+    auto firstIdle = std::find_if(syncs.begin(), syncs.end(), 
+        [lastTick](const SyncHdr &s) { return s.get_eventNumber() == lastTick; });
+    BOOST_REQUIRE(firstIdle != syncs.end());
+    BOOST_REQUIRE(firstIdle != syncs.begin());
+    auto rate = (firstIdle - 1)->get_avgEventRateHz();
+    BOOST_CHECK(ticks.count((firstIdle - 1)->get_eventNumber()) == 1);
+    BOOST_CHECK(rate > 800000 && rate <= 1100000);
+    // last sync after sending stopped reports the last event and a decaying rate
+    BOOST_CHECK(syncs.back().get_eventNumber() == lastTick);
+    BOOST_CHECK(syncs.back().get_avgEventRateHz() < rate);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file